@@ -3,7 +3,8 @@ import os
 import subprocess
 
 TestsToRun = {
-    "./bin/c/benchmark_c_ds": {"ARRAY": "CVEC", "LIST": "CLIST", "QSORT": "QSORTARR"},
+    "./bin/c/benchmark_c_ds": {"ARRAY": "CVEC", "LIST": "CLIST", "LISTMERGE": "CLISTMERGE",
+                               "QSORT": "QSORTARR", "PARALLEL": "CVECPAR", "RADIX": "CVECRADIX"},
     "./bin/cpp/benchmark_cpp_ds": {"ARRAY": "CPPVEC", "LIST": "CPPLIST"}
 }
 
@@ -11,7 +12,8 @@ def get_graph_data():
     nums = [10000,20000,30000,40000,50000,60000,70000,80000,90000]
     for i in range(100000, 10000001, 100000):
         nums.append(i)
-    output = {"CLIST": [], "CPPLIST": [], "CVEC": [], "CPPVEC": [], "QSORTARR": []}
+    output = {"CLIST": [], "CLISTMERGE": [], "CPPLIST": [], "CVEC": [], "CPPVEC": [], "QSORTARR": [],
+              "CVECPAR": [], "CVECRADIX": []}
     for n in nums:
         for name in TestsToRun:
             mappings = TestsToRun[name]
@@ -29,7 +31,8 @@ def get_graph_data():
 
 def get_averages():
     nums = [100, 1000, 10000, 100000, 1000000, 10000000]
-    output = {"CLIST": [], "CPPLIST": [], "CVEC": [], "CPPVEC": [], "QSORTARR": []}
+    output = {"CLIST": [], "CLISTMERGE": [], "CPPLIST": [], "CVEC": [], "CPPVEC": [], "QSORTARR": [],
+              "CVECPAR": [], "CVECRADIX": []}
     for n in nums:
         for name in TestsToRun:
             mappings = TestsToRun[name]
@@ -41,20 +44,39 @@ def get_averages():
                 output[mappings[ds]].append(total / 10)
     print("\n\nAVERAGES:\n")
 
-    outputStr = f'| {"N":<10} | {"C List":<10} | {"C++ List":<10} |\n'
-    outputStr += f"|-{'-' * 10}-|-{'-' * 10}-|-{'-' * 10}-|\n"
+    outputStr = f'| {"N":<10} | {"C List":<10} | {"C Merge":<10} | {"C++ List":<10} |\n'
+    outputStr += f"|-{'-' * 10}-|-{'-' * 10}-|-{'-' * 10}-|-{'-' * 10}-|\n"
     for i in range(len(nums)):
-        outputStr += f"| {nums[i]:>10} | {output['CLIST'][i]:10.3f} | {output['CPPLIST'][i]:10.3f} |\n"
+        outputStr += f"| {nums[i]:>10} | {output['CLIST'][i]:10.3f} | {output['CLISTMERGE'][i]:10.3f} | {output['CPPLIST'][i]:10.3f} |\n"
     print(outputStr)
     print("\n\n")
 
-    outputStr = f'| {"N":<10} | {"Qsort":<10} | {"C Array":<10} | {"C++ Vector":<10} |\n'
-    outputStr += f"|-{'-' * 10}-|-{'-' * 10}-|-{'-' * 10}-|-{'-' * 10}-|\n"
+    outputStr = f'| {"N":<10} | {"Qsort":<10} | {"C Array":<10} | {"C Parallel":<10} | {"C Radix":<10} | {"C++ Vector":<10} |\n'
+    outputStr += f"|-{'-' * 10}-|-{'-' * 10}-|-{'-' * 10}-|-{'-' * 10}-|-{'-' * 10}-|-{'-' * 10}-|\n"
     for i in range(len(nums)):
-        outputStr += f"| {nums[i]:>10} | {output['QSORTARR'][i]:10.3f} | {output['CVEC'][i]:10.3f} | {output['CPPVEC'][i]:10.3f} |\n"
+        outputStr += f"| {nums[i]:>10} | {output['QSORTARR'][i]:10.3f} | {output['CVEC'][i]:10.3f} | {output['CVECPAR'][i]:10.3f} | {output['CVECRADIX'][i]:10.3f} | {output['CPPVEC'][i]:10.3f} |\n"
+    print(outputStr)
+
+def get_queue_averages():
+    configs = [("SPSC", 1, 1), ("MPMC", 1, 1), ("MUTEX", 1, 1), ("MPMC", 4, 4), ("MUTEX", 4, 4)]
+    batches = [1, 16]
+    print("\n\nQUEUES (1000000 elements):\n")
+
+    outputStr = f'| {"Queue":<10} | {"Threads":<10} |' + "".join(f' {"Batch " + str(b):<10} |' for b in batches) + "\n"
+    outputStr += f"|-{'-' * 10}-|-{'-' * 10}-|" + f"-{'-' * 10}-|" * len(batches) + "\n"
+    for ds, p, c in configs:
+        outputStr += f"| {ds:<10} | {f'{p}P/{c}C':<10} |"
+        for b in batches:
+            total = 0.0
+            for i in range(10):
+                s = os.popen(f"./bin/c/benchmark_queue -d {ds} -p {p} -c {c} -b {b} -n 1000000")
+                total += float(s.readlines()[-1])
+            outputStr += f" {total / 10:10.3f} |"
+        outputStr += "\n"
     print(outputStr)
 
 
 if __name__ == "__main__":
     get_graph_data()
     get_averages()
+    get_queue_averages()
@@ -2,6 +2,7 @@
 #define DS_ALG_HELPER_H
 
 #include "ds.h"
+#include "alg_simd.h"
 
 /* --------------------------------------------------------------------------
  * RAI-Oriented Algorithm macros
@@ -16,6 +17,62 @@
 #define sort(id, a, n) ds_sort_##id(a, n)
 
 
+/**
+ * Sorts the array @c a with @c n elements, keeping equal elements in their
+ * original order. Runs that are already in order (or in strictly decreasing
+ * order) are found and merged, so sorted or nearly sorted input takes close
+ * to O(n) time. Up to @c n/2 elements of scratch memory are allocated.
+ *
+ * @param  a  @c t* : Start of array.
+ * @param  n  @c unsigned : Number of elements in the array.
+ *
+ * @return    @c unsigned @c char : True if the array was sorted, false if the
+ *            scratch memory could not be allocated, in which case the array
+ *            holds the same elements but may not be sorted.
+ */
+#define stable_sort(id, a, n) ds_stable_sort_##id(a, n, NULL, 0)
+
+
+/**
+ * Like @c stable_sort , but merges through @c buf , so no memory is allocated
+ * as long as @c bufSize is at least @c n/2 .
+ *
+ * @param  a        @c t* : Start of array.
+ * @param  n        @c unsigned : Number of elements in the array.
+ * @param  buf      @c t* : Scratch space, or NULL.
+ * @param  bufSize  @c unsigned : Number of elements that fit in @c buf .
+ *
+ * @return          @c unsigned @c char : Same as @c stable_sort .
+ */
+#define stable_sort_withBuffer(id, a, n, buf, bufSize)                                   \
+        ds_stable_sort_##id(a, n, buf, bufSize)
+
+
+/**
+ * Rearranges [ @c first , @c last ) so that [ @c first , @c middle ) holds its
+ * smallest elements in sorted order. The order of the remaining elements is
+ * unspecified. Takes O(n log k) time, where k is @c middle - @c first .
+ *
+ * @param  first   @c t* : Pointer to first index in the range.
+ * @param  middle  @c t* : Pointer to the end of the part to sort.
+ * @param  last    @c t* : Pointer to last index in the range (non-inclusive).
+ */
+#define partial_sort(id, first, middle, last) ds_partial_sort_##id(first, middle, last)
+
+
+/**
+ * Rearranges [ @c first , @c last ) so that @c nth holds the element that would
+ * be there if the range was sorted, no element before it is greater and no
+ * element after it is less. Takes O(n) time on average, and O(n log n) at
+ * worst.
+ *
+ * @param  first  @c t* : Pointer to first index in the range.
+ * @param  nth    @c t* : Pointer to the index to select.
+ * @param  last   @c t* : Pointer to last index in the range (non-inclusive).
+ */
+#define nth_element(id, first, nth, last) ds_nth_element_##id(first, nth, last)
+
+
 /**
  * Searches for @c val in an array @c a . The array must have been sorted 
  * prior to calling this function.
@@ -82,6 +139,10 @@
 void ds_make_heap_##id(t* first, t const *last) __attribute__((nonnull));                \
 void ds_sort_heap_##id(t* first, t* last) __attribute__((nonnull));                      \
 void ds_sort_##id(t* arr, unsigned n) __attribute__((nonnull));                          \
+unsigned char ds_stable_sort_##id(t* arr, unsigned n, t* buf, unsigned bufSize)          \
+  __attribute__((nonnull (1)));                                                          \
+void ds_partial_sort_##id(t* first, t* middle, t* last) __attribute__((nonnull));        \
+void ds_nth_element_##id(t* first, t* nth, t* last) __attribute__((nonnull));            \
 t* ds_binary_search_##id(t* arr, int l, int r, const t val)                              \
   __attribute__((nonnull));                                                              \
 void ds_push_heap_##id(t* first, t const *last) __attribute__((nonnull));                \
@@ -97,6 +158,25 @@ void ds_pop_heap_##id(t* first, t* last) __attribute__((nonnull));
  *                  strictly less than @c y .
  */
 #define gen_alg_source(id, t, cmp_lt)                                                    \
+        __ds_gen_alg_source(id, t, cmp_lt, dsk_none)
+
+
+/**
+ * Generates algorithm function definitions for a built-in numeric type,
+ * compared with @c ds_cmp_num_lt . When compiled for AVX2 or SSE4.1, sorting
+ * @c int , @c unsigned or @c float uses a vectorized partition and sorts the
+ * partitions of up to 16 elements with a bitonic sorting network.
+ *
+ * @param  id  ID used in @c gen_alg_headers .
+ * @param  t   Type used in @c gen_alg_headers , written as a single token:
+ *              one of @c char , @c short , @c int , @c long , @c unsigned ,
+ *              @c float or @c double .
+ */
+#define gen_alg_source_numeric(id, t)                                                    \
+        __ds_gen_alg_source(id, t, ds_cmp_num_lt, DSSortKernel_##t)
+
+
+#define __ds_gen_alg_source(id, t, cmp_lt, kernel)                                       \
                                                                                          \
 static void __ds_push_heap_##id(t* first, unsigned i,                                    \
                                 unsigned top, t const *val) {                            \
@@ -140,7 +220,7 @@ void ds_make_heap_##id(t* first, t const *last) {
     unsigned parent;                                                                     \
     if (len < 2) return;                                                                 \
                                                                                          \
-    for (parent = (len - 2) >> 1; parent; --parent) {                                    \
+    for (parent = len >> 1; parent--;) {                                                 \
         t value = *(first + parent);                                                     \
         __ds_adjust_heap_##id(first, parent, len, &value);                               \
     }                                                                                    \
@@ -153,62 +233,74 @@ void ds_sort_heap_##id(t* first, t* last) {
     }                                                                                    \
 }                                                                                        \
                                                                                          \
-static void __ds_introsort_##id(t* first, t* last, unsigned depth_limit) {               \
+static t* __ds_partition_##id(t* first, t* last) {                                       \
+    /* moves the median of three to first and partitions the rest around it */           \
     register t _temp;                                                                    \
-    t* cut; t* left; t* mid; t* right;                                                   \
-    while ((last - first) > 16) {                                                        \
-        if (depth_limit == 0) {                                                          \
-            ds_make_heap_##id(first, last);                                              \
-            ds_sort_heap_##id(first, last);                                              \
-            return;                                                                      \
-        }                                                                                \
-        --depth_limit;                                                                   \
-                                                                                         \
-        mid = first + (last - first) / 2;                                                \
-        left = first + 1;                                                                \
-        right = last - 1;                                                                \
-        _temp = *first;                                                                  \
-        if (cmp_lt(*left, *mid)) {                                                       \
-            if (cmp_lt(*mid, *right)) {                                                  \
-                *first = *mid;                                                           \
-                *mid = _temp;                                                            \
-            } else if (cmp_lt(*left, *right)) {                                          \
-                *first = *right;                                                         \
-                *right = _temp;                                                          \
-            } else {                                                                     \
-                *first = *left;                                                          \
-                *left = _temp;                                                           \
-            }                                                                            \
+    t* left; t* mid; t* right;                                                           \
+    mid = first + (last - first) / 2;                                                    \
+    left = first + 1;                                                                    \
+    right = last - 1;                                                                    \
+    _temp = *first;                                                                      \
+    if (cmp_lt(*left, *mid)) {                                                           \
+        if (cmp_lt(*mid, *right)) {                                                      \
+            *first = *mid;                                                               \
+            *mid = _temp;                                                                \
         } else if (cmp_lt(*left, *right)) {                                              \
-            *first = *left;                                                              \
-            *left = _temp;                                                               \
-        } else if (cmp_lt(*mid, *right)) {                                               \
             *first = *right;                                                             \
             *right = _temp;                                                              \
         } else {                                                                         \
-            *first = *mid;                                                               \
-            *mid = _temp;                                                                \
+            *first = *left;                                                              \
+            *left = _temp;                                                               \
         }                                                                                \
+    } else if (cmp_lt(*left, *right)) {                                                  \
+        *first = *left;                                                                  \
+        *left = _temp;                                                                   \
+    } else if (cmp_lt(*mid, *right)) {                                                   \
+        *first = *right;                                                                 \
+        *right = _temp;                                                                  \
+    } else {                                                                             \
+        *first = *mid;                                                                   \
+        *mid = _temp;                                                                    \
+    }                                                                                    \
                                                                                          \
-        left = first + 1;                                                                \
-        right = last;                                                                    \
-        mid = first;                                                                     \
-        while (1) {                                                                      \
-            while (cmp_lt(*left, *mid)) ++left;                                          \
-            --right;                                                                     \
-            while (cmp_lt(*mid, *right)) --right;                                        \
-            if (!(left < right)) {                                                       \
-                cut = left;                                                              \
-                break;                                                                   \
-            }                                                                            \
-            _temp = *left;                                                               \
-            *left = *right;                                                              \
-            *right = _temp;                                                              \
-            ++left;                                                                      \
+    left = first + 1;                                                                    \
+    right = last;                                                                        \
+    mid = first;                                                                         \
+    while (1) {                                                                          \
+        while (cmp_lt(*left, *mid)) ++left;                                              \
+        --right;                                                                         \
+        while (cmp_lt(*mid, *right)) --right;                                            \
+        if (!(left < right)) return left;                                                \
+        _temp = *left;                                                                   \
+        *left = *right;                                                                  \
+        *right = _temp;                                                                  \
+        ++left;                                                                          \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+/* Partitions with the vector kernel if there is one, which may advance *pfirst
+   past elements equal to the pivot (and then returns last). */                          \
+static t* __ds_partition_step_##id(t** pfirst, t* last) {                                \
+    if (__ds_sortk(on, kernel)) return __ds_sortk(partition, kernel)(pfirst, last);      \
+    return __ds_partition_##id(*pfirst, last);                                           \
+}                                                                                        \
+                                                                                         \
+static void __ds_introsort_##id(t* first, t* last, unsigned depth_limit) {               \
+    t* cut;                                                                              \
+    while ((last - first) > 16) {                                                        \
+        if (depth_limit == 0) {                                                          \
+            ds_make_heap_##id(first, last);                                              \
+            ds_sort_heap_##id(first, last);                                              \
+            return;                                                                      \
         }                                                                                \
+        --depth_limit;                                                                   \
+        cut = __ds_partition_step_##id(&first, last);                                    \
         __ds_introsort_##id(cut, last, depth_limit);                                     \
         last = cut;                                                                      \
     }                                                                                    \
+    if (__ds_sortk(on, kernel)) {                                                        \
+        __ds_sortk(small, kernel)(first, (unsigned) (last - first));                     \
+    }                                                                                    \
 }                                                                                        \
                                                                                          \
 /* --------------------------------------------------------------------------
@@ -238,22 +330,307 @@ static void __ds_insertion_sort_##id(t* first, t const *last) {
     }                                                                                    \
 }                                                                                        \
                                                                                          \
+static void __ds_sort_range_##id(t* first, t* last, unsigned depth_limit) {              \
+    t* i;                                                                                \
+    __ds_introsort_##id(first, last, depth_limit);                                       \
+    /* with a kernel, every partition has already been sorted */                         \
+    if (__ds_sortk(on, kernel)) return;                                                  \
+                                                                                         \
+    if ((last - first) > 16) {                                                           \
+        __ds_insertion_sort_##id(first, first + 16);                                     \
+        for (i = first + 16; i != last; ++i) {                                           \
+            __ds_unguarded_linear_insert_##id(i);                                        \
+        }                                                                                \
+    } else {                                                                             \
+        __ds_insertion_sort_##id(first, last);                                           \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
 void ds_sort_##id(t* arr, unsigned n) {                                                  \
-    t* last = &arr[n]; t* i;                                                             \
-    unsigned depth = 0;                                                                  \
+    unsigned depth;                                                                      \
     if (n <= 1) return;                                                                  \
                                                                                          \
-    while ((n >>= 1) >= 1) ++depth;                                                      \
-    __ds_introsort_##id(arr, last, depth << 1);                                          \
+    for (depth = 0; (n >> depth) > 1; ++depth);                                          \
+    __ds_sort_range_##id(arr, arr + n, depth << 1);                                      \
+}                                                                                        \
                                                                                          \
-    if ((last - arr) > 16) {                                                             \
-        __ds_insertion_sort_##id(arr, arr + 16);                                         \
-        for (i = arr + 16; i != last; ++i) {                                             \
-            __ds_unguarded_linear_insert_##id(i);                                        \
+void ds_partial_sort_##id(t* first, t* middle, t* last) {                                \
+    t* i;                                                                                \
+    if (first == middle) return;                                                         \
+    ds_make_heap_##id(first, middle);                                                    \
+    /* the heap holds the smallest elements seen so far, the greatest on top */          \
+    for (i = middle; i < last; ++i) {                                                    \
+        if (cmp_lt(*i, *first)) {                                                        \
+            __ds_pop_heap_##id(first, middle, i);                                        \
+        }                                                                                \
+    }                                                                                    \
+    ds_sort_heap_##id(first, middle);                                                    \
+}                                                                                        \
+                                                                                         \
+                                                                                         \
+void ds_nth_element_##id(t* first, t* nth, t* last) {                                    \
+    t* cut;                                                                              \
+    unsigned depth;                                                                      \
+    if (nth == last) return;                                                             \
+                                                                                         \
+    for (depth = 0; ((unsigned) (last - first) >> depth) > 1; ++depth);                  \
+    depth <<= 1;                                                                         \
+    while ((last - first) > 16) {                                                        \
+        if (depth == 0) {                                                                \
+            /* the pivots keep being poor, so select with a heap instead */              \
+            ds_partial_sort_##id(first, nth + 1, last);                                  \
+            return;                                                                      \
+        }                                                                                \
+        --depth;                                                                         \
+        cut = __ds_partition_step_##id(&first, last);                                    \
+        if (nth < first) return;                                                         \
+        if (cut <= nth) first = cut;                                                     \
+        else last = cut;                                                                 \
+    }                                                                                    \
+    if (__ds_sortk(on, kernel)) {                                                        \
+        __ds_sortk(small, kernel)(first, (unsigned) (last - first));                     \
+    } else {                                                                             \
+        __ds_insertion_sort_##id(first, last);                                           \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+/* --------------------------------------------------------------------------
+ * stable sort functions
+ * -------------------------------------------------------------------------- */         \
+                                                                                         \
+static unsigned __ds_count_run_##id(t* first, t* last) {                                 \
+    t* i = first + 1;                                                                    \
+    unsigned len;                                                                        \
+    t _temp;                                                                             \
+    if (i == last) return 1;                                                             \
+    if (!cmp_lt(*i, *first)) {                                                           \
+        for (++i; i != last && !cmp_lt(*i, *(i - 1)); ++i);                              \
+        return (unsigned) (i - first);                                                   \
+    }                                                                                    \
+    /* only strictly decreasing runs are reversed, which keeps the sort stable */        \
+    for (++i; i != last && cmp_lt(*i, *(i - 1)); ++i);                                   \
+    len = (unsigned) (i - first);                                                        \
+    for (--i; first < i; ++first, --i) {                                                 \
+        _temp = *first;                                                                  \
+        *first = *i;                                                                     \
+        *i = _temp;                                                                      \
+    }                                                                                    \
+    return len;                                                                          \
+}                                                                                        \
+                                                                                         \
+static void __ds_binary_insertion_sort_##id(t* first, t* start, t const *last) {         \
+    /* [first, start) is already sorted */                                               \
+    t* lo; t* hi; t* mid;                                                                \
+    t val;                                                                               \
+    for (; start != last; ++start) {                                                     \
+        val = *start;                                                                    \
+        lo = first;                                                                      \
+        hi = start;                                                                      \
+        while (lo < hi) {                                                                \
+            mid = lo + (hi - lo) / 2;                                                    \
+            if (cmp_lt(val, *mid)) hi = mid;                                             \
+            else lo = mid + 1;                                                           \
+        }                                                                                \
+        memmove(lo + 1, lo, (unsigned) (start - lo) * sizeof(t));                        \
+        *lo = val;                                                                       \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+static unsigned __ds_gallop_##id(t const *key, t const *a, unsigned n,                   \
+                                 unsigned char right, unsigned char fromEnd) {           \
+    /*                                                                                   \
+     * Returns the number of elements in a that go before key: those less than           \
+     * it, or also those equal to it if right is set. The search probes 1, 2,            \
+     * 4, ... elements from the start (or the end) before a binary search, so            \
+     * it takes O(log k) comparisons when the answer is k elements from there.           \
+     */                                                                                  \
+    unsigned lo = 0, hi = n, ofs = 0, step = 1, mid;                                     \
+    if (fromEnd) {                                                                       \
+        while (ofs < n && !(right ? !cmp_lt(*key, a[n - 1 - ofs])                        \
+                                  : cmp_lt(a[n - 1 - ofs], *key))) {                     \
+            hi = n - 1 - ofs;                                                            \
+            ofs = (n - ofs > step) ? ofs + step : n;                                     \
+            step <<= 1;                                                                  \
         }                                                                                \
+        lo = n - ofs;                                                                    \
     } else {                                                                             \
-        __ds_insertion_sort_##id(arr, last);                                             \
+        while (ofs < n && (right ? !cmp_lt(*key, a[ofs]) : cmp_lt(a[ofs], *key))) {      \
+            lo = ofs + 1;                                                                \
+            ofs = (n - ofs > step) ? ofs + step : n;                                     \
+            step <<= 1;                                                                  \
+        }                                                                                \
+        hi = ofs;                                                                        \
+    }                                                                                    \
+    while (lo < hi) {                                                                    \
+        mid = lo + ((hi - lo) >> 1);                                                     \
+        if (right ? !cmp_lt(*key, a[mid]) : cmp_lt(a[mid], *key)) lo = mid + 1;          \
+        else hi = mid;                                                                   \
+    }                                                                                    \
+    return lo;                                                                           \
+}                                                                                        \
+                                                                                         \
+static void __ds_merge_lo_##id(t* a, unsigned na, t* b, unsigned nb,                     \
+                               t* buf, unsigned *minGallop) {                            \
+    /* b[0] goes before a[0], and a[na - 1] goes after every element of b */             \
+    t* pa = buf;                                                                         \
+    t* dest = a;                                                                         \
+    unsigned acount = 0, bcount = 0, k, j;                                               \
+    memcpy(buf, a, na * sizeof(t));                                                      \
+    *dest++ = *b++;                                                                      \
+    --nb;                                                                                \
+    while (nb && na > 1) {                                                               \
+        if (acount < *minGallop && bcount < *minGallop) {                                \
+            if (cmp_lt(*b, *pa)) {                                                       \
+                *dest++ = *b++;                                                          \
+                --nb;                                                                    \
+                ++bcount;                                                                \
+                acount = 0;                                                              \
+            } else {                                                                     \
+                *dest++ = *pa++;                                                         \
+                --na;                                                                    \
+                ++acount;                                                                \
+                bcount = 0;                                                              \
+            }                                                                            \
+            continue;                                                                    \
+        }                                                                                \
+        /* one run keeps winning, so copy whole stretches of it */                       \
+        k = __ds_gallop_##id(b, pa, na, 1, 0);                                           \
+        memcpy(dest, pa, k * sizeof(t));                                                 \
+        dest += k;                                                                       \
+        pa += k;                                                                         \
+        na -= k;                                                                         \
+        if (na <= 1) break;                                                              \
+        *dest++ = *b++;                                                                  \
+        if (!--nb) break;                                                                \
+        j = __ds_gallop_##id(pa, b, nb, 0, 0);                                           \
+        memmove(dest, b, j * sizeof(t));                                                 \
+        dest += j;                                                                       \
+        b += j;                                                                          \
+        nb -= j;                                                                         \
+        if (!nb) break;                                                                  \
+        *dest++ = *pa++;                                                                 \
+        --na;                                                                            \
+        if (k < DS_STABLE_SORT_MIN_GALLOP && j < DS_STABLE_SORT_MIN_GALLOP) {            \
+            ++*minGallop;                                                                \
+            acount = bcount = 0;                                                         \
+        } else if (*minGallop > 1) {                                                     \
+            --*minGallop;                                                                \
+        }                                                                                \
     }                                                                                    \
+    memmove(dest, b, nb * sizeof(t));                                                    \
+    memcpy(dest + nb, pa, na * sizeof(t));                                               \
+}                                                                                        \
+                                                                                         \
+static void __ds_merge_hi_##id(t* a, unsigned na, t* b, unsigned nb,                     \
+                               t* buf, unsigned *minGallop) {                            \
+    /* the mirror image of __ds_merge_lo, filling in from the end */                     \
+    t* dest = b + nb;                                                                    \
+    unsigned acount = 0, bcount = 0, k, j;                                               \
+    memcpy(buf, b, nb * sizeof(t));                                                      \
+    *--dest = a[--na];                                                                   \
+    while (na && nb > 1) {                                                               \
+        if (acount < *minGallop && bcount < *minGallop) {                                \
+            if (cmp_lt(buf[nb - 1], a[na - 1])) {                                        \
+                *--dest = a[--na];                                                       \
+                ++acount;                                                                \
+                bcount = 0;                                                              \
+            } else {                                                                     \
+                *--dest = buf[--nb];                                                     \
+                ++bcount;                                                                \
+                acount = 0;                                                              \
+            }                                                                            \
+            continue;                                                                    \
+        }                                                                                \
+        k = na - __ds_gallop_##id(&buf[nb - 1], a, na, 1, 1);                            \
+        dest -= k;                                                                       \
+        na -= k;                                                                         \
+        memmove(dest, a + na, k * sizeof(t));                                            \
+        if (!na) break;                                                                  \
+        *--dest = buf[--nb];                                                             \
+        if (nb <= 1) break;                                                              \
+        j = nb - __ds_gallop_##id(&a[na - 1], buf, nb, 0, 1);                            \
+        dest -= j;                                                                       \
+        nb -= j;                                                                         \
+        memcpy(dest, buf + nb, j * sizeof(t));                                           \
+        if (nb <= 1) break;                                                              \
+        *--dest = a[--na];                                                               \
+        if (k < DS_STABLE_SORT_MIN_GALLOP && j < DS_STABLE_SORT_MIN_GALLOP) {            \
+            ++*minGallop;                                                                \
+            acount = bcount = 0;                                                         \
+        } else if (*minGallop > 1) {                                                     \
+            --*minGallop;                                                                \
+        }                                                                                \
+    }                                                                                    \
+    dest -= na;                                                                          \
+    memmove(dest, a, na * sizeof(t));                                                    \
+    memcpy(dest - nb, buf, nb * sizeof(t));                                              \
+}                                                                                        \
+                                                                                         \
+static void __ds_merge_runs_##id(t* a, unsigned na, unsigned nb,                         \
+                                 t* buf, unsigned *minGallop) {                          \
+    t* const b = a + na;                                                                 \
+    /* the start of a and the end of b are already in place */                           \
+    unsigned const k = __ds_gallop_##id(b, a, na, 1, 0);                                 \
+    a += k;                                                                              \
+    na -= k;                                                                             \
+    if (!na) return;                                                                     \
+    nb = __ds_gallop_##id(a + na - 1, b, nb, 0, 1);                                      \
+    if (!nb) return;                                                                     \
+    if (na <= nb) __ds_merge_lo_##id(a, na, b, nb, buf, minGallop);                      \
+    else __ds_merge_hi_##id(a, na, b, nb, buf, minGallop);                               \
+}                                                                                        \
+                                                                                         \
+unsigned char ds_stable_sort_##id(t* arr, unsigned n, t* buf, unsigned bufSize) {        \
+    unsigned runBase[64], runLen[64];                                                    \
+    unsigned runs = 0, lo = 0, len, minRun, force, i;                                    \
+    unsigned minGallop = DS_STABLE_SORT_MIN_GALLOP;                                      \
+    size_t bytes;                                                                        \
+    t* scratch = buf;                                                                    \
+    if (n < 2) return 1;                                                                 \
+                                                                                         \
+    len = __ds_count_run_##id(arr, arr + n);                                             \
+    if (len == n) return 1;                                                              \
+    if (!buf || bufSize < n / 2) {                                                       \
+        bytes = (n / 2) * sizeof(t);                                                     \
+        if (bytes / sizeof(t) != n / 2 || !(scratch = __ds_malloc(bytes))) return 0;     \
+    }                                                                                    \
+    /* a minimum run length in [32, 64] that splits n into about a power of 2 */         \
+    for (minRun = n, i = 0; minRun >= 64; minRun >>= 1) i |= minRun & 1;                 \
+    minRun += i;                                                                         \
+                                                                                         \
+    while (1) {                                                                          \
+        if (len < minRun) {                                                              \
+            i = min(minRun, n - lo);                                                     \
+            __ds_binary_insertion_sort_##id(arr + lo, arr + lo + len, arr + lo + i);     \
+            len = i;                                                                     \
+        }                                                                                \
+        runBase[runs] = lo;                                                              \
+        runLen[runs++] = len;                                                            \
+        lo += len;                                                                       \
+        force = (lo == n);                                                               \
+        /* merge until the run lengths shrink at least as fast as Fibonacci */           \
+        while (runs > 1) {                                                               \
+            i = runs - 2;                                                                \
+            if (force || (i > 0 && runLen[i - 1] <= runLen[i] + runLen[i + 1]) ||        \
+                (i > 1 && runLen[i - 2] <= runLen[i - 1] + runLen[i])) {                 \
+                if (i > 0 && runLen[i - 1] < runLen[i + 1]) --i;                         \
+            } else if (runLen[i] > runLen[i + 1]) {                                      \
+                break;                                                                   \
+            }                                                                            \
+            __ds_merge_runs_##id(arr + runBase[i], runLen[i], runLen[i + 1],             \
+                                 scratch, &minGallop);                                   \
+            runLen[i] += runLen[i + 1];                                                  \
+            if (i + 3 == runs) {                                                         \
+                runBase[i + 1] = runBase[i + 2];                                         \
+                runLen[i + 1] = runLen[i + 2];                                           \
+            }                                                                            \
+            --runs;                                                                      \
+        }                                                                                \
+        if (force) break;                                                                \
+        len = __ds_count_run_##id(arr + lo, arr + n);                                    \
+    }                                                                                    \
+    if (scratch != buf) __ds_free(scratch);                                              \
+    return 1;                                                                            \
 }                                                                                        \
                                                                                          \
 t* ds_binary_search_##id(t* arr, int l, int r, const t val) {                            \
@@ -282,4 +659,189 @@ void ds_pop_heap_##id(t* first, t* last) {
     }                                                                                    \
 }                                                                                        \
 
+/* Consecutive wins by one run after which a stable merge starts galloping. */
+#ifndef DS_STABLE_SORT_MIN_GALLOP
+#define DS_STABLE_SORT_MIN_GALLOP 7
+#endif
+
+/* --------------------------------------------------------------------------
+ * Radix sort
+ * -------------------------------------------------------------------------- */
+
+/*
+ * LSD radix sort for elements with an unsigned integer key. A single read pass
+ * builds the histograms of every digit up front, then each digit moves the
+ * elements between the array and a scratch buffer of the same size, so the
+ * sort takes O(n) time and is stable. Keys of up to 32 bits use 11-bit digits
+ * (3 passes); wider keys are sorted a byte at a time. Digits that are the same
+ * for every key are skipped.
+ */
+
+/* Arrays with fewer elements than this are sorted with ds_stable_sort instead. */
+#ifndef DS_RADIX_SORT_CUTOFF
+#define DS_RADIX_SORT_CUTOFF 512
+#endif
+
+/*
+ * How many elements ahead each scatter pass prefetches the slot it will write.
+ * The 2048 output streams of an 11-bit digit are more than the hardware
+ * prefetcher follows; the histogram pass reads sequentially and needs none.
+ */
+#ifndef DS_RADIX_PREFETCH_DISTANCE
+#define DS_RADIX_PREFETCH_DISTANCE 32
+#endif
+
+/**
+ * Sorts the array @c a with @c n elements by the keys given to
+ * @c gen_alg_source_radix .
+ *
+ * @param  a  @c t* : Start of array.
+ * @param  n  @c unsigned : Number of elements in the array.
+ */
+#define radix_sort(id, a, n) ds_radix_sort_##id(a, n)
+
+
+/*
+ * Keys for gen_alg_source_radix that order the built-in numeric types the
+ * same way as ds_cmp_num_lt (except that -0.0 comes before 0.0).
+ */
+#define DSRadix_keyUnsigned(x) (x)
+#define DSRadix_keyInt(x) ((unsigned) (x) ^ (~0u ^ (~0u >> 1)))
+#define DSRadix_keyLong(x) ((unsigned long) (x) ^ (~0ul ^ (~0ul >> 1)))
+#define DSRadix_keyFloat(x) __ds_radix_key_float(x)
+
+__attribute__((__unused__)) static
+#if __STDC_VERSION__ >= 199901L
+inline
+#endif
+unsigned __ds_radix_key_float(float x);
+
+unsigned __ds_radix_key_float(float x) {
+    /* negative floats order backwards, so all their bits are flipped */
+    unsigned k;
+    memcpy(&k, &x, sizeof(k));
+    return (k & ~(~0u >> 1)) ? ~k : k | ~(~0u >> 1);
+}
+
+#if __STDC_VERSION__ >= 199901L || ULONG_MAX > 0xffffffffUL
+#if __STDC_VERSION__ >= 199901L
+typedef unsigned long long DSRadixKey64;
+#else
+typedef unsigned long DSRadixKey64;
+#endif
+
+#define DSRadix_keyDouble(x) __ds_radix_key_double(x)
+
+__attribute__((__unused__)) static
+#if __STDC_VERSION__ >= 199901L
+inline
+#endif
+DSRadixKey64 __ds_radix_key_double(double x);
+
+DSRadixKey64 __ds_radix_key_double(double x) {
+    DSRadixKey64 k;
+    memcpy(&k, &x, sizeof(k));
+    return (k & ~(~(DSRadixKey64) 0 >> 1)) ? ~k : k | ~(~(DSRadixKey64) 0 >> 1);
+}
+#endif
+
+
+/**
+ * Generates the radix sort function declaration for the specified type. Use
+ * it along with @c gen_alg_headers (or @c gen_array_headers_withAlg ).
+ *
+ * @param  id  ID used in @c gen_alg_headers .
+ * @param  t   Type used in @c gen_alg_headers .
+ */
+#define gen_alg_headers_radix(id, t)                                                     \
+                                                                                         \
+void ds_radix_sort_##id(t* arr, unsigned n) __attribute__((nonnull));                    \
+
+
+/**
+ * Generates the radix sort function definition for the specified type. Small
+ * arrays, and arrays for which the scratch buffer cannot be allocated, are
+ * sorted with the stable sort generated by @c gen_alg_source (or
+ * @c gen_array_source_withAlg ), which must be expanded before it in the same
+ * file; if even that cannot allocate, an insertion sort is used.
+ *
+ * @param  id          ID used in @c gen_alg_source .
+ * @param  t           Type used in @c gen_alg_source .
+ * @param  keyExtract  Macro of the form @c (x) that returns the key of @c x as
+ *                      an unsigned integer, such that the keys order the
+ *                      elements the same way as @c cmp_lt .
+ *                       - For unsigned types, pass @c DSRadix_keyUnsigned .
+ *                       - For @c int , @c long , @c float and @c double , pass
+ *                        @c DSRadix_keyInt , @c DSRadix_keyLong ,
+ *                        @c DSRadix_keyFloat or @c DSRadix_keyDouble .
+ */
+#define gen_alg_source_radix(id, t, keyExtract)                                          \
+                                                                                         \
+static void __ds_radix_fallback_##id(t* arr, unsigned n) {                               \
+    unsigned i, j;                                                                       \
+    t tmp;                                                                               \
+    if (ds_stable_sort_##id(arr, n, NULL, 0)) return;                                    \
+    for (i = 1; i < n; ++i) {                                                            \
+        tmp = arr[i];                                                                    \
+        for (j = i; j && keyExtract(tmp) < keyExtract(arr[j - 1]); --j) {                \
+            arr[j] = arr[j - 1];                                                         \
+        }                                                                                \
+        arr[j] = tmp;                                                                    \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+void ds_radix_sort_##id(t* arr, unsigned n) {                                            \
+    unsigned const keyBits = (unsigned) (sizeof(keyExtract(*arr)) * CHAR_BIT);           \
+    unsigned const digitBits = keyBits <= 32 ? 11 : 8;                                   \
+    unsigned const passes = (keyBits + digitBits - 1) / digitBits;                       \
+    size_t const radix = (size_t) 1 << digitBits;                                        \
+    unsigned *counts;                                                                    \
+    unsigned i, p;                                                                       \
+    t* buf; t* src = arr; t* dst;                                                        \
+    if (n < DS_RADIX_SORT_CUTOFF || !(buf = __ds_malloc(n * sizeof(t)))) {               \
+        __ds_radix_fallback_##id(arr, n);                                                \
+        return;                                                                          \
+    } else if (!(counts = __ds_calloc(passes * radix, sizeof(unsigned)))) {              \
+        ds_stable_sort_##id(arr, n, buf, n);                                             \
+        __ds_free(buf);                                                                  \
+        return;                                                                          \
+    }                                                                                    \
+                                                                                         \
+    for (i = 0; i < n; ++i) {                                                            \
+        unsigned *c = counts;                                                            \
+        for (p = 0; p < passes; ++p, c += radix) {                                       \
+            ++c[(keyExtract(arr[i]) >> (p * digitBits)) & (radix - 1)];                  \
+        }                                                                                \
+    }                                                                                    \
+                                                                                         \
+    dst = buf;                                                                           \
+    for (p = 0; p < passes; ++p) {                                                       \
+        unsigned *c = counts + p * radix;                                                \
+        unsigned const shift = p * digitBits;                                            \
+        unsigned sum = 0, count;                                                         \
+        size_t d;                                                                        \
+        if (c[(keyExtract(*src) >> shift) & (radix - 1)] == n) continue;                 \
+                                                                                         \
+        for (d = 0; d < radix; ++d) {                                                    \
+            count = c[d];                                                                \
+            c[d] = sum;                                                                  \
+            sum += count;                                                                \
+        }                                                                                \
+        for (i = 0; i + DS_RADIX_PREFETCH_DISTANCE < n; ++i) {                           \
+            t const *ahead = &src[i + DS_RADIX_PREFETCH_DISTANCE];                       \
+            __builtin_prefetch(&dst[c[(keyExtract(*ahead) >> shift) & (radix - 1)]], 1); \
+            dst[c[(keyExtract(src[i]) >> shift) & (radix - 1)]++] = src[i];              \
+        }                                                                                \
+        for (; i < n; ++i) {                                                             \
+            dst[c[(keyExtract(src[i]) >> shift) & (radix - 1)]++] = src[i];              \
+        }                                                                                \
+        dst = src;                                                                       \
+        src = src == arr ? buf : arr;                                                    \
+    }                                                                                    \
+                                                                                         \
+    if (src != arr) memcpy(arr, src, n * sizeof(t));                                     \
+    __ds_free(counts);                                                                   \
+    __ds_free(buf);                                                                      \
+}                                                                                        \
+
 #endif /* DS_ALG_HELPER_H */
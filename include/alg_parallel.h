@@ -0,0 +1,201 @@
+#ifndef DS_ALG_PARALLEL_H
+#define DS_ALG_PARALLEL_H
+
+#include "alg_helper.h"
+#ifndef __CDS_SCAN
+#include <pthread.h>
+#include <sched.h>
+#endif /* __CDS_SCAN */
+
+/*
+ * Multi-threaded introsort. The array is partitioned the same way as by
+ * ds_sort; one half of each partition is pushed as a task onto the queue of
+ * the thread that split it, and that thread carries on with the other half.
+ * Threads take their own newest task first and, once their queue is empty,
+ * steal the oldest (and so largest) task from another thread. Ranges below
+ * DS_SORT_PARALLEL_CUTOFF elements are sorted with ds_sort's single-threaded
+ * code.
+ *
+ * Programs using it must be built with -pthread.
+ */
+
+/* Ranges with fewer elements than this are not split further (must be > 16). */
+#ifndef DS_SORT_PARALLEL_CUTOFF
+#define DS_SORT_PARALLEL_CUTOFF 8192
+#endif
+
+/* Tasks each thread can queue; a thread with a full queue sorts the range itself. */
+#define DS_SORT_PARALLEL_QUEUE 64
+
+/* --------------------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------------------- */
+
+/**
+ * Sorts the array @c a with @c n elements using @c nthreads threads,
+ * including the calling one. With fewer than 2 threads, or if the threads
+ * cannot be set up, this is the same as @c sort .
+ *
+ * @param  a         @c t* : Start of array.
+ * @param  n         @c unsigned : Number of elements in the array.
+ * @param  nthreads  @c unsigned : Number of threads to sort with.
+ */
+#define sort_parallel(id, a, n, nthreads) ds_sort_parallel_##id(a, n, nthreads)
+
+
+/**
+ * Generates the parallel sort function declaration for the specified type.
+ * Use it along with @c gen_alg_headers (or @c gen_array_headers_withAlg ).
+ *
+ * @param  id  ID used in @c gen_alg_headers .
+ * @param  t   Type used in @c gen_alg_headers .
+ */
+#define gen_alg_parallel_headers(id, t)                                                  \
+                                                                                         \
+void ds_sort_parallel_##id(t* arr, unsigned n, unsigned nthreads)                        \
+  __attribute__((nonnull));                                                              \
+
+
+/**
+ * Generates the parallel sort function definition for the specified type. It
+ * uses the sorting code generated by @c gen_alg_source (or
+ * @c gen_array_source_withAlg ), which must be expanded before it in the same
+ * file.
+ *
+ * @param  id  ID used in @c gen_alg_source .
+ * @param  t   Type used in @c gen_alg_source .
+ */
+#define gen_alg_parallel_source(id, t)                                                   \
+                                                                                         \
+typedef struct {                                                                         \
+    t* first;                                                                            \
+    t* last;                                                                             \
+    unsigned depth;                                                                      \
+} __DSSortTask_##id;                                                                     \
+                                                                                         \
+typedef struct __DSSortPool_##id __DSSortPool_##id;                                      \
+                                                                                         \
+typedef struct {                                                                         \
+    pthread_mutex_t lock;                                                                \
+    unsigned top;                                                                        \
+    unsigned bottom;                                                                     \
+    __DSSortTask_##id tasks[DS_SORT_PARALLEL_QUEUE];                                     \
+    __DSSortPool_##id *pool;                                                             \
+    unsigned self;                                                                       \
+} __DSSortQueue_##id;                                                                    \
+                                                                                         \
+struct __DSSortPool_##id {                                                               \
+    __DSSortQueue_##id *queues;                                                          \
+    unsigned nthreads;                                                                   \
+    unsigned long pending;                                                               \
+};                                                                                       \
+                                                                                         \
+static unsigned char __ds_sort_push_##id(__DSSortQueue_##id *q,                          \
+                                         t* first, t* last, unsigned depth) {            \
+    unsigned char pushed = 0;                                                            \
+    pthread_mutex_lock(&q->lock);                                                        \
+    if (q->bottom < DS_SORT_PARALLEL_QUEUE) {                                            \
+        q->tasks[q->bottom].first = first;                                               \
+        q->tasks[q->bottom].last = last;                                                 \
+        q->tasks[q->bottom].depth = depth;                                               \
+        ++q->bottom;                                                                     \
+        pushed = 1;                                                                      \
+    }                                                                                    \
+    pthread_mutex_unlock(&q->lock);                                                      \
+    return pushed;                                                                       \
+}                                                                                        \
+                                                                                         \
+static unsigned char __ds_sort_take_##id(__DSSortPool_##id *pool, unsigned self,         \
+                                         __DSSortTask_##id *task) {                      \
+    /* pops the newest task of this thread, or steals the oldest of another */           \
+    unsigned i;                                                                          \
+    for (i = 0; i < pool->nthreads; ++i) {                                               \
+        __DSSortQueue_##id *q = &pool->queues[(self + i) % pool->nthreads];              \
+        unsigned char found = 0;                                                         \
+        pthread_mutex_lock(&q->lock);                                                    \
+        if (q->top != q->bottom) {                                                       \
+            *task = i ? q->tasks[q->top++] : q->tasks[--q->bottom];                      \
+            if (q->top == q->bottom) q->top = q->bottom = 0;                             \
+            found = 1;                                                                   \
+        }                                                                                \
+        pthread_mutex_unlock(&q->lock);                                                  \
+        if (found) return 1;                                                             \
+    }                                                                                    \
+    return 0;                                                                            \
+}                                                                                        \
+                                                                                         \
+static void __ds_sort_task_##id(__DSSortPool_##id *pool, unsigned self,                  \
+                                t* first, t* last, unsigned depth) {                     \
+    while (last - first > DS_SORT_PARALLEL_CUTOFF && depth) {                            \
+        t* cut = __ds_partition_step_##id(&first, last);                                 \
+        --depth;                                                                         \
+        if (cut == last) continue; /* only elements equal to the pivot were skipped */   \
+        /* counted before it is pushed, so pending cannot drop to 0 meanwhile */         \
+        __atomic_add_fetch(&pool->pending, 1, __ATOMIC_RELAXED);                         \
+        if (!__ds_sort_push_##id(&pool->queues[self], cut, last, depth)) {               \
+            __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_RELAXED);                     \
+            __ds_sort_task_##id(pool, self, cut, last, depth);                           \
+        }                                                                                \
+        last = cut;                                                                      \
+    }                                                                                    \
+    __ds_sort_range_##id(first, last, depth);                                            \
+}                                                                                        \
+                                                                                         \
+static void *__ds_sort_worker_##id(void *arg) {                                          \
+    __DSSortQueue_##id const *q = arg;                                                   \
+    __DSSortTask_##id task;                                                              \
+    while (__atomic_load_n(&q->pool->pending, __ATOMIC_ACQUIRE)) {                       \
+        if (__ds_sort_take_##id(q->pool, q->self, &task)) {                              \
+            __ds_sort_task_##id(q->pool, q->self, task.first, task.last, task.depth);    \
+            __atomic_sub_fetch(&q->pool->pending, 1, __ATOMIC_ACQ_REL);                  \
+        } else {                                                                         \
+            sched_yield();                                                               \
+        }                                                                                \
+    }                                                                                    \
+    return NULL;                                                                         \
+}                                                                                        \
+                                                                                         \
+void ds_sort_parallel_##id(t* arr, unsigned n, unsigned nthreads) {                      \
+    __DSSortPool_##id pool;                                                              \
+    pthread_t *threads;                                                                  \
+    unsigned i, started, depth;                                                          \
+    if (nthreads < 2 || n <= DS_SORT_PARALLEL_CUTOFF ||                                  \
+            !(pool.queues = __ds_calloc(nthreads, sizeof(__DSSortQueue_##id)))) {        \
+        ds_sort_##id(arr, n);                                                            \
+        return;                                                                          \
+    } else if (!(threads = __ds_malloc(nthreads * sizeof(pthread_t)))) {                 \
+        __ds_free(pool.queues);                                                          \
+        ds_sort_##id(arr, n);                                                            \
+        return;                                                                          \
+    }                                                                                    \
+                                                                                         \
+    pool.nthreads = nthreads;                                                            \
+    for (i = 0; i < nthreads; ++i) {                                                     \
+        pthread_mutex_init(&pool.queues[i].lock, NULL);                                  \
+        pool.queues[i].pool = &pool;                                                     \
+        pool.queues[i].self = i;                                                         \
+    }                                                                                    \
+    for (depth = 0; (n >> depth) > 1; ++depth);                                          \
+    pool.pending = 1;                                                                    \
+    __ds_sort_push_##id(&pool.queues[0], arr, arr + n, depth << 1);                      \
+                                                                                         \
+    /* the calling thread is worker 0 */                                                 \
+    for (started = 1; started < nthreads; ++started) {                                   \
+        if (pthread_create(&threads[started], NULL,                                      \
+                           __ds_sort_worker_##id, &pool.queues[started])) {              \
+            break;                                                                       \
+        }                                                                                \
+    }                                                                                    \
+    __ds_sort_worker_##id(&pool.queues[0]);                                              \
+    for (i = 1; i < started; ++i) {                                                      \
+        pthread_join(threads[i], NULL);                                                  \
+    }                                                                                    \
+                                                                                         \
+    for (i = 0; i < nthreads; ++i) {                                                     \
+        pthread_mutex_destroy(&pool.queues[i].lock);                                     \
+    }                                                                                    \
+    __ds_free(pool.queues);                                                              \
+    __ds_free(threads);                                                                  \
+}                                                                                        \
+
+#endif /* DS_ALG_PARALLEL_H */
@@ -0,0 +1,363 @@
+#ifndef DS_ALG_SIMD_H
+#define DS_ALG_SIMD_H
+
+#include "ds.h"
+
+/* --------------------------------------------------------------------------
+ * Sorting kernels used by gen_alg_source_numeric
+ * -------------------------------------------------------------------------- */
+
+/*
+ * DSSortKernel_<t> names the kernel used to sort the numeric type @c t . The
+ * kernel @c k provides:
+ *  - __ds_sortk_on_<k> : 1 if the kernel is used, 0 if the scalar introsort
+ *    is used instead.
+ *  - __ds_sortk_small_<k>(first, n) : sorts the @c n <= 16 elements at
+ *    @c first .
+ *  - __ds_sortk_partition_<k>(&first, last) : partitions [ @c first ,
+ *    @c last ) around the median of three and returns the cut. If no element
+ *    is less than the pivot, @c first is advanced past the elements equal to
+ *    it (which are then in their final place) and @c last is returned.
+ */
+#define __ds_sortk(op, k) __ds_sortk_(op, k)
+#define __ds_sortk_(op, k) __ds_sortk_##op##_##k
+
+#define __ds_sortk_on_dsk_none 0
+#define __ds_sortk_small_dsk_none(first, n) ((void) 0)
+#define __ds_sortk_partition_dsk_none(pfirst, last) (last)
+
+#define DSSortKernel_char dsk_none
+#define DSSortKernel_short dsk_none
+#define DSSortKernel_long dsk_none
+#define DSSortKernel_double dsk_none
+
+#if (defined(__AVX2__) || defined(__SSE4_1__)) && UINT_MAX == 0xffffffff &&              \
+    !defined(__CDS_SCAN)
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+typedef __m256i __DSVec;
+
+#define __DS_VEC_LANES 8
+#define __ds_vec_load(p) _mm256_loadu_si256((__m256i const *) (void const *) (p))
+#define __ds_vec_store(p, v) _mm256_storeu_si256((__m256i *) (void *) (p), v)
+#define __ds_vec_set1(x) _mm256_set1_epi32(x)
+#define __ds_vec_lanes() _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)
+#define __ds_vec_xor(a, b) _mm256_xor_si256(a, b)
+#define __ds_vec_and(a, b) _mm256_and_si256(a, b)
+#define __ds_vec_srai(v, n) _mm256_srai_epi32(v, n)
+#define __ds_vec_gt(a, b) _mm256_cmpgt_epi32(a, b)
+#define __ds_vec_max(a, b) _mm256_max_epi32(a, b)
+#define __ds_vec_mask(v) ((unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(v)))
+
+/* for each lane mask, the lanes that are set followed by the others, a nibble each */
+__attribute__((__unused__)) static const unsigned __ds_vec_compress_table[256] = {
+    0x76543210u, 0x76543210u, 0x76543201u, 0x76543210u, 0x76543102u, 0x76543120u,
+    0x76543021u, 0x76543210u, 0x76542103u, 0x76542130u, 0x76542031u, 0x76542310u,
+    0x76541032u, 0x76541320u, 0x76540321u, 0x76543210u, 0x76532104u, 0x76532140u,
+    0x76532041u, 0x76532410u, 0x76531042u, 0x76531420u, 0x76530421u, 0x76534210u,
+    0x76521043u, 0x76521430u, 0x76520431u, 0x76524310u, 0x76510432u, 0x76514320u,
+    0x76504321u, 0x76543210u, 0x76432105u, 0x76432150u, 0x76432051u, 0x76432510u,
+    0x76431052u, 0x76431520u, 0x76430521u, 0x76435210u, 0x76421053u, 0x76421530u,
+    0x76420531u, 0x76425310u, 0x76410532u, 0x76415320u, 0x76405321u, 0x76453210u,
+    0x76321054u, 0x76321540u, 0x76320541u, 0x76325410u, 0x76310542u, 0x76315420u,
+    0x76305421u, 0x76354210u, 0x76210543u, 0x76215430u, 0x76205431u, 0x76254310u,
+    0x76105432u, 0x76154320u, 0x76054321u, 0x76543210u, 0x75432106u, 0x75432160u,
+    0x75432061u, 0x75432610u, 0x75431062u, 0x75431620u, 0x75430621u, 0x75436210u,
+    0x75421063u, 0x75421630u, 0x75420631u, 0x75426310u, 0x75410632u, 0x75416320u,
+    0x75406321u, 0x75463210u, 0x75321064u, 0x75321640u, 0x75320641u, 0x75326410u,
+    0x75310642u, 0x75316420u, 0x75306421u, 0x75364210u, 0x75210643u, 0x75216430u,
+    0x75206431u, 0x75264310u, 0x75106432u, 0x75164320u, 0x75064321u, 0x75643210u,
+    0x74321065u, 0x74321650u, 0x74320651u, 0x74326510u, 0x74310652u, 0x74316520u,
+    0x74306521u, 0x74365210u, 0x74210653u, 0x74216530u, 0x74206531u, 0x74265310u,
+    0x74106532u, 0x74165320u, 0x74065321u, 0x74653210u, 0x73210654u, 0x73216540u,
+    0x73206541u, 0x73265410u, 0x73106542u, 0x73165420u, 0x73065421u, 0x73654210u,
+    0x72106543u, 0x72165430u, 0x72065431u, 0x72654310u, 0x71065432u, 0x71654320u,
+    0x70654321u, 0x76543210u, 0x65432107u, 0x65432170u, 0x65432071u, 0x65432710u,
+    0x65431072u, 0x65431720u, 0x65430721u, 0x65437210u, 0x65421073u, 0x65421730u,
+    0x65420731u, 0x65427310u, 0x65410732u, 0x65417320u, 0x65407321u, 0x65473210u,
+    0x65321074u, 0x65321740u, 0x65320741u, 0x65327410u, 0x65310742u, 0x65317420u,
+    0x65307421u, 0x65374210u, 0x65210743u, 0x65217430u, 0x65207431u, 0x65274310u,
+    0x65107432u, 0x65174320u, 0x65074321u, 0x65743210u, 0x64321075u, 0x64321750u,
+    0x64320751u, 0x64327510u, 0x64310752u, 0x64317520u, 0x64307521u, 0x64375210u,
+    0x64210753u, 0x64217530u, 0x64207531u, 0x64275310u, 0x64107532u, 0x64175320u,
+    0x64075321u, 0x64753210u, 0x63210754u, 0x63217540u, 0x63207541u, 0x63275410u,
+    0x63107542u, 0x63175420u, 0x63075421u, 0x63754210u, 0x62107543u, 0x62175430u,
+    0x62075431u, 0x62754310u, 0x61075432u, 0x61754320u, 0x60754321u, 0x67543210u,
+    0x54321076u, 0x54321760u, 0x54320761u, 0x54327610u, 0x54310762u, 0x54317620u,
+    0x54307621u, 0x54376210u, 0x54210763u, 0x54217630u, 0x54207631u, 0x54276310u,
+    0x54107632u, 0x54176320u, 0x54076321u, 0x54763210u, 0x53210764u, 0x53217640u,
+    0x53207641u, 0x53276410u, 0x53107642u, 0x53176420u, 0x53076421u, 0x53764210u,
+    0x52107643u, 0x52176430u, 0x52076431u, 0x52764310u, 0x51076432u, 0x51764320u,
+    0x50764321u, 0x57643210u, 0x43210765u, 0x43217650u, 0x43207651u, 0x43276510u,
+    0x43107652u, 0x43176520u, 0x43076521u, 0x43765210u, 0x42107653u, 0x42176530u,
+    0x42076531u, 0x42765310u, 0x41076532u, 0x41765320u, 0x40765321u, 0x47653210u,
+    0x32107654u, 0x32176540u, 0x32076541u, 0x32765410u, 0x31076542u, 0x31765420u,
+    0x30765421u, 0x37654210u, 0x21076543u, 0x21765430u, 0x20765431u, 0x27654310u,
+    0x10765432u, 0x17654320u, 0x07654321u, 0x76543210u
+};
+
+/* moves the lanes set in m to the front of v, keeping their order */
+__attribute__((__unused__)) static __m256i __ds_vec_compress(__m256i v, unsigned m) {
+    __m256i const shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    __m256i const perm = _mm256_set1_epi32((int) __ds_vec_compress_table[m]);
+    return _mm256_permutevar8x32_epi32(v, _mm256_srlv_epi32(perm, shifts));
+}
+
+/* lanes set in imm take the min of v and p, the others the max */
+#define __ds_vec_cmpx(v, p, imm)                                                         \
+        _mm256_blend_epi32(_mm256_max_epi32(v, p), _mm256_min_epi32(v, p), imm)
+
+/* sorts a bitonic sequence */
+__attribute__((__unused__)) static __m256i __ds_vec_merge8(__m256i v) {
+    __m256i p = _mm256_permute4x64_epi64(v, 0x4E);
+    v = __ds_vec_cmpx(v, p, 0x0F);
+    p = _mm256_shuffle_epi32(v, 0x4E);
+    v = __ds_vec_cmpx(v, p, 0x33);
+    p = _mm256_shuffle_epi32(v, 0xB1);
+    return __ds_vec_cmpx(v, p, 0x55);
+}
+
+__attribute__((__unused__)) static __m256i __ds_vec_sort8(__m256i v) {
+    __m256i p = _mm256_shuffle_epi32(v, 0xB1);
+    v = __ds_vec_cmpx(v, p, 0x99);
+    p = _mm256_shuffle_epi32(v, 0x4E);
+    v = __ds_vec_cmpx(v, p, 0xC3);
+    p = _mm256_shuffle_epi32(v, 0xB1);
+    v = __ds_vec_cmpx(v, p, 0xA5);
+    return __ds_vec_merge8(v);
+}
+
+/* bitonic sorting network over the 16 keys in v[0..1] */
+__attribute__((__unused__)) static void __ds_vec_sort16(__m256i *v) {
+    __m256i const rev = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i const a = __ds_vec_sort8(v[0]);
+    __m256i const b = _mm256_permutevar8x32_epi32(__ds_vec_sort8(v[1]), rev);
+    v[0] = __ds_vec_merge8(_mm256_min_epi32(a, b));
+    v[1] = __ds_vec_merge8(_mm256_max_epi32(a, b));
+}
+
+#else
+#include <smmintrin.h>
+
+typedef __m128i __DSVec;
+
+#define __DS_VEC_LANES 4
+#define __ds_vec_load(p) _mm_loadu_si128((__m128i const *) (void const *) (p))
+#define __ds_vec_store(p, v) _mm_storeu_si128((__m128i *) (void *) (p), v)
+#define __ds_vec_set1(x) _mm_set1_epi32(x)
+#define __ds_vec_lanes() _mm_setr_epi32(0, 1, 2, 3)
+#define __ds_vec_xor(a, b) _mm_xor_si128(a, b)
+#define __ds_vec_and(a, b) _mm_and_si128(a, b)
+#define __ds_vec_srai(v, n) _mm_srai_epi32(v, n)
+#define __ds_vec_gt(a, b) _mm_cmpgt_epi32(a, b)
+#define __ds_vec_max(a, b) _mm_max_epi32(a, b)
+#define __ds_vec_mask(v) ((unsigned) _mm_movemask_ps(_mm_castsi128_ps(v)))
+
+/* for each lane mask, the bytes of the lanes that are set followed by the others */
+__attribute__((__unused__)) static const unsigned char __ds_vec_compress_table[16][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {4, 5, 6, 7, 0, 1, 2, 3, 8, 9, 10, 11, 12, 13, 14, 15},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {8, 9, 10, 11, 0, 1, 2, 3, 4, 5, 6, 7, 12, 13, 14, 15},
+    {0, 1, 2, 3, 8, 9, 10, 11, 4, 5, 6, 7, 12, 13, 14, 15},
+    {4, 5, 6, 7, 8, 9, 10, 11, 0, 1, 2, 3, 12, 13, 14, 15},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11},
+    {0, 1, 2, 3, 12, 13, 14, 15, 4, 5, 6, 7, 8, 9, 10, 11},
+    {4, 5, 6, 7, 12, 13, 14, 15, 0, 1, 2, 3, 8, 9, 10, 11},
+    {0, 1, 2, 3, 4, 5, 6, 7, 12, 13, 14, 15, 8, 9, 10, 11},
+    {8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7},
+    {0, 1, 2, 3, 8, 9, 10, 11, 12, 13, 14, 15, 4, 5, 6, 7},
+    {4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}
+};
+
+/* moves the lanes set in m to the front of v, keeping their order */
+__attribute__((__unused__)) static __m128i __ds_vec_compress(__m128i v, unsigned m) {
+    return _mm_shuffle_epi8(v, __ds_vec_load(__ds_vec_compress_table[m]));
+}
+
+/* lanes set in imm (two bits per lane) take the min of v and p, the others the max */
+#define __ds_vec_cmpx(v, p, imm)                                                         \
+        _mm_blend_epi16(_mm_max_epi32(v, p), _mm_min_epi32(v, p), imm)
+
+/* sorts a bitonic sequence */
+__attribute__((__unused__)) static __m128i __ds_vec_merge4(__m128i v) {
+    __m128i p = _mm_shuffle_epi32(v, 0x4E);
+    v = __ds_vec_cmpx(v, p, 0x0F);
+    p = _mm_shuffle_epi32(v, 0xB1);
+    return __ds_vec_cmpx(v, p, 0x33);
+}
+
+__attribute__((__unused__)) static __m128i __ds_vec_sort4(__m128i v) {
+    __m128i const p = _mm_shuffle_epi32(v, 0xB1);
+    return __ds_vec_merge4(__ds_vec_cmpx(v, p, 0xC3));
+}
+
+/* bitonic sorting network over the 16 keys in v[0..3] */
+__attribute__((__unused__)) static void __ds_vec_sort16(__m128i *v) {
+    __m128i a = __ds_vec_sort4(v[0]);
+    __m128i b = _mm_shuffle_epi32(__ds_vec_sort4(v[1]), 0x1B);
+    __m128i c = __ds_vec_sort4(v[2]);
+    __m128i d = _mm_shuffle_epi32(__ds_vec_sort4(v[3]), 0x1B);
+    __m128i lo, hi;
+    lo = _mm_min_epi32(a, b);
+    hi = _mm_max_epi32(a, b);
+    a = __ds_vec_merge4(lo);
+    b = __ds_vec_merge4(hi);
+    lo = _mm_min_epi32(c, d);
+    hi = _mm_max_epi32(c, d);
+    c = _mm_shuffle_epi32(__ds_vec_merge4(hi), 0x1B);
+    d = _mm_shuffle_epi32(__ds_vec_merge4(lo), 0x1B);
+    /* (a, b) and the reversed (c, d) form a bitonic sequence of 16 */
+    lo = _mm_min_epi32(a, c);
+    hi = _mm_min_epi32(b, d);
+    v[0] = __ds_vec_merge4(_mm_min_epi32(lo, hi));
+    v[1] = __ds_vec_merge4(_mm_max_epi32(lo, hi));
+    lo = _mm_max_epi32(a, c);
+    hi = _mm_max_epi32(b, d);
+    v[2] = __ds_vec_merge4(_mm_min_epi32(lo, hi));
+    v[3] = __ds_vec_merge4(_mm_max_epi32(lo, hi));
+}
+#endif /* __AVX2__ */
+
+/*
+ * Keys of the supported types as ints that order the same way. Each vector
+ * form is its own inverse, so it also turns keys back into elements.
+ */
+#define __ds_sortk_key_i32(x) (x)
+#define __ds_sortk_vkey_i32(v) (v)
+#define __ds_sortk_key_u32(x) ((int) ((x) ^ ~(~0u >> 1)))
+#define __ds_sortk_vkey_u32(v) __ds_vec_xor(v, __ds_vec_set1(INT_MIN))
+#define __ds_sortk_key_f32(x) __ds_sortk_float_key(x)
+#define __ds_sortk_vkey_f32(v)                                                           \
+        __ds_vec_xor(v, __ds_vec_and(__ds_vec_srai(v, 31), __ds_vec_set1(INT_MAX)))
+
+__attribute__((__unused__)) static int __ds_sortk_float_key(float x) {
+    /* negative floats order backwards, so all but their sign bit are flipped */
+    int k;
+    memcpy(&k, &x, sizeof(k));
+    return k < 0 ? k ^ INT_MAX : k;
+}
+
+__attribute__((__unused__)) static int __ds_sortk_median(int a, int b, int c) {
+    if (a < b) return b < c ? b : (a < c ? c : a);
+    return a < c ? a : (b < c ? c : b);
+}
+
+#define __ds_gen_sort_kernel(k, t, key, vkey)                                            \
+                                                                                         \
+__attribute__((__unused__)) static void __ds_sortk_small_##k(t* first, unsigned n) {     \
+    __DSVec v[16 / __DS_VEC_LANES];                                                      \
+    __DSVec const lanes = __ds_vec_lanes();                                              \
+    t buf[16];                                                                           \
+    unsigned i;                                                                          \
+    if (n < 2) return;                                                                   \
+                                                                                         \
+    memcpy(buf, first, n * sizeof(t));                                                   \
+    for (i = 0; i < 16 / __DS_VEC_LANES; ++i) {                                          \
+        /* lanes past the end get the largest key */                                     \
+        int const rest = (int) n - (int) (i * __DS_VEC_LANES);                           \
+        __DSVec const inside = __ds_vec_gt(__ds_vec_set1(rest), lanes);                  \
+        v[i] = __ds_vec_max(vkey(__ds_vec_load(buf + i * __DS_VEC_LANES)),               \
+                            __ds_vec_xor(inside, __ds_vec_set1(INT_MAX)));               \
+    }                                                                                    \
+    __ds_vec_sort16(v);                                                                  \
+    for (i = 0; i < 16 / __DS_VEC_LANES; ++i) {                                          \
+        __ds_vec_store(buf + i * __DS_VEC_LANES, vkey(v[i]));                            \
+    }                                                                                    \
+    memcpy(first, buf, n * sizeof(t));                                                   \
+}                                                                                        \
+                                                                                         \
+__attribute__((__unused__))                                                              \
+static t* __ds_sortk_split_##k(t* first, t* last, int pivot) {                           \
+    /*
+     * Moves the elements less than pivot to the front, a vector at a time. The
+     * first and last vectors are held back so that a whole vector can always be
+     * written to both ends, reading next from the end with less room.
+     */                                                                                  \
+    __DSVec const pv = __ds_vec_set1(pivot);                                             \
+    __DSVec const head = __ds_vec_load(first);                                           \
+    __DSVec const tail = __ds_vec_load(last - __DS_VEC_LANES);                           \
+    t* l = first + __DS_VEC_LANES;                                                       \
+    t* r = last - __DS_VEC_LANES;                                                        \
+    t* wl = first;                                                                       \
+    t* wr = last;                                                                        \
+    __DSVec v;                                                                           \
+    unsigned m;                                                                          \
+    t e;                                                                                 \
+    while (1) {                                                                          \
+        if (r - l >= __DS_VEC_LANES) {                                                   \
+            if (l - wl <= wr - r) {                                                      \
+                v = __ds_vec_load(l);                                                    \
+                l += __DS_VEC_LANES;                                                     \
+            } else {                                                                     \
+                r -= __DS_VEC_LANES;                                                     \
+                v = __ds_vec_load(r);                                                    \
+            }                                                                            \
+        } else if (l != r) {                                                             \
+            e = (l - wl <= wr - r) ? *l++ : *--r;                                        \
+            if (key(e) < pivot) *wl++ = e;                                               \
+            else *--wr = e;                                                              \
+            continue;                                                                    \
+        } else if (wl != wr) {                                                           \
+            v = (wr - wl > __DS_VEC_LANES) ? head : tail;                                \
+        } else {                                                                         \
+            return wl;                                                                   \
+        }                                                                                \
+        m = __ds_vec_mask(__ds_vec_gt(pv, vkey(v)));                                     \
+        v = __ds_vec_compress(v, m);                                                     \
+        __ds_vec_store(wr - __DS_VEC_LANES, v);                                          \
+        __ds_vec_store(wl, v);                                                           \
+        m = (unsigned) __builtin_popcount(m);                                            \
+        wl += m;                                                                         \
+        wr -= __DS_VEC_LANES - m;                                                        \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+__attribute__((__unused__))                                                              \
+static t* __ds_sortk_partition_##k(t** pfirst, t* last) {                                \
+    t* const first = *pfirst;                                                            \
+    t* const mid = first + (last - first) / 2;                                           \
+    t* const end = last - 1;                                                             \
+    long const step = (last - first) / 8;                                                \
+    int pivot;                                                                           \
+    t* cut;                                                                              \
+    if (step > 16) {                                                                     \
+        /* the vectors leave runs behind, so large ranges take the ninther */            \
+        pivot = __ds_sortk_median(                                                       \
+            __ds_sortk_median(key(*first), key(first[step]), key(first[2 * step])),      \
+            __ds_sortk_median(key(mid[-step]), key(*mid), key(mid[step])),               \
+            __ds_sortk_median(key(end[-2 * step]), key(end[-step]), key(*end)));         \
+    } else {                                                                             \
+        pivot = __ds_sortk_median(key(*first), key(*mid), key(*end));                    \
+    }                                                                                    \
+                                                                                         \
+    cut = __ds_sortk_split_##k(first, last, pivot);                                      \
+    if (cut != first) return cut;                                                        \
+    /* the pivot is the smallest element, so the ones equal to it are done */            \
+    *pfirst = (pivot == INT_MAX) ? last : __ds_sortk_split_##k(first, last, pivot + 1);  \
+    return last;                                                                         \
+}                                                                                        \
+
+#define DSSortKernel_int dsk_i32
+#define DSSortKernel_unsigned dsk_u32
+#define DSSortKernel_float dsk_f32
+#define __ds_sortk_on_dsk_i32 1
+#define __ds_sortk_on_dsk_u32 1
+#define __ds_sortk_on_dsk_f32 1
+
+__ds_gen_sort_kernel(dsk_i32, int, __ds_sortk_key_i32, __ds_sortk_vkey_i32)
+__ds_gen_sort_kernel(dsk_u32, unsigned, __ds_sortk_key_u32, __ds_sortk_vkey_u32)
+__ds_gen_sort_kernel(dsk_f32, float, __ds_sortk_key_f32, __ds_sortk_vkey_f32)
+
+#else
+#define DSSortKernel_int dsk_none
+#define DSSortKernel_unsigned dsk_none
+#define DSSortKernel_float dsk_none
+#endif
+
+#endif /* DS_ALG_SIMD_H */
@@ -173,9 +173,7 @@
 /**
  * Deletes all elements and frees the array.
  */
-#define array_free(id, this) do {                                                        \
-    array_clear(id, this); free((this)->arr); free(this);                                \
-} while(0)
+#define array_free(id, this) array_free_##id(this)
 
 
 /**
@@ -367,6 +365,7 @@ unsigned array_insert_fromArray_##id(Array_##id *this, unsigned index,
                                      t const *arr, unsigned n)                           \
   __attribute__((nonnull));                                                              \
 Array_##id *array_new_fromArray_##id(t const *arr, unsigned size);                       \
+void array_free_##id(Array_##id *this) __attribute__((nonnull));                         \
 Array_##id *array_new_repeatingValue_##id(unsigned n, t const value)                     \
   __attribute__((nonnull));                                                              \
 void array_shrink_to_fit_##id(Array_##id *this) __attribute__((nonnull));                \
@@ -408,7 +407,7 @@ unsigned char array_reserve_##id(Array_##id *this, unsigned n) {
         ncap = DS_ARRAY_MAX_SIZE;                                                        \
     }                                                                                    \
                                                                                          \
-    if (!(tmp = realloc(this->arr, ncap * sizeof(t)))) return 0;                         \
+    if (!(tmp = __ds_realloc(this->arr, ncap * sizeof(t)))) return 0;                    \
     this->capacity = ncap;                                                               \
     this->arr = tmp;                                                                     \
     return 1;                                                                            \
@@ -491,13 +490,13 @@ unsigned array_insert_fromArray_##id(Array_##id *this, unsigned index,
 }                                                                                        \
                                                                                          \
 Array_##id *array_new_fromArray_##id(t const *arr, unsigned size) {                      \
-    Array_##id *a = malloc(sizeof(Array_##id));                                          \
+    Array_##id *a = __ds_malloc(sizeof(Array_##id));                                     \
     customAssert(a)                                                                      \
     if (!a) return NULL;                                                                 \
-    a->arr = malloc(8 * sizeof(t));                                                      \
+    a->arr = __ds_malloc(8 * sizeof(t));                                                 \
     customAssert(a->arr)                                                                 \
     if (!a->arr) {                                                                       \
-        free(a);                                                                         \
+        __ds_free(a);                                                                    \
         return NULL;                                                                     \
     }                                                                                    \
     a->size = 0;                                                                         \
@@ -506,6 +505,12 @@ Array_##id *array_new_fromArray_##id(t const *arr, unsigned size) {
     return a;                                                                            \
 }                                                                                        \
                                                                                          \
+void array_free_##id(Array_##id *this) {                                                 \
+    array_clear(id, this);                                                               \
+    __ds_free(this->arr);                                                                \
+    __ds_free(this);                                                                     \
+}                                                                                        \
+                                                                                         \
 Array_##id *array_new_repeatingValue_##id(unsigned n, t const value) {                   \
     Array_##id *a = array_new(id);                                                       \
     if (a && n) array_insert_repeatingValue_##id(a, 0, n, value);                        \
@@ -517,7 +522,7 @@ void array_shrink_to_fit_##id(Array_##id *this) {
     unsigned newCap = this->size;                                                        \
     if (this->capacity != 8 && newCap != this->capacity) {                               \
         if (!newCap) newCap = 8;                                                         \
-        if ((tmp = realloc(this->arr, newCap * sizeof(t)))) {                            \
+        if ((tmp = __ds_realloc(this->arr, newCap * sizeof(t)))) {                       \
             this->capacity = newCap;                                                     \
             this->arr = tmp;                                                             \
         }                                                                                \
@@ -565,6 +570,65 @@ Array_##id *array_subarr_##id(Array_##id *this, unsigned start,
 #define array_sort(id, this) ds_sort_##id(this->arr, this->size)
 
 
+/**
+ * Sorts the array in increasing order using @c nthreads threads (see
+ * @c alg_parallel.h ). The parallel sort must have been generated for @c id
+ * with @c gen_alg_parallel_headers and @c gen_alg_parallel_source .
+ *
+ * @param  nthreads  @c unsigned : Number of threads to sort with.
+ */
+#define array_sort_parallel(id, this, nthreads)                                          \
+        ds_sort_parallel_##id(this->arr, this->size, nthreads)
+
+
+/**
+ * Sorts the array in increasing order with a radix sort, which takes O(n)
+ * time and keeps equal elements in their original order. The radix sort must
+ * have been generated for @c id with @c gen_alg_headers_radix and
+ * @c gen_alg_source_radix .
+ */
+#define array_radix_sort(id, this) ds_radix_sort_##id(this->arr, this->size)
+
+
+/**
+ * Sorts the array in increasing order, keeping equal elements in their
+ * original order (see @c stable_sort ). Sorted or nearly sorted arrays take
+ * close to O(n) time.
+ *
+ * @return  @c unsigned @c char : True if the array was sorted, false if the
+ *          scratch memory could not be allocated.
+ */
+#define array_stable_sort(id, this) ds_stable_sort_##id(this->arr, this->size, NULL, 0)
+
+
+/**
+ * Like @c array_stable_sort , but merges through @c buf instead of allocating
+ * scratch memory as long as @c bufSize is at least half the size of the array.
+ *
+ * @param  buf      @c t* : Scratch space, or NULL.
+ * @param  bufSize  @c unsigned : Number of elements that fit in @c buf .
+ *
+ * @return          @c unsigned @c char : Same as @c array_stable_sort .
+ */
+#define array_stable_sort_withBuffer(id, this, buf, bufSize)                             \
+        ds_stable_sort_##id(this->arr, this->size, buf, bufSize)
+
+
+/**
+ * Moves the @c k smallest elements of the array to its front, in sorted
+ * order, in O(n log k) time (see @c partial_sort ). The order of the other
+ * elements is unspecified. To get the greatest elements instead, generate the
+ * algorithms with a greater-than comparison.
+ *
+ * @param  k  @c unsigned : Number of elements to select; if it is greater than
+ *             the size of the array, the whole array is sorted.
+ */
+#define array_top_k(id, this, k)                                                         \
+        ds_partial_sort_##id(this->arr,                                                  \
+                             this->arr + ((k) < this->size ? (k) : this->size),          \
+                             this->arr + this->size)
+
+
 /**
  * Given that the array is sorted, finds @c key .
  *
@@ -736,6 +800,26 @@ Array_##id *merge_array_##id(t const *first1, t const *last1,
                                                                                          \
 gen_array_source(id, t, copyValue, deleteValue)                                          \
 gen_alg_source(id, t, cmp_lt)                                                            \
+__setup_array_alg_source(id, t, cmp_lt)                                                  \
+
+
+/**
+ * Generates @c Array function definitions for a built-in numeric type,
+ * including sort, find, and set functions. The sort uses the vectorized
+ * kernels described in @c gen_alg_source_numeric .
+ *
+ * @param  id  ID used in @c gen_array_headers_withAlg .
+ * @param  t   Type used in @c gen_array_headers_withAlg , written as a single
+ *              token (see @c gen_alg_source_numeric ).
+ */
+#define gen_array_source_withNumericAlg(id, t)                                           \
+                                                                                         \
+gen_array_source(id, t, DSDefault_shallowCopy, DSDefault_shallowDelete)                  \
+gen_alg_source_numeric(id, t)                                                            \
+__setup_array_alg_source(id, t, ds_cmp_num_lt)                                           \
+
+
+#define __setup_array_alg_source(id, t, cmp_lt)                                          \
                                                                                          \
 Array_##id *array_union_##id(t const *first1, t const *last1,                            \
                              t const *first2, t const *last2) {                          \
@@ -2,21 +2,81 @@
 #define DS_AVL_TREE_H
 
 #include "ds.h"
+#include "pool.h"
 
-#define __setup_avltree_headers(id, kt, TreeType, DataType, EntryType)                   \
+/*
+ * Entries can store the number of entries in their subtree (countMode
+ * __avl_counts_stored), which makes rank queries and advancing or measuring
+ * the distance between entries O(log n); __avl_counts_none keeps entries
+ * smaller, and those operations then step through the entries one by one. The
+ * mode only changes the entry layout and the helpers below.
+ */
+#define __avl_counts_none_field
+#define __avl_counts_none_helpers(id, EntryType)                                         \
+__attribute__((__unused__)) static unsigned char __avl_has_counts_##id(void) {           \
+    return 0;                                                                            \
+}                                                                                        \
+__attribute__((__unused__)) static unsigned __avl_count_##id(EntryType const *e) {       \
+    (void) e;                                                                            \
+    return 0;                                                                            \
+}                                                                                        \
+__attribute__((__unused__)) static void __avl_fix_count_##id(EntryType *e) {             \
+    (void) e;                                                                            \
+}                                                                                        \
+__attribute__((__unused__)) static void                                                  \
+__avl_count_path_##id(EntryType *e, unsigned char inc) {                                 \
+    (void) e; (void) inc;                                                                \
+}                                                                                        \
+
+#define __avl_counts_stored_field unsigned count;
+#define __avl_counts_stored_helpers(id, EntryType)                                       \
+__attribute__((__unused__)) static unsigned char __avl_has_counts_##id(void) {           \
+    return 1;                                                                            \
+}                                                                                        \
+__attribute__((__unused__)) static unsigned __avl_count_##id(EntryType const *e) {       \
+    return e ? e->count : 0;                                                             \
+}                                                                                        \
+__attribute__((__unused__)) static void __avl_fix_count_##id(EntryType *e) {             \
+    e->count = 1 + __avl_count_##id(e->left) + __avl_count_##id(e->right);               \
+}                                                                                        \
+__attribute__((__unused__)) static void                                                  \
+__avl_count_path_##id(EntryType *e, unsigned char inc) {                                 \
+    /* adds or removes one entry from the counts of e and all its ancestors */           \
+    for (; e; e = e->parent) {                                                           \
+        if (inc) {                                                                       \
+            ++e->count;                                                                  \
+        } else {                                                                         \
+            --e->count;                                                                  \
+        }                                                                                \
+    }                                                                                    \
+}                                                                                        \
+
+/*
+ * Entries per slab for insertions into a tree created by
+ * __avltree_new_fromSorted, whose initial entries all share one slab.
+ */
+#ifndef DS_AVL_BULK_CHUNK
+#define DS_AVL_BULK_CHUNK 64
+#endif
+
+#define __setup_avltree_headers(id, kt, TreeType, DataType, EntryType, countMode)        \
                                                                                          \
 typedef struct EntryType EntryType;                                                      \
 struct EntryType {                                                                       \
     EntryType *parent;                                                                   \
     EntryType *left;                                                                     \
     EntryType *right;                                                                    \
+    countMode##_field                                                                    \
     signed char bf;                                                                      \
     DataType data;                                                                       \
 };                                                                                       \
                                                                                          \
+countMode##_helpers(id, EntryType)                                                       \
+                                                                                         \
 typedef struct {                                                                         \
     EntryType *root;                                                                     \
     unsigned size;                                                                       \
+    DSPool pool;                                                                         \
 } TreeType;                                                                              \
                                                                                          \
 EntryType *__avl_successor_##id(EntryType *x);                                           \
@@ -41,6 +101,9 @@ unsigned char __avltree_insert_fromTree_##id(TreeType *this,
                                              EntryType const *end)                       \
   __attribute__((nonnull (1)));                                                          \
 TreeType *__avltree_new_fromArray_##id(DataType const *arr, unsigned n);                 \
+TreeType *__avltree_new_withPool_##id(unsigned chunk);                                   \
+TreeType *__avltree_new_fromSorted_##id(DataType const *arr, unsigned n);                \
+void __avltree_free_##id(TreeType *this) __attribute__((nonnull));                       \
 TreeType *__avltree_createCopy_##id(TreeType const *other)                               \
   __attribute__((nonnull));                                                              \
 EntryType * __avltree_remove_entry_##id(TreeType *this, EntryType *v)                    \
@@ -48,6 +111,24 @@ EntryType * __avltree_remove_entry_##id(TreeType *this, EntryType *v)
 EntryType *__avltree_erase_##id(TreeType *this,                                          \
                                 EntryType *begin, EntryType const *end)                  \
   __attribute__((nonnull (1)));                                                          \
+EntryType *__avltree_lower_bound_##id(TreeType const *this, kt const key)                \
+  __attribute__((nonnull));                                                              \
+EntryType *__avltree_upper_bound_##id(TreeType const *this, kt const key)                \
+  __attribute__((nonnull));                                                              \
+unsigned char __avlEntry_key_lt_##id(EntryType const *e, kt const key)                   \
+  __attribute__((nonnull));                                                              \
+EntryType *__avltree_at_rank_##id(TreeType const *this, unsigned k)                      \
+  __attribute__((nonnull));                                                              \
+unsigned __avltree_rank_of_##id(TreeType const *this, kt const key)                      \
+  __attribute__((nonnull));                                                              \
+unsigned __avltree_count_range_##id(TreeType const *this, kt const lo, kt const hi)      \
+  __attribute__((nonnull));                                                              \
+unsigned char __avltree_build_fromSorted_##id(TreeType *this,                            \
+                                              DataType const *arr,                       \
+                                              unsigned n)                                \
+  __attribute__((nonnull (1)));                                                          \
+unsigned char __avltree_merge_##id(TreeType *this, TreeType *other)                      \
+  __attribute__((nonnull));                                                              \
 
 #define __setup_avltree_source(id, kt, TreeType, DataType, EntryType, cmp_lt,            \
                                entry_get_key, data_get_key, copyKey, deleteKey,          \
@@ -87,9 +168,41 @@ EntryType *__avl_inorder_predecessor_##id(EntryType const *x) {
     return parent;                                                                       \
 }                                                                                        \
                                                                                          \
+static EntryType *__avl_select_##id(EntryType *curr, unsigned k) {                       \
+    while (curr) {                                                                       \
+        unsigned left = __avl_count_##id(curr->left);                                    \
+        if (k < left) {                                                                  \
+            curr = curr->left;                                                           \
+        } else if (k == left) {                                                          \
+            break;                                                                       \
+        } else {                                                                         \
+            k -= left + 1;                                                               \
+            curr = curr->right;                                                          \
+        }                                                                                \
+    }                                                                                    \
+    return curr;                                                                         \
+}                                                                                        \
+                                                                                         \
+static unsigned __avl_entry_rank_##id(EntryType const *e, EntryType **root) {            \
+    unsigned rank = __avl_count_##id(e->left);                                           \
+    for (; e->parent; e = e->parent) {                                                   \
+        if (e == e->parent->right) rank += __avl_count_##id(e->parent->left) + 1;        \
+    }                                                                                    \
+    *root = (EntryType *) e;                                                             \
+    return rank;                                                                         \
+}                                                                                        \
+                                                                                         \
 void __avlEntry_advance_##id(EntryType **p1, long n) {                                   \
     long count = 0;                                                                      \
-    if (n >= 0) {                                                                        \
+    if (__avl_has_counts_##id() && *p1) {                                                \
+        EntryType *root;                                                                 \
+        long rank = (long) __avl_entry_rank_##id(*p1, &root) + n;                        \
+        if (rank < 0 || rank >= (long) __avl_count_##id(root)) {                         \
+            *p1 = NULL;                                                                  \
+        } else {                                                                         \
+            *p1 = __avl_select_##id(root, (unsigned) rank);                              \
+        }                                                                                \
+    } else if (n >= 0) {                                                                 \
         for (; count++ < n && *p1; *p1 = __avl_inorder_successor_##id(*p1));             \
     } else {                                                                             \
         for (; count-- > n && *p1; *p1 = __avl_inorder_predecessor_##id(*p1));           \
@@ -98,6 +211,16 @@ void __avlEntry_advance_##id(EntryType **p1, long n) {
                                                                                          \
 long __avlEntry_distance_##id(EntryType const *p1, EntryType const *p2) {                \
     long dist = 0;                                                                       \
+    if (__avl_has_counts_##id() && p1) {                                                 \
+        EntryType *root1, *root2;                                                        \
+        unsigned first = __avl_entry_rank_##id(p1, &root1);                              \
+        unsigned last = __avl_count_##id(root1);                                         \
+        if (p2) {                                                                        \
+            last = __avl_entry_rank_##id(p2, &root2);                                    \
+            if (root1 != root2 || last < first) return -1;                               \
+        }                                                                                \
+        return (long) (last - first);                                                    \
+    }                                                                                    \
     for (; p1 && p1 != p2; p1 = __avl_inorder_successor_##id(p1), ++dist);               \
     if (p1 != p2) return -1;                                                             \
     return dist;                                                                         \
@@ -118,6 +241,8 @@ static EntryType *__avl_leftRotate_##id(TreeType *this, EntryType *x) {
     }                                                                                    \
     nParent->left = x;                                                                   \
     x->parent = nParent;                                                                 \
+    __avl_fix_count_##id(x);                                                             \
+    __avl_fix_count_##id(nParent);                                                       \
     return nParent;                                                                      \
 }                                                                                        \
                                                                                          \
@@ -136,6 +261,8 @@ static EntryType *__avl_rightRotate_##id(TreeType *this, EntryType *x) {
     }                                                                                    \
     nParent->right = x;                                                                  \
     x->parent = nParent;                                                                 \
+    __avl_fix_count_##id(x);                                                             \
+    __avl_fix_count_##id(nParent);                                                       \
     return nParent;                                                                      \
 }                                                                                        \
                                                                                          \
@@ -164,36 +291,10 @@ EntryType *__avltree_find_key_##id(TreeType const *this,
     return curr;                                                                         \
 }                                                                                        \
                                                                                          \
-EntryType *__avltree_insert_##id(TreeType *this,                                         \
-                                 DataType const data, int *inserted) {                   \
-    EntryType *curr = __avltree_find_key_##id(this, data_get_key(data), 1);              \
-    EntryType *new, *parent;                                                             \
-    if (curr && ds_cmp_eq(cmp_lt, entry_get_key(curr), data_get_key(data))) {            \
-        deleteValue(curr->data.second);                                                  \
-        copyValue(curr->data.second, data.second);                                       \
-        if (inserted) *inserted = 0;                                                     \
-        return curr;                                                                     \
-    } else if (this->size == UINT_MAX || !(new = calloc(1, sizeof(EntryType))))          \
-        return NULL;                                                                     \
-                                                                                         \
-    copyKey(entry_get_key(new), data_get_key(data));                                     \
-    copyValue(new->data.second, data.second);                                            \
-    new->parent = curr;                                                                  \
-    if (!curr) {                                                                         \
-        customAssert(this->root == NULL)                                                 \
-        this->root = new;                                                                \
-        ++this->size;                                                                    \
-        if (inserted) *inserted = 1;                                                     \
-        return new;                                                                      \
-    }                                                                                    \
-                                                                                         \
-    if (cmp_lt(data_get_key(data), entry_get_key(curr))) {                               \
-        curr->left = new;                                                                \
-    } else {                                                                             \
-        curr->right = new;                                                               \
-    }                                                                                    \
-                                                                                         \
-    for (curr = new, parent = curr->parent;                                              \
+static void __avl_retrace_insert_##id(TreeType *this, EntryType *curr) {                 \
+    /* rebalances the ancestors of curr, whose subtree just grew by one level */         \
+    EntryType *parent;                                                                   \
+    for (parent = curr->parent;                                                          \
             curr && parent;                                                              \
             curr = parent, parent = curr->parent) {                                      \
         if (curr == parent->left) {                                                      \
@@ -254,6 +355,41 @@ EntryType *__avltree_insert_##id(TreeType *this,
             }                                                                            \
         }                                                                                \
     }                                                                                    \
+}                                                                                        \
+                                                                                         \
+EntryType *__avltree_insert_##id(TreeType *this,                                         \
+                                 DataType const data, int *inserted) {                   \
+    EntryType *curr = __avltree_find_key_##id(this, data_get_key(data), 1);              \
+    EntryType *new;                                                                      \
+    if (curr && ds_cmp_eq(cmp_lt, entry_get_key(curr), data_get_key(data))) {            \
+        deleteValue(curr->data.second);                                                  \
+        copyValue(curr->data.second, data.second);                                       \
+        if (inserted) *inserted = 0;                                                     \
+        return curr;                                                                     \
+    } else if (this->size == UINT_MAX ||                                                 \
+            !(new = ds_pool_alloc(&this->pool, sizeof(EntryType)))) {                    \
+        return NULL;                                                                     \
+    }                                                                                    \
+                                                                                         \
+    copyKey(entry_get_key(new), data_get_key(data));                                     \
+    copyValue(new->data.second, data.second);                                            \
+    new->parent = curr;                                                                  \
+    __avl_count_path_##id(new, 1);                                                       \
+    if (!curr) {                                                                         \
+        customAssert(this->root == NULL)                                                 \
+        this->root = new;                                                                \
+        ++this->size;                                                                    \
+        if (inserted) *inserted = 1;                                                     \
+        return new;                                                                      \
+    }                                                                                    \
+                                                                                         \
+    if (cmp_lt(data_get_key(data), entry_get_key(curr))) {                               \
+        curr->left = new;                                                                \
+    } else {                                                                             \
+        curr->right = new;                                                               \
+    }                                                                                    \
+                                                                                         \
+    __avl_retrace_insert_##id(this, new);                                                \
     ++this->size;                                                                        \
     if (inserted) *inserted = 1;                                                         \
     return new;                                                                          \
@@ -282,15 +418,21 @@ unsigned char __avltree_insert_fromTree_##id(TreeType *this,
 }                                                                                        \
                                                                                          \
 TreeType *__avltree_new_fromArray_##id(DataType const *arr, unsigned n) {                \
-    TreeType *t = calloc(1, sizeof(TreeType));                                           \
+    TreeType *t = __ds_calloc(1, sizeof(TreeType));                                      \
     customAssert(t)                                                                      \
     if (t && arr && n) __avltree_insert_fromArray_##id(t, arr, n);                       \
     return t;                                                                            \
 }                                                                                        \
                                                                                          \
+TreeType *__avltree_new_withPool_##id(unsigned chunk) {                                  \
+    TreeType *t = __avltree_new_fromArray_##id(NULL, 0);                                 \
+    if (t) ds_pool_init(&t->pool, chunk);                                                \
+    return t;                                                                            \
+}                                                                                        \
+                                                                                         \
 TreeType *__avltree_createCopy_##id(TreeType const *other) {                             \
     EntryType *e = __avl_successor_##id(other->root);                                    \
-    TreeType *t = __avltree_new_fromArray_##id(NULL, 0);                                 \
+    TreeType *t = __avltree_new_withPool_##id(other->pool.chunk);                        \
     if (t) __avltree_insert_fromTree_##id(t, e, NULL);                                   \
     return t;                                                                            \
 }                                                                                        \
@@ -311,6 +453,8 @@ EntryType * __avltree_remove_entry_##id(TreeType *this, EntryType *v) {
         rv = v;                                                                          \
         v = temp;                                                                        \
     }                                                                                    \
+    /* v has at most one child now; drop it from the counts before rotating */           \
+    __avl_count_path_##id(v, 0);                                                         \
                                                                                          \
     for (curr = v, parent = curr->parent;                                                \
             curr && parent;                                                              \
@@ -395,11 +539,43 @@ EntryType * __avltree_remove_entry_##id(TreeType *this, EntryType *v) {
         deleteValue(v->data.second);                                                     \
     }                                                                                    \
     customAssert(v != ((void *) -1))                                                     \
-    free(v);                                                                             \
+    ds_pool_free(&this->pool, v);                                                        \
     --this->size;                                                                        \
     return rv;                                                                           \
 }                                                                                        \
                                                                                          \
+static void __avltree_clear_##id(TreeType *this) {                                       \
+    /* post-order walk: no rebalancing, and pooled entries go back as whole slabs */     \
+    EntryType *curr = this->root, *parent;                                               \
+    while (curr) {                                                                       \
+        if (curr->left) {                                                                \
+            curr = curr->left;                                                           \
+        } else if (curr->right) {                                                        \
+            curr = curr->right;                                                          \
+        } else {                                                                         \
+            if ((parent = curr->parent)) {                                               \
+                if (curr == parent->left) {                                              \
+                    parent->left = NULL;                                                 \
+                } else {                                                                 \
+                    parent->right = NULL;                                                \
+                }                                                                        \
+            }                                                                            \
+            deleteKey(entry_get_key(curr));                                              \
+            deleteValue(curr->data.second);                                              \
+            if (!this->pool.chunk) __ds_free(curr);                                      \
+            curr = parent;                                                               \
+        }                                                                                \
+    }                                                                                    \
+    ds_pool_release(&this->pool);                                                        \
+    this->root = NULL;                                                                   \
+    this->size = 0;                                                                      \
+}                                                                                        \
+                                                                                         \
+void __avltree_free_##id(TreeType *this) {                                               \
+    __avltree_clear_##id(this);                                                          \
+    __ds_free(this);                                                                     \
+}                                                                                        \
+                                                                                         \
 EntryType *__avltree_erase_##id(TreeType *this,                                          \
                                 EntryType *begin, EntryType const *end) {                \
     if (!begin || begin == end) return NULL;                                             \
@@ -412,6 +588,9 @@ EntryType *__avltree_erase_##id(TreeType *this,
             begin = __avltree_remove_entry_##id(this, begin);                            \
         }                                                                                \
         return __avltree_find_key_##id(this, lastKey, 0);                                \
+    } else if (begin == __avl_successor_##id(this->root)) {                              \
+        __avltree_clear_##id(this);                                                      \
+        return ((void *) -1);                                                            \
     } else {                                                                             \
         begin = __avltree_remove_entry_##id(this, begin);                                \
         while (begin != ((void *)-1)) {                                                  \
@@ -420,5 +599,267 @@ EntryType *__avltree_erase_##id(TreeType *this,
         return ((void *) -1);                                                            \
     }                                                                                    \
 }                                                                                        \
+                                                                                         \
+EntryType *__avltree_lower_bound_##id(TreeType const *this, kt const key) {              \
+    EntryType *curr = this->root, *bound = NULL;                                         \
+    while (curr) {                                                                       \
+        if (cmp_lt(entry_get_key(curr), key)) {                                          \
+            curr = curr->right;                                                          \
+        } else {                                                                         \
+            bound = curr;                                                                \
+            curr = curr->left;                                                           \
+        }                                                                                \
+    }                                                                                    \
+    return bound;                                                                        \
+}                                                                                        \
+                                                                                         \
+EntryType *__avltree_upper_bound_##id(TreeType const *this, kt const key) {              \
+    EntryType *curr = this->root, *bound = NULL;                                         \
+    while (curr) {                                                                       \
+        if (cmp_lt(key, entry_get_key(curr))) {                                          \
+            bound = curr;                                                                \
+            curr = curr->left;                                                           \
+        } else {                                                                         \
+            curr = curr->right;                                                          \
+        }                                                                                \
+    }                                                                                    \
+    return bound;                                                                        \
+}                                                                                        \
+                                                                                         \
+unsigned char __avlEntry_key_lt_##id(EntryType const *e, kt const key) {                 \
+    return cmp_lt(entry_get_key(e), key);                                                \
+}                                                                                        \
+                                                                                         \
+EntryType *__avltree_at_rank_##id(TreeType const *this, unsigned k) {                    \
+    EntryType *e;                                                                        \
+    if (k >= this->size) return NULL;                                                    \
+    else if (__avl_has_counts_##id()) return __avl_select_##id(this->root, k);           \
+                                                                                         \
+    e = __avl_successor_##id(this->root);                                                \
+    for (; k; --k, e = __avl_inorder_successor_##id(e));                                 \
+    return e;                                                                            \
+}                                                                                        \
+                                                                                         \
+unsigned __avltree_rank_of_##id(TreeType const *this, kt const key) {                    \
+    EntryType *curr = this->root;                                                        \
+    unsigned rank = 0;                                                                   \
+    if (!__avl_has_counts_##id()) {                                                      \
+        curr = __avl_successor_##id(curr);                                               \
+        for (; curr && cmp_lt(entry_get_key(curr), key); ++rank) {                       \
+            curr = __avl_inorder_successor_##id(curr);                                   \
+        }                                                                                \
+        return rank;                                                                     \
+    }                                                                                    \
+    while (curr) {                                                                       \
+        if (cmp_lt(entry_get_key(curr), key)) {                                          \
+            rank += __avl_count_##id(curr->left) + 1;                                    \
+            curr = curr->right;                                                          \
+        } else {                                                                         \
+            curr = curr->left;                                                           \
+        }                                                                                \
+    }                                                                                    \
+    return rank;                                                                         \
+}                                                                                        \
+                                                                                         \
+unsigned __avltree_count_range_##id(TreeType const *this, kt const lo, kt const hi) {    \
+    if (!cmp_lt(lo, hi)) return 0;                                                       \
+    return __avltree_rank_of_##id(this, hi) - __avltree_rank_of_##id(this, lo);          \
+}                                                                                        \
+                                                                                         \
+static EntryType *__avl_build_##id(TreeType *this, EntryType *parent,                    \
+                                   DataType const *arr, EntryType *nodes,                \
+                                   unsigned n, unsigned *height) {                       \
+    /*                                                                                   \
+     * The middle element becomes the root, so both halves differ by at most             \
+     * one. Entries come from the pool, or from nodes (which then holds one              \
+     * entry per element of arr, in the same order) if it is not NULL.                   \
+     */                                                                                  \
+    unsigned const mid = n / 2;                                                          \
+    unsigned hl = 0, hr = 0;                                                             \
+    EntryType *e;                                                                        \
+    *height = 0;                                                                         \
+    if (!n) return NULL;                                                                 \
+    else if (nodes) e = nodes + mid;                                                     \
+    else if (!(e = ds_pool_alloc(&this->pool, sizeof(EntryType)))) return NULL;          \
+                                                                                         \
+    copyKey(entry_get_key(e), data_get_key(arr[mid]));                                   \
+    copyValue(e->data.second, arr[mid].second);                                          \
+    e->parent = parent;                                                                  \
+    ++this->size;                                                                        \
+    e->left = __avl_build_##id(this, e, arr, nodes, mid, &hl);                           \
+    e->right = __avl_build_##id(this, e, arr + mid + 1, nodes ? nodes + mid + 1 : NULL,  \
+                                n - mid - 1, &hr);                                       \
+    e->bf = (signed char) ((int) hr - (int) hl);                                         \
+    __avl_fix_count_##id(e);                                                             \
+    *height = max(hl, hr) + 1;                                                           \
+    return e;                                                                            \
+}                                                                                        \
+                                                                                         \
+unsigned char __avltree_build_fromSorted_##id(TreeType *this,                            \
+                                              DataType const *arr,                       \
+                                              unsigned n) {                              \
+    unsigned height;                                                                     \
+    customAssert(this->root == NULL)                                                     \
+    if (!n) return 1;                                                                    \
+    else if (this->root || !arr) return 0;                                               \
+                                                                                         \
+    this->root = __avl_build_##id(this, NULL, arr, NULL, n, &height);                    \
+    if (this->size != n) {                                                               \
+        __avltree_clear_##id(this);                                                      \
+        return 0;                                                                        \
+    }                                                                                    \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+TreeType *__avltree_new_fromSorted_##id(DataType const *arr, unsigned n) {               \
+    TreeType *t;                                                                         \
+    DSPoolSlabHeader *slab;                                                              \
+    size_t const bytes = (size_t) n * sizeof(EntryType);                                 \
+    unsigned i, height;                                                                  \
+    for (i = 1; arr && i < n; ++i) {                                                     \
+        if (!cmp_lt(data_get_key(arr[i - 1]), data_get_key(arr[i]))) {                   \
+            return __avltree_new_fromArray_##id(arr, n);                                 \
+        }                                                                                \
+    }                                                                                    \
+    if (!(t = __avltree_new_withPool_##id(DS_AVL_BULK_CHUNK)) || !arr || !n) return t;   \
+    else if (bytes / sizeof(EntryType) != n ||                                           \
+            !(slab = __ds_malloc(sizeof(DSPoolSlabHeader) + bytes))) {                   \
+        __avltree_free_##id(t);                                                          \
+        return NULL;                                                                     \
+    }                                                                                    \
+    /* the slab belongs to the pool, so it is freed along with later slabs; its header
+       is padded to the strictest alignment, so the entries after it are aligned */      \
+    slab->next = NULL;                                                                   \
+    t->pool.slabs = slab;                                                                \
+    t->root = __avl_build_##id(t, NULL, arr, (EntryType *) (slab + 1), n, &height);      \
+    return t;                                                                            \
+}                                                                                        \
+                                                                                         \
+static unsigned __avl_height_##id(EntryType const *e) {                                  \
+    unsigned h = 0;                                                                      \
+    for (; e; ++h, e = e->bf < 0 ? e->left : e->right);                                  \
+    return h;                                                                            \
+}                                                                                        \
+                                                                                         \
+static EntryType *__avl_join_##id(EntryType *l, EntryType *k, EntryType *r) {            \
+    /* every key in l < key of k < every key in r; returns the root of the result */     \
+    unsigned const hl = __avl_height_##id(l), hr = __avl_height_##id(r);                 \
+    unsigned h;                                                                          \
+    EntryType *c, *p = NULL;                                                             \
+    TreeType tmp;                                                                        \
+    if (l) l->parent = NULL;                                                             \
+    if (r) r->parent = NULL;                                                             \
+    k->parent = NULL;                                                                    \
+                                                                                         \
+    if (hl > hr + 1) {                                                                   \
+        /* hang k where the right spine of l is as tall as r, then rebalance */          \
+        for (c = l, h = hl; h > hr + 1; p = c, h -= c->bf < 0 ? 2 : 1, c = c->right);    \
+        k->left = c;                                                                     \
+        k->right = r;                                                                    \
+        k->bf = (signed char) ((int) hr - (int) h);                                      \
+        p->right = k;                                                                    \
+        tmp.root = l;                                                                    \
+    } else if (hr > hl + 1) {                                                            \
+        for (c = r, h = hr; h > hl + 1; p = c, h -= c->bf > 0 ? 2 : 1, c = c->left);     \
+        k->left = l;                                                                     \
+        k->right = c;                                                                    \
+        k->bf = (signed char) ((int) h - (int) hl);                                      \
+        p->left = k;                                                                     \
+        tmp.root = r;                                                                    \
+    } else {                                                                             \
+        k->left = l;                                                                     \
+        k->right = r;                                                                    \
+        k->bf = (signed char) ((int) hr - (int) hl);                                     \
+        if (l) l->parent = k;                                                            \
+        if (r) r->parent = k;                                                            \
+        __avl_fix_count_##id(k);                                                         \
+        return k;                                                                        \
+    }                                                                                    \
+                                                                                         \
+    k->parent = p;                                                                       \
+    if (k->left) k->left->parent = k;                                                    \
+    if (k->right) k->right->parent = k;                                                  \
+    for (c = k; c; c = c->parent) __avl_fix_count_##id(c);                               \
+    __avl_retrace_insert_##id(&tmp, k);                                                  \
+    return tmp.root;                                                                     \
+}                                                                                        \
+                                                                                         \
+static EntryType *__avl_detach_##id(EntryType *e, EntryType **l, EntryType **r) {        \
+    *l = e->left;                                                                        \
+    *r = e->right;                                                                       \
+    if (*l) (*l)->parent = NULL;                                                         \
+    if (*r) (*r)->parent = NULL;                                                         \
+    e->left = e->right = NULL;                                                           \
+    return e;                                                                            \
+}                                                                                        \
+                                                                                         \
+static void __avl_split_##id(EntryType *e, kt const key,                                 \
+                             EntryType **l, EntryType **r, EntryType **found) {          \
+    /* splits the subtree at e into the entries less than and greater than key */        \
+    EntryType *left, *right, *mid;                                                       \
+    if (!e) {                                                                            \
+        *l = *r = NULL;                                                                  \
+        return;                                                                          \
+    }                                                                                    \
+    __avl_detach_##id(e, &left, &right);                                                 \
+    if (cmp_lt(key, entry_get_key(e))) {                                                 \
+        __avl_split_##id(left, key, l, &mid, found);                                     \
+        *r = __avl_join_##id(mid, e, right);                                             \
+    } else if (cmp_lt(entry_get_key(e), key)) {                                          \
+        __avl_split_##id(right, key, &mid, r, found);                                    \
+        *l = __avl_join_##id(left, e, mid);                                              \
+    } else {                                                                             \
+        *found = e;                                                                      \
+        *l = left;                                                                       \
+        *r = right;                                                                      \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+static EntryType *__avl_union_##id(TreeType *other, EntryType *a, EntryType *b) {        \
+    /*                                                                                   \
+     * Splits b around the root of a and recurses on both sides. The two                 \
+     * recursive calls touch disjoint entries, so they could run in parallel.            \
+     */                                                                                  \
+    EntryType *la, *ra, *lb, *rb, *dup = NULL;                                           \
+    if (!a) return b;                                                                    \
+    else if (!b) return a;                                                               \
+                                                                                         \
+    __avl_detach_##id(a, &la, &ra);                                                      \
+    __avl_split_##id(b, entry_get_key(a), &lb, &rb, &dup);                               \
+    if (dup) {                                                                           \
+        deleteKey(entry_get_key(dup));                                                   \
+        deleteValue(dup->data.second);                                                   \
+        ds_pool_free(&other->pool, dup);                                                 \
+        --other->size;                                                                   \
+    }                                                                                    \
+    la = __avl_union_##id(other, la, lb);                                                \
+    ra = __avl_union_##id(other, ra, rb);                                                \
+    return __avl_join_##id(la, a, ra);                                                   \
+}                                                                                        \
+                                                                                         \
+unsigned char __avltree_merge_##id(TreeType *this, TreeType *other) {                    \
+    EntryType *e;                                                                        \
+    if (this == other || !other->root) return 1;                                         \
+                                                                                         \
+    if (!this->pool.chunk && !other->pool.chunk &&                                       \
+            other->size <= UINT_MAX - this->size) {                                      \
+        /* unpooled entries can change owners, so the trees are joined in place */       \
+        this->root = __avl_union_##id(other, this->root, other->root);                   \
+        this->size += other->size;                                                       \
+        other->root = NULL;                                                              \
+        other->size = 0;                                                                 \
+        return 1;                                                                        \
+    }                                                                                    \
+                                                                                         \
+    e = __avl_successor_##id(other->root);                                               \
+    for (; e; e = __avl_inorder_successor_##id(e)) {                                     \
+        if (!__avltree_find_key_##id(this, entry_get_key(e), 0) &&                       \
+                !__avltree_insert_##id(this, e->data, NULL)) {                           \
+            return 0;                                                                    \
+        }                                                                                \
+    }                                                                                    \
+    __avltree_clear_##id(other);                                                         \
+    return 1;                                                                            \
+}                                                                                        \
 
 #endif /* DS_AVL_TREE_H */
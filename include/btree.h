@@ -0,0 +1,782 @@
+#ifndef DS_BTREE_H
+#define DS_BTREE_H
+
+#include "ds.h"
+#include "pool.h"
+
+/*
+ * B+-tree engine for Set and Map. Elements are stored in sorted leaves which
+ * are linked to each other, and inner nodes hold separator keys only, so a
+ * lookup touches a few wide nodes instead of one node per level of a binary
+ * tree, and in-order iteration walks contiguous arrays.
+ *
+ * The engine defines the same functions as the AVL tree in avltree.h, so the
+ * set_* and map_* macros work unchanged on either one. An entry is a slot in a
+ * leaf: inserting or removing an element may move the other elements of its
+ * leaf (or of a sibling), so entry pointers other than the one returned by an
+ * insertion or removal must be looked up again afterwards.
+ *
+ * Leaves are aligned to a power of two no smaller than their size, which lets
+ * the iterators find the leaf of an entry from its address alone. They are
+ * carved out of slabs owned by the tree, so clearing or freeing it releases
+ * them all at once.
+ */
+
+/* Approximate size of a node in bytes. Must be a power of two. */
+#ifndef DS_BTREE_NODE_SIZE
+#define DS_BTREE_NODE_SIZE 256
+#endif
+
+/* Number of leaves per slab when the tree is created without a pool size. */
+#ifndef DS_BTREE_SLAB_LEAVES
+#define DS_BTREE_SLAB_LEAVES 8
+#endif
+
+/* Maximum height of a tree; 32 levels hold far more than UINT_MAX elements. */
+#define DS_BTREE_MAX_DEPTH 32
+
+#define __btree_cap(bytes, size) ((bytes) / (size) < 4 ? 4 : (bytes) / (size))
+
+/* level is 0 for a leaf; n is the number of elements or separator keys */
+typedef struct {
+    unsigned level;
+    unsigned n;
+} DSBTreeNode;
+
+#define __setup_btree_headers(id, kt, TreeType, DataType, EntryType)                     \
+                                                                                         \
+typedef struct EntryType EntryType;                                                      \
+struct EntryType {                                                                       \
+    DataType data;                                                                       \
+};                                                                                       \
+                                                                                         \
+enum {                                                                                   \
+    __BTREE_LEAF_CAP_##id = __btree_cap(DS_BTREE_NODE_SIZE - sizeof(DSBTreeNode) -       \
+                                        2 * sizeof(void *), sizeof(EntryType)),          \
+    __BTREE_INNER_CAP_##id = __btree_cap(DS_BTREE_NODE_SIZE - sizeof(DSBTreeNode) -      \
+                                         sizeof(void *), sizeof(kt) + sizeof(void *))    \
+};                                                                                       \
+                                                                                         \
+typedef struct __BTreeLeaf_##id __BTreeLeaf_##id;                                        \
+struct __BTreeLeaf_##id {                                                                \
+    DSBTreeNode h;                                                                       \
+    __BTreeLeaf_##id *prev;                                                              \
+    __BTreeLeaf_##id *next;                                                              \
+    EntryType slots[__BTREE_LEAF_CAP_##id];                                              \
+};                                                                                       \
+                                                                                         \
+typedef struct {                                                                         \
+    DSBTreeNode h;                                                                       \
+    kt keys[__BTREE_INNER_CAP_##id];                                                     \
+    DSBTreeNode *children[__BTREE_INNER_CAP_##id + 1];                                   \
+} __BTreeInner_##id;                                                                     \
+                                                                                         \
+typedef struct {                                                                         \
+    DSBTreeNode *root;                                                                   \
+    unsigned size;                                                                       \
+    unsigned leavesPerSlab;                                                              \
+    void *freeLeaves;                                                                    \
+    void *slabs;                                                                         \
+} TreeType;                                                                              \
+                                                                                         \
+EntryType *__avl_successor_##id(DSBTreeNode const *x);                                   \
+EntryType *__avl_predecessor_##id(DSBTreeNode const *x);                                 \
+EntryType *__avl_inorder_successor_##id(EntryType const *x);                             \
+EntryType *__avl_inorder_predecessor_##id(EntryType const *x);                           \
+void __avlEntry_advance_##id(EntryType **p1, long n) __attribute__((nonnull));           \
+long __avlEntry_distance_##id(EntryType const *p1, EntryType const *p2);                 \
+                                                                                         \
+EntryType *__avltree_find_key_##id(TreeType const *this,                                 \
+                                   kt const key, unsigned char candidate)                \
+  __attribute__((nonnull));                                                              \
+EntryType *__avltree_insert_##id(TreeType *this,                                         \
+                                 DataType const data, int *inserted)                     \
+  __attribute__((nonnull (1)));                                                          \
+unsigned char __avltree_insert_fromArray_##id(TreeType *this,                            \
+                                              DataType const *arr,                       \
+                                              unsigned n)                                \
+  __attribute__((nonnull));                                                              \
+unsigned char __avltree_insert_fromTree_##id(TreeType *this,                             \
+                                             EntryType const *start,                     \
+                                             EntryType const *end)                       \
+  __attribute__((nonnull (1)));                                                          \
+TreeType *__avltree_new_fromArray_##id(DataType const *arr, unsigned n);                 \
+TreeType *__avltree_new_withPool_##id(unsigned chunk);                                   \
+TreeType *__avltree_new_fromSorted_##id(DataType const *arr, unsigned n);                \
+void __avltree_free_##id(TreeType *this) __attribute__((nonnull));                       \
+TreeType *__avltree_createCopy_##id(TreeType const *other)                               \
+  __attribute__((nonnull));                                                              \
+EntryType * __avltree_remove_entry_##id(TreeType *this, EntryType *v)                    \
+  __attribute__((nonnull (1)));                                                          \
+EntryType *__avltree_erase_##id(TreeType *this,                                          \
+                                EntryType *begin, EntryType const *end)                  \
+  __attribute__((nonnull (1)));                                                          \
+EntryType *__avltree_lower_bound_##id(TreeType const *this, kt const key)                \
+  __attribute__((nonnull));                                                              \
+EntryType *__avltree_upper_bound_##id(TreeType const *this, kt const key)                \
+  __attribute__((nonnull));                                                              \
+unsigned char __avlEntry_key_lt_##id(EntryType const *e, kt const key)                   \
+  __attribute__((nonnull));                                                              \
+EntryType *__avltree_at_rank_##id(TreeType const *this, unsigned k)                      \
+  __attribute__((nonnull));                                                              \
+unsigned __avltree_rank_of_##id(TreeType const *this, kt const key)                      \
+  __attribute__((nonnull));                                                              \
+unsigned __avltree_count_range_##id(TreeType const *this, kt const lo, kt const hi)      \
+  __attribute__((nonnull));                                                              \
+unsigned char __avltree_build_fromSorted_##id(TreeType *this,                            \
+                                              DataType const *arr,                       \
+                                              unsigned n)                                \
+  __attribute__((nonnull (1)));                                                          \
+unsigned char __avltree_merge_##id(TreeType *this, TreeType *other)                      \
+  __attribute__((nonnull));                                                              \
+
+#define __setup_btree_source(id, kt, TreeType, DataType, EntryType, cmp_lt,              \
+                             entry_get_key, data_get_key, copyKey, deleteKey,            \
+                             copyValue, deleteValue)                                     \
+                                                                                         \
+static size_t __btree_leaf_align_##id(void) {                                            \
+    size_t align = DS_BTREE_NODE_SIZE;                                                   \
+    while (align < sizeof(__BTreeLeaf_##id)) align <<= 1;                                \
+    return align;                                                                        \
+}                                                                                        \
+                                                                                         \
+static __BTreeLeaf_##id *__btree_leaf_of_##id(EntryType const *e) {                      \
+    size_t offset = (size_t) e & (__btree_leaf_align_##id() - 1);                        \
+    return (__BTreeLeaf_##id *) ((char *) e - offset);                                   \
+}                                                                                        \
+                                                                                         \
+static __BTreeLeaf_##id *__btree_leaf_new_##id(TreeType *this) {                         \
+    __BTreeLeaf_##id *leaf;                                                              \
+    if (!this->freeLeaves) {                                                             \
+        unsigned i, k = this->leavesPerSlab;                                             \
+        size_t align = __btree_leaf_align_##id();                                        \
+        DSPoolSlabHeader *slab;                                                          \
+        char *base;                                                                      \
+        if (!k) k = DS_BTREE_SLAB_LEAVES;                                                \
+        if (!(slab = __ds_malloc(sizeof(DSPoolSlabHeader) + (k + 1) * align))) {         \
+            return NULL;                                                                 \
+        }                                                                                \
+        slab->next = this->slabs;                                                        \
+        this->slabs = slab;                                                              \
+        base = (char *) (slab + 1);                                                      \
+        base += (align - ((size_t) base & (align - 1))) & (align - 1);                   \
+        for (i = k; i; --i) {                                                            \
+            void *n = base + (i - 1) * align;                                            \
+            *(void **) n = this->freeLeaves;                                             \
+            this->freeLeaves = n;                                                        \
+        }                                                                                \
+    }                                                                                    \
+    leaf = this->freeLeaves;                                                             \
+    this->freeLeaves = *(void **) leaf;                                                  \
+    leaf->h.level = leaf->h.n = 0;                                                       \
+    leaf->prev = leaf->next = NULL;                                                      \
+    return leaf;                                                                         \
+}                                                                                        \
+                                                                                         \
+static void __btree_leaf_free_##id(TreeType *this, __BTreeLeaf_##id *leaf) {             \
+    *(void **) leaf = this->freeLeaves;                                                  \
+    this->freeLeaves = leaf;                                                             \
+}                                                                                        \
+                                                                                         \
+static unsigned __btree_upper_bound_##id(__BTreeInner_##id const *node,                  \
+                                         kt const key) {                                 \
+    unsigned lo = 0, hi = node->h.n, mid;                                                \
+    while (lo < hi) {                                                                    \
+        mid = (lo + hi) / 2;                                                             \
+        if (cmp_lt(key, node->keys[mid])) {                                              \
+            hi = mid;                                                                    \
+        } else {                                                                         \
+            lo = mid + 1;                                                                \
+        }                                                                                \
+    }                                                                                    \
+    return lo;                                                                           \
+}                                                                                        \
+                                                                                         \
+static unsigned __btree_lower_bound_##id(__BTreeLeaf_##id const *leaf, kt const key) {   \
+    unsigned lo = 0, hi = leaf->h.n, mid;                                                \
+    while (lo < hi) {                                                                    \
+        mid = (lo + hi) / 2;                                                             \
+        if (cmp_lt(entry_get_key(&leaf->slots[mid]), key)) {                             \
+            lo = mid + 1;                                                                \
+        } else {                                                                         \
+            hi = mid;                                                                    \
+        }                                                                                \
+    }                                                                                    \
+    return lo;                                                                           \
+}                                                                                        \
+                                                                                         \
+EntryType *__avl_successor_##id(DSBTreeNode const *x) {                                  \
+    if (!x) return NULL;                                                                 \
+    for (; x->level; x = ((__BTreeInner_##id const *) x)->children[0]);                  \
+    return ((__BTreeLeaf_##id *) x)->slots;                                              \
+}                                                                                        \
+                                                                                         \
+EntryType *__avl_predecessor_##id(DSBTreeNode const *x) {                                \
+    __BTreeLeaf_##id *leaf;                                                              \
+    if (!x) return NULL;                                                                 \
+    for (; x->level; x = ((__BTreeInner_##id const *) x)->children[x->n]);               \
+    leaf = (__BTreeLeaf_##id *) x;                                                       \
+    return &leaf->slots[leaf->h.n - 1];                                                  \
+}                                                                                        \
+                                                                                         \
+EntryType *__avl_inorder_successor_##id(EntryType const *x) {                            \
+    __BTreeLeaf_##id *leaf;                                                              \
+    if (!x) return NULL;                                                                 \
+    leaf = __btree_leaf_of_##id(x);                                                      \
+    if (x + 1 < leaf->slots + leaf->h.n) return (EntryType *) (x + 1);                   \
+    return leaf->next ? leaf->next->slots : NULL;                                        \
+}                                                                                        \
+                                                                                         \
+EntryType *__avl_inorder_predecessor_##id(EntryType const *x) {                          \
+    __BTreeLeaf_##id *leaf;                                                              \
+    if (!x) return NULL;                                                                 \
+    leaf = __btree_leaf_of_##id(x);                                                      \
+    if (x > leaf->slots) return (EntryType *) (x - 1);                                   \
+    return leaf->prev ? &leaf->prev->slots[leaf->prev->h.n - 1] : NULL;                  \
+}                                                                                        \
+                                                                                         \
+void __avlEntry_advance_##id(EntryType **p1, long n) {                                   \
+    __BTreeLeaf_##id *leaf;                                                              \
+    long i;                                                                              \
+    if (!*p1) return;                                                                    \
+    leaf = __btree_leaf_of_##id(*p1);                                                    \
+    i = (*p1 - leaf->slots) + n;                                                         \
+    if (n >= 0) {                                                                        \
+        while (leaf && i >= (long) leaf->h.n) {                                          \
+            i -= (long) leaf->h.n;                                                       \
+            leaf = leaf->next;                                                           \
+        }                                                                                \
+    } else {                                                                             \
+        while (leaf && i < 0) {                                                          \
+            if ((leaf = leaf->prev)) i += (long) leaf->h.n;                              \
+        }                                                                                \
+    }                                                                                    \
+    *p1 = leaf ? &leaf->slots[i] : NULL;                                                 \
+}                                                                                        \
+                                                                                         \
+long __avlEntry_distance_##id(EntryType const *p1, EntryType const *p2) {                \
+    __BTreeLeaf_##id *leaf, *target;                                                     \
+    long dist;                                                                           \
+    if (!p1) return p2 ? -1 : 0;                                                         \
+    leaf = __btree_leaf_of_##id(p1);                                                     \
+    target = p2 ? __btree_leaf_of_##id(p2) : NULL;                                       \
+    /* count whole leaves, starting from the first slot of the leaf of p1 */             \
+    for (dist = -(p1 - leaf->slots); leaf; leaf = leaf->next) {                          \
+        if (leaf == target) {                                                            \
+            dist += p2 - leaf->slots;                                                    \
+            return dist < 0 ? -1 : dist;                                                 \
+        }                                                                                \
+        dist += (long) leaf->h.n;                                                        \
+    }                                                                                    \
+    return p2 ? -1 : dist;                                                               \
+}                                                                                        \
+                                                                                         \
+EntryType *__avltree_find_key_##id(TreeType const *this,                                 \
+                                   kt const key, unsigned char candidate) {              \
+    DSBTreeNode *node = this->root;                                                      \
+    __BTreeLeaf_##id *leaf;                                                              \
+    unsigned i;                                                                          \
+    if (!node) return NULL;                                                              \
+    while (node->level) {                                                                \
+        __BTreeInner_##id *inner = (__BTreeInner_##id *) node;                           \
+        node = inner->children[__btree_upper_bound_##id(inner, key)];                    \
+    }                                                                                    \
+    leaf = (__BTreeLeaf_##id *) node;                                                    \
+    i = __btree_lower_bound_##id(leaf, key);                                             \
+    if (i < leaf->h.n) {                                                                 \
+        if (candidate || !cmp_lt(key, entry_get_key(&leaf->slots[i]))) {                 \
+            return &leaf->slots[i];                                                      \
+        }                                                                                \
+        return NULL;                                                                     \
+    }                                                                                    \
+    /* the lower bound, if any, is the first element of the next leaf */                 \
+    return candidate && leaf->next ? leaf->next->slots : NULL;                           \
+}                                                                                        \
+                                                                                         \
+static EntryType *__btree_split_insert_##id(TreeType *this,                              \
+                                            __BTreeInner_##id **path,                    \
+                                            unsigned *pos, unsigned depth,               \
+                                            __BTreeLeaf_##id *leaf, unsigned i,          \
+                                            DataType const data) {                       \
+    __BTreeInner_##id *spare[DS_BTREE_MAX_DEPTH + 1];                                    \
+    __BTreeLeaf_##id *right, *target;                                                    \
+    DSBTreeNode *child;                                                                  \
+    EntryType *new;                                                                      \
+    unsigned mid, full, nSpare, s;                                                       \
+    const unsigned cap = __BTREE_LEAF_CAP_##id;                                          \
+    kt sep;                                                                              \
+                                                                                         \
+    /* allocate every node the split may need up front, so failure changes nothing */    \
+    for (full = depth; full && path[full - 1]->h.n == __BTREE_INNER_CAP_##id; --full);   \
+    nSpare = depth - full + !full;                                                       \
+    if (!(right = __btree_leaf_new_##id(this))) return NULL;                             \
+    for (s = 0; s < nSpare; ++s) {                                                       \
+        if (!(spare[s] = __ds_malloc(sizeof(__BTreeInner_##id)))) {                      \
+            while (s) __ds_free(spare[--s]);                                             \
+            __btree_leaf_free_##id(this, right);                                         \
+            return NULL;                                                                 \
+        }                                                                                \
+    }                                                                                    \
+                                                                                         \
+    /* keep leaves full when appending or prepending, otherwise split evenly */          \
+    if (i == cap && !leaf->next) {                                                       \
+        mid = cap;                                                                       \
+    } else if (i == 0 && !leaf->prev) {                                                  \
+        mid = 0;                                                                         \
+    } else {                                                                             \
+        mid = cap / 2;                                                                   \
+    }                                                                                    \
+    right->h.n = cap - mid;                                                              \
+    memcpy(right->slots, &leaf->slots[mid], (cap - mid) * sizeof(EntryType));            \
+    leaf->h.n = mid;                                                                     \
+    right->next = leaf->next;                                                            \
+    if (right->next) right->next->prev = right;                                          \
+    right->prev = leaf;                                                                  \
+    leaf->next = right;                                                                  \
+                                                                                         \
+    if (i < mid || (i == mid && mid < cap)) {                                            \
+        target = leaf;                                                                   \
+    } else {                                                                             \
+        target = right;                                                                  \
+        i -= mid;                                                                        \
+    }                                                                                    \
+    new = &target->slots[i];                                                             \
+    memmove(new + 1, new, (target->h.n - i) * sizeof(EntryType));                        \
+    copyKey(entry_get_key(new), data_get_key(data));                                     \
+    copyValue(new->data.second, data.second);                                            \
+    ++target->h.n;                                                                       \
+    copyKey(sep, entry_get_key(right->slots));                                           \
+                                                                                         \
+    for (child = &right->h, s = 0; ; ) {                                                 \
+        __BTreeInner_##id *parent, *sibling;                                             \
+        kt keys[__BTREE_INNER_CAP_##id + 1];                                             \
+        DSBTreeNode *children[__BTREE_INNER_CAP_##id + 2];                               \
+        unsigned p, n, half;                                                             \
+        if (!depth) {                                                                    \
+            parent = spare[s++];                                                         \
+            parent->h.level = this->root->level + 1;                                     \
+            parent->h.n = 1;                                                             \
+            parent->keys[0] = sep;                                                       \
+            parent->children[0] = this->root;                                            \
+            parent->children[1] = child;                                                 \
+            this->root = &parent->h;                                                     \
+            break;                                                                       \
+        }                                                                                \
+        parent = path[--depth];                                                          \
+        p = pos[depth];                                                                  \
+        n = parent->h.n;                                                                 \
+        if (n < __BTREE_INNER_CAP_##id) {                                                \
+            memmove(&parent->keys[p + 1], &parent->keys[p], (n - p) * sizeof(kt));       \
+            memmove(&parent->children[p + 2], &parent->children[p + 1],                  \
+                    (n - p) * sizeof(DSBTreeNode *));                                    \
+            parent->keys[p] = sep;                                                       \
+            parent->children[p + 1] = child;                                             \
+            ++parent->h.n;                                                               \
+            break;                                                                       \
+        }                                                                                \
+                                                                                         \
+        /* full: the middle separator moves up and the upper half goes right */          \
+        memcpy(keys, parent->keys, p * sizeof(kt));                                      \
+        keys[p] = sep;                                                                   \
+        memcpy(&keys[p + 1], &parent->keys[p], (n - p) * sizeof(kt));                    \
+        memcpy(children, parent->children, (p + 1) * sizeof(DSBTreeNode *));             \
+        children[p + 1] = child;                                                         \
+        memcpy(&children[p + 2], &parent->children[p + 1],                               \
+               (n - p) * sizeof(DSBTreeNode *));                                         \
+        half = (n + 1) / 2;                                                              \
+        sibling = spare[s++];                                                            \
+        sibling->h.level = parent->h.level;                                              \
+        sibling->h.n = n - half;                                                         \
+        parent->h.n = half;                                                              \
+        memcpy(parent->keys, keys, half * sizeof(kt));                                   \
+        memcpy(parent->children, children, (half + 1) * sizeof(DSBTreeNode *));          \
+        memcpy(sibling->keys, &keys[half + 1], (n - half) * sizeof(kt));                 \
+        memcpy(sibling->children, &children[half + 1],                                   \
+               (n - half + 1) * sizeof(DSBTreeNode *));                                  \
+        sep = keys[half];                                                                \
+        child = &sibling->h;                                                             \
+    }                                                                                    \
+    customAssert(s == nSpare)                                                            \
+    ++this->size;                                                                        \
+    return new;                                                                          \
+}                                                                                        \
+                                                                                         \
+EntryType *__avltree_insert_##id(TreeType *this,                                         \
+                                 DataType const data, int *inserted) {                   \
+    __BTreeInner_##id *path[DS_BTREE_MAX_DEPTH];                                         \
+    unsigned pos[DS_BTREE_MAX_DEPTH];                                                    \
+    unsigned depth = 0, i;                                                               \
+    DSBTreeNode *node;                                                                   \
+    __BTreeLeaf_##id *leaf;                                                              \
+    EntryType *new;                                                                      \
+    if (!this->root) {                                                                   \
+        if (!(leaf = __btree_leaf_new_##id(this))) return NULL;                          \
+        this->root = &leaf->h;                                                           \
+    }                                                                                    \
+                                                                                         \
+    for (node = this->root; node->level; ++depth) {                                      \
+        path[depth] = (__BTreeInner_##id *) node;                                        \
+        pos[depth] = __btree_upper_bound_##id(path[depth], data_get_key(data));          \
+        node = path[depth]->children[pos[depth]];                                        \
+    }                                                                                    \
+    leaf = (__BTreeLeaf_##id *) node;                                                    \
+    i = __btree_lower_bound_##id(leaf, data_get_key(data));                              \
+    if (i < leaf->h.n && !cmp_lt(data_get_key(data), entry_get_key(&leaf->slots[i]))) {  \
+        deleteValue(leaf->slots[i].data.second);                                         \
+        copyValue(leaf->slots[i].data.second, data.second);                              \
+        if (inserted) *inserted = 0;                                                     \
+        return &leaf->slots[i];                                                          \
+    } else if (this->size == UINT_MAX) {                                                 \
+        return NULL;                                                                     \
+    }                                                                                    \
+                                                                                         \
+    if (leaf->h.n < __BTREE_LEAF_CAP_##id) {                                             \
+        new = &leaf->slots[i];                                                           \
+        memmove(new + 1, new, (leaf->h.n - i) * sizeof(EntryType));                      \
+        copyKey(entry_get_key(new), data_get_key(data));                                 \
+        copyValue(new->data.second, data.second);                                        \
+        ++leaf->h.n;                                                                     \
+        ++this->size;                                                                    \
+    } else if (!(new = __btree_split_insert_##id(this, path, pos, depth, leaf, i,        \
+                                                   data))) {                             \
+        return NULL;                                                                     \
+    }                                                                                    \
+    if (inserted) *inserted = 1;                                                         \
+    return new;                                                                          \
+}                                                                                        \
+                                                                                         \
+unsigned char __avltree_insert_fromArray_##id(TreeType *this,                            \
+                                              DataType const *arr,                       \
+                                              unsigned n) {                              \
+    unsigned i;                                                                          \
+    for (i = 0; i < n; ++i) {                                                            \
+        if (!__avltree_insert_##id(this, arr[i], NULL)) return 0;                        \
+    }                                                                                    \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+unsigned char __avltree_insert_fromTree_##id(TreeType *this,                             \
+                                             EntryType const *start,                     \
+                                             EntryType const *end) {                     \
+    if (start) {                                                                         \
+        for (; start != end; start = __avl_inorder_successor_##id(start)) {              \
+            customAssert(start)                                                          \
+            if (!__avltree_insert_##id(this, start->data, NULL)) return 0;               \
+        }                                                                                \
+    }                                                                                    \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+TreeType *__avltree_new_fromArray_##id(DataType const *arr, unsigned n) {                \
+    TreeType *t = __ds_calloc(1, sizeof(TreeType));                                      \
+    customAssert(t)                                                                      \
+    if (t && arr && n) __avltree_insert_fromArray_##id(t, arr, n);                       \
+    return t;                                                                            \
+}                                                                                        \
+                                                                                         \
+TreeType *__avltree_new_withPool_##id(unsigned chunk) {                                  \
+    TreeType *t = __avltree_new_fromArray_##id(NULL, 0);                                 \
+    if (t && chunk) {                                                                    \
+        t->leavesPerSlab = chunk < __BTREE_LEAF_CAP_##id ? 1 :                           \
+                           chunk / __BTREE_LEAF_CAP_##id;                                \
+    }                                                                                    \
+    return t;                                                                            \
+}                                                                                        \
+                                                                                         \
+TreeType *__avltree_createCopy_##id(TreeType const *other) {                             \
+    EntryType *e = __avl_successor_##id(other->root);                                    \
+    TreeType *t = __avltree_new_fromArray_##id(NULL, 0);                                 \
+    if (t) {                                                                             \
+        t->leavesPerSlab = other->leavesPerSlab;                                         \
+        __avltree_insert_fromTree_##id(t, e, NULL);                                      \
+    }                                                                                    \
+    return t;                                                                            \
+}                                                                                        \
+                                                                                         \
+static void __btree_remove_inner_##id(__BTreeInner_##id *node, unsigned k) {             \
+    /* removes keys[k] and children[k + 1] */                                            \
+    memmove(&node->keys[k], &node->keys[k + 1], (node->h.n - k - 1) * sizeof(kt));       \
+    memmove(&node->children[k + 1], &node->children[k + 2],                              \
+            (node->h.n - k - 1) * sizeof(DSBTreeNode *));                                \
+    --node->h.n;                                                                         \
+}                                                                                        \
+                                                                                         \
+static void __btree_rebalance_##id(TreeType *this, __BTreeInner_##id **path,             \
+                                   unsigned *pos, unsigned depth,                        \
+                                   __BTreeLeaf_##id *leaf) {                             \
+    const unsigned leafMin = __BTREE_LEAF_CAP_##id / 2;                                  \
+    const unsigned innerMin = (__BTREE_INNER_CAP_##id - 1) / 2;                          \
+    __BTreeInner_##id *node = path[--depth];                                             \
+    unsigned p = pos[depth];                                                             \
+    __BTreeLeaf_##id *left = p ? (__BTreeLeaf_##id *) node->children[p - 1] : NULL;      \
+    __BTreeLeaf_##id *right = p < node->h.n ?                                            \
+                              (__BTreeLeaf_##id *) node->children[p + 1] : NULL;         \
+                                                                                         \
+    if (left && left->h.n > leafMin) {                                                   \
+        memmove(&leaf->slots[1], leaf->slots, leaf->h.n++ * sizeof(EntryType));          \
+        leaf->slots[0] = left->slots[--left->h.n];                                       \
+        deleteKey(node->keys[p - 1]);                                                    \
+        copyKey(node->keys[p - 1], entry_get_key(leaf->slots));                          \
+        return;                                                                          \
+    } else if (right && right->h.n > leafMin) {                                          \
+        leaf->slots[leaf->h.n++] = right->slots[0];                                      \
+        memmove(right->slots, &right->slots[1], --right->h.n * sizeof(EntryType));       \
+        deleteKey(node->keys[p]);                                                        \
+        copyKey(node->keys[p], entry_get_key(right->slots));                             \
+        return;                                                                          \
+    }                                                                                    \
+                                                                                         \
+    /* neither sibling can spare an element: merge into the left one of the pair */      \
+    if (!left) {                                                                         \
+        left = leaf;                                                                     \
+        leaf = right;                                                                    \
+        ++p;                                                                             \
+    }                                                                                    \
+    customAssert(leaf && left->h.n + leaf->h.n <= __BTREE_LEAF_CAP_##id)                 \
+    memcpy(&left->slots[left->h.n], leaf->slots, leaf->h.n * sizeof(EntryType));         \
+    left->h.n += leaf->h.n;                                                              \
+    left->next = leaf->next;                                                             \
+    if (left->next) left->next->prev = left;                                             \
+    __btree_leaf_free_##id(this, leaf);                                                  \
+    deleteKey(node->keys[p - 1]);                                                        \
+    __btree_remove_inner_##id(node, p - 1);                                              \
+                                                                                         \
+    while (node->h.n < innerMin && depth) {                                              \
+        __BTreeInner_##id *parent = path[--depth], *l, *r;                               \
+        p = pos[depth];                                                                  \
+        l = p ? (__BTreeInner_##id *) parent->children[p - 1] : NULL;                    \
+        r = p < parent->h.n ? (__BTreeInner_##id *) parent->children[p + 1] : NULL;      \
+        if (l && l->h.n > innerMin) {                                                    \
+            memmove(&node->keys[1], node->keys, node->h.n * sizeof(kt));                 \
+            memmove(&node->children[1], node->children,                                  \
+                    (node->h.n + 1) * sizeof(DSBTreeNode *));                            \
+            node->keys[0] = parent->keys[p - 1];                                         \
+            node->children[0] = l->children[l->h.n];                                     \
+            parent->keys[p - 1] = l->keys[--l->h.n];                                     \
+            ++node->h.n;                                                                 \
+            return;                                                                      \
+        } else if (r && r->h.n > innerMin) {                                             \
+            node->keys[node->h.n] = parent->keys[p];                                     \
+            node->children[++node->h.n] = r->children[0];                                \
+            parent->keys[p] = r->keys[0];                                                \
+            memmove(r->keys, &r->keys[1], (r->h.n - 1) * sizeof(kt));                    \
+            memmove(r->children, &r->children[1], r->h.n * sizeof(DSBTreeNode *));       \
+            --r->h.n;                                                                    \
+            return;                                                                      \
+        }                                                                                \
+                                                                                         \
+        /* merge, pulling the separator between the pair down */                         \
+        if (!l) {                                                                        \
+            l = node;                                                                    \
+            node = r;                                                                    \
+            ++p;                                                                         \
+        }                                                                                \
+        l->keys[l->h.n] = parent->keys[p - 1];                                           \
+        memcpy(&l->keys[l->h.n + 1], node->keys, node->h.n * sizeof(kt));                \
+        memcpy(&l->children[l->h.n + 1], node->children,                                 \
+               (node->h.n + 1) * sizeof(DSBTreeNode *));                                 \
+        l->h.n += node->h.n + 1;                                                         \
+        __ds_free(node);                                                                 \
+        __btree_remove_inner_##id(parent, p - 1);                                        \
+        node = parent;                                                                   \
+    }                                                                                    \
+                                                                                         \
+    if (!node->h.n) {                                                                    \
+        customAssert(&node->h == this->root)                                             \
+        this->root = node->children[0];                                                  \
+        __ds_free(node);                                                                 \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+EntryType * __avltree_remove_entry_##id(TreeType *this, EntryType *v) {                  \
+    __BTreeInner_##id *path[DS_BTREE_MAX_DEPTH];                                         \
+    unsigned pos[DS_BTREE_MAX_DEPTH];                                                    \
+    unsigned depth = 0, i;                                                               \
+    __BTreeLeaf_##id *leaf;                                                              \
+    EntryType *next;                                                                     \
+    if (!v) return NULL;                                                                 \
+                                                                                         \
+    leaf = __btree_leaf_of_##id(v);                                                      \
+    i = (unsigned) (v - leaf->slots);                                                    \
+    if (leaf->h.n <= __BTREE_LEAF_CAP_##id / 2 && &leaf->h != this->root) {              \
+        /* the leaf will underflow: record the path to it while its key exists */        \
+        DSBTreeNode *node;                                                               \
+        for (node = this->root; node->level; ++depth) {                                  \
+            path[depth] = (__BTreeInner_##id *) node;                                    \
+            pos[depth] = __btree_upper_bound_##id(path[depth], entry_get_key(v));        \
+            node = path[depth]->children[pos[depth]];                                    \
+        }                                                                                \
+        customAssert(node == &leaf->h)                                                   \
+    }                                                                                    \
+                                                                                         \
+    deleteKey(entry_get_key(v));                                                         \
+    deleteValue(v->data.second);                                                         \
+    memmove(v, v + 1, (leaf->h.n - i - 1) * sizeof(EntryType));                          \
+    --leaf->h.n;                                                                         \
+    --this->size;                                                                        \
+    if (i < leaf->h.n) {                                                                 \
+        next = v;                                                                        \
+    } else {                                                                             \
+        next = leaf->next ? leaf->next->slots : NULL;                                    \
+    }                                                                                    \
+                                                                                         \
+    if (depth && next) {                                                                 \
+        /* rebalancing may move the next element, so find it again by key */             \
+        kt nextKey = entry_get_key(next);                                                \
+        __btree_rebalance_##id(this, path, pos, depth, leaf);                            \
+        next = __avltree_find_key_##id(this, nextKey, 0);                                \
+    } else if (depth) {                                                                  \
+        __btree_rebalance_##id(this, path, pos, depth, leaf);                            \
+    } else if (!leaf->h.n) {                                                             \
+        customAssert(&leaf->h == this->root)                                             \
+        __btree_leaf_free_##id(this, leaf);                                              \
+        this->root = NULL;                                                               \
+    }                                                                                    \
+    return next ? next : (void *) -1;                                                    \
+}                                                                                        \
+                                                                                         \
+static void __btree_clear_node_##id(DSBTreeNode *node) {                                 \
+    unsigned i;                                                                          \
+    if (node->level) {                                                                   \
+        __BTreeInner_##id *inner = (__BTreeInner_##id *) node;                           \
+        for (i = 0; i < node->n; ++i) {                                                  \
+            deleteKey(inner->keys[i]);                                                   \
+            __btree_clear_node_##id(inner->children[i]);                                 \
+        }                                                                                \
+        __btree_clear_node_##id(inner->children[i]);                                     \
+        __ds_free(inner);                                                                \
+    } else {                                                                             \
+        EntryType *e = ((__BTreeLeaf_##id *) node)->slots;                               \
+        for (i = 0; i < node->n; ++i, ++e) {                                             \
+            deleteKey(entry_get_key(e));                                                 \
+            deleteValue(e->data.second);                                                 \
+        }                                                                                \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+static void __btree_clear_##id(TreeType *this) {                                         \
+    /* leaves are not freed one by one; their slabs are released below */                \
+    DSPoolSlabHeader *slab;                                                              \
+    if (this->root) __btree_clear_node_##id(this->root);                                 \
+    while ((slab = this->slabs)) {                                                       \
+        this->slabs = slab->next;                                                        \
+        __ds_free(slab);                                                                 \
+    }                                                                                    \
+    this->freeLeaves = NULL;                                                             \
+    this->root = NULL;                                                                   \
+    this->size = 0;                                                                      \
+}                                                                                        \
+                                                                                         \
+void __avltree_free_##id(TreeType *this) {                                               \
+    __btree_clear_##id(this);                                                            \
+    __ds_free(this);                                                                     \
+}                                                                                        \
+                                                                                         \
+EntryType *__avltree_erase_##id(TreeType *this,                                          \
+                                EntryType *begin, EntryType const *end) {                \
+    if (!begin || begin == end) return NULL;                                             \
+                                                                                         \
+    if (end) {                                                                           \
+        kt lastKey = entry_get_key(end);                                                 \
+        begin = __avltree_remove_entry_##id(this, begin);                                \
+        customAssert(begin)                                                              \
+        while (cmp_lt(entry_get_key(begin), lastKey)) {                                  \
+            begin = __avltree_remove_entry_##id(this, begin);                            \
+        }                                                                                \
+        return begin;                                                                    \
+    } else if (begin == __avl_successor_##id(this->root)) {                              \
+        __btree_clear_##id(this);                                                        \
+        return ((void *) -1);                                                            \
+    } else {                                                                             \
+        begin = __avltree_remove_entry_##id(this, begin);                                \
+        while (begin != ((void *)-1)) {                                                  \
+            begin = __avltree_remove_entry_##id(this, begin);                            \
+        }                                                                                \
+        return ((void *) -1);                                                            \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+EntryType *__avltree_lower_bound_##id(TreeType const *this, kt const key) {              \
+    return __avltree_find_key_##id(this, key, 1);                                        \
+}                                                                                        \
+                                                                                         \
+EntryType *__avltree_upper_bound_##id(TreeType const *this, kt const key) {              \
+    EntryType *e = __avltree_find_key_##id(this, key, 1);                                \
+    if (e && !cmp_lt(key, entry_get_key(e))) e = __avl_inorder_successor_##id(e);        \
+    return e;                                                                            \
+}                                                                                        \
+                                                                                         \
+unsigned char __avlEntry_key_lt_##id(EntryType const *e, kt const key) {                 \
+    return cmp_lt(entry_get_key(e), key);                                                \
+}                                                                                        \
+                                                                                         \
+/* rank queries skip whole leaves, so they take O(n / leaf capacity) time */             \
+                                                                                         \
+EntryType *__avltree_at_rank_##id(TreeType const *this, unsigned k) {                    \
+    __BTreeLeaf_##id *leaf;                                                              \
+    if (k >= this->size) return NULL;                                                    \
+    leaf = __btree_leaf_of_##id(__avl_successor_##id(this->root));                       \
+    for (; k >= leaf->h.n; leaf = leaf->next) k -= leaf->h.n;                            \
+    return &leaf->slots[k];                                                              \
+}                                                                                        \
+                                                                                         \
+unsigned __avltree_rank_of_##id(TreeType const *this, kt const key) {                    \
+    return (unsigned) __avlEntry_distance_##id(__avl_successor_##id(this->root),         \
+                                               __avltree_find_key_##id(this, key, 1));   \
+}                                                                                        \
+                                                                                         \
+unsigned __avltree_count_range_##id(TreeType const *this, kt const lo, kt const hi) {    \
+    if (!cmp_lt(lo, hi)) return 0;                                                       \
+    return (unsigned) __avlEntry_distance_##id(__avltree_find_key_##id(this, lo, 1),     \
+                                               __avltree_find_key_##id(this, hi, 1));    \
+}                                                                                        \
+                                                                                         \
+unsigned char __avltree_build_fromSorted_##id(TreeType *this,                            \
+                                              DataType const *arr,                       \
+                                              unsigned n) {                              \
+    /* each insertion appends to the last leaf, which splits when full */                \
+    customAssert(this->root == NULL)                                                     \
+    if (!n) return 1;                                                                    \
+    else if (this->root || !arr) return 0;                                               \
+    else if (!__avltree_insert_fromArray_##id(this, arr, n)) {                           \
+        __btree_clear_##id(this);                                                        \
+        return 0;                                                                        \
+    }                                                                                    \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+TreeType *__avltree_new_fromSorted_##id(DataType const *arr, unsigned n) {               \
+    TreeType *t;                                                                         \
+    unsigned i;                                                                          \
+    for (i = 1; arr && i < n; ++i) {                                                     \
+        if (!cmp_lt(data_get_key(arr[i - 1]), data_get_key(arr[i]))) {                   \
+            return __avltree_new_fromArray_##id(arr, n);                                 \
+        }                                                                                \
+    }                                                                                    \
+    /* appends leave every leaf full, so one slab holds all of them */                   \
+    if (!(t = __avltree_new_fromArray_##id(NULL, 0)) || !arr || !n) return t;            \
+    t->leavesPerSlab = n / __BTREE_LEAF_CAP_##id + 1;                                    \
+    if (!__avltree_build_fromSorted_##id(t, arr, n)) {                                   \
+        __avltree_free_##id(t);                                                          \
+        return NULL;                                                                     \
+    }                                                                                    \
+    t->leavesPerSlab = 0;                                                                \
+    return t;                                                                            \
+}                                                                                        \
+                                                                                         \
+unsigned char __avltree_merge_##id(TreeType *this, TreeType *other) {                    \
+    EntryType *e;                                                                        \
+    if (this == other || !other->root) return 1;                                         \
+                                                                                         \
+    e = __avl_successor_##id(other->root);                                               \
+    for (; e; e = __avl_inorder_successor_##id(e)) {                                     \
+        if (!__avltree_find_key_##id(this, entry_get_key(e), 0) &&                       \
+                !__avltree_insert_##id(this, e->data, NULL)) {                           \
+            return 0;                                                                    \
+        }                                                                                \
+    }                                                                                    \
+    __btree_clear_##id(other);                                                           \
+    return 1;                                                                            \
+}                                                                                        \
+
+#endif /* DS_BTREE_H */
@@ -0,0 +1,310 @@
+#ifndef DS_CONCURRENT_UNORDERED_MAP_H
+#define DS_CONCURRENT_UNORDERED_MAP_H
+
+#include "unordered_map.h"
+#ifndef __CDS_SCAN
+#include <pthread.h>
+#endif /* __CDS_SCAN */
+
+/*
+ * A thread-safe map (named CUMap) split into independently locked shards. Each
+ * shard is a chained table from hash_table.h behind its own reader-writer lock,
+ * so threads only contend when they touch the same shard, and lookups within a
+ * shard run in parallel. A key is hashed once: the high bits of its hash pick
+ * the shard and the low bits pick the bucket within it. Shards are aligned to
+ * cache lines so that locking one does not invalidate its neighbours.
+ *
+ * Programs using it must be built with -pthread.
+ */
+
+#define DS_CUMAP_MAX_SHARDS 0x10000
+
+/* --------------------------------------------------------------------------
+ * FUNCTIONS
+ * -------------------------------------------------------------------------- */
+
+/**
+ * Creates a new, empty map with @c nshards shards (rounded up to a power of
+ * two). A few times the number of threads using the map is a good choice.
+ *
+ * @param   nshards  @c unsigned : Number of independently locked shards.
+ *
+ * @return           @c CUMap* : Newly created map.
+ */
+#define cumap_new(id, nshards) __cumap_new_##id(nshards)
+
+
+/**
+ * Deletes all entries and frees the map. No other thread may be using it.
+ */
+#define cumap_free(id, this) __cumap_free_##id(this)
+
+
+/**
+ * Inserts @c pair into the map. If the key already exists, the value is
+ * updated to that of @c pair .
+ *
+ * @param   pair  @c Pair : Key-value pair to insert.
+ *
+ * @return        @c bool : Whether the operation succeeded.
+ */
+#define cumap_insert(id, this, pair) __cumap_insert_##id(this, pair)
+
+
+/**
+ * Inserts @c pair if its key is not in the map; otherwise calls
+ * @c update(value,arg) with a pointer to the existing value, while the key's
+ * shard is locked, so read-modify-write updates are atomic.
+ *
+ * @param   pair    @c Pair : Key-value pair to insert.
+ * @param   update  @c void(*)(vt*,void*) : Function that updates an existing
+ *                   value in place.
+ * @param   arg     @c void* : Passed through to @c update .
+ *
+ * @return          @c bool : Whether the operation succeeded.
+ */
+#define cumap_upsert(id, this, pair, update, arg)                                        \
+        __cumap_upsert_##id(this, pair, update, arg)
+
+
+/**
+ * Finds the entry with a key matching @c k . Since another thread may remove
+ * the entry at any time, the value is copied out (using @c copyValue ) rather
+ * than returned by pointer.
+ *
+ * @param   k      @c kt : Key to find.
+ * @param   value  @c vt* : Receives a copy of the value if the key was found;
+ *                  may be NULL.
+ *
+ * @return         @c bool : Whether the key was found.
+ */
+#define cumap_find(id, this, k, value) __cumap_find_##id(this, k, value)
+
+
+/**
+ * @brief @c bool : Whether the map contains @c k .
+ */
+#define cumap_contains(id, this, k) __cumap_find_##id(this, k, NULL)
+
+
+/**
+ * Removes the pair whose key is equal to @c k .
+ *
+ * @param   k  @c kt : Key to be deleted.
+ *
+ * @return     @c bool : Whether an entry was found and deleted.
+ */
+#define cumap_remove_key(id, this, k) __cumap_erase_##id(this, k)
+
+
+/**
+ * @brief @c unsigned : The number of entries in the map. Only a snapshot if
+ * other threads are modifying it.
+ */
+#define cumap_size(id, this) __cumap_size_##id(this)
+
+
+/**
+ * Removes all entries from the map.
+ */
+#define cumap_clear(id, this) __cumap_clear_##id(this)
+
+
+/**
+ * Generates @c CUMap function declarations for the given key type and value
+ * type.
+ *
+ * @param  id  ID to be used for the @c CUMap and @c Pair types (must be
+ *              unique).
+ * @param  kt  Key type.
+ * @param  vt  Value type.
+ */
+#define gen_umap_concurrent_headers(id, kt, vt)                                          \
+                                                                                         \
+typedef struct {                                                                         \
+    kt first;                                                                            \
+    vt second;                                                                           \
+} Pair_##id;                                                                             \
+                                                                                         \
+__setup_hash_table_headers(id##_shard, kt, __CUMapTable_##id, Pair_##id,                 \
+                           __CUMapEntry_##id, __htable_hash_none)                        \
+                                                                                         \
+typedef struct {                                                                         \
+    pthread_rwlock_t lock;                                                               \
+    __CUMapTable_##id *table;                                                            \
+} __attribute__((__aligned__(DS_CACHE_LINE_SIZE))) __CUMapShard_##id;                    \
+                                                                                         \
+typedef struct {                                                                         \
+    unsigned nshards;                                                                    \
+    unsigned shift;                                                                      \
+    unsigned seed;                                                                       \
+    void *mem;                                                                           \
+    __CUMapShard_##id *shards;                                                           \
+} CUMap_##id;                                                                            \
+                                                                                         \
+CUMap_##id *__cumap_new_##id(unsigned nshards);                                          \
+void __cumap_free_##id(CUMap_##id *this) __attribute__((nonnull));                       \
+unsigned char __cumap_insert_##id(CUMap_##id *this, Pair_##id const pair)                \
+  __attribute__((nonnull));                                                              \
+unsigned char __cumap_upsert_##id(CUMap_##id *this, Pair_##id const pair,                \
+                                  void (*update)(vt *value, void *arg), void *arg)       \
+  __attribute__((nonnull (1, 3)));                                                       \
+unsigned char __cumap_find_##id(CUMap_##id *this, kt const key, vt *value)               \
+  __attribute__((nonnull (1)));                                                          \
+unsigned char __cumap_erase_##id(CUMap_##id *this, kt const key)                         \
+  __attribute__((nonnull (1)));                                                          \
+unsigned __cumap_size_##id(CUMap_##id *this) __attribute__((nonnull));                   \
+void __cumap_clear_##id(CUMap_##id *this) __attribute__((nonnull));                      \
+                                                                                         \
+
+
+/**
+ * Generates @c CUMap function definitions for the given key type and value
+ * type. The parameters are the same as for @c gen_umap_source .
+ */
+#define gen_umap_concurrent_source(id, kt, vt, cmp_eq, addrOfKey, sizeOfKey,             \
+                                   copyKey, deleteKey, copyValue, deleteValue)           \
+                                                                                         \
+__ds_gen_murmur_hash(__cumap_hash_##id, kt, addrOfKey, sizeOfKey)                        \
+                                                                                         \
+gen_umap_concurrent_source_withHash(id, kt, vt, cmp_eq, __cumap_hash_##id, copyKey,      \
+                                    deleteKey, copyValue, deleteValue)                   \
+                                                                                         \
+
+
+/**
+ * Generates @c CUMap function definitions like @c gen_umap_concurrent_source ,
+ * hashing keys with @c hashKey ; see @c gen_umap_source_withHash .
+ */
+#define gen_umap_concurrent_source_withHash(id, kt, vt, cmp_eq, hashKey, copyKey,        \
+                                            deleteKey, copyValue, deleteValue)           \
+                                                                                         \
+__setup_hash_table_source(id##_shard, kt, cmp_eq, __CUMapTable_##id, Pair_##id,          \
+    __CUMapEntry_##id, __umap_entry_get_key, __umap_data_get_key, hashKey, copyKey,      \
+    deleteKey, copyValue, deleteValue)                                                   \
+                                                                                         \
+static __CUMapShard_##id *__cumap_shard_##id(CUMap_##id const *this, unsigned hash) {    \
+    /* remixed, so the shard does not depend on the bits the shard's table uses */       \
+    return this->nshards > 1 ? &this->shards[(hash * 0x9e3779b1U) >> this->shift]        \
+                             : this->shards;                                             \
+}                                                                                        \
+                                                                                         \
+CUMap_##id *__cumap_new_##id(unsigned nshards) {                                         \
+    unsigned i, bits = 0;                                                                \
+    size_t addr;                                                                         \
+    CUMap_##id *this = __ds_calloc(1, sizeof(CUMap_##id));                               \
+    customAssert(this)                                                                   \
+    if (!this) return NULL;                                                              \
+    if (nshards > DS_CUMAP_MAX_SHARDS) nshards = DS_CUMAP_MAX_SHARDS;                    \
+    while ((1u << bits) < nshards) ++bits;                                               \
+    this->nshards = 1u << bits;                                                          \
+    this->shift = (unsigned) (sizeof(unsigned) * CHAR_BIT) - bits;                       \
+    this->seed = ((unsigned) rand()) % UINT_MAX;                                         \
+    this->mem = __ds_malloc(this->nshards * sizeof(__CUMapShard_##id) +                  \
+                            DS_CACHE_LINE_SIZE);                                         \
+    customAssert(this->mem)                                                              \
+    if (!this->mem) {                                                                    \
+        __ds_free(this);                                                                 \
+        return NULL;                                                                     \
+    }                                                                                    \
+    addr = (size_t) this->mem + DS_CACHE_LINE_SIZE - 1;                                  \
+    addr &= ~(size_t) (DS_CACHE_LINE_SIZE - 1);                                          \
+    this->shards = (__CUMapShard_##id *) addr;                                           \
+    for (i = 0; i < this->nshards; ++i) {                                                \
+        __CUMapShard_##id *shard = &this->shards[i];                                     \
+        if (!(shard->table = __htable_new_fromArray_##id##_shard(NULL, 0))) {            \
+            this->nshards = i;                                                           \
+            __cumap_free_##id(this);                                                     \
+            return NULL;                                                                 \
+        }                                                                                \
+        shard->table->seed = this->seed;                                                 \
+        if (pthread_rwlock_init(&shard->lock, NULL)) {                                   \
+            /* this shard's table exists but its lock does not */                        \
+            __htable_free_##id##_shard(shard->table);                                    \
+            this->nshards = i;                                                           \
+            __cumap_free_##id(this);                                                     \
+            return NULL;                                                                 \
+        }                                                                                \
+    }                                                                                    \
+    return this;                                                                         \
+}                                                                                        \
+                                                                                         \
+void __cumap_free_##id(CUMap_##id *this) {                                               \
+    unsigned i;                                                                          \
+    for (i = 0; i < this->nshards; ++i) {                                                \
+        __htable_free_##id##_shard(this->shards[i].table);                               \
+        pthread_rwlock_destroy(&this->shards[i].lock);                                   \
+    }                                                                                    \
+    __ds_free(this->mem);                                                                \
+    __ds_free(this);                                                                     \
+}                                                                                        \
+                                                                                         \
+unsigned char __cumap_insert_##id(CUMap_##id *this, Pair_##id const pair) {              \
+    const unsigned hash = hashKey(pair.first, this->seed);                               \
+    __CUMapShard_##id *shard = __cumap_shard_##id(this, hash);                           \
+    unsigned char res;                                                                   \
+    pthread_rwlock_wrlock(&shard->lock);                                                 \
+    res = !!__htable_insert_hashed_##id##_shard(shard->table, hash, pair, NULL);         \
+    pthread_rwlock_unlock(&shard->lock);                                                 \
+    return res;                                                                          \
+}                                                                                        \
+                                                                                         \
+unsigned char __cumap_upsert_##id(CUMap_##id *this, Pair_##id const pair,                \
+                                  void (*update)(vt *value, void *arg), void *arg) {     \
+    const unsigned hash = hashKey(pair.first, this->seed);                               \
+    __CUMapShard_##id *shard = __cumap_shard_##id(this, hash);                           \
+    struct __CUMapEntry_##id *e;                                                         \
+    unsigned char res = 1;                                                               \
+    pthread_rwlock_wrlock(&shard->lock);                                                 \
+    if ((e = __htable_find_entry_##id##_shard(shard->table, hash, pair.first))) {        \
+        update(&e->data.second, arg);                                                    \
+    } else {                                                                             \
+        res = !!__htable_insert_hashed_##id##_shard(shard->table, hash, pair, NULL);     \
+    }                                                                                    \
+    pthread_rwlock_unlock(&shard->lock);                                                 \
+    return res;                                                                          \
+}                                                                                        \
+                                                                                         \
+unsigned char __cumap_find_##id(CUMap_##id *this, kt const key, vt *value) {             \
+    const unsigned hash = hashKey(key, this->seed);                                      \
+    __CUMapShard_##id *shard = __cumap_shard_##id(this, hash);                           \
+    struct __CUMapEntry_##id *e;                                                         \
+    pthread_rwlock_rdlock(&shard->lock);                                                 \
+    if ((e = __htable_find_entry_##id##_shard(shard->table, hash, key)) && value) {      \
+        copyValue(*value, e->data.second);                                               \
+    }                                                                                    \
+    pthread_rwlock_unlock(&shard->lock);                                                 \
+    return e != NULL;                                                                    \
+}                                                                                        \
+                                                                                         \
+unsigned char __cumap_erase_##id(CUMap_##id *this, kt const key) {                       \
+    const unsigned hash = hashKey(key, this->seed);                                      \
+    __CUMapShard_##id *shard = __cumap_shard_##id(this, hash);                           \
+    unsigned char res;                                                                   \
+    pthread_rwlock_wrlock(&shard->lock);                                                 \
+    res = __htable_erase_hashed_##id##_shard(shard->table, hash, key);                   \
+    pthread_rwlock_unlock(&shard->lock);                                                 \
+    return res;                                                                          \
+}                                                                                        \
+                                                                                         \
+unsigned __cumap_size_##id(CUMap_##id *this) {                                           \
+    unsigned i, size = 0;                                                                \
+    for (i = 0; i < this->nshards; ++i) {                                                \
+        pthread_rwlock_rdlock(&this->shards[i].lock);                                    \
+        size += this->shards[i].table->size;                                             \
+        pthread_rwlock_unlock(&this->shards[i].lock);                                    \
+    }                                                                                    \
+    return size;                                                                         \
+}                                                                                        \
+                                                                                         \
+void __cumap_clear_##id(CUMap_##id *this) {                                              \
+    unsigned i;                                                                          \
+    for (i = 0; i < this->nshards; ++i) {                                                \
+        pthread_rwlock_wrlock(&this->shards[i].lock);                                    \
+        __htable_clear_##id##_shard(this->shards[i].table);                              \
+        pthread_rwlock_unlock(&this->shards[i].lock);                                    \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+
+#endif /* DS_CONCURRENT_UNORDERED_MAP_H */
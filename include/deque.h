@@ -3,12 +3,16 @@
 
 #include "ds.h"
 
+/*
+ * The deque is a circular buffer whose capacity is a power of 2: the elements
+ * start at index head and wrap around to the start of the buffer. Pushing to
+ * either end only moves elements when the buffer is full and has to grow.
+ */
+
 #if UINT_MAX == 0xffffffff
-#define DS_DQ_MAX_SIZE 0x7fffffff
-#define DS_DQ_SHIFT_THRESHOLD 0x3fffffff
+#define DS_DQ_MAX_SIZE 0x80000000
 #elif UINT_MAX == 0xffff
-#define DS_DQ_MAX_SIZE 0x7fff
-#define DS_DQ_SHIFT_THRESHOLD 0x3fff
+#define DS_DQ_MAX_SIZE 0x8000
 #endif
 
 /* --------------------------------------------------------------------------
@@ -18,36 +22,67 @@
 /**
  * @brief @c unsigned : The number of elements in the deque.
  */
-#define deque_size(this)                                                                 \
-        (((this)->front.size - (this)->front.start) +                                    \
-         ((this)->back.size - (this)->back.start))
+#define deque_size(this) (this)->size
 
 
 /**
  * @brief @c bool : Whether there are no elements in the deque.
  */
-#define deque_empty(this) !deque_size(this)
+#define deque_empty(this) !(this)->size
 
 
 /**
  * @brief @c t* : Pointer to the first element in the deque, if it is not 
  * empty.
  */
-#define deque_front(this)                                                                \
-        (((this)->front.size - (this)->front.start) ?                                    \
-            &(this)->front.arr[(this)->front.size - 1] :                                 \
-            (((this)->back.size - (this)->back.start) ?                                  \
-                &(this)->back.arr[(this)->back.start] : NULL))
+#define deque_front(this) ((this)->size ? &(this)->arr[(this)->head] : NULL)
 
 
 /**
  * @brief @c t* : Pointer to the last element in the deque, if it is not empty.
  */
 #define deque_back(this)                                                                 \
-        (((this)->back.size - (this)->back.start) ?                                      \
-            &(this)->back.arr[(this)->back.size - 1] :                                   \
-            (((this)->front.size - (this)->front.start) ?                                \
-                &(this)->front.arr[(this)->front.start] : NULL))
+        ((this)->size ?                                                                  \
+            &(this)->arr[((this)->head + (this)->size - 1) & ((this)->cap - 1)] : NULL)
+
+
+/**
+ * Pointer to the element at index @c i (counting from the front).
+ *
+ * @param   i  @c unsigned : The index in the deque.
+ *
+ * @return     @c t* : Pointer to the element at this index, or NULL if it is
+ *             out of bounds.
+ */
+#define deque_at(this, i)                                                                \
+        ((i) < (this)->size ?                                                            \
+            &(this)->arr[((this)->head + (i)) & ((this)->cap - 1)] : NULL)
+
+
+/**
+ * Macro for iterating over the deque from front to back. Pushing to the deque
+ * invalidates the iterator.
+ *
+ * @param  it  @c t* : Assigned to the current element. May be dereferenced
+ *              with @c (*it) .
+ */
+#define deque_iter(this, it)                                                             \
+        for (it = deque_front(this); it;                                                 \
+             it = (it) == deque_back(this) ? NULL :                                      \
+                  ((it) + 1 == &(this)->arr[(this)->cap] ? (this)->arr : (it) + 1))
+
+
+/**
+ * Macro for iterating over the deque in reverse (from back to front). Pushing
+ * to the deque invalidates the iterator.
+ *
+ * @param  it  @c t* : Assigned to the current element. May be dereferenced
+ *              with @c (*it) .
+ */
+#define deque_riter(this, it)                                                            \
+        for (it = deque_back(this); it;                                                  \
+             it = (it) == deque_front(this) ? NULL :                                     \
+                  ((it) == (this)->arr ? &(this)->arr[(this)->cap - 1] : (it) - 1))
 
 /* --------------------------------------------------------------------------
  * FUNCTIONS
@@ -99,6 +134,43 @@
 #define deque_push_front(id, this, value) __dq_push_front_##id(this, value)
 
 
+/**
+ * Appends the @c n elements of @c arr to the back of the deque, in order. The
+ * deque grows at most once, and the elements are copied into at most two
+ * contiguous runs of the buffer.
+ *
+ * @param   arr  @c t* : Values to be appended.
+ * @param   n    @c unsigned : Number of values in @c arr .
+ *
+ * @return       @c bool : Whether the operation succeeded.
+ */
+#define deque_push_back_fromArray(id, this, arr, n)                                      \
+        __dq_push_back_fromArray_##id(this, arr, n)
+
+
+/**
+ * Places the @c n elements of @c arr in front of the deque, keeping their
+ * order, so that @c arr[0] becomes the first element.
+ *
+ * @param   arr  @c t* : Values to be prepended.
+ * @param   n    @c unsigned : Number of values in @c arr .
+ *
+ * @return       @c bool : Whether the operation succeeded.
+ */
+#define deque_push_front_fromArray(id, this, arr, n)                                     \
+        __dq_push_front_fromArray_##id(this, arr, n)
+
+
+/**
+ * Ensures that the deque can hold at least @c n elements without growing.
+ *
+ * @param   n  @c unsigned : Minimum capacity.
+ *
+ * @return     @c bool : Whether the operation succeeded.
+ */
+#define deque_reserve(id, this, n) __dq_reserve_##id(this, n)
+
+
 /**
  * Generates @c Deque function declarations for the specified type and ID.
  *
@@ -133,14 +205,8 @@
 #define __setup_deque_headers(id, t, TypeName)                                           \
                                                                                          \
 typedef struct {                                                                         \
-    struct {                                                                             \
-        t* arr;                                                                          \
-        unsigned size, cap, start;                                                       \
-    } front;                                                                             \
-    struct {                                                                             \
-        t* arr;                                                                          \
-        unsigned size, cap, start;                                                       \
-    } back;                                                                              \
+    t* arr;                                                                              \
+    unsigned head, size, cap;                                                            \
 } TypeName;                                                                              \
                                                                                          \
 TypeName *__dq_new_##id(void);                                                           \
@@ -151,122 +217,135 @@ unsigned char __dq_push_back_##id(TypeName *this, t const item)
 void __dq_pop_back_##id(TypeName *this) __attribute__((nonnull));                        \
 unsigned char __dq_push_front_##id(TypeName *this, t const item)                         \
   __attribute__((nonnull));                                                              \
+unsigned char __dq_reserve_##id(TypeName *this, unsigned n) __attribute__((nonnull));    \
+unsigned char __dq_push_back_fromArray_##id(TypeName *this, t const *arr, unsigned n)    \
+  __attribute__((nonnull (1)));                                                          \
+unsigned char __dq_push_front_fromArray_##id(TypeName *this, t const *arr, unsigned n)   \
+  __attribute__((nonnull (1)));                                                          \
+                                                                                         \
 
 #define __setup_deque_source(id, t, TypeName, copyValue, deleteValue)                    \
                                                                                          \
 TypeName *__dq_new_##id(void) {                                                          \
-    TypeName *q = malloc(sizeof(TypeName));                                              \
+    TypeName *q = __ds_malloc(sizeof(TypeName));                                         \
     customAssert(q)                                                                      \
     if (!q) return NULL;                                                                 \
-    q->front.arr = malloc(8 * sizeof(t));                                                \
-    customAssert(q->front.arr)                                                           \
-    if (!q->front.arr) {                                                                 \
-        free(q);                                                                         \
-        return NULL;                                                                     \
-    }                                                                                    \
-    q->back.arr = malloc(8 * sizeof(t));                                                 \
-    customAssert(q->back.arr)                                                            \
-    if (!q->back.arr) {                                                                  \
-        free(q->front.arr);                                                              \
-        free(q);                                                                         \
+    q->arr = __ds_malloc(8 * sizeof(t));                                                 \
+    customAssert(q->arr)                                                                 \
+    if (!q->arr) {                                                                       \
+        __ds_free(q);                                                                    \
         return NULL;                                                                     \
     }                                                                                    \
-    q->front.cap = q->back.cap = 8;                                                      \
-    q->front.size = q->back.size = q->front.start = q->back.start = 0;                   \
+    q->cap = 8;                                                                          \
+    q->head = q->size = 0;                                                               \
     return q;                                                                            \
 }                                                                                        \
                                                                                          \
 void __dq_free_##id(TypeName *this) {                                                    \
     unsigned i;                                                                          \
-    for (i = this->front.start; i < this->front.size; ++i) {                             \
-        deleteValue(this->front.arr[i]);                                                 \
+    for (i = 0; i < this->size; ++i) {                                                   \
+        deleteValue(this->arr[(this->head + i) & (this->cap - 1)]);                      \
     }                                                                                    \
-    for (i = this->back.start; i < this->back.size; ++i) {                               \
-        deleteValue(this->back.arr[i]);                                                  \
+    __ds_free(this->arr);                                                                \
+    __ds_free(this);                                                                     \
+}                                                                                        \
+                                                                                         \
+/*                                                                                       \
+ * Grows the buffer to the smallest power of 2 that holds n elements. If the             \
+ * elements wrapped around, the shorter of the two runs is moved so that they            \
+ * are contiguous (modulo the new capacity) again.                                       \
+ */                                                                                      \
+unsigned char __dq_reserve_##id(TypeName *this, unsigned n) {                            \
+    t* tmp;                                                                              \
+    const unsigned cap = this->cap;                                                      \
+    unsigned ncap = cap;                                                                 \
+    if (n <= cap) return 1;                                                              \
+    if (n > DS_DQ_MAX_SIZE) return 0;                                                    \
+    while (ncap < n) ncap <<= 1;                                                         \
+    if (!(tmp = __ds_realloc(this->arr, ncap * sizeof(t)))) return 0;                    \
+    this->arr = tmp;                                                                     \
+    this->cap = ncap;                                                                    \
+    if (this->head + this->size > cap) {                                                 \
+        const unsigned wrapped = this->head + this->size - cap;                          \
+        if (wrapped <= cap - this->head) {                                               \
+            memcpy(&tmp[cap], tmp, wrapped * sizeof(t));                                 \
+        } else {                                                                         \
+            memcpy(&tmp[this->head + ncap - cap], &tmp[this->head],                      \
+                   (cap - this->head) * sizeof(t));                                      \
+            this->head += ncap - cap;                                                    \
+        }                                                                                \
     }                                                                                    \
-    free(this->front.arr);                                                               \
-    free(this->back.arr);                                                                \
-    free(this);                                                                          \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+/*                                                                                       \
+ * Copies arr into the n slots starting at index start, which may wrap around            \
+ * the end of the buffer.                                                                \
+ */                                                                                      \
+static void __dq_copy_in_##id(TypeName *this, unsigned start, t const *arr,              \
+                              unsigned n) {                                              \
+    const unsigned run = min(n, this->cap - start);                                      \
+    unsigned i;                                                                          \
+    for (i = 0; i < run; ++i) {                                                          \
+        copyValue(this->arr[start + i], arr[i]);                                         \
+    }                                                                                    \
+    for (; i < n; ++i) {                                                                 \
+        copyValue(this->arr[i - run], arr[i]);                                           \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+unsigned char __dq_push_back_fromArray_##id(TypeName *this, t const *arr, unsigned n) {  \
+    if (!n) return 1;                                                                    \
+    if (n > DS_DQ_MAX_SIZE - this->size ||                                               \
+        !__dq_reserve_##id(this, this->size + n)) return 0;                              \
+    __dq_copy_in_##id(this, (this->head + this->size) & (this->cap - 1), arr, n);        \
+    this->size += n;                                                                     \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+unsigned char __dq_push_front_fromArray_##id(TypeName *this, t const *arr, unsigned n) { \
+    unsigned head;                                                                       \
+    if (!n) return 1;                                                                    \
+    if (n > DS_DQ_MAX_SIZE - this->size ||                                               \
+        !__dq_reserve_##id(this, this->size + n)) return 0;                              \
+    head = (this->head - n) & (this->cap - 1);                                           \
+    __dq_copy_in_##id(this, head, arr, n);                                               \
+    this->head = head;                                                                   \
+    this->size += n;                                                                     \
+    return 1;                                                                            \
 }                                                                                        \
                                                                                          \
 void __dq_pop_front_##id(TypeName *this) {                                               \
-    if (this->front.size - this->front.start) {                                          \
-        deleteValue(this->front.arr[this->front.size - 1]);                              \
-        --this->front.size;                                                              \
-    } else if (this->back.size - this->back.start) {                                     \
-        deleteValue(this->back.arr[this->back.start]);                                   \
-        ++this->back.start;                                                              \
-        if (this->back.size > 32 &&                                                      \
-                this->back.start > (this->back.size >> 1)) {                             \
-            const unsigned half = this->back.cap >> 1;                                   \
-            memmove(this->back.arr, this->back.arr + this->back.start,                   \
-                    (this->back.size - this->back.start) * sizeof(t));                   \
-            this->back.size -= this->back.start;                                         \
-            this->back.start = 0;                                                        \
-            if (half > 8 && this->back.size < half) {                                    \
-                t* tmp = realloc(this->back.arr, half * sizeof(t));                      \
-                if (!tmp) return;                                                        \
-                this->back.arr = tmp;                                                    \
-                this->back.cap = half;                                                   \
-            }                                                                            \
-        }                                                                                \
+    if (this->size) {                                                                    \
+        deleteValue(this->arr[this->head]);                                              \
+        this->head = (this->head + 1) & (this->cap - 1);                                 \
+        --this->size;                                                                    \
     }                                                                                    \
 }                                                                                        \
                                                                                          \
 unsigned char __dq_push_back_##id(TypeName *this, t const item) {                        \
-    t* tmp;                                                                              \
-    unsigned cap = this->back.cap;                                                       \
-    if (this->back.size == cap) {                                                        \
-        if (cap == DS_DQ_MAX_SIZE) return 0;                                             \
-        else if (cap < DS_DQ_SHIFT_THRESHOLD) cap <<= 1;                                 \
-        else cap = DS_DQ_MAX_SIZE;                                                       \
-        if (!(tmp = realloc(this->back.arr, cap * sizeof(t)))) return 0;                 \
-        this->back.arr = tmp;                                                            \
-        this->back.cap = cap;                                                            \
-    }                                                                                    \
-    copyValue(this->back.arr[this->back.size], item);                                    \
-    ++this->back.size;                                                                   \
+    if (this->size == this->cap && !__dq_reserve_##id(this, this->size + 1)) return 0;   \
+    copyValue(this->arr[(this->head + this->size) & (this->cap - 1)], item);             \
+    ++this->size;                                                                        \
     return 1;                                                                            \
 }                                                                                        \
                                                                                          \
 void __dq_pop_back_##id(TypeName *this) {                                                \
-    if (this->back.size - this->back.start) {                                            \
-        deleteValue(this->back.arr[this->back.size - 1]);                                \
-        --this->back.size;                                                               \
-    } else if (this->front.size - this->front.start) {                                   \
-        deleteValue(this->front.arr[this->front.start]);                                 \
-        ++this->front.start;                                                             \
-        if (this->front.size > 32 &&                                                     \
-                this->front.start > (this->front.size >> 1)) {                           \
-            const unsigned half = this->front.cap >> 1;                                  \
-            memmove(this->front.arr, this->front.arr + this->front.start,                \
-                    (this->front.size - this->front.start) * sizeof(t));                 \
-            this->front.size -= this->front.start;                                       \
-            this->front.start = 0;                                                       \
-            if (half > 8 && this->front.size < half) {                                   \
-                t* tmp = realloc(this->front.arr, half * sizeof(t));                     \
-                if (!tmp) return;                                                        \
-                this->front.arr = tmp;                                                   \
-                this->back.cap = half;                                                   \
-            }                                                                            \
-        }                                                                                \
+    if (this->size) {                                                                    \
+        --this->size;                                                                    \
+        deleteValue(this->arr[(this->head + this->size) & (this->cap - 1)]);             \
     }                                                                                    \
 }                                                                                        \
                                                                                          \
 unsigned char __dq_push_front_##id(TypeName *this, t const item) {                       \
-    t* tmp;                                                                              \
-    unsigned cap = this->front.cap;                                                      \
-    if (this->front.size == cap) {                                                       \
-        if (cap == DS_DQ_MAX_SIZE) return 0;                                             \
-        else if (cap < DS_DQ_SHIFT_THRESHOLD) cap <<= 1;                                 \
-        else cap = DS_DQ_MAX_SIZE;                                                       \
-        if (!(tmp = realloc(this->front.arr, cap * sizeof(t)))) return 0;                \
-        this->front.arr = tmp;                                                           \
-        this->front.cap = cap;                                                           \
-    }                                                                                    \
-    copyValue(this->front.arr[this->front.size], item);                                  \
-    ++this->front.size;                                                                  \
+    unsigned head;                                                                       \
+    if (this->size == this->cap && !__dq_reserve_##id(this, this->size + 1)) return 0;   \
+    head = (this->head - 1) & (this->cap - 1);                                           \
+    copyValue(this->arr[head], item);                                                    \
+    this->head = head;                                                                   \
+    ++this->size;                                                                        \
     return 1;                                                                            \
 }                                                                                        \
+                                                                                         \
 
 #endif /* DS_DEQUE_H */
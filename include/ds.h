@@ -20,14 +20,48 @@
 
 #define DS_ARG_NOT_APPLICABLE UINT_MAX
 
+/*
+ * Allocation hooks. Every data structure gets its memory through these, so
+ * defining them routes it to another allocator (an arena, a thread-local or
+ * NUMA-local heap, etc). They are expanded along with each gen_*_source macro,
+ * so they may be redefined between two expansions to give each type its own
+ * allocator. DS_ALLOC_CONTEXT is evaluated on every call and passed through as
+ * @c ctx . src/str.c picks them up when it is compiled.
+ */
+#ifndef DS_ALLOC_CONTEXT
+#define DS_ALLOC_CONTEXT NULL
+#endif
+#ifndef DS_MALLOC
+#define DS_MALLOC(ctx, size) malloc(size)
+#endif
+#ifndef DS_CALLOC
+#define DS_CALLOC(ctx, n, size) calloc(n, size)
+#endif
+#ifndef DS_REALLOC
+#define DS_REALLOC(ctx, ptr, size) realloc(ptr, size)
+#endif
+#ifndef DS_FREE
+#define DS_FREE(ctx, ptr) free(ptr)
+#endif
+
+#define __ds_malloc(size) DS_MALLOC(DS_ALLOC_CONTEXT, size)
+#define __ds_calloc(n, size) DS_CALLOC(DS_ALLOC_CONTEXT, n, size)
+#define __ds_realloc(ptr, size) DS_REALLOC(DS_ALLOC_CONTEXT, ptr, size)
+#define __ds_free(ptr) DS_FREE(DS_ALLOC_CONTEXT, ptr)
+
+/* Alignment used to keep data written by different threads on separate lines. */
+#ifndef DS_CACHE_LINE_SIZE
+#define DS_CACHE_LINE_SIZE 64
+#endif
+
 #define DSDefault_shallowCopy(dest, src) (dest) = (src)
 #define DSDefault_shallowDelete(x) /* do nothing */
 #define DSDefault_deepCopyStr(dest, src) do {                                            \
-    dest = malloc(strlen(src) + 1);                                                      \
+    dest = __ds_malloc(strlen(src) + 1);                                                 \
     if (!dest) exit(1);                                                                  \
     strcpy(dest, src);                                                                   \
 } while(0)
-#define DSDefault_deepDelete(x) free(x)
+#define DSDefault_deepDelete(x) __ds_free(x)
 
 #define DSDefault_addrOfVal(x) &(x)
 #define DSDefault_addrOfRef(x) x
@@ -0,0 +1,375 @@
+#ifndef DS_FLAT_HASH_TABLE_H
+#define DS_FLAT_HASH_TABLE_H
+
+#include "ds.h"
+#include "hash.h"
+
+/*
+ * Open-addressing ("Swiss table") backend for UMap and USet. Entries are
+ * stored inline in a single slab, followed by one control byte per slot. A
+ * control byte is either empty, deleted (a tombstone), or holds the low 7 bits
+ * of the entry's hash, so that a group of 16 slots can be filtered with one
+ * vector comparison before any key is compared.
+ */
+
+#define DS_FLAT_GROUP_WIDTH 16
+#define DS_FLAT_CTRL_EMPTY ((signed char) -128)
+#define DS_FLAT_CTRL_DELETED ((signed char) -2)
+
+#if UINT_MAX == 0xffffffff
+#define DS_FLAT_HTABLE_MAX_SIZE 0x2000000
+#elif UINT_MAX == 0xffff
+#define DS_FLAT_HTABLE_MAX_SIZE 0x200
+#endif
+
+#define __flat_h1(hash) ((hash) >> 7)
+#define __flat_h2(hash) ((signed char) ((hash) & 0x7f))
+#define __flat_is_full(c) ((c) >= 0)
+
+#if defined(__SSE2__) && !defined(__CDS_SCAN)
+#include <emmintrin.h>
+
+__attribute__((__unused__)) static unsigned
+__ds_flat_match(signed char const *ctrl, signed char h2) {
+    __m128i group = _mm_loadu_si128((__m128i const *) ctrl);
+    return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+}
+
+__attribute__((__unused__)) static unsigned
+__ds_flat_match_free(signed char const *ctrl) {
+    __m128i group = _mm_loadu_si128((__m128i const *) ctrl);
+    return (unsigned) _mm_movemask_epi8(group);
+}
+#else
+__attribute__((__unused__)) static unsigned
+__ds_flat_match(signed char const *ctrl, signed char h2) {
+    unsigned i, bits = 0;
+    for (i = 0; i < DS_FLAT_GROUP_WIDTH; ++i) {
+        if (ctrl[i] == h2) bits |= 1U << i;
+    }
+    return bits;
+}
+
+__attribute__((__unused__)) static unsigned
+__ds_flat_match_free(signed char const *ctrl) {
+    unsigned i, bits = 0;
+    for (i = 0; i < DS_FLAT_GROUP_WIDTH; ++i) {
+        if (ctrl[i] < 0) bits |= 1U << i;
+    }
+    return bits;
+}
+#endif /* __SSE2__ */
+
+__attribute__((__unused__)) static unsigned
+__ds_flat_match_empty(signed char const *ctrl) {
+    return __ds_flat_match(ctrl, DS_FLAT_CTRL_EMPTY);
+}
+
+__attribute__((__unused__)) static void
+__ds_flat_set_ctrl(signed char *ctrl, unsigned cap, unsigned i, signed char c) {
+    ctrl[i] = c;
+    if (i < DS_FLAT_GROUP_WIDTH) ctrl[cap + i] = c; /* mirrored for wrapped loads */
+}
+
+#define __setup_flat_hash_table_headers(id, kt, TableType, DataType, EntryType)          \
+                                                                                         \
+struct EntryType {                                                                       \
+    DataType data;                                                                       \
+};                                                                                       \
+                                                                                         \
+typedef struct {                                                                         \
+    unsigned size;                                                                       \
+    unsigned cap;                                                                        \
+    unsigned threshold;                                                                  \
+    unsigned lf;                                                                         \
+    unsigned seed;                                                                       \
+    unsigned deleted;                                                                    \
+    struct {                                                                             \
+        unsigned idx;                                                                    \
+    } it;                                                                                \
+    signed char *ctrl;                                                                   \
+    struct EntryType *buckets;                                                           \
+} TableType;                                                                             \
+                                                                                         \
+DataType* __htable_iter_begin_##id(TableType *this) __attribute__((nonnull));            \
+DataType* __htable_iter_next_##id(TableType *this) __attribute__((nonnull));             \
+                                                                                         \
+unsigned char __htable_rehash_##id(TableType *this, unsigned nbuckets)                   \
+  __attribute__((nonnull));                                                              \
+DataType* __htable_insert_##id(TableType *this,                                          \
+                               DataType const data, int *inserted)                       \
+  __attribute__((nonnull (1)));                                                          \
+unsigned char __htable_insert_fromArray_##id(TableType *this,                            \
+                                             DataType const *arr, unsigned n)            \
+  __attribute__((nonnull));                                                              \
+TableType *__htable_new_fromArray_##id(DataType const *arr, unsigned n);                 \
+TableType *__htable_new_withPool_##id(unsigned chunk);                                   \
+TableType *__htable_createCopy_##id(TableType const *other)                              \
+  __attribute__((nonnull));                                                              \
+unsigned char __htable_erase_##id(TableType *this, kt const key)                         \
+  __attribute__((nonnull));                                                              \
+void __htable_clear_##id(TableType *this)                                                \
+  __attribute__((nonnull));                                                              \
+void __htable_free_##id(TableType *this) __attribute__((nonnull));                       \
+DataType* __htable_find_##id(TableType const *this, kt const key)                        \
+  __attribute__((nonnull));                                                              \
+unsigned char __htable_set_load_factor_##id(TableType *this, unsigned lf)                \
+  __attribute__((nonnull));                                                              \
+void __htable_set_incremental_##id(TableType *this, unsigned char enable)                \
+  __attribute__((nonnull));                                                              \
+
+#define __setup_flat_hash_table_source(id, kt, cmp_eq, TableType, DataType,              \
+                                       EntryType, entry_get_key, data_get_key,           \
+                                       hashKey, copyKey, deleteKey,                      \
+                                       copyValue, deleteValue)                           \
+                                                                                         \
+static unsigned __htable_next_full_##id(TableType const *this, unsigned idx) {           \
+    while (idx < this->cap) {                                                            \
+        unsigned bits = ~__ds_flat_match_free(&this->ctrl[idx]) & 0xffff;                \
+        if (bits) {                                                                      \
+            idx += (unsigned) __builtin_ctz(bits);                                       \
+            break;                                                                       \
+        }                                                                                \
+        idx += DS_FLAT_GROUP_WIDTH;                                                      \
+    }                                                                                    \
+    return idx < this->cap ? idx : this->cap;                                            \
+}                                                                                        \
+                                                                                         \
+DataType* __htable_iter_begin_##id(TableType *this) {                                    \
+    this->it.idx = this->size ? __htable_next_full_##id(this, 0) : this->cap;            \
+    return this->it.idx < this->cap ? &this->buckets[this->it.idx].data : NULL;          \
+}                                                                                        \
+                                                                                         \
+DataType* __htable_iter_next_##id(TableType *this) {                                     \
+    this->it.idx = __htable_next_full_##id(this, this->it.idx + 1);                      \
+    return this->it.idx < this->cap ? &this->buckets[this->it.idx].data : NULL;          \
+}                                                                                        \
+                                                                                         \
+static struct EntryType *__htable_find_entry_##id(TableType const *this,                 \
+                                                  unsigned hash,                         \
+                                                  kt const key) {                        \
+    const unsigned mask = this->cap - 1;                                                 \
+    const signed char h2 = __flat_h2(hash);                                              \
+    unsigned pos = __flat_h1(hash) & mask, step = 0;                                     \
+    while (1) {                                                                          \
+        unsigned bits = __ds_flat_match(&this->ctrl[pos], h2);                           \
+        for (; bits; bits &= bits - 1) {                                                 \
+            struct EntryType *e =                                                        \
+                &this->buckets[(pos + (unsigned) __builtin_ctz(bits)) & mask];           \
+            if (cmp_eq(entry_get_key(e), key)) return e;                                 \
+        }                                                                                \
+        if (__ds_flat_match_empty(&this->ctrl[pos])) return NULL;                        \
+        step += DS_FLAT_GROUP_WIDTH;                                                     \
+        pos = (pos + step) & mask;                                                       \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+static unsigned __htable_find_slot_##id(TableType const *this, unsigned hash) {          \
+    const unsigned mask = this->cap - 1;                                                 \
+    unsigned pos = __flat_h1(hash) & mask, step = 0, bits;                               \
+    while (!(bits = __ds_flat_match_free(&this->ctrl[pos]))) {                           \
+        step += DS_FLAT_GROUP_WIDTH;                                                     \
+        pos = (pos + step) & mask;                                                       \
+    }                                                                                    \
+    return (pos + (unsigned) __builtin_ctz(bits)) & mask;                                \
+}                                                                                        \
+                                                                                         \
+static unsigned char __htable_resize_##id(TableType *this, unsigned ncap) {              \
+    unsigned i, lf = min(this->lf, 87);                                                  \
+    struct EntryType *old = this->buckets, *slots;                                       \
+    signed char *oldCtrl = this->ctrl;                                                   \
+    const unsigned oldCap = this->cap;                                                   \
+    if (!(slots = __ds_malloc(ncap * sizeof(struct EntryType) +                          \
+                         ncap + DS_FLAT_GROUP_WIDTH))) return 0;                         \
+                                                                                         \
+    this->buckets = slots;                                                               \
+    this->ctrl = (signed char *) (slots + ncap);                                         \
+    this->cap = ncap;                                                                    \
+    this->threshold = (ncap * lf) / 100;                                                 \
+    this->deleted = 0;                                                                   \
+    memset(this->ctrl, DS_FLAT_CTRL_EMPTY, ncap + DS_FLAT_GROUP_WIDTH);                  \
+    if (!old) return 1;                                                                  \
+                                                                                         \
+    for (i = 0; i < oldCap; ++i) {                                                       \
+        if (__flat_is_full(oldCtrl[i])) {                                                \
+            kt const key = entry_get_key(&old[i]);                                       \
+            unsigned hash = hashKey(key, this->seed);                                    \
+            unsigned idx = __htable_find_slot_##id(this, hash);                          \
+            __ds_flat_set_ctrl(this->ctrl, ncap, idx, __flat_h2(hash));                  \
+            this->buckets[idx] = old[i];                                                 \
+        }                                                                                \
+    }                                                                                    \
+    __ds_free(old);                                                                      \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+static DataType* __htable_insert_nocheck_##id(TableType *this,                           \
+                                              DataType const data,                       \
+                                              int *inserted) {                           \
+    unsigned idx, hash = hashKey(data_get_key(data), this->seed);                        \
+    struct EntryType *e = __htable_find_entry_##id(this, hash, data_get_key(data));      \
+                                                                                         \
+    if (e) {                                                                             \
+        deleteValue(e->data.second);                                                     \
+        copyValue(e->data.second, data.second);                                          \
+        if (inserted) *inserted = 0;                                                     \
+        return &e->data;                                                                 \
+    }                                                                                    \
+                                                                                         \
+    if (this->size + this->deleted >= this->threshold) {                                 \
+        /* tombstones are purged in place when live entries don't need the room */       \
+        unsigned ncap = this->cap;                                                       \
+        if (this->size >= (this->threshold >> 1)) {                                      \
+            if (ncap == DS_FLAT_HTABLE_MAX_SIZE) {                                       \
+                if (!this->deleted) return NULL;                                         \
+            } else {                                                                     \
+                ncap <<= 1;                                                              \
+            }                                                                            \
+        }                                                                                \
+        if (!__htable_resize_##id(this, ncap)) return NULL;                              \
+    }                                                                                    \
+                                                                                         \
+    idx = __htable_find_slot_##id(this, hash);                                           \
+    if (this->ctrl[idx] == DS_FLAT_CTRL_DELETED) this->deleted--;                        \
+    __ds_flat_set_ctrl(this->ctrl, this->cap, idx, __flat_h2(hash));                     \
+    e = &this->buckets[idx];                                                             \
+    memset(e, 0, sizeof(struct EntryType));                                              \
+    copyKey(entry_get_key(e), data_get_key(data));                                       \
+    copyValue(e->data.second, data.second);                                              \
+    this->size++;                                                                        \
+    if (inserted) *inserted = 1;                                                         \
+    return &e->data;                                                                     \
+}                                                                                        \
+                                                                                         \
+unsigned char __htable_rehash_##id(TableType *this, unsigned nbuckets) {                 \
+    unsigned ncap = this->cap;                                                           \
+    if (nbuckets <= ncap) return 1;                                                      \
+    else if (nbuckets > DS_FLAT_HTABLE_MAX_SIZE) return 0;                               \
+                                                                                         \
+    while (ncap < nbuckets) ncap <<= 1;                                                  \
+    return __htable_resize_##id(this, ncap);                                             \
+}                                                                                        \
+                                                                                         \
+DataType* __htable_insert_##id(TableType *this,                                          \
+                               DataType const data, int *inserted) {                     \
+    return __htable_insert_nocheck_##id(this, data, inserted);                           \
+}                                                                                        \
+                                                                                         \
+unsigned char __htable_insert_fromArray_##id(TableType *this,                            \
+                                             DataType const *arr, unsigned n) {          \
+    unsigned i, newSize = this->size + n;                                                \
+    if (newSize >= this->threshold || newSize < this->size) {                            \
+        unsigned newCap = this->cap + n;                                                 \
+        if (newCap < this->cap || newCap > DS_FLAT_HTABLE_MAX_SIZE)                      \
+            newCap = DS_FLAT_HTABLE_MAX_SIZE;                                            \
+        __htable_rehash_##id(this, newCap);                                              \
+    }                                                                                    \
+    for (i = 0; i < n; ++i) {                                                            \
+        if (!__htable_insert_nocheck_##id(this, arr[i], NULL)) return 0;                 \
+    }                                                                                    \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+TableType *__htable_new_fromArray_##id(DataType const *arr, unsigned n) {                \
+    TableType *ht = __ds_calloc(1, sizeof(TableType));                                   \
+    customAssert(ht)                                                                     \
+    if (!ht) return NULL;                                                                \
+    ht->lf = 75;                                                                         \
+    if (!__htable_resize_##id(ht, 32)) {                                                 \
+        customAssert(0)                                                                  \
+        __ds_free(ht);                                                                   \
+        return NULL;                                                                     \
+    }                                                                                    \
+    ht->seed = ((unsigned) rand()) % UINT_MAX;                                           \
+    if (arr && n) __htable_insert_fromArray_##id(ht, arr, n);                            \
+    return ht;                                                                           \
+}                                                                                        \
+                                                                                         \
+TableType *__htable_new_withPool_##id(unsigned chunk) {                                  \
+    (void) chunk; /* entries are stored inline, so there is nothing to pool */           \
+    return __htable_new_fromArray_##id(NULL, 0);                                         \
+}                                                                                        \
+                                                                                         \
+TableType *__htable_createCopy_##id(TableType const *other) {                            \
+    unsigned i;                                                                          \
+    TableType *ht = __htable_new_fromArray_##id(NULL, 0);                                \
+    if (ht) {                                                                            \
+        ht->lf = other->lf;                                                              \
+        ht->threshold = (ht->cap * min(ht->lf, 87)) / 100;                               \
+        __htable_rehash_##id(ht, other->cap);                                            \
+        for (i = 0; i < other->cap; ++i) {                                               \
+            if (__flat_is_full(other->ctrl[i])) {                                        \
+                __htable_insert_nocheck_##id(ht, other->buckets[i].data, NULL);          \
+            }                                                                            \
+        }                                                                                \
+    }                                                                                    \
+    return ht;                                                                           \
+}                                                                                        \
+                                                                                         \
+unsigned char __htable_erase_##id(TableType *this, kt const key) {                       \
+    unsigned idx, before, emptyAfter, emptyBefore;                                       \
+    const unsigned mask = this->cap - 1;                                                 \
+    struct EntryType *e = __htable_find_entry_##id(this, hashKey(key, this->seed), key); \
+    if (!e) return 0;                                                                    \
+                                                                                         \
+    idx = (unsigned) (e - this->buckets);                                                \
+    deleteKey(entry_get_key(e));                                                         \
+    deleteValue(e->data.second);                                                         \
+    this->size--;                                                                        \
+                                                                                         \
+    /* if no probe could have seen a full group spanning idx, it can be empty */         \
+    before = (idx - DS_FLAT_GROUP_WIDTH) & mask;                                         \
+    emptyAfter = __ds_flat_match_empty(&this->ctrl[idx]);                                \
+    emptyBefore = __ds_flat_match_empty(&this->ctrl[before]);                            \
+    if (emptyAfter && emptyBefore &&                                                     \
+            (unsigned) (__builtin_ctz(emptyAfter) + __builtin_clz(emptyBefore)) <        \
+            sizeof(unsigned) * CHAR_BIT) {                                               \
+        __ds_flat_set_ctrl(this->ctrl, this->cap, idx, DS_FLAT_CTRL_EMPTY);              \
+    } else {                                                                             \
+        __ds_flat_set_ctrl(this->ctrl, this->cap, idx, DS_FLAT_CTRL_DELETED);            \
+        this->deleted++;                                                                 \
+    }                                                                                    \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+void __htable_clear_##id(TableType *this) {                                              \
+    unsigned i;                                                                          \
+    for (i = 0; i < this->cap; ++i) {                                                    \
+        if (__flat_is_full(this->ctrl[i])) {                                             \
+            deleteKey(entry_get_key(&this->buckets[i]));                                 \
+            deleteValue(this->buckets[i].data.second);                                   \
+        }                                                                                \
+    }                                                                                    \
+    memset(this->ctrl, DS_FLAT_CTRL_EMPTY, this->cap + DS_FLAT_GROUP_WIDTH);             \
+    this->size = this->deleted = 0;                                                      \
+}                                                                                        \
+                                                                                         \
+void __htable_free_##id(TableType *this) {                                               \
+    __htable_clear_##id(this);                                                           \
+    __ds_free(this->buckets);                                                            \
+    __ds_free(this);                                                                     \
+}                                                                                        \
+                                                                                         \
+DataType* __htable_find_##id(TableType const *this, kt const key) {                      \
+    struct EntryType *e = __htable_find_entry_##id(this, hashKey(key, this->seed), key); \
+    return e ? &e->data : NULL;                                                          \
+}                                                                                        \
+                                                                                         \
+unsigned char __htable_set_load_factor_##id(TableType *this, unsigned lf) {              \
+    if (lf > 24 && lf < 101) {                                                           \
+        this->lf = lf;                                                                   \
+        lf = (this->size * 100) / this->cap;                                             \
+        if (lf >= min(this->lf, 87)) {                                                   \
+            return __htable_rehash_##id(this, (this->cap + 1) << 2);                     \
+        }                                                                                \
+        this->threshold = (this->cap * min(this->lf, 87)) / 100;                         \
+    }                                                                                    \
+    return 1;                                                                            \
+}                                                                                        \
+                                                                                         \
+/* Resizing moves entries between probe sequences, so it is never incremental. */        \
+void __htable_set_incremental_##id(TableType *this, unsigned char enable) {              \
+    (void) this; (void) enable;                                                          \
+}                                                                                        \
+
+#endif /* DS_FLAT_HASH_TABLE_H */
@@ -1,7 +1,62 @@
 #ifndef DS_MURMURHASH_H
 #define DS_MURMURHASH_H
 
+#include "ds.h"
+
 unsigned murmurhash(const void *key, int len, unsigned seed)
   __attribute__((nonnull));
 
+
+/**
+ * Hash for integer keys, for use as the @c hashKey argument of the
+ * @c gen_umap_source_withHash family. The key (up to the width of an
+ * @c unsigned @c long ) goes through the murmur3 finalizer, so every input bit
+ * affects every output bit and strided keys still spread over all buckets.
+ *
+ * @param   x     @c integer : Key to hash.
+ * @param   seed  @c unsigned : Per-table seed.
+ *
+ * @return        @c unsigned : Hash of @c x .
+ */
+#define DSDefault_hashInt(x, seed) __ds_hash_int((unsigned long) (x), seed)
+
+
+/**
+ * Defines @c name(key,seed) , which hashes the bytes of a key with
+ * @c murmurhash ; the generators taking @c addrOfKey and @c sizeOfKey use it
+ * as their @c hashKey .
+ */
+#define __ds_gen_murmur_hash(name, kt, addrOfKey, sizeOfKey)                             \
+static unsigned name(kt const key, unsigned seed) {                                      \
+    return murmurhash(addrOfKey(key), (int) sizeOfKey(key), seed);                       \
+}                                                                                        \
+
+
+__attribute__((__unused__)) static
+#if __STDC_VERSION__ >= 199901L
+inline
+#endif
+unsigned __ds_hash_int(unsigned long key, unsigned seed);
+
+unsigned __ds_hash_int(unsigned long key, unsigned seed) {
+    key ^= seed;
+#if ULONG_MAX > 0xffffffffUL
+    /* murmur3 fmix64 */
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdUL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53UL;
+    key ^= key >> 33;
+    return (unsigned) (key ^ (key >> 16 >> 16));
+#else
+    /* murmur3 fmix32 */
+    key ^= key >> 16;
+    key *= 0x85ebca6bUL;
+    key ^= key >> 13;
+    key *= 0xc2b2ae35UL;
+    key ^= key >> 16;
+    return (unsigned) key;
+#endif
+}
+
 #endif /* DS_MURMURHASH_H */
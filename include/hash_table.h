@@ -3,22 +3,74 @@
 
 #include "ds.h"
 #include "hash.h"
+#include "pool.h"
 
+/*
+ * The bucket count is always a power of two so a bucket is picked by masking
+ * the hash; hashKey functions must therefore mix well into the low bits.
+ */
 #if UINT_MAX == 0xffffffff
 #define DS_HTABLE_MAX_SIZE 42949672
-#define DS_HTABLE_SHIFT_THRESHOLD 21474836
+#define DS_HTABLE_MAX_BUCKETS 0x2000000
 #elif UINT_MAX == 0xffff
 #define DS_HTABLE_MAX_SIZE 655
-#define DS_HTABLE_SHIFT_THRESHOLD 327
+#define DS_HTABLE_MAX_BUCKETS 0x200
 #endif
 
-#define __setup_hash_table_headers(id, kt, TableType, DataType, EntryType)               \
+/* Number of old buckets moved per operation during an incremental rehash. */
+#ifndef DS_HTABLE_REHASH_STEP
+#define DS_HTABLE_REHASH_STEP 16
+#endif
+
+/*
+ * Entries can store the full hash of their key (hashMode __htable_hash_stored)
+ * so that growing the table never rehashes a key and lookups skip the key
+ * comparison for entries whose hash differs; __htable_hash_none keeps entries
+ * smaller. The mode only changes the entry layout and the helpers below.
+ */
+#define __htable_hash_none_field
+#define __htable_hash_none_helpers(id, EntryType)                                        \
+__attribute__((__unused__)) static unsigned char                                         \
+__htable_stored_hash_##id(struct EntryType const *e, unsigned *hash) {                   \
+    (void) e; (void) hash;                                                               \
+    return 0;                                                                            \
+}                                                                                        \
+__attribute__((__unused__)) static void                                                  \
+__htable_store_hash_##id(struct EntryType *e, unsigned hash) {                           \
+    (void) e; (void) hash;                                                               \
+}                                                                                        \
+__attribute__((__unused__)) static unsigned char                                         \
+__htable_hash_may_match_##id(struct EntryType const *e, unsigned hash) {                 \
+    (void) e; (void) hash;                                                               \
+    return 1;                                                                            \
+}                                                                                        \
+
+#define __htable_hash_stored_field unsigned hash;
+#define __htable_hash_stored_helpers(id, EntryType)                                      \
+__attribute__((__unused__)) static unsigned char                                         \
+__htable_stored_hash_##id(struct EntryType const *e, unsigned *hash) {                   \
+    *hash = e->hash;                                                                     \
+    return 1;                                                                            \
+}                                                                                        \
+__attribute__((__unused__)) static void                                                  \
+__htable_store_hash_##id(struct EntryType *e, unsigned hash) {                           \
+    e->hash = hash;                                                                      \
+}                                                                                        \
+__attribute__((__unused__)) static unsigned char                                         \
+__htable_hash_may_match_##id(struct EntryType const *e, unsigned hash) {                 \
+    return e->hash == hash;                                                              \
+}                                                                                        \
+
+#define __setup_hash_table_headers(id, kt, TableType, DataType, EntryType, hashMode)     \
                                                                                          \
 struct EntryType {                                                                       \
     struct EntryType *next;                                                              \
+    hashMode##_field                                                                     \
     DataType data;                                                                       \
 };                                                                                       \
                                                                                          \
+hashMode##_helpers(id, EntryType)                                                        \
+                                                                                         \
 typedef struct {                                                                         \
     unsigned size;                                                                       \
     unsigned cap;                                                                        \
@@ -30,6 +82,11 @@ typedef struct {
         unsigned idx;                                                                    \
     } it;                                                                                \
     struct EntryType **buckets;                                                          \
+    struct EntryType **oldBuckets;                                                       \
+    unsigned oldCap;                                                                     \
+    unsigned migrated;                                                                   \
+    unsigned char incremental;                                                           \
+    DSPool pool;                                                                         \
 } TableType;                                                                             \
                                                                                          \
 DataType* __htable_iter_begin_##id(TableType *this) __attribute__((nonnull));            \
@@ -44,31 +101,46 @@ unsigned char __htable_insert_fromArray_##id(TableType *this,
                                              DataType const *arr, unsigned n)            \
   __attribute__((nonnull));                                                              \
 TableType *__htable_new_fromArray_##id(DataType const *arr, unsigned n);                 \
+TableType *__htable_new_withPool_##id(unsigned chunk);                                   \
 TableType *__htable_createCopy_##id(TableType const *other)                              \
   __attribute__((nonnull));                                                              \
 unsigned char __htable_erase_##id(TableType *this, kt const key)                         \
   __attribute__((nonnull));                                                              \
 void __htable_clear_##id(TableType *this)                                                \
   __attribute__((nonnull));                                                              \
+void __htable_free_##id(TableType *this) __attribute__((nonnull));                       \
 DataType* __htable_find_##id(TableType const *this, kt const key)                        \
   __attribute__((nonnull));                                                              \
 unsigned char __htable_set_load_factor_##id(TableType *this, unsigned lf)                \
   __attribute__((nonnull));                                                              \
+void __htable_set_incremental_##id(TableType *this, unsigned char enable)                \
+  __attribute__((nonnull));                                                              \
 
 #define __setup_hash_table_source(id, kt, cmp_eq, TableType, DataType,                   \
                                   EntryType, entry_get_key, data_get_key,                \
-                                  addrOfKey, sizeOfKey, copyKey, deleteKey,              \
+                                  hashKey, copyKey, deleteKey,                           \
                                   copyValue, deleteValue)                                \
                                                                                          \
+/* Buckets of the old array, if any, come before those of the current one. */            \
+static struct EntryType *__htable_bucket_##id(TableType const *this,                     \
+                                              unsigned idx) {                            \
+    return idx < this->oldCap ? this->oldBuckets[idx]                                    \
+                              : this->buckets[idx - this->oldCap];                       \
+}                                                                                        \
+                                                                                         \
+static unsigned __htable_next_bucket_##id(TableType const *this, unsigned idx) {         \
+    const unsigned end = this->oldCap + this->cap;                                       \
+    for (; idx < end && !__htable_bucket_##id(this, idx); ++idx);                        \
+    return idx;                                                                          \
+}                                                                                        \
+                                                                                         \
 DataType* __htable_iter_begin_##id(TableType *this) {                                    \
     if (!this->size) {                                                                   \
         this->it.curr = NULL;                                                            \
-        this->it.idx = this->cap;                                                        \
+        this->it.idx = this->oldCap + this->cap;                                         \
     } else {                                                                             \
-        unsigned idx;                                                                    \
-        for (idx = 0; idx < this->cap && this->buckets[idx] == NULL; ++idx);             \
-        this->it.idx = idx;                                                              \
-        this->it.curr = this->buckets[this->it.idx];                                     \
+        this->it.idx = __htable_next_bucket_##id(this, 0);                               \
+        this->it.curr = __htable_bucket_##id(this, this->it.idx);                        \
     }                                                                                    \
     return this->it.curr ? &this->it.curr->data : NULL;                                  \
 }                                                                                        \
@@ -77,34 +149,74 @@ DataType* __htable_iter_next_##id(TableType *this) {
     if (this->it.curr->next) {                                                           \
         this->it.curr = this->it.curr->next;                                             \
     } else {                                                                             \
-        unsigned idx = this->it.idx + 1;                                                 \
-        for (; idx < this->cap && this->buckets[idx] == NULL; ++idx);                    \
-        this->it.idx = idx;                                                              \
-        this->it.curr = (this->it.idx >= this->cap) ?                                    \
-            NULL : this->buckets[this->it.idx];                                          \
+        this->it.idx = __htable_next_bucket_##id(this, this->it.idx + 1);                \
+        this->it.curr = (this->it.idx >= this->oldCap + this->cap) ?                     \
+            NULL : __htable_bucket_##id(this, this->it.idx);                             \
     }                                                                                    \
     return this->it.curr ? &this->it.curr->data : NULL;                                  \
 }                                                                                        \
                                                                                          \
+/*                                                                                       \
+ * While a rehash is in progress, keys whose old bucket has not been migrated            \
+ * yet still live (and are inserted) there; all others are in the new array.             \
+ */                                                                                      \
+static struct EntryType **__htable_slot_##id(TableType const *this,                      \
+                                             unsigned hash) {                            \
+    if (this->oldBuckets) {                                                              \
+        const unsigned idx = hash & (this->oldCap - 1);                                  \
+        if (idx >= this->migrated) return &this->oldBuckets[idx];                        \
+    }                                                                                    \
+    return &this->buckets[hash & (this->cap - 1)];                                       \
+}                                                                                        \
+                                                                                         \
+/*                                                                                       \
+ * The static functions taking the key's hash are also used directly by code             \
+ * that has already hashed the key (see concurrent_unordered_map.h).                     \
+ */                                                                                      \
 static struct EntryType *__htable_find_entry_##id(TableType const *this,                 \
-                                                  unsigned *index,                       \
+                                                  unsigned const hash,                   \
                                                   kt const key) {                        \
     /* get index and entry at this index */                                              \
     struct EntryType *e;                                                                 \
-    *index = murmurhash(addrOfKey(key),                                                  \
-                        (int) sizeOfKey(key), this->seed) % this->cap;                   \
-    for (e = this->buckets[*index]; e; e = e->next) {                                    \
-        if (cmp_eq(entry_get_key(e), key)) break;                                        \
+    for (e = *__htable_slot_##id(this, hash); e; e = e->next) {                          \
+        if (__htable_hash_may_match_##id(e, hash) && cmp_eq(entry_get_key(e), key)) {    \
+            break;                                                                       \
+        }                                                                                \
     }                                                                                    \
     return e;                                                                            \
 }                                                                                        \
                                                                                          \
-static DataType* __htable_insert_nocheck_##id(TableType *this,                           \
+/*                                                                                       \
+ * Moves the entries of up to n old buckets into the current array, and frees            \
+ * the old array once all of them have been moved.                                       \
+ */                                                                                      \
+static void __htable_migrate_##id(TableType *this, unsigned n) {                         \
+    struct EntryType *e, *next;                                                          \
+    for (; n && this->migrated < this->oldCap; --n) {                                    \
+        for (e = this->oldBuckets[this->migrated]; e; e = next) {                        \
+            unsigned index;                                                              \
+            if (!__htable_stored_hash_##id(e, &index)) {                                 \
+                index = hashKey(entry_get_key(e), this->seed);                           \
+            }                                                                            \
+            index &= this->cap - 1;                                                      \
+            next = e->next;                                                              \
+            e->next = this->buckets[index];                                              \
+            this->buckets[index] = e;                                                    \
+        }                                                                                \
+        this->oldBuckets[this->migrated++] = NULL;                                       \
+    }                                                                                    \
+    if (this->migrated == this->oldCap) {                                                \
+        __ds_free(this->oldBuckets);                                                     \
+        this->oldBuckets = NULL;                                                         \
+        this->oldCap = this->migrated = 0;                                               \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+static DataType* __htable_insert_nocheck_##id(TableType *this, unsigned const hash,      \
                                               DataType const data,                       \
                                               int *inserted) {                           \
-    unsigned index;                                                                      \
-    struct EntryType *e = __htable_find_entry_##id(this, &index,                         \
-                                                   data_get_key(data));                  \
+    struct EntryType **slot;                                                             \
+    struct EntryType *e = __htable_find_entry_##id(this, hash, data_get_key(data));      \
                                                                                          \
     if (e) {                                                                             \
         deleteValue(e->data.second);                                                     \
@@ -112,11 +224,15 @@ static DataType* __htable_insert_nocheck_##id(TableType *this,
         if (inserted) *inserted = 0;                                                     \
     } else {                                                                             \
         if (this->size == DS_HTABLE_MAX_SIZE ||                                          \
-                !(e = calloc(1, sizeof(struct EntryType)))) return NULL;                 \
+                !(e = ds_pool_alloc(&this->pool, sizeof(struct EntryType)))) {           \
+            return NULL;                                                                 \
+        }                                                                                \
         copyKey(entry_get_key(e), data_get_key(data));                                   \
         copyValue(e->data.second, data.second);                                          \
-        e->next = this->buckets[index];                                                  \
-        this->buckets[index] = e;                                                        \
+        __htable_store_hash_##id(e, hash);                                               \
+        slot = __htable_slot_##id(this, hash);                                           \
+        e->next = *slot;                                                                 \
+        *slot = e;                                                                       \
         this->size++;                                                                    \
         if (inserted) *inserted = 1;                                                     \
     }                                                                                    \
@@ -124,42 +240,38 @@ static DataType* __htable_insert_nocheck_##id(TableType *this,
 }                                                                                        \
                                                                                          \
 unsigned char __htable_rehash_##id(TableType *this, unsigned nbuckets) {                 \
-    unsigned ncap = this->cap, i;                                                        \
-    struct EntryType **new, *e, *next;                                                   \
+    unsigned ncap = this->cap;                                                           \
+    struct EntryType **new;                                                              \
     if (nbuckets <= ncap) return 1;                                                      \
                                                                                          \
-    if (nbuckets < DS_HTABLE_SHIFT_THRESHOLD) {                                          \
-        while (ncap < nbuckets) ncap <<= 1;                                              \
-    } else {                                                                             \
-        if (nbuckets > DS_HTABLE_MAX_SIZE) return 0;                                     \
-        ncap = DS_HTABLE_MAX_SIZE;                                                       \
-    }                                                                                    \
+    if (nbuckets > DS_HTABLE_MAX_SIZE) return 0;                                         \
+    while (ncap < nbuckets && ncap < DS_HTABLE_MAX_BUCKETS) ncap <<= 1;                  \
+    if (ncap == this->cap) return 1;                                                     \
                                                                                          \
-    if (!(new = calloc(ncap, sizeof(struct EntryType *)))) return 0;                     \
-    for (i = 0; i < this->cap; ++i) {                                                    \
-        for (e = this->buckets[i]; e; e = next) {                                        \
-            unsigned index = murmurhash(addrOfKey(entry_get_key(e)),                     \
-                                        (int) sizeOfKey(entry_get_key(e)),               \
-                                        this->seed) % ncap;                              \
-            next = e->next;                                                              \
-            e->next = new[index];                                                        \
-            new[index] = e;                                                              \
-        }                                                                                \
-    }                                                                                    \
-                                                                                         \
-    free(this->buckets);                                                                 \
+    if (!(new = __ds_calloc(ncap, sizeof(struct EntryType *)))) return 0;                \
+    if (this->oldBuckets) __htable_migrate_##id(this, UINT_MAX);                         \
+    this->oldBuckets = this->buckets;                                                    \
+    this->oldCap = this->cap;                                                            \
     this->buckets = new;                                                                 \
     this->cap = ncap;                                                                    \
     this->threshold = (ncap * this->lf) / 100;                                           \
+    __htable_migrate_##id(this, this->incremental ? DS_HTABLE_REHASH_STEP : UINT_MAX);   \
     return 1;                                                                            \
 }                                                                                        \
                                                                                          \
-DataType* __htable_insert_##id(TableType *this,                                          \
-                               DataType const data, int *inserted) {                     \
+static DataType* __htable_insert_hashed_##id(TableType *this, unsigned const hash,       \
+                                             DataType const data, int *inserted) {       \
+    if (this->oldBuckets) __htable_migrate_##id(this, DS_HTABLE_REHASH_STEP);            \
     if (this->size >= this->threshold) {                                                 \
         __htable_rehash_##id(this, this->cap + 1);                                       \
     }                                                                                    \
-    return __htable_insert_nocheck_##id(this, data, inserted);                           \
+    return __htable_insert_nocheck_##id(this, hash, data, inserted);                     \
+}                                                                                        \
+                                                                                         \
+DataType* __htable_insert_##id(TableType *this,                                          \
+                               DataType const data, int *inserted) {                     \
+    return __htable_insert_hashed_##id(this, hashKey(data_get_key(data), this->seed),    \
+                                       data, inserted);                                  \
 }                                                                                        \
                                                                                          \
 unsigned char __htable_insert_fromArray_##id(TableType *this,                            \
@@ -171,19 +283,20 @@ unsigned char __htable_insert_fromArray_##id(TableType *this,
         __htable_rehash_##id(this, newCap);                                              \
     }                                                                                    \
     for (i = 0; i < n; ++i) {                                                            \
-        if (!__htable_insert_nocheck_##id(this, arr[i], NULL)) return 0;                 \
+        const unsigned hash = hashKey(data_get_key(arr[i]), this->seed);                 \
+        if (!__htable_insert_nocheck_##id(this, hash, arr[i], NULL)) return 0;           \
     }                                                                                    \
     return 1;                                                                            \
 }                                                                                        \
                                                                                          \
 TableType *__htable_new_fromArray_##id(DataType const *arr, unsigned n) {                \
-    TableType *ht = calloc(1, sizeof(TableType));                                        \
+    TableType *ht = __ds_calloc(1, sizeof(TableType));                                   \
     customAssert(ht)                                                                     \
     if (!ht) return NULL;                                                                \
-    ht->buckets = calloc(32, sizeof(struct EntryType *));                                \
+    ht->buckets = __ds_calloc(32, sizeof(struct EntryType *));                           \
     customAssert(ht->buckets)                                                            \
     if (!ht->buckets) {                                                                  \
-        free(ht);                                                                        \
+        __ds_free(ht);                                                                   \
         return NULL;                                                                     \
     }                                                                                    \
     ht->cap = 32;                                                                        \
@@ -194,44 +307,57 @@ TableType *__htable_new_fromArray_##id(DataType const *arr, unsigned n) {
     return ht;                                                                           \
 }                                                                                        \
                                                                                          \
+TableType *__htable_new_withPool_##id(unsigned chunk) {                                  \
+    TableType *ht = __htable_new_fromArray_##id(NULL, 0);                                \
+    if (ht) ds_pool_init(&ht->pool, chunk);                                              \
+    return ht;                                                                           \
+}                                                                                        \
+                                                                                         \
 TableType *__htable_createCopy_##id(TableType const *other) {                            \
     unsigned i;                                                                          \
     struct EntryType *e;                                                                 \
-    TableType *ht = __htable_new_fromArray_##id(NULL, 0);                                \
+    TableType *ht = __htable_new_withPool_##id(other->pool.chunk);                       \
     if (ht) {                                                                            \
+        ht->lf = other->lf;                                                              \
+        ht->threshold = (ht->cap * ht->lf) / 100;                                        \
         __htable_rehash_##id(ht, other->cap);                                            \
-        for (i = 0; i < other->cap; ++i) {                                               \
-            for (e = other->buckets[i]; e; e = e->next) {                                \
-                __htable_insert_nocheck_##id(ht, e->data, NULL);                         \
+        ht->incremental = other->incremental;                                            \
+        for (i = 0; i < other->oldCap + other->cap; ++i) {                               \
+            for (e = __htable_bucket_##id(other, i); e; e = e->next) {                   \
+                __htable_insert_nocheck_##id(ht, hashKey(entry_get_key(e), ht->seed),    \
+                                             e->data, NULL);                             \
             }                                                                            \
         }                                                                                \
     }                                                                                    \
     return ht;                                                                           \
 }                                                                                        \
                                                                                          \
-unsigned char __htable_erase_##id(TableType *this, kt const key) {                       \
-    struct EntryType *prev, *curr;                                                       \
-    unsigned index = murmurhash(addrOfKey(key), (int) sizeOfKey(key),                    \
-                                this->seed) % this->cap;                                 \
-    if (!this->buckets[index]) return 0; /* this entry does not exist */                 \
+static unsigned char __htable_erase_hashed_##id(TableType *this, unsigned const hash,    \
+                                                kt const key) {                          \
+    struct EntryType **slot, *prev, *curr;                                               \
+    if (this->oldBuckets) __htable_migrate_##id(this, DS_HTABLE_REHASH_STEP);            \
+    slot = __htable_slot_##id(this, hash);                                               \
+    if (!*slot) return 0; /* this entry does not exist */                                \
                                                                                          \
-    prev = this->buckets[index];                                                         \
+    prev = *slot;                                                                        \
     curr = prev->next;                                                                   \
-    if (cmp_eq(entry_get_key(prev), key)) { /* special case for first bucket entry */    \
-        this->buckets[index] = curr;                                                     \
+    /* special case for first bucket entry */                                            \
+    if (__htable_hash_may_match_##id(prev, hash) && cmp_eq(entry_get_key(prev), key)) {  \
+        *slot = curr;                                                                    \
         deleteKey(entry_get_key(prev));                                                  \
         deleteValue(prev->data.second);                                                  \
-        free(prev);                                                                      \
+        ds_pool_free(&this->pool, prev);                                                 \
         this->size--;                                                                    \
         return 1;                                                                        \
     }                                                                                    \
                                                                                          \
     for (; curr; prev = curr, curr = curr->next) {                                       \
-        if (cmp_eq(entry_get_key(curr), key)) {                                          \
+        if (__htable_hash_may_match_##id(curr, hash) &&                                  \
+                cmp_eq(entry_get_key(curr), key)) {                                      \
             prev->next = curr->next;                                                     \
             deleteKey(entry_get_key(curr));                                              \
             deleteValue(curr->data.second);                                              \
-            free(curr);                                                                  \
+            ds_pool_free(&this->pool, curr);                                             \
             this->size--;                                                                \
             return 1;                                                                    \
         }                                                                                \
@@ -239,24 +365,37 @@ unsigned char __htable_erase_##id(TableType *this, kt const key) {
     return 0;                                                                            \
 }                                                                                        \
                                                                                          \
+unsigned char __htable_erase_##id(TableType *this, kt const key) {                       \
+    return __htable_erase_hashed_##id(this, hashKey(key, this->seed), key);              \
+}                                                                                        \
+                                                                                         \
 void __htable_clear_##id(TableType *this) {                                              \
     unsigned i;                                                                          \
     struct EntryType *e, *next;                                                          \
-    for (i = 0; i < this->cap; ++i) { /* iterate over all buckets */                     \
-        for (e = this->buckets[i]; e; e = next) {                                        \
+    for (i = 0; i < this->oldCap + this->cap; ++i) { /* iterate over all buckets */      \
+        for (e = __htable_bucket_##id(this, i); e; e = next) {                           \
             next = e->next;                                                              \
             deleteKey(entry_get_key(e));                                                 \
             deleteValue(e->data.second);                                                 \
-            free(e);                                                                     \
+            if (!this->pool.chunk) __ds_free(e);                                         \
         }                                                                                \
     }                                                                                    \
+    ds_pool_release(&this->pool);                                                        \
+    __ds_free(this->oldBuckets);                                                         \
+    this->oldBuckets = NULL;                                                             \
+    this->oldCap = this->migrated = 0;                                                   \
     memset(this->buckets, 0, sizeof(struct EntryType *) * this->cap);                    \
     this->size = 0;                                                                      \
 }                                                                                        \
                                                                                          \
+void __htable_free_##id(TableType *this) {                                               \
+    __htable_clear_##id(this);                                                           \
+    __ds_free(this->buckets);                                                            \
+    __ds_free(this);                                                                     \
+}                                                                                        \
+                                                                                         \
 DataType* __htable_find_##id(TableType const *this, kt const key) {                      \
-    unsigned i;                                                                          \
-    struct EntryType *e = __htable_find_entry_##id(this, &i, key);                       \
+    struct EntryType *e = __htable_find_entry_##id(this, hashKey(key, this->seed), key); \
     return e ? &e->data : NULL;                                                          \
 }                                                                                        \
                                                                                          \
@@ -271,5 +410,10 @@ unsigned char __htable_set_load_factor_##id(TableType *this, unsigned lf) {
     }                                                                                    \
     return 1;                                                                            \
 }                                                                                        \
+                                                                                         \
+void __htable_set_incremental_##id(TableType *this, unsigned char enable) {              \
+    this->incremental = enable;                                                          \
+    if (!enable && this->oldBuckets) __htable_migrate_##id(this, UINT_MAX);              \
+}                                                                                        \
 
 #endif /* DS_HASH_TABLE_H */
@@ -2,9 +2,15 @@
 #define DS_LIST_H
 
 #include "ds.h"
+#include "pool.h"
 
 #define LIST_END ((void*)-1)
 
+/* Shortest run list_merge_sort builds by insertion before it starts merging. */
+#ifndef DS_LIST_SORT_MIN_RUN
+#define DS_LIST_SORT_MIN_RUN 8
+#endif
+
 /* --------------------------------------------------------------------------
  * ITERATORS
  * -------------------------------------------------------------------------- */
@@ -138,6 +144,19 @@
 #define list_new(id) list_new_fromArray_##id(NULL, 0)
 
 
+/**
+ * Creates a new, empty list whose entries are allocated from slabs of
+ * @c chunk entries owned by the list. Removed entries are recycled, and
+ * clearing or freeing the list releases whole slabs at once.
+ *
+ * @param   chunk  @c unsigned : Number of entries per slab; 0 disables
+ *                  pooling.
+ *
+ * @return         @c List* : Newly allocated list.
+ */
+#define list_new_withPool(id, chunk) list_new_withPool_##id(chunk)
+
+
 /**
  * Creates a new list with size @c n , where each element is set to @c value .
  *
@@ -174,9 +193,7 @@
 /**
  * Deletes all elements and frees the list.
  */
-#define list_free(id, this) do {                                                         \
-    list_erase(id, this, (this)->front, NULL); free(this);                               \
-} while(0)
+#define list_free(id, this) list_free_##id(this)
 
 
 /**
@@ -419,6 +436,7 @@ typedef struct {
     unsigned size;                                                                       \
     ListEntry_##id *front;                                                               \
     ListEntry_##id *back;                                                                \
+    DSPool pool;                                                                         \
 } List_##id;                                                                             \
                                                                                          \
 void listEntry_advance_##id(ListEntry_##id **p1, long n)                                 \
@@ -440,6 +458,8 @@ ListEntry_##id *list_insert_fromList_##id(List_##id *this,
                                           ListEntry_##id const *end)                     \
   __attribute__((nonnull (1)));                                                          \
 List_##id *list_new_fromArray_##id(t const *arr, unsigned size);                         \
+List_##id *list_new_withPool_##id(unsigned chunk);                                       \
+void list_free_##id(List_##id *this) __attribute__((nonnull));                           \
 List_##id *list_new_repeatingValue_##id(unsigned n, t const value)                       \
   __attribute__((nonnull));                                                              \
 List_##id *list_createCopy_##id(List_##id const *other)                                  \
@@ -502,13 +522,13 @@ ListEntry_##id *list_insert_repeatingValue_##id(List_##id *this,
     unsigned i = 1;                                                                      \
     ListEntry_##id *rv, *first, *last, *curr;                                            \
     if (n + this->size <= this->size ||                                                  \
-            !(first = calloc(1, sizeof(ListEntry_##id)))) return NULL;                   \
+            !(first = ds_pool_alloc(&this->pool, sizeof(ListEntry_##id)))) return NULL;  \
                                                                                          \
     rv = first;                                                                          \
     copyValue(first->data, value);                                                       \
     last = first;                                                                        \
     for (; i < n; ++i, curr->prev = last, last->next = curr, last = curr) {              \
-        if (!(curr = calloc(1, sizeof(ListEntry_##id)))) {                               \
+        if (!(curr = ds_pool_alloc(&this->pool, sizeof(ListEntry_##id)))) {              \
             rv = NULL;                                                                   \
             break;                                                                       \
         }                                                                                \
@@ -541,13 +561,13 @@ ListEntry_##id *list_insert_fromArray_##id(List_##id *this,
     unsigned i = 1;                                                                      \
     ListEntry_##id *rv, *first, *last, *curr;                                            \
     if (n + this->size <= this->size ||                                                  \
-            !(first = calloc(1, sizeof(ListEntry_##id)))) return NULL;                   \
+            !(first = ds_pool_alloc(&this->pool, sizeof(ListEntry_##id)))) return NULL;  \
                                                                                          \
     rv = first;                                                                          \
     copyValue(first->data, *arr);                                                        \
     last = first;                                                                        \
     for (; i < n; ++i, curr->prev = last, last->next = curr, last = curr) {              \
-        if (!(curr = calloc(1, sizeof(ListEntry_##id)))) {                               \
+        if (!(curr = ds_pool_alloc(&this->pool, sizeof(ListEntry_##id)))) {              \
             rv = NULL;                                                                   \
             break;                                                                       \
         }                                                                                \
@@ -581,7 +601,7 @@ ListEntry_##id *list_insert_fromList_##id(List_##id *this,
     ListEntry_##id *rv, *first, *last, *curr;                                            \
     unsigned newSize = this->size + 1;                                                   \
     if (!start || start == end || !newSize ||                                            \
-            !(first = calloc(1, sizeof(ListEntry_##id)))) return NULL;                   \
+            !(first = ds_pool_alloc(&this->pool, sizeof(ListEntry_##id)))) return NULL;  \
                                                                                          \
     rv = first;                                                                          \
     copyValue(first->data, start->data);                                                 \
@@ -589,7 +609,8 @@ ListEntry_##id *list_insert_fromList_##id(List_##id *this,
     start = start->next;                                                                 \
     for (; start != end; start = start->next, curr->prev = last,                         \
             last->next = curr, last = curr) {                                            \
-        if (++newSize == 0 || !(curr = calloc(1, sizeof(ListEntry_##id)))) {             \
+        if (++newSize == 0 ||                                                            \
+                !(curr = ds_pool_alloc(&this->pool, sizeof(ListEntry_##id)))) {          \
             if (!newSize) newSize = UINT_MAX;                                            \
             rv = NULL;                                                                   \
             break;                                                                       \
@@ -618,7 +639,7 @@ ListEntry_##id *list_insert_fromList_##id(List_##id *this,
 }                                                                                        \
                                                                                          \
 List_##id *list_new_fromArray_##id(t const *arr, unsigned size) {                        \
-    List_##id *l = calloc(1, sizeof(List_##id));                                         \
+    List_##id *l = __ds_calloc(1, sizeof(List_##id));                                    \
     customAssert(l)                                                                      \
     if (l && arr && size) list_insert_fromArray_##id(l, NULL, arr, size);                \
     return l;                                                                            \
@@ -630,8 +651,20 @@ List_##id *list_new_repeatingValue_##id(unsigned n, t const value) {
     return l;                                                                            \
 }                                                                                        \
                                                                                          \
-List_##id *list_createCopy_##id(List_##id const *other) {                                \
+List_##id *list_new_withPool_##id(unsigned chunk) {                                      \
     List_##id *l = list_new(id);                                                         \
+    if (l) ds_pool_init(&l->pool, chunk);                                                \
+    return l;                                                                            \
+}                                                                                        \
+                                                                                         \
+void list_free_##id(List_##id *this) {                                                   \
+    list_erase_##id(this, this->front, NULL);                                            \
+    ds_pool_release(&this->pool);                                                        \
+    __ds_free(this);                                                                     \
+}                                                                                        \
+                                                                                         \
+List_##id *list_createCopy_##id(List_##id const *other) {                                \
+    List_##id *l = list_new_withPool_##id(other->pool.chunk);                            \
     if (l) list_insert_fromList_##id(l, NULL, other->front, NULL);                       \
     return l;                                                                            \
 }                                                                                        \
@@ -642,10 +675,20 @@ ListEntry_##id *list_erase_##id(List_##id *this,
     if (!first || first == last) return NULL;                                            \
                                                                                          \
     before = first->prev;                                                                \
+    if (!before && !last && this->pool.chunk) { /* clearing: hand back whole slabs */    \
+        for (; first; first = first->next) {                                             \
+            deleteValue(first->data);                                                    \
+        }                                                                                \
+        ds_pool_release(&this->pool);                                                    \
+        this->front = this->back = NULL;                                                 \
+        this->size = 0;                                                                  \
+        return LIST_END;                                                                 \
+    }                                                                                    \
+                                                                                         \
     for (; first != last; first = next, --this->size) {                                  \
         next = first->next;                                                              \
         deleteValue(first->data);                                                        \
-        free(first);                                                                     \
+        ds_pool_free(&this->pool, first);                                                \
     }                                                                                    \
                                                                                          \
     if (before) {                                                                        \
@@ -705,7 +748,7 @@ void list_remove_if_##id(List_##id *this, int (*cond)(t*)) {
             }                                                                            \
                                                                                          \
             deleteValue(curr->data);                                                     \
-            free(curr);                                                                  \
+            ds_pool_free(&this->pool, curr);                                             \
             this->size--;                                                                \
         } else {                                                                         \
             prev = curr;                                                                 \
@@ -714,12 +757,47 @@ void list_remove_if_##id(List_##id *this, int (*cond)(t*)) {
     this->back = prev;                                                                   \
 }                                                                                        \
                                                                                          \
-void list_splice_range_##id(List_##id *this,                                             \
-                            ListEntry_##id *position, List_##id *other,                  \
-                            ListEntry_##id *first, ListEntry_##id *last) {               \
+static ListEntry_##id *__list_adopt_range_##id(List_##id *this, List_##id *other,        \
+                                               ListEntry_##id *first,                    \
+                                               ListEntry_##id *last) {                   \
+    /* entries from another pool must be moved into this list's own entries */           \
+    ListEntry_##id *curr, *next, *nodes = NULL, *node;                                   \
+    for (curr = first; curr != last; curr = curr->next) {                                \
+        if (!(node = ds_pool_alloc(&this->pool, sizeof(ListEntry_##id)))) {              \
+            for (; nodes; nodes = next) {                                                \
+                next = nodes->next;                                                      \
+                ds_pool_free(&this->pool, nodes);                                        \
+            }                                                                            \
+            return NULL;                                                                 \
+        }                                                                                \
+        node->next = nodes;                                                              \
+        nodes = node;                                                                    \
+    }                                                                                    \
+                                                                                         \
+    for (curr = first, first = nodes; curr != last; curr = next, nodes = node) {         \
+        next = curr->next;                                                               \
+        node = nodes->next;                                                              \
+        *nodes = *curr;                                                                  \
+        if (nodes->prev) {                                                               \
+            nodes->prev->next = nodes;                                                   \
+        } else {                                                                         \
+            other->front = nodes;                                                        \
+        }                                                                                \
+        if (next) {                                                                      \
+            next->prev = nodes;                                                          \
+        } else {                                                                         \
+            other->back = nodes;                                                         \
+        }                                                                                \
+        ds_pool_free(&other->pool, curr);                                                \
+    }                                                                                    \
+    return first;                                                                        \
+}                                                                                        \
+                                                                                         \
+static void __list_link_range_##id(List_##id *this,                                      \
+                                   ListEntry_##id *position, List_##id *other,           \
+                                   ListEntry_##id *first, ListEntry_##id *last) {        \
     ListEntry_##id *firstprev, *curr;                                                    \
     unsigned count = 0;                                                                  \
-    if (!first || first == last) return;                                                 \
                                                                                          \
     /* get number of elements */                                                         \
     firstprev = first->prev;                                                             \
@@ -760,6 +838,15 @@ void list_splice_range_##id(List_##id *this,
     this->size += count;                                                                 \
     other->size -= count;                                                                \
 }                                                                                        \
+                                                                                         \
+void list_splice_range_##id(List_##id *this,                                             \
+                            ListEntry_##id *position, List_##id *other,                  \
+                            ListEntry_##id *first, ListEntry_##id *last) {               \
+    if (!first || first == last) return;                                                 \
+    if (this != other && (this->pool.chunk || other->pool.chunk) &&                      \
+            !(first = __list_adopt_range_##id(this, other, first, last))) return;        \
+    __list_link_range_##id(this, position, other, first, last);                          \
+}                                                                                        \
 
 /* --------------------------------------------------------------------------
  * LIST ALGORITHM/COMPARISONS SECTION
@@ -814,6 +901,17 @@ void list_splice_range_##id(List_##id *this,
 #define list_sort(id, this) list_sort_##id(this)
 
 
+/**
+ * @brief Sorts the list according to the @c cmp_lt macro provided in 
+ * @c gen_list_source . Produces the same result as @c list_sort (the sort is
+ * stable), but merges runs through the @c next links only and restores the 
+ * @c prev links in a single pass at the end, touching each node far less
+ * often. Ascending and strictly descending runs already in the list are
+ * merged as they are, so nearly sorted lists take close to O(n).
+ */
+#define list_merge_sort(id, this) list_merge_sort_##id(this)
+
+
 /**
  * Creates a new list representing the union of this list and @c other 
  * (i.e. elements that are in this list, @c other , or both - all elements).
@@ -904,6 +1002,7 @@ ListEntry_##id *list_find_##id(List_##id *this, const t val)
 void list_merge_##id(List_##id *this, List_##id *other)                                  \
   __attribute__((nonnull));                                                              \
 void list_sort_##id(List_##id *this) __attribute__((nonnull));                           \
+void list_merge_sort_##id(List_##id *this) __attribute__((nonnull));                     \
 
 
 /**
@@ -1083,7 +1182,7 @@ void list_unique_##id(List_##id *this) {
             }                                                                            \
                                                                                          \
             deleteValue(curr->data);                                                     \
-            free(curr);                                                                  \
+            ds_pool_free(&this->pool, curr);                                             \
             this->size--;                                                                \
         } else {                                                                         \
             prev = curr;                                                                 \
@@ -1110,7 +1209,7 @@ void list_remove_value_##id(List_##id *this, const t val) {
             }                                                                            \
                                                                                          \
             deleteValue(curr->data);                                                     \
-            free(curr);                                                                  \
+            ds_pool_free(&this->pool, curr);                                             \
             this->size--;                                                                \
         } else {                                                                         \
             prev = curr;                                                                 \
@@ -1127,7 +1226,7 @@ ListEntry_##id *list_find_##id(List_##id *this, const t val) {
     return NULL;                                                                         \
 }                                                                                        \
                                                                                          \
-void list_merge_##id(List_##id *this, List_##id *other) {                                \
+static void __list_merge_nodes_##id(List_##id *this, List_##id *other) {                 \
     ListEntry_##id *first1 = this->front, *first2 = other->front, *next, *prev;          \
     if (!first2) return;                                                                 \
     else if (!first1) {                                                                  \
@@ -1166,6 +1265,13 @@ void list_merge_##id(List_##id *this, List_##id *other) {
     other->size = 0;                                                                     \
 }                                                                                        \
                                                                                          \
+void list_merge_##id(List_##id *this, List_##id *other) {                                \
+    if (!other->front) return;                                                           \
+    if (this != other && (this->pool.chunk || other->pool.chunk) &&                      \
+            !__list_adopt_range_##id(this, other, other->front, NULL)) return;           \
+    __list_merge_nodes_##id(this, other);                                                \
+}                                                                                        \
+                                                                                         \
 void list_sort_##id(List_##id *this) {                                                   \
     List_##id tmp[64] = {0};                                                             \
     List_##id carry = {0};                                                               \
@@ -1174,7 +1280,7 @@ void list_sort_##id(List_##id *this) {
     register unsigned ltemp_size;                                                        \
     if (this->front == this->back) return;                                               \
     else if (this->size == 2 && cmp_lt(this->back->data, this->front->data)) {           \
-        ltemp_back = this->back;                                                         \
+        ltemp_back = this->front;                                                        \
         this->front = this->back;                                                        \
         this->back = ltemp_back;                                                         \
         this->front->prev = this->back->next = NULL;                                     \
@@ -1185,10 +1291,11 @@ void list_sort_##id(List_##id *this) {
                                                                                          \
     fill = &tmp[0];                                                                      \
     do {                                                                                 \
-        list_splice_element(id, &carry, carry.front, this, this->front);                 \
+        __list_link_range_##id(&carry, carry.front, this, this->front,                   \
+                               this->front->next);                                       \
                                                                                          \
         for (counter = &tmp[0]; counter != fill && counter->front; ++counter) {          \
-            list_merge_##id(counter, &carry);                                            \
+            __list_merge_nodes_##id(counter, &carry);                                    \
                                                                                          \
             ltemp_front = carry.front;                                                   \
             ltemp_back = carry.back;                                                     \
@@ -1215,7 +1322,7 @@ void list_sort_##id(List_##id *this) {
     } while (this->front);                                                               \
                                                                                          \
     for (counter = &tmp[1]; counter != fill; ++counter) {                                \
-        list_merge_##id(counter, counter - 1);                                           \
+        __list_merge_nodes_##id(counter, counter - 1);                                   \
     }                                                                                    \
                                                                                          \
     ltemp_front = this->front;                                                           \
@@ -1228,5 +1335,112 @@ void list_sort_##id(List_##id *this) {
     (fill - 1)->back = ltemp_back;                                                       \
     (fill - 1)->size = ltemp_size;                                                       \
 }                                                                                        \
+                                                                                         \
+static ListEntry_##id *__list_merge_next_##id(ListEntry_##id *a, ListEntry_##id *b) {    \
+    ListEntry_##id *head, **tail = &head;                                                \
+    while (a && b) {                                                                     \
+        if (cmp_lt(b->data, a->data)) {                                                  \
+            *tail = b;                                                                   \
+            tail = &b->next;                                                             \
+            b = b->next;                                                                 \
+        } else {                                                                         \
+            *tail = a;                                                                   \
+            tail = &a->next;                                                             \
+            a = a->next;                                                                 \
+        }                                                                                \
+    }                                                                                    \
+    *tail = a ? a : b;                                                                   \
+    return head;                                                                         \
+}                                                                                        \
+                                                                                         \
+static ListEntry_##id *__list_gather_run_##id(ListEntry_##id **pcurr,                    \
+                                              ListEntry_##id **ptail) {                  \
+    ListEntry_##id *head = *pcurr, *tail = head, *curr = head->next, *node, *pos;        \
+    unsigned len = 1;                                                                    \
+    head->prev = NULL;                                                                   \
+    if (curr && cmp_lt(curr->data, head->data)) {                                        \
+        do { /* strictly descending, so reversing it keeps the sort stable */            \
+            node = curr;                                                                 \
+            curr = curr->next;                                                           \
+            node->next = head;                                                           \
+            node->prev = NULL;                                                           \
+            head->prev = node;                                                           \
+            head = node;                                                                 \
+            ++len;                                                                       \
+        } while (curr && cmp_lt(curr->data, head->data));                                \
+    } else {                                                                             \
+        while (curr && !cmp_lt(curr->data, tail->data)) {                                \
+            tail = curr;                                                                 \
+            curr = curr->next;                                                           \
+            ++len;                                                                       \
+        }                                                                                \
+    }                                                                                    \
+                                                                                         \
+    /* pad short runs by insertion while their nodes are still in cache */               \
+    for (; curr && len < DS_LIST_SORT_MIN_RUN; ++len) {                                  \
+        node = curr;                                                                     \
+        curr = curr->next;                                                               \
+        for (pos = tail; pos && cmp_lt(node->data, pos->data); pos = pos->prev);         \
+        if (pos == tail) {                                                               \
+            tail = node;                                                                 \
+        } else {                                                                         \
+            node->next = pos ? pos->next : head;                                         \
+            node->next->prev = node;                                                     \
+        }                                                                                \
+        if (pos) {                                                                       \
+            pos->next = node;                                                            \
+        } else {                                                                         \
+            head = node;                                                                 \
+        }                                                                                \
+        node->prev = pos;                                                                \
+    }                                                                                    \
+    tail->next = NULL;                                                                   \
+    *ptail = tail;                                                                       \
+    *pcurr = curr;                                                                       \
+    return head;                                                                         \
+}                                                                                        \
+                                                                                         \
+void list_merge_sort_##id(List_##id *this) {                                             \
+    ListEntry_##id *bins[64] = {0};                                                      \
+    ListEntry_##id *curr = this->front, *run, *tail, *a, *prev = NULL, **link;           \
+    unsigned k, top = 0;                                                                 \
+    if (this->size < 2) return;                                                          \
+                                                                                         \
+    /* runs keep valid prev links; merges below maintain the next links only */          \
+    while ((run = __list_gather_run_##id(&curr, &tail)), curr) {                         \
+        for (k = 0; bins[k]; ++k) {                                                      \
+            run = __list_merge_next_##id(bins[k], run);                                  \
+            bins[k] = NULL;                                                              \
+        }                                                                                \
+        bins[k] = run;                                                                   \
+        if (k >= top) top = k + 1;                                                       \
+    }                                                                                    \
+    if (!top) {                                                                          \
+        this->front = run;                                                               \
+        this->back = tail;                                                               \
+        return;                                                                          \
+    }                                                                                    \
+    for (k = 0; k + 1 < top; ++k) {                                                      \
+        if (bins[k]) run = __list_merge_next_##id(bins[k], run);                         \
+    }                                                                                    \
+                                                                                         \
+    /* the final merge relinks prev as it goes, leaving only its leftovers */            \
+    for (a = bins[top - 1], link = &this->front; a && run; link = &prev->next) {         \
+        if (cmp_lt(run->data, a->data)) {                                                \
+            curr = run;                                                                  \
+            run = run->next;                                                             \
+        } else {                                                                         \
+            curr = a;                                                                    \
+            a = a->next;                                                                 \
+        }                                                                                \
+        *link = curr;                                                                    \
+        curr->prev = prev;                                                               \
+        prev = curr;                                                                     \
+    }                                                                                    \
+    for (*link = curr = a ? a : run; curr; prev = curr, curr = curr->next) {             \
+        curr->prev = prev;                                                               \
+    }                                                                                    \
+    this->back = prev;                                                                   \
+}                                                                                        \
 
 #endif /* DS_LIST_H */
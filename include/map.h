@@ -2,6 +2,7 @@
 #define DS_MAP_H
 
 #include "avltree.h"
+#include "btree.h"
 
 #define __map_entry_get_key(e) (e)->data.first
 #define __map_data_get_key(d)  (d).first
@@ -104,6 +105,59 @@
         for (it = map_iterator_rbegin(id, this); it;                                     \
              it = mapEntry_getPrev(id, it))
 
+
+/**
+ * Returns the first entry whose key is not less than @c key .
+ *
+ * @param   key  @c kt : Key to search for.
+ *
+ * @return       @c MapEntry* : First entry whose key is at least @c key , or
+ *               NULL if there is none.
+ */
+#define map_lower_bound(id, this, key) __avltree_lower_bound_##id(this, key)
+
+
+/**
+ * Returns the first entry whose key is greater than @c key .
+ *
+ * @param   key  @c kt : Key to search for.
+ *
+ * @return       @c MapEntry* : First entry whose key is greater than @c key ,
+ *               or NULL if there is none.
+ */
+#define map_upper_bound(id, this, key) __avltree_upper_bound_##id(this, key)
+
+
+/**
+ * Sets @c first and @c last to the range [ @c first , @c last ) of entries
+ * whose key is equal to @c key ; the range is empty ( @c first equals
+ * @c last ) if there is no such entry.
+ *
+ * @param  key    @c kt : Key to search for.
+ * @param  first  @c MapEntry* : Assigned to the lower bound of @c key .
+ * @param  last   @c MapEntry* : Assigned to the upper bound of @c key .
+ */
+#define map_equal_range(id, this, key, first, last) do {                                 \
+    first = __avltree_lower_bound_##id(this, key);                                       \
+    last = __avltree_upper_bound_##id(this, key);                                        \
+} while(0)
+
+
+/**
+ * Iterates in-order through the entries whose key is in the range
+ * [ @c lo , @c hi ). Finding the first entry takes O(log n) time, and each
+ * step after it O(1) amortized time.
+ *
+ * @param  lo  @c kt : Smallest key to visit.
+ * @param  hi  @c kt : Key after the largest key to visit.
+ * @param  it  @c MapEntry* : Assigned to the current element. May be
+ *              dereferenced with @c it->data .
+ */
+#define map_iter_range(id, this, lo, hi, it)                                             \
+        for (it = __avltree_lower_bound_##id(this, lo);                                  \
+             it && __avlEntry_key_lt_##id(it, hi);                                       \
+             it = __avl_inorder_successor_##id(it))
+
 /* --------------------------------------------------------------------------
  * HELPERS
  * -------------------------------------------------------------------------- */
@@ -131,6 +185,19 @@
 #define map_new(id) __avltree_new_fromArray_##id(NULL, 0)
 
 
+/**
+ * Creates a new, empty map whose entries are allocated from slabs of @c chunk
+ * entries owned by the map. Removed entries are recycled, and clearing or
+ * freeing the map releases whole slabs at once.
+ *
+ * @param   chunk  @c unsigned : Number of entries per slab; 0 disables
+ *                  pooling.
+ *
+ * @return         @c Map* : Newly created map.
+ */
+#define map_new_withPool(id, chunk) __avltree_new_withPool_##id(chunk)
+
+
 /**
  * Creates a new map using @c n key-value pairs in a built-in array @c arr .
  *
@@ -142,6 +209,21 @@
 #define map_new_fromArray(id, arr, n) __avltree_new_fromArray_##id(arr, n)
 
 
+/**
+ * Creates a new map from @c n key-value pairs in a built-in array @c arr ,
+ * which must be in increasing order of keys without duplicates. The tree is
+ * built directly in O(n) time and all of its entries are allocated as a single
+ * slab; pairs inserted later come from slabs of @c DS_AVL_BULK_CHUNK entries.
+ * If @c arr is not sorted, this falls back to @c map_new_fromArray .
+ *
+ * @param   arr  @c Pair* : Pointer to the first element to insert.
+ * @param   n    @c unsigned : Number of elements to include.
+ *
+ * @return       @c Map* : Newly created map, or NULL if allocation failed.
+ */
+#define map_new_fromSortedArray(id, arr, n) __avltree_new_fromSorted_##id(arr, n)
+
+
 /**
  * Creates a new map as a copy of @c other .
  *
@@ -155,7 +237,7 @@
 /**
  * Deletes all elements and frees the map.
  */
-#define map_free(id, this) do { map_clear(id, this); free(this); } while(0)
+#define map_free(id, this) __avltree_free_##id(this)
 
 
 /**
@@ -240,6 +322,23 @@
         __avltree_insert_fromTree_##id(this, start, end)
 
 
+/**
+ * Moves every pair of @c other into this map, leaving @c other empty. Keys
+ * that are in both maps keep the value from this map. No pairs are copied:
+ * the two trees are split and joined in place in O(m log(n / m + 1)) time,
+ * where @c m is the size of the smaller map. Maps with a pool (including
+ * those from @c map_new_fromSortedArray and their copies) and B+-tree maps
+ * cannot hand over their entries, so for them the missing pairs are inserted
+ * one by one instead.
+ *
+ * @param   other  @c Map* : Map to take the pairs from.
+ *
+ * @return         @c bool : Whether the operation succeeded. On failure, some
+ *                 pairs may have been copied to this map already.
+ */
+#define map_merge(id, this, other) __avltree_merge_##id(this, other)
+
+
 /**
  * Removes key-value pairs in the range [ @c begin , @c end ).
  *
@@ -283,6 +382,44 @@
         __avltree_remove_entry_##id(this, entry)
 
 
+/**
+ * Returns the entry whose key is the @c k th smallest in the map. This takes
+ * O(log n) time if the map was generated with @c gen_map_headers_withRank , and
+ * O(k) time otherwise.
+ *
+ * @param   k  @c unsigned : Rank of the key, starting at 0 for the smallest.
+ *
+ * @return     @c MapEntry* : Entry at rank @c k , or NULL if @c k is not less
+ *             than the size of the map.
+ */
+#define map_at_rank(id, this, k) __avltree_at_rank_##id(this, k)
+
+
+/**
+ * Returns the number of keys in the map which are less than @c key , which is
+ * the rank of @c key if it is in the map. This takes O(log n) time if the map
+ * was generated with @c gen_map_headers_withRank , and O(n) time otherwise.
+ *
+ * @param   key  @c kt : Key to rank.
+ *
+ * @return       @c unsigned : Number of keys less than @c key .
+ */
+#define map_rank_of(id, this, key) __avltree_rank_of_##id(this, key)
+
+
+/**
+ * Returns the number of keys in the range [ @c lo , @c hi ). This takes
+ * O(log n) time if the map was generated with @c gen_map_headers_withRank .
+ *
+ * @param   lo  @c kt : Smallest key to count.
+ * @param   hi  @c kt : Key after the largest key to count.
+ *
+ * @return      @c unsigned : Number of keys at least @c lo and less than
+ *              @c hi , or 0 if @c hi is not greater than @c lo .
+ */
+#define map_count_range(id, this, lo, hi) __avltree_count_range_##id(this, lo, hi)
+
+
 /**
  * Generates @c Map function declarations for the given key type and value 
  * type.
@@ -292,14 +429,32 @@
  * @param  kt  Key type.
  * @param  vt  Value type.
  */
-#define gen_map_headers(id, kt, vt)                                                      \
+#define gen_map_headers(id, kt, vt) __map_headers(id, kt, vt, __avl_counts_none)
+
+
+/**
+ * Generates @c Map function declarations like @c gen_map_headers , but each
+ * entry also stores the size of its subtree. @c map_at_rank , @c map_rank_of ,
+ * @c map_count_range , @c mapEntry_advance and @c mapEntry_distance then take
+ * O(log n) time, at the cost of an @c unsigned per entry and keeping the sizes
+ * up to date on insertion and removal. Use @c gen_map_source with it.
+ *
+ * @param  id  ID to be used for the @c Map , @c MapEntry , and @c Pair types
+ *              (must be unique).
+ * @param  kt  Key type.
+ * @param  vt  Value type.
+ */
+#define gen_map_headers_withRank(id, kt, vt)                                             \
+        __map_headers(id, kt, vt, __avl_counts_stored)
+
+#define __map_headers(id, kt, vt, countMode)                                             \
                                                                                          \
 typedef struct {                                                                         \
     kt first;                                                                            \
     vt second;                                                                           \
 } Pair_##id;                                                                             \
                                                                                          \
-__setup_avltree_headers(id, kt, Map_##id, Pair_##id, MapEntry_##id)                      \
+__setup_avltree_headers(id, kt, Map_##id, Pair_##id, MapEntry_##id, countMode)           \
                                                                                          \
 vt* map_at_##id(Map_##id const *this, kt const key) __attribute__((nonnull));            \
 
@@ -351,4 +506,44 @@ vt* map_at_##id(Map_##id const *this, kt const key) {
     return e ? &(e->data.second) : NULL;                                                 \
 }                                                                                        \
 
+
+/**
+ * Same as @c gen_map_headers , but the map is a B+-tree (see @c btree.h ).
+ * Every @c map_* macro works on it, with one difference: an insertion or
+ * removal may move other pairs in memory, so entries and value pointers
+ * obtained before it (other than the entry it returns) must be looked up again.
+ *
+ * @param  id  ID to be used for the @c Map , @c MapEntry , and @c Pair types
+ *              (must be unique).
+ * @param  kt  Key type.
+ * @param  vt  Value type.
+ */
+#define gen_map_headers_btree(id, kt, vt)                                                \
+                                                                                         \
+typedef struct {                                                                         \
+    kt first;                                                                            \
+    vt second;                                                                           \
+} Pair_##id;                                                                             \
+                                                                                         \
+__setup_btree_headers(id, kt, Map_##id, Pair_##id, MapEntry_##id)                        \
+                                                                                         \
+vt* map_at_##id(Map_##id const *this, kt const key) __attribute__((nonnull));            \
+
+
+/**
+ * Generates the @c Map function definitions for @c gen_map_headers_btree . The
+ * arguments are the same as for @c gen_map_source .
+ */
+#define gen_map_source_btree(id, kt, vt, cmp_lt, copyKey, deleteKey, copyValue,          \
+                             deleteValue)                                                \
+                                                                                         \
+__setup_btree_source(id, kt, Map_##id, Pair_##id, MapEntry_##id, cmp_lt,                 \
+    __map_entry_get_key, __map_data_get_key, copyKey, deleteKey, copyValue,              \
+    deleteValue)                                                                         \
+                                                                                         \
+vt* map_at_##id(Map_##id const *this, kt const key) {                                    \
+    MapEntry_##id *e = __avltree_find_key_##id(this, key, 0);                            \
+    return e ? &(e->data.second) : NULL;                                                 \
+}                                                                                        \
+
 #endif /* DS_MAP_H */
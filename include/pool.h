@@ -0,0 +1,127 @@
+#ifndef DS_POOL_H
+#define DS_POOL_H
+
+#include "ds.h"
+
+/*
+ * Fixed-size node allocator used by the node-based containers (List, Set/Map
+ * and the chained UMap/USet). Nodes are carved out of slabs holding @c chunk
+ * nodes each; freed nodes go onto a free list and are handed out again before
+ * a new slab is allocated. Releasing the pool frees every slab at once, so a
+ * container that owns a pool never frees its nodes one by one.
+ *
+ * A pool with a @c chunk of 0 is disabled and simply forwards to @c calloc and
+ * @c free (through the hooks in @c ds.h ), which is what a zero-initialized
+ * container gets by default.
+ */
+
+typedef struct {
+    void *freeList;
+    void *slabs;
+    unsigned chunk;
+} DSPool;
+
+/* Padded to the strictest alignment of the basic types, which nodes inherit. */
+typedef union {
+    void *next;
+    double d;
+    long double ld;
+    long l;
+    void (*fn)(void);
+} DSPoolSlabHeader;
+
+
+/**
+ * Enables pooling with @c n nodes per slab. The pool must not own any nodes
+ * yet.
+ *
+ * @param  pool  @c DSPool* : Pool to set up.
+ * @param  n     @c unsigned : Number of nodes per slab, or 0 to disable
+ *                pooling.
+ */
+#define ds_pool_init(pool, n) do {                                                       \
+    (pool)->freeList = (pool)->slabs = NULL;                                             \
+    (pool)->chunk = (n);                                                                 \
+} while(0)
+
+
+/**
+ * Returns a zeroed node of @c size bytes, allocating a new slab when the free
+ * list is empty. Memory comes from the @c DS_* allocation hooks in @c ds.h .
+ *
+ * @param   pool  @c DSPool* : Pool to allocate from.
+ * @param   size  @c size_t : Size of a node; must be the same for every call
+ *                 on this pool and at least @c sizeof(void*) .
+ *
+ * @return        @c void* : Pointer to the node, or NULL if allocation failed.
+ */
+#define ds_pool_alloc(pool, size)                                                        \
+        (!(pool)->chunk ? __ds_calloc(1, size) :                                         \
+         __ds_pool_take(pool, size, (pool)->freeList ? NULL :                            \
+             __ds_malloc(sizeof(DSPoolSlabHeader) + (pool)->chunk * (size))))
+
+
+/**
+ * Returns @c node to the free list of @c pool .
+ *
+ * @param  pool  @c DSPool* : Pool which @c node was allocated from.
+ * @param  node  @c void* : Node to free.
+ */
+#define ds_pool_free(pool, node) do {                                                    \
+    if ((pool)->chunk) {                                                                 \
+        *(void **) (node) = (pool)->freeList;                                            \
+        (pool)->freeList = (node);                                                       \
+    } else {                                                                             \
+        __ds_free(node);                                                                 \
+    }                                                                                    \
+} while(0)
+
+
+/**
+ * Frees every slab owned by @c pool . All nodes allocated from it become
+ * invalid; the pool itself stays usable with the same chunk size.
+ *
+ * @param  pool  @c DSPool* : Pool to release.
+ */
+#define ds_pool_release(pool) do {                                                       \
+    DSPoolSlabHeader *_slab;                                                             \
+    while ((_slab = (pool)->slabs)) {                                                    \
+        (pool)->slabs = _slab->next;                                                     \
+        __ds_free(_slab);                                                                \
+    }                                                                                    \
+    (pool)->freeList = NULL;                                                             \
+} while(0)
+
+
+/**
+ * Pops a node off the free list, first threading @c slab onto it if the list
+ * is empty. Used by @c ds_pool_alloc .
+ */
+__attribute__((__unused__)) static
+#if __STDC_VERSION__ >= 199901L
+inline
+#endif
+void *__ds_pool_take(DSPool *pool, size_t size, void *slab) __attribute__((nonnull (1)));
+
+void *__ds_pool_take(DSPool *pool, size_t size, void *slab) {
+    void *node;
+    if (slab) {
+        unsigned i;
+        char *nodes = (char *) ((DSPoolSlabHeader *) slab + 1);
+        ((DSPoolSlabHeader *) slab)->next = pool->slabs;
+        pool->slabs = slab;
+        for (i = pool->chunk; i; --i) { /* thread the nodes in address order */
+            void *n = nodes + (i - 1) * size;
+            *(void **) n = pool->freeList;
+            pool->freeList = n;
+        }
+    } else if (!pool->freeList) {
+        return NULL;
+    }
+    node = pool->freeList;
+    pool->freeList = *(void **) node;
+    memset(node, 0, size);
+    return node;
+}
+
+#endif /* DS_POOL_H */
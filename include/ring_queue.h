@@ -0,0 +1,471 @@
+#ifndef DS_RING_QUEUE_H
+#define DS_RING_QUEUE_H
+
+#include "ds.h"
+#ifndef __CDS_SCAN
+#include <stddef.h>
+#endif /* __CDS_SCAN */
+
+/*
+ * Bounded queues for passing values between threads, backed by a ring buffer
+ * whose capacity is rounded up to a power of two.
+ *  - SPSCQueue may only be used by one producer and one consumer thread. Every
+ *    operation is wait-free.
+ *  - MPMCQueue may be used by any number of producers and consumers. It is
+ *    Vyukov's bounded queue: each slot has a sequence number telling whether it
+ *    is ready to be pushed to or popped from on the current pass over the
+ *    buffer, so a thread claims a slot with a single compare-and-swap on the
+ *    head or tail index, and then reads or writes it without further
+ *    synchronization.
+ *
+ * The head and tail indices are on separate cache lines so that producers and
+ * consumers do not invalidate each other's line on every operation. Pushed
+ * values are copied in with @c copyValue , while popped values are moved out,
+ * so the caller takes ownership of them.
+ *
+ * The atomics use the GCC/Clang @c __atomic builtins, which follow the C11
+ * memory model and are available with -std=c89/c99 as well.
+ */
+
+#define __rq_load_relaxed(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define __rq_load_acquire(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define __rq_store_release(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define __rq_cas_weak(ptr, expected, desired)                                            \
+        __atomic_compare_exchange_n(ptr, expected, desired, 1, __ATOMIC_RELAXED,         \
+                                    __ATOMIC_RELAXED)
+
+#define __rq_align(ptr)                                                                  \
+        (void *) (((size_t) (ptr) + DS_CACHE_LINE_SIZE - 1) &                            \
+                  ~(size_t) (DS_CACHE_LINE_SIZE - 1))
+
+#define DS_RING_QUEUE_MAX_SIZE(t) (((size_t) -1 >> 2) / sizeof(t))
+
+__attribute__((__unused__)) static
+#if __STDC_VERSION__ >= 199901L
+inline
+#endif
+size_t __rq_size(size_t const *head, size_t const *tail);
+
+size_t __rq_size(size_t const *head, size_t const *tail) {
+    const size_t h = __rq_load_acquire(head);
+    return __rq_load_acquire(tail) - h;
+}
+
+/* --------------------------------------------------------------------------
+ * HELPERS
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief @c size_t : The number of elements in the queue. This is only a
+ * snapshot if other threads are using the queue.
+ */
+#define spsc_queue_size(this) __rq_size(&(this)->head, &(this)->tail)
+
+
+/**
+ * @brief @c size_t : The maximum number of elements the queue can hold.
+ */
+#define spsc_queue_capacity(this) ((this)->mask + 1)
+
+
+/**
+ * @brief @c size_t : The number of elements in the queue. This is only a
+ * snapshot if other threads are using the queue.
+ */
+#define mpmc_queue_size(this) __rq_size(&(this)->head, &(this)->tail)
+
+
+/**
+ * @brief @c size_t : The maximum number of elements the queue can hold.
+ */
+#define mpmc_queue_capacity(this) ((this)->mask + 1)
+
+/* --------------------------------------------------------------------------
+ * SPSC QUEUE
+ * -------------------------------------------------------------------------- */
+
+/**
+ * Creates a new, empty queue that can hold at least @c capacity elements.
+ *
+ * @param   capacity  @c size_t : Minimum capacity, rounded up to a power of 2.
+ *
+ * @return            @c SPSCQueue* : Newly allocated queue.
+ */
+#define spsc_queue_new(id, capacity) __spsc_new_##id(capacity)
+
+
+/**
+ * Frees the queue and deletes any remaining elements. No other thread may be
+ * using it.
+ */
+#define spsc_queue_free(id, this) __spsc_free_##id(this)
+
+
+/**
+ * Appends @c value to the back of the queue. May only be called by the
+ * producer thread.
+ *
+ * @param   value  @c t : Value to be pushed.
+ *
+ * @return         @c bool : Whether the value was pushed (false if the queue is
+ *                  full).
+ */
+#define spsc_queue_push(id, this, value) __spsc_push_##id(this, value)
+
+
+/**
+ * Removes the first element in the queue and stores it in @c out . May only be
+ * called by the consumer thread.
+ *
+ * @param   out  @c t* : Receives the popped value.
+ *
+ * @return       @c bool : Whether a value was popped (false if the queue is
+ *                empty).
+ */
+#define spsc_queue_pop(id, this, out) __spsc_pop_##id(this, out)
+
+
+/**
+ * Appends as many of the @c n elements of @c arr as fit, in order. The tail
+ * index is only published once, after all of them have been copied.
+ *
+ * @param   arr  @c t* : Values to be pushed.
+ * @param   n    @c size_t : Number of values in @c arr .
+ *
+ * @return       @c size_t : Number of values pushed.
+ */
+#define spsc_queue_push_n(id, this, arr, n) __spsc_push_n_##id(this, arr, n)
+
+
+/**
+ * Removes up to @c n elements from the front of the queue into @c out .
+ *
+ * @param   out  @c t* : Array receiving the popped values.
+ * @param   n    @c size_t : Maximum number of values to pop.
+ *
+ * @return       @c size_t : Number of values popped.
+ */
+#define spsc_queue_pop_n(id, this, out, n) __spsc_pop_n_##id(this, out, n)
+
+
+/**
+ * Generates @c SPSCQueue function declarations for the specified type and ID.
+ *
+ * @param  id  ID to be used for the queue (must be unique).
+ * @param  t   Type to be stored in the queue.
+ */
+#define gen_spsc_queue_headers(id, t)                                                    \
+                                                                                         \
+typedef struct {                                                                         \
+    t *buf;                                                                              \
+    size_t mask;                                                                         \
+    void *mem;                                                                           \
+    size_t head __attribute__((__aligned__(DS_CACHE_LINE_SIZE)));                        \
+    size_t tailCache;                                                                    \
+    size_t tail __attribute__((__aligned__(DS_CACHE_LINE_SIZE)));                        \
+    size_t headCache;                                                                    \
+} SPSCQueue_##id;                                                                        \
+                                                                                         \
+SPSCQueue_##id *__spsc_new_##id(size_t capacity);                                        \
+void __spsc_free_##id(SPSCQueue_##id *this) __attribute__((nonnull));                    \
+size_t __spsc_push_n_##id(SPSCQueue_##id *this, t const *arr, size_t n)                  \
+  __attribute__((nonnull (1)));                                                          \
+size_t __spsc_pop_n_##id(SPSCQueue_##id *this, t *out, size_t n)                         \
+  __attribute__((nonnull (1)));                                                          \
+unsigned char __spsc_push_##id(SPSCQueue_##id *this, t const value)                      \
+  __attribute__((nonnull));                                                              \
+unsigned char __spsc_pop_##id(SPSCQueue_##id *this, t *out) __attribute__((nonnull));    \
+                                                                                         \
+
+
+/**
+ * Generates @c SPSCQueue function definitions for the specified type and ID.
+ *
+ * @param  id           ID used in @c gen_spsc_queue_headers .
+ * @param  t            Type used in @c gen_spsc_queue_headers .
+ * @param  copyValue    Macro of the form @c (x,y) which copies @c y into @c x
+ *                       to store the element in the queue.
+ * @param  deleteValue  Macro of the form @c (x) which is a complement to
+ *                       @c copyValue ; it is only used for elements still in
+ *                       the queue when it is freed.
+ */
+#define gen_spsc_queue_source(id, t, copyValue, deleteValue)                             \
+                                                                                         \
+SPSCQueue_##id *__spsc_new_##id(size_t capacity) {                                       \
+    SPSCQueue_##id *this;                                                                \
+    void *mem;                                                                           \
+    size_t cap = 2;                                                                      \
+    if (capacity > DS_RING_QUEUE_MAX_SIZE(t)) return NULL;                               \
+    while (cap < capacity) cap <<= 1;                                                    \
+    mem = __ds_malloc(sizeof(SPSCQueue_##id) + DS_CACHE_LINE_SIZE);                      \
+    customAssert(mem)                                                                    \
+    if (!mem) return NULL;                                                               \
+    this = __rq_align(mem);                                                              \
+    memset(this, 0, sizeof(SPSCQueue_##id));                                             \
+    this->mem = mem;                                                                     \
+    this->mask = cap - 1;                                                                \
+    this->buf = __ds_malloc(cap * sizeof(t));                                            \
+    customAssert(this->buf)                                                              \
+    if (!this->buf) {                                                                    \
+        __ds_free(mem);                                                                  \
+        return NULL;                                                                     \
+    }                                                                                    \
+    return this;                                                                         \
+}                                                                                        \
+                                                                                         \
+void __spsc_free_##id(SPSCQueue_##id *this) {                                            \
+    size_t i;                                                                            \
+    for (i = this->head; i != this->tail; ++i) {                                         \
+        deleteValue(this->buf[i & this->mask]);                                          \
+    }                                                                                    \
+    __ds_free(this->buf);                                                                \
+    __ds_free(this->mem);                                                                \
+}                                                                                        \
+                                                                                         \
+size_t __spsc_push_n_##id(SPSCQueue_##id *this, t const *arr, size_t n) {                \
+    const size_t tail = __rq_load_relaxed(&this->tail);                                  \
+    size_t i, space = this->mask + 1 - (tail - this->headCache);                         \
+    if (space < n) {                                                                     \
+        this->headCache = __rq_load_acquire(&this->head);                                \
+        space = this->mask + 1 - (tail - this->headCache);                               \
+        if (space < n) n = space;                                                        \
+    }                                                                                    \
+    for (i = 0; i < n; ++i) {                                                            \
+        copyValue(this->buf[(tail + i) & this->mask], arr[i]);                           \
+    }                                                                                    \
+    __rq_store_release(&this->tail, tail + n);                                           \
+    return n;                                                                            \
+}                                                                                        \
+                                                                                         \
+size_t __spsc_pop_n_##id(SPSCQueue_##id *this, t *out, size_t n) {                       \
+    const size_t head = __rq_load_relaxed(&this->head);                                  \
+    size_t i, avail = this->tailCache - head;                                            \
+    if (avail < n) {                                                                     \
+        this->tailCache = __rq_load_acquire(&this->tail);                                \
+        avail = this->tailCache - head;                                                  \
+        if (avail < n) n = avail;                                                        \
+    }                                                                                    \
+    for (i = 0; i < n; ++i) {                                                            \
+        out[i] = this->buf[(head + i) & this->mask];                                     \
+    }                                                                                    \
+    __rq_store_release(&this->head, head + n);                                           \
+    return n;                                                                            \
+}                                                                                        \
+                                                                                         \
+unsigned char __spsc_push_##id(SPSCQueue_##id *this, t const value) {                    \
+    return __spsc_push_n_##id(this, &value, 1) != 0;                                     \
+}                                                                                        \
+                                                                                         \
+unsigned char __spsc_pop_##id(SPSCQueue_##id *this, t *out) {                            \
+    return __spsc_pop_n_##id(this, out, 1) != 0;                                         \
+}                                                                                        \
+                                                                                         \
+
+
+/* --------------------------------------------------------------------------
+ * MPMC QUEUE
+ * -------------------------------------------------------------------------- */
+
+/**
+ * Creates a new, empty queue that can hold at least @c capacity elements.
+ *
+ * @param   capacity  @c size_t : Minimum capacity, rounded up to a power of 2.
+ *
+ * @return            @c MPMCQueue* : Newly allocated queue.
+ */
+#define mpmc_queue_new(id, capacity) __mpmc_new_##id(capacity)
+
+
+/**
+ * Frees the queue and deletes any remaining elements. No other thread may be
+ * using it.
+ */
+#define mpmc_queue_free(id, this) __mpmc_free_##id(this)
+
+
+/**
+ * Appends @c value to the back of the queue.
+ *
+ * @param   value  @c t : Value to be pushed.
+ *
+ * @return         @c bool : Whether the value was pushed (false if the queue is
+ *                  full).
+ */
+#define mpmc_queue_push(id, this, value) __mpmc_push_##id(this, value)
+
+
+/**
+ * Removes the first element in the queue and stores it in @c out .
+ *
+ * @param   out  @c t* : Receives the popped value.
+ *
+ * @return       @c bool : Whether a value was popped (false if the queue is
+ *                empty).
+ */
+#define mpmc_queue_pop(id, this, out) __mpmc_pop_##id(this, out)
+
+
+/**
+ * Appends up to @c n elements of @c arr , in order, claiming all of their
+ * slots with one compare-and-swap. Fewer are pushed if the queue is nearly
+ * full or if some of the following slots are still being read by consumers.
+ *
+ * @param   arr  @c t* : Values to be pushed.
+ * @param   n    @c size_t : Number of values in @c arr .
+ *
+ * @return       @c size_t : Number of values pushed.
+ */
+#define mpmc_queue_push_n(id, this, arr, n) __mpmc_push_n_##id(this, arr, n)
+
+
+/**
+ * Removes up to @c n consecutive elements from the front of the queue into
+ * @c out , claiming them with one compare-and-swap.
+ *
+ * @param   out  @c t* : Array receiving the popped values.
+ * @param   n    @c size_t : Maximum number of values to pop.
+ *
+ * @return       @c size_t : Number of values popped.
+ */
+#define mpmc_queue_pop_n(id, this, out, n) __mpmc_pop_n_##id(this, out, n)
+
+
+/**
+ * Generates @c MPMCQueue function declarations for the specified type and ID.
+ *
+ * @param  id  ID to be used for the queue (must be unique).
+ * @param  t   Type to be stored in the queue.
+ */
+#define gen_mpmc_queue_headers(id, t)                                                    \
+                                                                                         \
+typedef struct {                                                                         \
+    size_t seq;                                                                          \
+    t data;                                                                              \
+} __MPMCCell_##id;                                                                       \
+                                                                                         \
+typedef struct {                                                                         \
+    __MPMCCell_##id *buf;                                                                \
+    size_t mask;                                                                         \
+    void *mem;                                                                           \
+    size_t head __attribute__((__aligned__(DS_CACHE_LINE_SIZE)));                        \
+    size_t tail __attribute__((__aligned__(DS_CACHE_LINE_SIZE)));                        \
+} MPMCQueue_##id;                                                                        \
+                                                                                         \
+MPMCQueue_##id *__mpmc_new_##id(size_t capacity);                                        \
+void __mpmc_free_##id(MPMCQueue_##id *this) __attribute__((nonnull));                    \
+size_t __mpmc_push_n_##id(MPMCQueue_##id *this, t const *arr, size_t n)                  \
+  __attribute__((nonnull (1)));                                                          \
+size_t __mpmc_pop_n_##id(MPMCQueue_##id *this, t *out, size_t n)                         \
+  __attribute__((nonnull (1)));                                                          \
+unsigned char __mpmc_push_##id(MPMCQueue_##id *this, t const value)                      \
+  __attribute__((nonnull));                                                              \
+unsigned char __mpmc_pop_##id(MPMCQueue_##id *this, t *out) __attribute__((nonnull));    \
+                                                                                         \
+
+
+/**
+ * Generates @c MPMCQueue function definitions for the specified type and ID.
+ * The parameters are the same as for @c gen_spsc_queue_source .
+ */
+#define gen_mpmc_queue_source(id, t, copyValue, deleteValue)                             \
+                                                                                         \
+MPMCQueue_##id *__mpmc_new_##id(size_t capacity) {                                       \
+    MPMCQueue_##id *this;                                                                \
+    void *mem;                                                                           \
+    size_t i, cap = 2;                                                                   \
+    if (capacity > DS_RING_QUEUE_MAX_SIZE(__MPMCCell_##id)) return NULL;                 \
+    while (cap < capacity) cap <<= 1;                                                    \
+    mem = __ds_malloc(sizeof(MPMCQueue_##id) + DS_CACHE_LINE_SIZE);                      \
+    customAssert(mem)                                                                    \
+    if (!mem) return NULL;                                                               \
+    this = __rq_align(mem);                                                              \
+    memset(this, 0, sizeof(MPMCQueue_##id));                                             \
+    this->mem = mem;                                                                     \
+    this->mask = cap - 1;                                                                \
+    this->buf = __ds_malloc(cap * sizeof(__MPMCCell_##id));                              \
+    customAssert(this->buf)                                                              \
+    if (!this->buf) {                                                                    \
+        __ds_free(mem);                                                                  \
+        return NULL;                                                                     \
+    }                                                                                    \
+    for (i = 0; i < cap; ++i) {                                                          \
+        this->buf[i].seq = i;                                                            \
+    }                                                                                    \
+    return this;                                                                         \
+}                                                                                        \
+                                                                                         \
+void __mpmc_free_##id(MPMCQueue_##id *this) {                                            \
+    size_t i;                                                                            \
+    for (i = this->head; i != this->tail; ++i) {                                         \
+        deleteValue(this->buf[i & this->mask].data);                                     \
+    }                                                                                    \
+    __ds_free(this->buf);                                                                \
+    __ds_free(this->mem);                                                                \
+}                                                                                        \
+                                                                                         \
+/*                                                                                       \
+ * A cell whose sequence number equals the position being pushed is empty, and           \
+ * one whose sequence number is one past the position being popped is full.              \
+ * Since only the thread that claims a position may change its cell, a run of            \
+ * ready cells checked before the claim is still ready after it.                         \
+ */                                                                                      \
+size_t __mpmc_push_n_##id(MPMCQueue_##id *this, t const *arr, size_t n) {                \
+    size_t i, seq = 0, pos = __rq_load_relaxed(&this->tail);                             \
+    if (!n) return 0;                                                                    \
+    for (;;) {                                                                           \
+        for (i = 0; i < n; ++i) {                                                        \
+            seq = __rq_load_acquire(&this->buf[(pos + i) & this->mask].seq);             \
+            if (seq != pos + i) break;                                                   \
+        }                                                                                \
+        if (i) {                                                                         \
+            if (__rq_cas_weak(&this->tail, &pos, pos + i)) break;                        \
+        } else if ((ptrdiff_t) (seq - pos) < 0) {                                        \
+            return 0;                                                                    \
+        } else {                                                                         \
+            pos = __rq_load_relaxed(&this->tail);                                        \
+        }                                                                                \
+    }                                                                                    \
+    n = i;                                                                               \
+    for (i = 0; i < n; ++i) {                                                            \
+        __MPMCCell_##id *cell = &this->buf[(pos + i) & this->mask];                      \
+        copyValue(cell->data, arr[i]);                                                   \
+        __rq_store_release(&cell->seq, pos + i + 1);                                     \
+    }                                                                                    \
+    return n;                                                                            \
+}                                                                                        \
+                                                                                         \
+size_t __mpmc_pop_n_##id(MPMCQueue_##id *this, t *out, size_t n) {                       \
+    size_t i, seq = 0, pos = __rq_load_relaxed(&this->head);                             \
+    if (!n) return 0;                                                                    \
+    for (;;) {                                                                           \
+        for (i = 0; i < n; ++i) {                                                        \
+            seq = __rq_load_acquire(&this->buf[(pos + i) & this->mask].seq);             \
+            if (seq != pos + i + 1) break;                                               \
+        }                                                                                \
+        if (i) {                                                                         \
+            if (__rq_cas_weak(&this->head, &pos, pos + i)) break;                        \
+        } else if ((ptrdiff_t) (seq - (pos + 1)) < 0) {                                  \
+            return 0;                                                                    \
+        } else {                                                                         \
+            pos = __rq_load_relaxed(&this->head);                                        \
+        }                                                                                \
+    }                                                                                    \
+    n = i;                                                                               \
+    for (i = 0; i < n; ++i) {                                                            \
+        __MPMCCell_##id *cell = &this->buf[(pos + i) & this->mask];                      \
+        out[i] = cell->data;                                                             \
+        __rq_store_release(&cell->seq, pos + i + this->mask + 1);                        \
+    }                                                                                    \
+    return n;                                                                            \
+}                                                                                        \
+                                                                                         \
+unsigned char __mpmc_push_##id(MPMCQueue_##id *this, t const value) {                    \
+    return __mpmc_push_n_##id(this, &value, 1) != 0;                                     \
+}                                                                                        \
+                                                                                         \
+unsigned char __mpmc_pop_##id(MPMCQueue_##id *this, t *out) {                            \
+    return __mpmc_pop_n_##id(this, out, 1) != 0;                                         \
+}                                                                                        \
+                                                                                         \
+
+#endif /* DS_RING_QUEUE_H */
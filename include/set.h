@@ -2,6 +2,7 @@
 #define DS_SET_H
 
 #include "avltree.h"
+#include "btree.h"
 
 #define __set_entry_get_key(e) (e)->data
 #define __set_data_get_key(d) d
@@ -107,6 +108,59 @@
         for (it = set_iterator_rbegin(id, this); it;                                     \
              it = setEntry_getPrev(id, it))
 
+
+/**
+ * Returns the first entry whose value is not less than @c value .
+ *
+ * @param   value  @c t : Value to search for.
+ *
+ * @return         @c SetEntry* : First entry whose value is at least
+ *                 @c value , or NULL if there is none.
+ */
+#define set_lower_bound(id, this, value) __avltree_lower_bound_##id(this, value)
+
+
+/**
+ * Returns the first entry whose value is greater than @c value .
+ *
+ * @param   value  @c t : Value to search for.
+ *
+ * @return         @c SetEntry* : First entry whose value is greater than
+ *                 @c value , or NULL if there is none.
+ */
+#define set_upper_bound(id, this, value) __avltree_upper_bound_##id(this, value)
+
+
+/**
+ * Sets @c first and @c last to the range [ @c first , @c last ) of entries
+ * whose value is equal to @c value ; the range is empty ( @c first equals
+ * @c last ) if there is no such entry.
+ *
+ * @param  value  @c t : Value to search for.
+ * @param  first  @c SetEntry* : Assigned to the lower bound of @c value .
+ * @param  last   @c SetEntry* : Assigned to the upper bound of @c value .
+ */
+#define set_equal_range(id, this, value, first, last) do {                               \
+    first = __avltree_lower_bound_##id(this, value);                                     \
+    last = __avltree_upper_bound_##id(this, value);                                      \
+} while(0)
+
+
+/**
+ * Iterates in-order through the entries whose value is in the range
+ * [ @c lo , @c hi ). Finding the first entry takes O(log n) time, and each
+ * step after it O(1) amortized time.
+ *
+ * @param  lo  @c t : Smallest value to visit.
+ * @param  hi  @c t : Value after the largest value to visit.
+ * @param  it  @c SetEntry* : Assigned to the current element. May be
+ *              dereferenced with @c it->data .
+ */
+#define set_iter_range(id, this, lo, hi, it)                                             \
+        for (it = __avltree_lower_bound_##id(this, lo);                                  \
+             it && __avlEntry_key_lt_##id(it, hi);                                       \
+             it = __avl_inorder_successor_##id(it))
+
 /* --------------------------------------------------------------------------
  * HELPERS
  * -------------------------------------------------------------------------- */
@@ -134,6 +188,19 @@
 #define set_new(id) __avltree_new_fromArray_##id(NULL, 0)
 
 
+/**
+ * Creates a new, empty set whose elements are allocated from slabs of @c chunk
+ * elements owned by the set. Removed elements are recycled, and clearing or
+ * freeing the set releases whole slabs at once.
+ *
+ * @param   chunk  @c unsigned : Number of elements per slab; 0 disables
+ *                  pooling.
+ *
+ * @return         @c Set* : Newly created set.
+ */
+#define set_new_withPool(id, chunk) __avltree_new_withPool_##id(chunk)
+
+
 /**
  * Creates a new set using @c n elements from a built-in array @c arr .
  *
@@ -145,6 +212,21 @@
 #define set_new_fromArray(id, arr, n) __avltree_new_fromArray_##id(arr, n)
 
 
+/**
+ * Creates a new set from @c n elements in a built-in array @c arr , which must
+ * be in increasing order without duplicates. The tree is built directly in
+ * O(n) time and all of its entries are allocated as a single slab; elements
+ * inserted later come from slabs of @c DS_AVL_BULK_CHUNK entries. If @c arr is
+ * not sorted, this falls back to @c set_new_fromArray .
+ *
+ * @param   arr  @c t* : Pointer to the first element to insert.
+ * @param   n    @c unsigned : Number of elements to include.
+ *
+ * @return       @c Set* : Newly created set, or NULL if allocation failed.
+ */
+#define set_new_fromSortedArray(id, arr, n) __avltree_new_fromSorted_##id(arr, n)
+
+
 /**
  * Creates a new set as a copy of @c other .
  *
@@ -158,7 +240,7 @@
 /**
  * Deletes all elements and frees the set.
  */
-#define set_free(id, this) do { set_clear(id, this); free(this); } while(0)
+#define set_free(id, this) __avltree_free_##id(this)
 
 
 /**
@@ -284,6 +366,45 @@
         __avltree_remove_entry_##id(this, entry)
 
 
+/**
+ * Returns the entry whose value is the @c k th smallest in the set. This takes
+ * O(log n) time if the set was generated with @c gen_set_headers_withRank , and
+ * O(k) time otherwise.
+ *
+ * @param   k  @c unsigned : Rank of the element, starting at 0 for the smallest.
+ *
+ * @return     @c SetEntry* : Entry at rank @c k , or NULL if @c k is not less
+ *             than the size of the set.
+ */
+#define set_at_rank(id, this, k) __avltree_at_rank_##id(this, k)
+
+
+/**
+ * Returns the number of elements in the set which are less than @c value ,
+ * which is the rank of @c value if it is in the set. This takes O(log n) time
+ * if the set was generated with @c gen_set_headers_withRank , and O(n) time
+ * otherwise.
+ *
+ * @param   value  @c t : Value to rank.
+ *
+ * @return         @c unsigned : Number of elements less than @c value .
+ */
+#define set_rank_of(id, this, value) __avltree_rank_of_##id(this, value)
+
+
+/**
+ * Returns the number of elements in the range [ @c lo , @c hi ). This takes
+ * O(log n) time if the set was generated with @c gen_set_headers_withRank .
+ *
+ * @param   lo  @c t : Smallest value to count.
+ * @param   hi  @c t : Value after the largest value to count.
+ *
+ * @return      @c unsigned : Number of elements at least @c lo and less than
+ *              @c hi , or 0 if @c hi is not greater than @c lo .
+ */
+#define set_count_range(id, this, lo, hi) __avltree_count_range_##id(this, lo, hi)
+
+
 /**
  * Returns a set with the union of this set and @c other (i.e. elements 
  * that are in this set, @c other , or both - all elements).
@@ -329,6 +450,25 @@
         set_symmetric_difference_##id(this, other)
 
 
+/**
+ * Moves every element of @c other into this set, leaving @c other empty. Unlike
+ * @c set_union , no elements are copied: the two trees are split and joined
+ * in place in O(m log(n / m + 1)) time, where @c m is the size of the smaller
+ * set. The sets being split at each step are disjoint, which also makes the
+ * algorithm suitable for splitting the work between threads. Sets with a pool
+ * (including those from @c set_new_fromSortedArray and their copies) and
+ * B+-tree sets cannot hand over their entries, so for them the missing
+ * elements are inserted one by one instead.
+ *
+ * @param   other  @c Set* : Set to take the elements from. Elements that are
+ *                  already in this set are deleted.
+ *
+ * @return         @c bool : Whether the operation succeeded. On failure, some
+ *                 elements may have been copied to this set already.
+ */
+#define set_merge(id, this, other) __avltree_merge_##id(this, other)
+
+
 /**
  * Tests whether this set is a subset of @c other (i.e. whether each element 
  * in this subset is in @c other ).
@@ -364,16 +504,7 @@
 #define set_isdisjoint(id, this, other) set_disjoint_##id(this, other)
 
 
-/**
- * Generates @c Set function declarations for the given value type.
- *
- * @param  id           ID to be used for the @c Set and @c SetEntry types (must be
- *                       unique).
- * @param  t            Type to be stored in the set.
- */
-#define gen_set_headers(id, t)                                                           \
-                                                                                         \
-__setup_avltree_headers(id, t, Set_##id, t, SetEntry_##id)                               \
+#define __setup_set_algebra_headers(id)                                                  \
                                                                                          \
 Set_##id *set_union_##id(Set_##id const *this, Set_##id const *other)                    \
   __attribute__((nonnull));                                                              \
@@ -389,156 +520,72 @@ unsigned char set_includes_##id(Set_##id const *this, Set_##id const *other)
 unsigned char set_disjoint_##id(Set_##id const *this, Set_##id const *other)             \
   __attribute__((nonnull));                                                              \
 
-
-/**
- * Generates @c Set function definitions for the given value type.
- *
- * @param  id           ID used in @c gen_set_headers .
- * @param  t            Type used in @c gen_set_headers .
- * @param  cmp_lt       Macro of the form @c (x,y) that returns whether @c x is
- *                       strictly less than @c y .
- * @param  copyValue    Macro of the form @c (x,y) which copies @c y into @c x
- *                       to store the element in the set.
- *                        - If no special copying is required, pass
- *                         @c DSDefault_shallowCopy .
- *                        - If the value is a string which should be
- *                         deep-copied, pass @c DSDefault_deepCopyStr .
- * @param  deleteValue  Macro of the form @c (x) which is a complement to
- *                       @c copyValue ; if memory was dynamically allocated in
- *                       @c copyValue , it should be freed here.
- *                        - If @c DSDefault_shallowCopy was used in
- *                         @c copyValue , pass @c DSDefault_shallowDelete here.
- *                        - If @c DSDefault_deepCopyStr was used in
- *                         @c copyValue , pass @c DSDefault_deepDelete here.
- */
-#define gen_set_source(id, t, cmp_lt, copyValue, deleteValue)                            \
+#define __setup_set_algebra_source(id, t, cmp_lt)                                        \
                                                                                          \
-__setup_avltree_source(id, t, Set_##id, t, SetEntry_##id, cmp_lt,                        \
-    __set_entry_get_key, __set_data_get_key, copyValue, deleteValue,                     \
-    __set_copy_value, __set_delete_value)                                                \
-                                                                                         \
-Set_##id *set_union_##id(Set_##id const *this, Set_##id const *other) {                  \
+static Set_##id *__set_combine_##id(Set_##id const *this, Set_##id const *other,         \
+                                    unsigned char keep) {                                \
+    /*                                                                                   \
+     * Merges both sets into a sorted buffer and builds the result from it in            \
+     * O(n). keep selects what to copy: 1 for elements only in this, 2 for               \
+     * elements only in other and 4 for elements in both.                                \
+     */                                                                                  \
     SetEntry_##id *first1, *first2;                                                      \
     Set_##id *d_new = set_new(id);                                                       \
-    first1 = __avl_successor_##id(this->root);                                           \
-    first2 = __avl_successor_##id(other->root);                                          \
+    size_t cap = (size_t) this->size + ((keep & 2) ? (size_t) other->size : 0);          \
+    unsigned n = 0;                                                                      \
+    t *buf;                                                                              \
     if (!d_new) return NULL;                                                             \
-    else if (!(first1 && first2)) {                                                      \
-        if (first1) {                                                                    \
-            set_insert_fromSet(id, d_new, first1, NULL);                                 \
-        } else if (first2) {                                                             \
-            set_insert_fromSet(id, d_new, first2, NULL);                                 \
-        }                                                                                \
-        return d_new;                                                                    \
+    else if (!cap) return d_new;                                                         \
+    else if (cap > UINT_MAX || !(buf = __ds_malloc(cap * sizeof(t)))) {                  \
+        set_free(id, d_new);                                                             \
+        return NULL;                                                                     \
     }                                                                                    \
                                                                                          \
+    first1 = __avl_successor_##id(this->root);                                           \
+    first2 = __avl_successor_##id(other->root);                                          \
     while (first1 && first2) {                                                           \
         if (cmp_lt(first1->data, first2->data)) {                                        \
-            set_insert(id, d_new, first1->data);                                         \
+            if (keep & 1) buf[n++] = first1->data;                                       \
             first1 = __avl_inorder_successor_##id(first1);                               \
         } else if (cmp_lt(first2->data, first1->data)) {                                 \
-            set_insert(id, d_new, first2->data);                                         \
+            if (keep & 2) buf[n++] = first2->data;                                       \
             first2 = __avl_inorder_successor_##id(first2);                               \
         } else {                                                                         \
-            set_insert(id, d_new, first1->data);                                         \
+            if (keep & 4) buf[n++] = first1->data;                                       \
             first1 = __avl_inorder_successor_##id(first1);                               \
             first2 = __avl_inorder_successor_##id(first2);                               \
         }                                                                                \
     }                                                                                    \
-    if (first1) {                                                                        \
-        set_insert_fromSet(id, d_new, first1, NULL);                                     \
-    } else if (first2) {                                                                 \
-        set_insert_fromSet(id, d_new, first2, NULL);                                     \
+    for (; first1 && (keep & 1); first1 = __avl_inorder_successor_##id(first1)) {        \
+        buf[n++] = first1->data;                                                         \
     }                                                                                    \
+    for (; first2 && (keep & 2); first2 = __avl_inorder_successor_##id(first2)) {        \
+        buf[n++] = first2->data;                                                         \
+    }                                                                                    \
+                                                                                         \
+    if (!__avltree_build_fromSorted_##id(d_new, buf, n)) {                               \
+        set_free(id, d_new);                                                             \
+        d_new = NULL;                                                                    \
+    }                                                                                    \
+    __ds_free(buf);                                                                      \
     return d_new;                                                                        \
 }                                                                                        \
                                                                                          \
-Set_##id *set_intersection_##id(Set_##id const *this, Set_##id const *other) {           \
-    SetEntry_##id *first1, *first2;                                                      \
-    Set_##id *d_new = set_new(id);                                                       \
-    first1 = __avl_successor_##id(this->root);                                           \
-    first2 = __avl_successor_##id(other->root);                                          \
-    if (!d_new) return NULL;                                                             \
-    else if (!(first1 && first2)) return d_new;                                          \
+Set_##id *set_union_##id(Set_##id const *this, Set_##id const *other) {                  \
+    return __set_combine_##id(this, other, 7);                                           \
+}                                                                                        \
                                                                                          \
-    while (first1 && first2) {                                                           \
-        if (cmp_lt(first1->data, first2->data)) {                                        \
-            first1 = __avl_inorder_successor_##id(first1);                               \
-        } else if (cmp_lt(first2->data, first1->data)) {                                 \
-            first2 = __avl_inorder_successor_##id(first2);                               \
-        } else {                                                                         \
-            set_insert(id, d_new, first1->data);                                         \
-            first1 = __avl_inorder_successor_##id(first1);                               \
-            first2 = __avl_inorder_successor_##id(first2);                               \
-        }                                                                                \
-    }                                                                                    \
-    return d_new;                                                                        \
+Set_##id *set_intersection_##id(Set_##id const *this, Set_##id const *other) {           \
+    return __set_combine_##id(this, other, 4);                                           \
 }                                                                                        \
                                                                                          \
 Set_##id *set_difference_##id(Set_##id const *this, Set_##id const *other) {             \
-    SetEntry_##id *first1, *first2;                                                      \
-    Set_##id *d_new = set_new(id);                                                       \
-    first1 = __avl_successor_##id(this->root);                                           \
-    first2 = __avl_successor_##id(other->root);                                          \
-    if (!d_new) return NULL;                                                             \
-    else if (!(first1 && first2)) {                                                      \
-        if (first1) {                                                                    \
-            set_insert_fromSet(id, d_new, first1, NULL);                                 \
-        }                                                                                \
-        return d_new;                                                                    \
-    }                                                                                    \
-                                                                                         \
-    while (first1 && first2) {                                                           \
-        if (cmp_lt(first1->data, first2->data)) {                                        \
-            set_insert(id, d_new, first1->data);                                         \
-            first1 = __avl_inorder_successor_##id(first1);                               \
-        } else if (cmp_lt(first2->data, first1->data)) {                                 \
-            first2 = __avl_inorder_successor_##id(first2);                               \
-        } else {                                                                         \
-            first1 = __avl_inorder_successor_##id(first1);                               \
-            first2 = __avl_inorder_successor_##id(first2);                               \
-        }                                                                                \
-    }                                                                                    \
-    if (first1) {                                                                        \
-        set_insert_fromSet(id, d_new, first1, NULL);                                     \
-    }                                                                                    \
-    return d_new;                                                                        \
+    return __set_combine_##id(this, other, 1);                                           \
 }                                                                                        \
                                                                                          \
 Set_##id *set_symmetric_difference_##id(Set_##id const *this,                            \
                                         Set_##id const *other) {                         \
-    SetEntry_##id *first1, *first2;                                                      \
-    Set_##id *d_new = set_new(id);                                                       \
-    first1 = __avl_successor_##id(this->root);                                           \
-    first2 = __avl_successor_##id(other->root);                                          \
-    if (!d_new) return NULL;                                                             \
-    else if (!(first1 && first2)) {                                                      \
-        if (first1) {                                                                    \
-            set_insert_fromSet(id, d_new, first1, NULL);                                 \
-        } else if (first2) {                                                             \
-            set_insert_fromSet(id, d_new, first2, NULL);                                 \
-        }                                                                                \
-        return d_new;                                                                    \
-    }                                                                                    \
-                                                                                         \
-    while (first1 && first2) {                                                           \
-        if (cmp_lt(first1->data, first2->data)) {                                        \
-            set_insert(id, d_new, first1->data);                                         \
-            first1 = __avl_inorder_successor_##id(first1);                               \
-        } else if (cmp_lt(first2->data, first1->data)) {                                 \
-            set_insert(id, d_new, first2->data);                                         \
-            first2 = __avl_inorder_successor_##id(first2);                               \
-        } else {                                                                         \
-            first1 = __avl_inorder_successor_##id(first1);                               \
-            first2 = __avl_inorder_successor_##id(first2);                               \
-        }                                                                                \
-    }                                                                                    \
-    if (first1) {                                                                        \
-        set_insert_fromSet(id, d_new, first1, NULL);                                     \
-    } else if (first2) {                                                                 \
-        set_insert_fromSet(id, d_new, first2, NULL);                                     \
-    }                                                                                    \
-    return d_new;                                                                        \
+    return __set_combine_##id(this, other, 3);                                           \
 }                                                                                        \
                                                                                          \
 unsigned char set_includes_##id(Set_##id const *this, Set_##id const *other) {           \
@@ -576,4 +623,95 @@ unsigned char set_disjoint_##id(Set_##id const *this, Set_##id const *other) {
     return 1;                                                                            \
 }                                                                                        \
 
+
+/**
+ * Generates @c Set function declarations for the given value type.
+ *
+ * @param  id           ID to be used for the @c Set and @c SetEntry types (must be
+ *                       unique).
+ * @param  t            Type to be stored in the set.
+ */
+#define gen_set_headers(id, t) __set_headers(id, t, __avl_counts_none)
+
+
+/**
+ * Generates @c Set function declarations like @c gen_set_headers , but each
+ * entry also stores the size of its subtree. @c set_at_rank , @c set_rank_of ,
+ * @c set_count_range , @c setEntry_advance and @c setEntry_distance then take
+ * O(log n) time, at the cost of an @c unsigned per entry and keeping the sizes
+ * up to date on insertion and removal. Use @c gen_set_source with it.
+ *
+ * @param  id           ID to be used for the @c Set and @c SetEntry types (must be
+ *                       unique).
+ * @param  t            Type to be stored in the set.
+ */
+#define gen_set_headers_withRank(id, t) __set_headers(id, t, __avl_counts_stored)
+
+#define __set_headers(id, t, countMode)                                                  \
+                                                                                         \
+__setup_avltree_headers(id, t, Set_##id, t, SetEntry_##id, countMode)                    \
+                                                                                         \
+__setup_set_algebra_headers(id)                                                          \
+
+
+
+/**
+ * Generates @c Set function definitions for the given value type.
+ *
+ * @param  id           ID used in @c gen_set_headers .
+ * @param  t            Type used in @c gen_set_headers .
+ * @param  cmp_lt       Macro of the form @c (x,y) that returns whether @c x is
+ *                       strictly less than @c y .
+ * @param  copyValue    Macro of the form @c (x,y) which copies @c y into @c x
+ *                       to store the element in the set.
+ *                        - If no special copying is required, pass
+ *                         @c DSDefault_shallowCopy .
+ *                        - If the value is a string which should be
+ *                         deep-copied, pass @c DSDefault_deepCopyStr .
+ * @param  deleteValue  Macro of the form @c (x) which is a complement to
+ *                       @c copyValue ; if memory was dynamically allocated in
+ *                       @c copyValue , it should be freed here.
+ *                        - If @c DSDefault_shallowCopy was used in
+ *                         @c copyValue , pass @c DSDefault_shallowDelete here.
+ *                        - If @c DSDefault_deepCopyStr was used in
+ *                         @c copyValue , pass @c DSDefault_deepDelete here.
+ */
+#define gen_set_source(id, t, cmp_lt, copyValue, deleteValue)                            \
+                                                                                         \
+__setup_avltree_source(id, t, Set_##id, t, SetEntry_##id, cmp_lt,                        \
+    __set_entry_get_key, __set_data_get_key, copyValue, deleteValue,                     \
+    __set_copy_value, __set_delete_value)                                                \
+                                                                                         \
+__setup_set_algebra_source(id, t, cmp_lt)                                                \
+
+
+/**
+ * Same as @c gen_set_headers , but the set is a B+-tree (see @c btree.h ).
+ * Every @c set_* macro works on it, with one difference: an insertion or
+ * removal may move other elements in memory, so entries obtained before it
+ * (other than the one it returns) must be looked up again.
+ *
+ * @param  id           ID to be used for the @c Set and @c SetEntry types (must be
+ *                       unique).
+ * @param  t            Type to be stored in the set.
+ */
+#define gen_set_headers_btree(id, t)                                                     \
+                                                                                         \
+__setup_btree_headers(id, t, Set_##id, t, SetEntry_##id)                                 \
+                                                                                         \
+__setup_set_algebra_headers(id)                                                          \
+
+
+/**
+ * Generates the @c Set function definitions for @c gen_set_headers_btree . The
+ * arguments are the same as for @c gen_set_source .
+ */
+#define gen_set_source_btree(id, t, cmp_lt, copyValue, deleteValue)                      \
+                                                                                         \
+__setup_btree_source(id, t, Set_##id, t, SetEntry_##id, cmp_lt,                          \
+    __set_entry_get_key, __set_data_get_key, copyValue, deleteValue,                     \
+    __set_copy_value, __set_delete_value)                                                \
+                                                                                         \
+__setup_set_algebra_source(id, t, cmp_lt)                                                \
+
 #endif /* DS_SET_H */
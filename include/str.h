@@ -6,12 +6,52 @@
 #include <ctype.h>
 #endif /* __CDS_SCAN */
 
+/*
+ * Strings whose capacity fits in DS_STR_INLINE_CAP bytes (including the nul
+ * terminator) are stored in the String itself, so creating a short string only
+ * takes one allocation. This also sets the capacity of a new string. It must be
+ * the same for src/str.c and every file using it.
+ */
+#ifndef DS_STR_INLINE_CAP
+#define DS_STR_INLINE_CAP 64
+#endif
+
+/* Bump allocator for temporary strings; see string_new_inArena. */
+typedef struct StringArena StringArena;
+
 typedef struct {
     unsigned size;
     unsigned cap;
     char *s;
+    StringArena *arena;
+    char buf[DS_STR_INLINE_CAP];
 } String;
 
+/* Non-owning reference to @c len characters starting at @c s (not terminated). */
+typedef struct {
+    char const *s;
+    unsigned len;
+} StringView;
+
+/*
+ * Needle preprocessed for Boyer-Moore-Horspool search; see
+ * string_searcher_init.
+ */
+typedef struct {
+    char const *needle;
+    unsigned len;
+    unsigned shift[256];
+} StringSearcher;
+
+/* State for walking the tokens of a string; see string_tokenizer_init. */
+typedef struct {
+    char const *pos;
+    char const *end;
+    char const *delim;
+    unsigned delimLen;
+    unsigned char done;
+} StringTokenizer;
+
 #if UINT_MAX == 0xffffffff
 #define DS_STR_MAX_SIZE 0xfffffffd
 #define DS_STR_SHIFT_THRESHOLD 0x7ffffffe
@@ -329,6 +369,41 @@ String *string_new_fromCStr(char const *s, unsigned n);
 #define string_new() string_new_fromCStr(NULL, 0)
 
 
+/**
+ * Creates an arena from which strings can be allocated with
+ * @c string_new_inArena . Memory is handed out from blocks of @c blockSize
+ * bytes and is only given back when the arena is freed.
+ *
+ * @param   blockSize  Size of each block; 0 uses a default of 4096 bytes.
+ *
+ * @return             Newly created arena.
+ */
+StringArena *string_arena_new(unsigned blockSize);
+
+
+/**
+ * Frees the arena along with every string allocated from it.
+ */
+void string_arena_free(StringArena *arena) __attribute__((nonnull));
+
+
+/**
+ * Creates a new string from @c s whose struct and character buffer are both
+ * bump-allocated from @c arena . Calling @c string_free on it does nothing;
+ * it is released by @c string_arena_free .
+ *
+ * @param   arena  Arena to allocate from.
+ * @param   s      C-string.
+ * @param   n      Number of characters from @c s to include. If this is
+ *                  @c DS_ARG_NOT_APPLICABLE , all characters from @c s will
+ *                  be used.
+ *
+ * @return         Newly created string.
+ */
+String *string_new_inArena(StringArena *arena, char const *s, unsigned n)
+  __attribute__((nonnull (1)));
+
+
 /**
  * Creates a new string as a copy of @c other .
  * 
@@ -412,9 +487,10 @@ void string_erase(String *this, unsigned start, unsigned n)
 
 
 /**
- * Frees memory allocated to the string.
+ * Frees memory allocated to the string. Strings from an arena are left to be
+ * released with the arena.
  */
-#define string_free(this) do { free((this)->s); free(this); } while(0)
+void string_free(String *this) __attribute__((nonnull));
 
 
 /**
@@ -555,6 +631,39 @@ unsigned string_rfind(String const *this, unsigned end_pos,
   __attribute__((nonnull));
 
 
+/**
+ * Prepares @c searcher to look for the first @c len characters of @c needle ,
+ * so the same needle can be searched for in many strings with
+ * @c string_find_with without redoing any work. @c needle is not copied and
+ * must outlive @c searcher .
+ *
+ * @param  searcher  Searcher to initialize.
+ * @param  needle    Substring to find.
+ * @param  len       Number of characters to match from needle. If this is
+ *                    @c DS_ARG_NOT_APPLICABLE , all characters from
+ *                    @c needle will be used.
+ */
+void string_searcher_init(StringSearcher *searcher, char const *needle,
+                          unsigned len)
+  __attribute__((nonnull));
+
+
+/**
+ * Finds the first occurrence of the needle in @c searcher in this string
+ * starting at @c start_pos . Does not allocate.
+ *
+ * @param   searcher   Searcher built with @c string_searcher_init .
+ * @param   start_pos  First index in the string to consider for the search.
+ *
+ * @return             The index in this string where the needle was found,
+ *                     @c STRING_NPOS if it was not found, or
+ *                     @c STRING_ERROR if @c start_pos is out of bounds.
+ */
+unsigned string_find_with(StringSearcher const *searcher,
+                          String const *this, unsigned start_pos)
+  __attribute__((nonnull));
+
+
 /**
  * Creates a substring from this string with @c n characters, starting at 
  * @c start and moving to the next character to include with a step size of 
@@ -595,11 +704,61 @@ String **string_split(String const *this, char const *delim)
  *
  * @param  arr  @c String** : Array allocated by @c string_split .
  */
-#define string_split_free(arr) {                                                         \
-    String **_sPtr;                                                                      \
-    for (_sPtr = arr; *_sPtr; ++_sPtr) string_free(*_sPtr);                              \
-    free(arr);                                                                           \
-}
+void string_split_free(String **arr) __attribute__((nonnull));
+
+
+/**
+ * Splits this string on @c delim without copying: each token is stored in
+ * @c views as a pointer into this string's buffer, so the views are only valid
+ * until the string is modified or freed.
+ *
+ * @param   delim  The delimiter to use to split the string.
+ * @param   views  Array receiving the tokens.
+ * @param   n      Capacity of @c views . Tokens past the first @c n are
+ *                  counted but not stored.
+ *
+ * @return         The total number of tokens, which may exceed @c n , or 0 if
+ *                 this string or @c delim is empty.
+ */
+unsigned string_split_views(String const *this, char const *delim,
+                            StringView *views, unsigned n)
+  __attribute__((nonnull (1, 2)));
+
+
+/**
+ * Prepares @c it to yield the tokens of this string separated by @c delim ,
+ * one at a time, via @c string_tokenizer_next . Nothing is allocated; the
+ * string and @c delim must stay unchanged while tokenizing.
+ *
+ * @param  it     Tokenizer to initialize.
+ * @param  delim  The delimiter to use to split the string.
+ */
+void string_tokenizer_init(StringTokenizer *it, String const *this,
+                           char const *delim)
+  __attribute__((nonnull));
+
+
+/**
+ * Retrieves the next token from @c it .
+ *
+ * @param   token  Assigned a view of the next token.
+ *
+ * @return         Whether there was another token.
+ */
+unsigned char string_tokenizer_next(StringTokenizer *it, StringView *token)
+  __attribute__((nonnull));
+
+
+/**
+ * Iterates through each token of this string separated by @c delim .
+ *
+ * @param  it     @c StringTokenizer* : Tokenizer to use.
+ * @param  delim  @c char* : The delimiter to use to split the string.
+ * @param  token  @c StringView : Assigned the current token.
+ */
+#define string_iter_tokens(this, it, delim, token)                                       \
+        for (string_tokenizer_init(it, this, delim);                                     \
+             string_tokenizer_next(it, &(token));)
 
 
 /**
@@ -2,6 +2,7 @@
 #define DS_UNORDERED_MAP_H
 
 #include "hash_table.h"
+#include "flat_hash_table.h"
 
 #define __umap_entry_get_key(e) (e)->data.first
 #define __umap_data_get_key(d)  (d).first
@@ -58,6 +59,20 @@
 #define umap_new(id) __htable_new_fromArray_##id(NULL, 0)
 
 
+/**
+ * Creates a new, empty map whose entries are allocated from slabs of @c chunk
+ * entries owned by the map. Removed entries are recycled, and clearing or
+ * freeing the map releases whole slabs at once. UMaps generated with the flat
+ * backend store entries inline and ignore @c chunk .
+ *
+ * @param   chunk  @c unsigned : Number of entries per slab; 0 disables
+ *                  pooling.
+ *
+ * @return         @c UMap* : Newly created map.
+ */
+#define umap_new_withPool(id, chunk) __htable_new_withPool_##id(chunk)
+
+
 /**
  * Creates a new map using @c n key-value pairs in a built-in array @c arr .
  *
@@ -82,9 +97,7 @@
 /**
  * Deletes all elements and frees the map.
  */
-#define umap_free(id, this) do {                                                         \
-    __htable_clear_##id(this); free((this)->buckets); free(this);                        \
-} while(0)
+#define umap_free(id, this) __htable_free_##id(this)
 
 
 /**
@@ -181,6 +194,20 @@
         __htable_set_load_factor_##id(this, lf)
 
 
+/**
+ * Turns incremental rehashing on or off. When it is on, growing the map only
+ * allocates the new bucket array; entries are moved over a few buckets at a
+ * time by later insertions and removals instead of all at once, which bounds
+ * the worst-case latency of a single insertion. Turning it off completes any
+ * rehash in progress. Only the chained backend rehashes incrementally; for
+ * the flat backend this does nothing.
+ *
+ * @param  enable  @c bool : Whether to rehash incrementally.
+ */
+#define umap_set_incremental_rehash(id, this, enable)                                    \
+        __htable_set_incremental_##id(this, enable)
+
+
 /**
  * Removes all entries from the map.
  */
@@ -196,14 +223,32 @@
  * @param  kt  Key type.
  * @param  vt  Value type.
  */
-#define gen_umap_headers(id, kt, vt)                                                     \
+#define gen_umap_headers(id, kt, vt) __umap_headers(id, kt, vt, __htable_hash_none)
+
+
+/**
+ * Generates @c UMap function declarations like @c gen_umap_headers , but each
+ * entry also stores the full hash of its key. Growing the map then never
+ * hashes a key again, and lookups only call @c cmp_eq on entries whose hash
+ * matches, which pays off for keys that are expensive to hash or compare
+ * (e.g. strings). Use any of the @c gen_umap_source generators with it.
+ *
+ * @param  id  ID to be used for the @c UMap and @c Pair types (must be
+ *              unique).
+ * @param  kt  Key type.
+ * @param  vt  Value type.
+ */
+#define gen_umap_headers_storeHash(id, kt, vt)                                           \
+        __umap_headers(id, kt, vt, __htable_hash_stored)
+
+#define __umap_headers(id, kt, vt, hashMode)                                             \
                                                                                          \
 typedef struct {                                                                         \
     kt first;                                                                            \
     vt second;                                                                           \
 } Pair_##id;                                                                             \
                                                                                          \
-__setup_hash_table_headers(id, kt, UMap_##id, Pair_##id, UMapEntry_##id)                 \
+__setup_hash_table_headers(id, kt, UMap_##id, Pair_##id, UMapEntry_##id, hashMode)       \
                                                                                          \
 vt* umap_at_##id(UMap_##id const *this, kt const key) __attribute__((nonnull));          \
 
@@ -257,8 +302,83 @@ vt* umap_at_##id(UMap_##id const *this, kt const key) __attribute__((nonnull));
 #define gen_umap_source(id, kt, vt, cmp_eq, addrOfKey, sizeOfKey,                        \
                         copyKey, deleteKey, copyValue, deleteValue)                      \
                                                                                          \
+__ds_gen_murmur_hash(__umap_hash_##id, kt, addrOfKey, sizeOfKey)                         \
+                                                                                         \
+gen_umap_source_withHash(id, kt, vt, cmp_eq, __umap_hash_##id, copyKey, deleteKey,       \
+                         copyValue, deleteValue)                                         \
+
+
+/**
+ * Generates @c UMap function definitions like @c gen_umap_source , but hashes
+ * keys with @c hashKey instead of running @c murmurhash over their bytes.
+ *
+ * @param  hashKey  Macro or function of the form @c (x,seed) that returns an
+ *                   @c unsigned hash of the key @c x . Buckets are picked with
+ *                   the low bits of the hash, so they must be well mixed.
+ *                    - For integer keys, pass @c DSDefault_hashInt .
+ *
+ * The other parameters are the same as for @c gen_umap_source .
+ */
+#define gen_umap_source_withHash(id, kt, vt, cmp_eq, hashKey,                            \
+                                 copyKey, deleteKey, copyValue, deleteValue)             \
+                                                                                         \
 __setup_hash_table_source(id, kt, cmp_eq, UMap_##id, Pair_##id, UMapEntry_##id,          \
-    __umap_entry_get_key, __umap_data_get_key, addrOfKey, sizeOfKey, copyKey,            \
+    __umap_entry_get_key, __umap_data_get_key, hashKey, copyKey,                         \
+    deleteKey, copyValue, deleteValue)                                                   \
+                                                                                         \
+vt* umap_at_##id(UMap_##id const *this, kt const key) {                                  \
+    Pair_##id *p = __htable_find_##id(this, key);                                        \
+    return p ? &(p->second) : NULL;                                                      \
+}                                                                                        \
+
+
+/**
+ * Generates @c UMap code declarations for the given key type and value type,
+ * using the open-addressing table in @c flat_hash_table.h instead of separate
+ * chaining. Entries live inline in one allocation, so lookups touch fewer cache
+ * lines and no per-entry allocations are made. The same @c umap_* macros are
+ * used with either backend.
+ *
+ * @param  id  ID to be used for the @c UMap and @c Pair types (must be unique).
+ * @param  kt  Key type.
+ * @param  vt  Value type.
+ */
+#define gen_umap_headers_flat(id, kt, vt)                                                \
+                                                                                         \
+typedef struct {                                                                         \
+    kt first;                                                                            \
+    vt second;                                                                           \
+} Pair_##id;                                                                             \
+                                                                                         \
+__setup_flat_hash_table_headers(id, kt, UMap_##id, Pair_##id, UMapEntry_##id)            \
+                                                                                         \
+vt* umap_at_##id(UMap_##id const *this, kt const key) __attribute__((nonnull));          \
+
+
+/**
+ * Generates @c UMap function definitions for a map declared with
+ * @c gen_umap_headers_flat . The parameters are the same as for
+ * @c gen_umap_source .
+ */
+#define gen_umap_source_flat(id, kt, vt, cmp_eq, addrOfKey, sizeOfKey,                   \
+                             copyKey, deleteKey, copyValue, deleteValue)                 \
+                                                                                         \
+__ds_gen_murmur_hash(__umap_hash_##id, kt, addrOfKey, sizeOfKey)                         \
+                                                                                         \
+gen_umap_source_flat_withHash(id, kt, vt, cmp_eq, __umap_hash_##id, copyKey, deleteKey,  \
+                              copyValue, deleteValue)                                    \
+
+
+/**
+ * Generates @c UMap function definitions for a map declared with
+ * @c gen_umap_headers_flat , hashing keys with @c hashKey . The parameters are
+ * the same as for @c gen_umap_source_withHash .
+ */
+#define gen_umap_source_flat_withHash(id, kt, vt, cmp_eq, hashKey,                       \
+                                      copyKey, deleteKey, copyValue, deleteValue)        \
+                                                                                         \
+__setup_flat_hash_table_source(id, kt, cmp_eq, UMap_##id, Pair_##id, UMapEntry_##id,     \
+    __umap_entry_get_key, __umap_data_get_key, hashKey, copyKey,                         \
     deleteKey, copyValue, deleteValue)                                                   \
                                                                                          \
 vt* umap_at_##id(UMap_##id const *this, kt const key) {                                  \
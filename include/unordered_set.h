@@ -2,6 +2,7 @@
 #define DS_UNORDERED_SET_H
 
 #include "hash_table.h"
+#include "flat_hash_table.h"
 
 #define __uset_entry_get_key(e) (e)->data
 #define __uset_data_get_key(d)  d
@@ -60,6 +61,20 @@
 #define uset_new(id) __htable_new_fromArray_##id(NULL, 0)
 
 
+/**
+ * Creates a new, empty set whose elements are allocated from slabs of @c chunk
+ * elements owned by the set. Removed elements are recycled, and clearing or
+ * freeing the set releases whole slabs at once. USets generated with the flat
+ * backend store elements inline and ignore @c chunk .
+ *
+ * @param   chunk  @c unsigned : Number of elements per slab; 0 disables
+ *                  pooling.
+ *
+ * @return         @c USet* : Newly created set.
+ */
+#define uset_new_withPool(id, chunk) __htable_new_withPool_##id(chunk)
+
+
 /**
  * Creates a new set using @c n elements in a built-in array @c arr .
  *
@@ -84,9 +99,7 @@
 /**
  * Deletes all elements and frees the set.
  */
-#define uset_free(id, this) do {                                                         \
-    __htable_clear_##id(this); free((this)->buckets); free(this);                        \
-} while(0)
+#define uset_free(id, this) __htable_free_##id(this)
 
 
 /**
@@ -166,6 +179,20 @@
         __htable_set_load_factor_##id(this, lf) 
 
 
+/**
+ * Turns incremental rehashing on or off. When it is on, growing the set only
+ * allocates the new bucket array; entries are moved over a few buckets at a
+ * time by later insertions and removals instead of all at once, which bounds
+ * the worst-case latency of a single insertion. Turning it off completes any
+ * rehash in progress. Only the chained backend rehashes incrementally; for
+ * the flat backend this does nothing.
+ *
+ * @param  enable  @c bool : Whether to rehash incrementally.
+ */
+#define uset_set_incremental_rehash(id, this, enable)                                    \
+        __htable_set_incremental_##id(this, enable)
+
+
 /**
  * Removes all entries from the set.
  */
@@ -179,7 +206,22 @@
  * @param  t   Type to be stored in the set.
  */
 #define gen_uset_headers(id, t)                                                          \
-        __setup_hash_table_headers(id, t, USet_##id, t, USetEntry_##id)
+        __setup_hash_table_headers(id, t, USet_##id, t, USetEntry_##id,                  \
+                                   __htable_hash_none)
+
+
+/**
+ * Generates @c USet function declarations like @c gen_uset_headers , but each
+ * entry also stores the full hash of its value, so growing the set never
+ * hashes a value again and lookups only call @c cmp_eq on entries whose hash
+ * matches. Use any of the @c gen_uset_source generators with it.
+ *
+ * @param  id  ID to be used for the @c USet type (must be unique).
+ * @param  t   Type to be stored in the set.
+ */
+#define gen_uset_headers_storeHash(id, t)                                                \
+        __setup_hash_table_headers(id, t, USet_##id, t, USetEntry_##id,                  \
+                                   __htable_hash_stored)
 
 
 /**
@@ -217,9 +259,62 @@
  */
 #define gen_uset_source(id, t, cmp_eq, addrOfValue, sizeOfValue,                         \
                         copyValue, deleteValue)                                          \
+        __ds_gen_murmur_hash(__uset_hash_##id, t, addrOfValue, sizeOfValue)              \
+        gen_uset_source_withHash(id, t, cmp_eq, __uset_hash_##id,                        \
+                                 copyValue, deleteValue)
+
+
+/**
+ * Generates @c USet function definitions like @c gen_uset_source , but hashes
+ * elements with @c hashValue instead of running @c murmurhash over their
+ * bytes.
+ *
+ * @param  hashValue  Macro or function of the form @c (x,seed) that returns an
+ *                     @c unsigned hash of @c x . Buckets are picked with the
+ *                     low bits of the hash, so they must be well mixed.
+ *                      - For integers, pass @c DSDefault_hashInt .
+ *
+ * The other parameters are the same as for @c gen_uset_source .
+ */
+#define gen_uset_source_withHash(id, t, cmp_eq, hashValue, copyValue, deleteValue)       \
         __setup_hash_table_source(id, t, cmp_eq, USet_##id, t, USetEntry_##id,           \
-            __uset_entry_get_key, __uset_data_get_key, addrOfValue,                      \
-            sizeOfValue, copyValue, deleteValue, __uset_copy_value,                      \
-            __uset_delete_value)
+            __uset_entry_get_key, __uset_data_get_key, hashValue,                        \
+            copyValue, deleteValue, __uset_copy_value, __uset_delete_value)
+
+
+/**
+ * Generates @c USet code declarations for the given value type, using the
+ * open-addressing table in @c flat_hash_table.h instead of separate chaining.
+ * The same @c uset_* macros are used with either backend.
+ *
+ * @param  id  ID to be used for the @c USet type (must be unique).
+ * @param  t   Type to be stored in the set.
+ */
+#define gen_uset_headers_flat(id, t)                                                     \
+        __setup_flat_hash_table_headers(id, t, USet_##id, t, USetEntry_##id)
+
+
+/**
+ * Generates @c USet function definitions for a set declared with
+ * @c gen_uset_headers_flat . The parameters are the same as for
+ * @c gen_uset_source .
+ */
+#define gen_uset_source_flat(id, t, cmp_eq, addrOfValue, sizeOfValue,                    \
+                             copyValue, deleteValue)                                     \
+        __ds_gen_murmur_hash(__uset_hash_##id, t, addrOfValue, sizeOfValue)              \
+        gen_uset_source_flat_withHash(id, t, cmp_eq, __uset_hash_##id,                   \
+                                      copyValue, deleteValue)
+
+
+/**
+ * Generates @c USet function definitions for a set declared with
+ * @c gen_uset_headers_flat , hashing elements with @c hashValue . The
+ * parameters are the same as for @c gen_uset_source_withHash .
+ */
+#define gen_uset_source_flat_withHash(id, t, cmp_eq, hashValue,                          \
+                                      copyValue, deleteValue)                            \
+        __setup_flat_hash_table_source(id, t, cmp_eq, USet_##id, t, USetEntry_##id,      \
+            __uset_entry_get_key, __uset_data_get_key, hashValue,                        \
+            copyValue, deleteValue, __uset_copy_value, __uset_delete_value)
 
 #endif /* DS_UNORDERED_SET_H */
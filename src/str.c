@@ -6,9 +6,66 @@
 #define __DSSTR_MAX_RESERVE 0xfffc
 #endif
 
+#define str_is_inline(this) ((this)->s == (this)->buf)
+
+/*
+ * Substring and character-class searches use SSE2 where the compiler targets
+ * it; on top of that, an AVX2 substring kernel is chosen at runtime when the
+ * CPU supports it. Other targets use the portable scalar code.
+ */
+#if defined(__SSE2__) && !defined(__CDS_SCAN)
+#include <emmintrin.h>
+#define STR_VEC_SSE2
+#if (defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__)
+#include <immintrin.h>
+#define STR_VEC_AVX2
+#endif
+#endif /* __SSE2__ */
+
+/* 256-bit membership set indexed by unsigned char value. */
+#define str_charset_has(set, c)                                                \
+        ((set)[(unsigned char) (c) >> 3] & (1u << ((unsigned char) (c) & 7)))
+
+typedef union StrArenaBlock {
+    union StrArenaBlock *prev;
+    double d;
+    long l;
+} StrArenaBlock;
+
+struct StringArena {
+    StrArenaBlock *blocks; /* every block, most recent first */
+    char *next;
+    size_t avail;
+    size_t blockSize;
+};
+
+static void *str_arena_alloc(StringArena *arena, size_t n) {
+    const size_t align = sizeof(StrArenaBlock);
+    StrArenaBlock *b;
+    void *p;
+    n = (n + align - 1) / align * align;
+    if (n <= arena->avail) {
+        p = arena->next;
+        arena->next += n;
+        arena->avail -= n;
+        return p;
+    }
+
+    b = __ds_malloc(sizeof(StrArenaBlock) + max(n, arena->blockSize));
+    if (!b) return NULL;
+    b->prev = arena->blocks;
+    arena->blocks = b;
+    p = b + 1;
+    if (n < arena->blockSize) { /* oversized requests keep the current block */
+        arena->next = (char *) p + n;
+        arena->avail = arena->blockSize - n;
+    }
+    return p;
+}
+
 static unsigned *str_gen_prefix_table(char const *needle, unsigned len) {
     unsigned i = 1, j = 0;
-    unsigned *table = malloc(sizeof(unsigned) * len);
+    unsigned *table = __ds_malloc(sizeof(unsigned) * len);
     if (!table) return NULL;
     table[0] = 0;
 
@@ -24,6 +81,207 @@ static unsigned *str_gen_prefix_table(char const *needle, unsigned len) {
     return table;
 }
 
+static char const *str_find_delim(char const *pos, char const *end,
+                                  char const *delim, unsigned len) {
+    const char first = delim[0];
+    for (; (size_t) (end - pos) >= len; ++pos) {
+        if (!(pos = memchr(pos, first, (size_t) (end - pos) - len + 1))) break;
+        if (!memcmp(pos + 1, delim + 1, len - 1)) return pos;
+    }
+    return NULL;
+}
+
+static void str_build_charset(unsigned char *set, char const *chars,
+                              char const *end) {
+    memset(set, 0, 32);
+    for (; chars != end; ++chars) {
+        set[(unsigned char) *chars >> 3] |=
+          (unsigned char) (1u << ((unsigned char) *chars & 7));
+    }
+}
+
+/*
+ * Returns the index of the first character in h[0, n) that is (or, with
+ * negate set, is not) in the set, or n if there is none.
+ */
+static size_t str_span_charset(char const *h, size_t n, char const *chars,
+                               char const *end, unsigned char negate) {
+    unsigned char set[32];
+    size_t i = 0;
+#ifdef STR_VEC_SSE2
+    const size_t nChars = (size_t) (end - chars);
+    if (nChars <= 16) { /* compare 16 bytes against each set member at once */
+        __m128i members[16];
+        unsigned k;
+        for (k = 0; k < nChars; ++k) members[k] = _mm_set1_epi8(chars[k]);
+        for (; i + 16 <= n; i += 16) {
+            const __m128i block = _mm_loadu_si128((__m128i const *) (h + i));
+            __m128i hits = _mm_setzero_si128();
+            unsigned mask;
+            for (k = 0; k < nChars; ++k) {
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, members[k]));
+            }
+            mask = (unsigned) _mm_movemask_epi8(hits);
+            if (negate) mask ^= 0xffff;
+            if (mask) return i + (unsigned) __builtin_ctz(mask);
+        }
+    }
+#endif
+    str_build_charset(set, chars, end);
+    for (; i < n; ++i) {
+        if (!str_charset_has(set, h[i]) == !!negate) return i;
+    }
+    return n;
+}
+
+/*
+ * Returns the index of the last character in h[0, n) that is (or, with negate
+ * set, is not) in the set, or (size_t) -1 if there is none.
+ */
+static size_t str_rspan_charset(char const *h, size_t n, char const *chars,
+                                char const *end, unsigned char negate) {
+    unsigned char set[32];
+    str_build_charset(set, chars, end);
+    while (n--) {
+        if (!str_charset_has(set, h[n]) == !!negate) return n;
+    }
+    return (size_t) -1;
+}
+
+/*
+ * Scalar search for the last match of needle (len >= 2) starting in h[0, m);
+ * the haystack extends at least len - 1 bytes past that range.
+ */
+static char const *str_rfind_scalar(char const *h, size_t m,
+                                    char const *needle, size_t len) {
+    while (m--) {
+        if (h[m] == needle[0] && !memcmp(h + m + 1, needle + 1, len - 1)) {
+            return h + m;
+        }
+    }
+    return NULL;
+}
+
+#ifdef STR_VEC_SSE2
+/*
+ * Substring kernels: a block of candidate positions is filtered by comparing
+ * it against the first and the last character of the needle, and only the
+ * positions where both match are checked with memcmp. Needles have at least
+ * 2 characters. find scans the m = n - len + 1 start positions forwards,
+ * rfind scans them backwards.
+ */
+static char const *str_find_sse2(char const *h, size_t n,
+                                 char const *needle, size_t len) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[len - 1]);
+    const size_t m = n - len + 1;
+    size_t i;
+    for (i = 0; i + 16 <= m; i += 16) {
+        const __m128i a = _mm_loadu_si128((__m128i const *) (h + i));
+        const __m128i b = _mm_loadu_si128((__m128i const *) (h + i + len - 1));
+        unsigned mask = (unsigned) _mm_movemask_epi8(
+          _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        for (; mask; mask &= mask - 1) {
+            char const *p = h + i + (unsigned) __builtin_ctz(mask);
+            if (!memcmp(p + 1, needle + 1, len - 2)) return p;
+        }
+    }
+    return str_find_delim(h + i, h + n, needle, (unsigned) len);
+}
+
+static char const *str_rfind_sse2(char const *h, size_t n,
+                                  char const *needle, size_t len) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[len - 1]);
+    size_t i = n - len + 1;
+    while (i >= 16) {
+        const __m128i *a, *b;
+        unsigned mask;
+        i -= 16;
+        a = (__m128i const *) (h + i);
+        b = (__m128i const *) (h + i + len - 1);
+        mask = (unsigned) _mm_movemask_epi8(
+          _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(a), first),
+                        _mm_cmpeq_epi8(_mm_loadu_si128(b), last)));
+        while (mask) {
+            const unsigned bit = 31 - (unsigned) __builtin_clz(mask);
+            char const *p = h + i + bit;
+            if (!memcmp(p + 1, needle + 1, len - 2)) return p;
+            mask ^= 1u << bit;
+        }
+    }
+    return str_rfind_scalar(h, i, needle, len);
+}
+
+#ifdef STR_VEC_AVX2
+__attribute__((__target__("avx2")))
+static char const *str_find_avx2(char const *h, size_t n,
+                                 char const *needle, size_t len) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[len - 1]);
+    const size_t m = n - len + 1;
+    size_t i;
+    for (i = 0; i + 32 <= m; i += 32) {
+        const __m256i a = _mm256_loadu_si256((__m256i const *) (h + i));
+        const __m256i b =
+          _mm256_loadu_si256((__m256i const *) (h + i + len - 1));
+        unsigned mask = (unsigned) _mm256_movemask_epi8(
+          _mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                           _mm256_cmpeq_epi8(b, last)));
+        for (; mask; mask &= mask - 1) {
+            char const *p = h + i + (unsigned) __builtin_ctz(mask);
+            if (!memcmp(p + 1, needle + 1, len - 2)) return p;
+        }
+    }
+    return str_find_sse2(h + i, n - i, needle, len);
+}
+
+__attribute__((__target__("avx2")))
+static char const *str_rfind_avx2(char const *h, size_t n,
+                                  char const *needle, size_t len) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[len - 1]);
+    size_t i = n - len + 1;
+    while (i >= 32) {
+        const __m256i *a, *b;
+        unsigned mask;
+        i -= 32;
+        a = (__m256i const *) (h + i);
+        b = (__m256i const *) (h + i + len - 1);
+        mask = (unsigned) _mm256_movemask_epi8(
+          _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(a), first),
+                           _mm256_cmpeq_epi8(_mm256_loadu_si256(b), last)));
+        while (mask) {
+            const unsigned bit = 31 - (unsigned) __builtin_clz(mask);
+            char const *p = h + i + bit;
+            if (!memcmp(p + 1, needle + 1, len - 2)) return p;
+            mask ^= 1u << bit;
+        }
+    }
+    return str_rfind_sse2(h, i + len - 1, needle, len);
+}
+
+static unsigned char str_cpu_has_avx2(void) {
+    static int supported = -1;
+    if (supported < 0) {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("avx2") != 0;
+    }
+    return (unsigned char) supported;
+}
+
+#define str_find_vec(h, n, needle, len)                                        \
+        (str_cpu_has_avx2() ? str_find_avx2(h, n, needle, len)                 \
+                            : str_find_sse2(h, n, needle, len))
+#define str_rfind_vec(h, n, needle, len)                                       \
+        (str_cpu_has_avx2() ? str_rfind_avx2(h, n, needle, len)                \
+                            : str_rfind_sse2(h, n, needle, len))
+#else
+#define str_find_vec(h, n, needle, len) str_find_sse2(h, n, needle, len)
+#define str_rfind_vec(h, n, needle, len) str_rfind_sse2(h, n, needle, len)
+#endif /* STR_VEC_AVX2 */
+#endif /* STR_VEC_SSE2 */
+
 unsigned char string_reserve(String *this, unsigned n) {
     unsigned ncap = this->cap;
     char *tmp;
@@ -36,7 +294,17 @@ unsigned char string_reserve(String *this, unsigned n) {
         ncap = DS_STR_MAX_SIZE;
     }
 
-    if (!(tmp = realloc(this->s, ncap))) return 0;
+    if (str_is_inline(this) || this->arena) {
+        if (this->arena) {
+            tmp = str_arena_alloc(this->arena, ncap);
+        } else {
+            tmp = __ds_malloc(ncap);
+        }
+        if (!tmp) return 0;
+        memcpy(tmp, this->s, this->size + 1);
+    } else if (!(tmp = __ds_realloc(this->s, ncap))) {
+        return 0;
+    }
     this->cap = ncap;
     this->s = tmp;
     return 1;
@@ -110,23 +378,54 @@ unsigned char string_replace_repeatingChar(String *this, unsigned pos,
     return rv;
 }
 
-String *string_new_fromCStr(char const *s, unsigned n) {
-    String *t = malloc(sizeof(String));
-    customAssert(t)
-    if (!t) return NULL;
-    t->s = malloc(64);
-    customAssert(t->s)
-    if (!t->s) {
-        free(t);
-        return NULL;
-    }
+static String *str_init(String *t, StringArena *arena,
+                        char const *s, unsigned n) {
+    t->s = t->buf;
+    t->arena = arena;
     t->size = 0;
-    t->cap = 64;
+    t->cap = DS_STR_INLINE_CAP;
     t->s[0] = 0;
     if (s && n) string_append(t, s, n);
     return t;
 }
 
+String *string_new_fromCStr(char const *s, unsigned n) {
+    String *t = __ds_malloc(sizeof(String));
+    customAssert(t)
+    if (!t) return NULL;
+    return str_init(t, NULL, s, n);
+}
+
+StringArena *string_arena_new(unsigned blockSize) {
+    StringArena *arena = __ds_calloc(1, sizeof(StringArena));
+    customAssert(arena)
+    if (!arena) return NULL;
+    arena->blockSize = blockSize ? blockSize : 4096;
+    return arena;
+}
+
+void string_arena_free(StringArena *arena) {
+    StrArenaBlock *b, *prev;
+    for (b = arena->blocks; b; b = prev) {
+        prev = b->prev;
+        __ds_free(b);
+    }
+    __ds_free(arena);
+}
+
+String *string_new_inArena(StringArena *arena, char const *s, unsigned n) {
+    String *t = str_arena_alloc(arena, sizeof(String));
+    customAssert(t)
+    if (!t) return NULL;
+    return str_init(t, arena, s, n);
+}
+
+void string_free(String *this) {
+    if (this->arena) return;
+    if (!str_is_inline(this)) __ds_free(this->s);
+    __ds_free(this);
+}
+
 String *string_new_fromString(String const *other, unsigned pos, unsigned n) {
     String *s = string_new();
     if (s && n) string_append_fromString(s, other, pos, n);
@@ -166,121 +465,75 @@ void string_erase(String *this, unsigned start, unsigned n) {
 void string_shrink_to_fit(String *this) {
     char *tmp;
     unsigned newCap = this->size + 1;
-    if (this->cap != 64 && newCap != this->cap) {
-        if (newCap == 1) newCap = 64;
-        if ((tmp = realloc(this->s, newCap))) {
-            this->cap = newCap;
-            this->s = tmp;
-        }
+    if (str_is_inline(this) || newCap == this->cap) return;
+
+    if (newCap <= DS_STR_INLINE_CAP) { /* move back into the inline buffer */
+        memcpy(this->buf, this->s, newCap);
+        if (!this->arena) __ds_free(this->s);
+        this->s = this->buf;
+        this->cap = DS_STR_INLINE_CAP;
+    } else if (!this->arena && (tmp = __ds_realloc(this->s, newCap))) {
+        this->cap = newCap;
+        this->s = tmp;
     }
 }
 
 unsigned string_find_first_of(String const *this, unsigned pos,
                               char const *chars, unsigned n) {
-    char const *c, *end;
+    size_t i;
     if (pos >= this->size) return STRING_ERROR;
     else if (!(*chars && n)) return pos;
 
-    end = (n == DS_ARG_NOT_APPLICABLE) ? &chars[strlen(chars)] : &chars[n];
-
-    for (c = chars; c != end; ++c) {
-        if (this->s[pos] == *c) return pos;
-    }
-
-    for (++pos; pos < this->size; ++pos) {
-        if (this->s[pos] == this->s[pos - 1]) continue;
-        for (c = chars; c != end; ++c) {
-            if (this->s[pos] == *c) return pos;
-        }
-    }
-    return STRING_NPOS;
+    if (n == DS_ARG_NOT_APPLICABLE) n = (unsigned) strlen(chars);
+    i = str_span_charset(this->s + pos, this->size - pos, chars, chars + n, 0);
+    return i == this->size - pos ? STRING_NPOS : pos + (unsigned) i;
 }
 
 unsigned string_find_last_of(String const *this, unsigned pos,
                              char const *chars, unsigned n) {
-    char const *c, *end;
+    size_t i;
     if (pos >= this->size) return STRING_ERROR;
     else if (!(*chars && n)) return pos;
 
-    end = (n == DS_ARG_NOT_APPLICABLE) ? &chars[strlen(chars)] : &chars[n];
-
-    for (c = chars; c != end; ++c) {
-        if (this->s[pos] == *c) return pos;
-    }
-
-    for (--pos; pos != UINT_MAX; --pos) {
-        if (this->s[pos] == this->s[pos + 1]) continue;
-        for (c = chars; c != end; ++c) {
-            if (this->s[pos] == *c) return pos;
-        }
-    }
-    return STRING_NPOS;
+    if (n == DS_ARG_NOT_APPLICABLE) n = (unsigned) strlen(chars);
+    i = str_rspan_charset(this->s, (size_t) pos + 1, chars, chars + n, 0);
+    return i == (size_t) -1 ? STRING_NPOS : (unsigned) i;
 }
 
 unsigned string_find_first_not_of(String const *this, unsigned pos,
                                   char const *chars, unsigned n) {
-    char const *c, *end;
+    size_t i;
     if (pos >= this->size) return STRING_ERROR;
     else if (!(*chars && n)) return pos;
 
-    end = (n == DS_ARG_NOT_APPLICABLE) ? &chars[strlen(chars)] : &chars[n];
-
-    for (c = chars; c != end; ++c) {
-        if (this->s[pos] == *c) break;
-    }
-    if (c == end) return pos;
-
-    for (++pos; pos < this->size; ++pos) {
-        if (this->s[pos] == this->s[pos - 1]) continue;
-        for (c = chars; c != end; ++c) {
-            if (this->s[pos] == *c) break;
-        }
-        if (c == end) return pos;
-    }
-    return STRING_NPOS;
+    if (n == DS_ARG_NOT_APPLICABLE) n = (unsigned) strlen(chars);
+    i = str_span_charset(this->s + pos, this->size - pos, chars, chars + n, 1);
+    return i == this->size - pos ? STRING_NPOS : pos + (unsigned) i;
 }
 
 unsigned string_find_last_not_of(String const *this, unsigned pos,
                                  char const *chars, unsigned n) {
-    char const *c, *end;
+    size_t i;
     if (pos >= this->size) return STRING_ERROR;
     else if (!(*chars && n)) return pos;
 
-    end = (n == DS_ARG_NOT_APPLICABLE) ? &chars[strlen(chars)] : &chars[n];
-
-    for (c = chars; c != end; ++c) {
-        if (this->s[pos] == *c) break;
-    }
-    if (c == end) return pos;
-
-    for (--pos; pos != UINT_MAX; --pos) {
-        if (this->s[pos] == this->s[pos + 1]) continue;
-        for (c = chars; c != end; ++c) {
-            if (this->s[pos] == *c) break;
-        }
-        if (c == end) return pos;
-    }
-    return STRING_NPOS;
+    if (n == DS_ARG_NOT_APPLICABLE) n = (unsigned) strlen(chars);
+    i = str_rspan_charset(this->s, (size_t) pos + 1, chars, chars + n, 1);
+    return i == (size_t) -1 ? STRING_NPOS : (unsigned) i;
 }
 
-unsigned string_find(String const *this, unsigned start_pos,
-                     char const *needle, unsigned len) {
-    const unsigned len_haystack = this->size - start_pos;
+#ifndef STR_VEC_SSE2
+/*
+ * Returns the index in h[0, n) where needle starts, STRING_NPOS, or
+ * STRING_ERROR if the prefix table could not be allocated.
+ */
+static unsigned str_find_kmp(char const *haystack, unsigned n,
+                             char const *needle, unsigned len) {
     unsigned res = STRING_NPOS, i = 0, j = 0;
     unsigned *table;
-    char *haystack;
-    if (start_pos >= this->size) return STRING_ERROR;
-    else if (!(*needle && len)) return start_pos;
-
-    if (len == DS_ARG_NOT_APPLICABLE) len = (unsigned) strlen(needle);
-
-    if (len > len_haystack) return STRING_NPOS;
-    else if (len == 1) return string_find_first_of(this, start_pos, needle, 1);
-
-    haystack = this->s + start_pos;
     if (!(table = str_gen_prefix_table(needle, len))) return STRING_ERROR;
 
-    while (i < len_haystack) {
+    while (i < n) {
         if (haystack[i] == needle[j]) {
             ++i;
             ++j;
@@ -291,31 +544,23 @@ unsigned string_find(String const *this, unsigned start_pos,
         }
 
         if (j == len) {
-            res = start_pos + (i - j);
+            res = i - j;
             break;
         }
     }
-    free(table);
+    __ds_free(table);
     return res;
 }
 
-unsigned string_rfind(String const *this, unsigned end_pos,
-                      char const *needle, unsigned len) {
+/* Same as above, for the last match ending at or before end_pos. */
+static unsigned str_rfind_kmp(char const *haystack, unsigned end_pos,
+                              char const *needle, unsigned len) {
     unsigned res = STRING_NPOS, i, j, minIndex;
     unsigned *table;
-    char *haystack = this->s;
-    if (end_pos >= this->size) return STRING_ERROR;
-    else if (!(*needle && len)) return end_pos;
-
-    if (len == DS_ARG_NOT_APPLICABLE) len = (unsigned) strlen(needle);
-
-    if (len > end_pos + 1) return STRING_NPOS;
-    else if (len == 1) return string_find_last_of(this, end_pos, needle, 1);
-
     minIndex = len - 1;
     j = minIndex;
     i = j - 1;
-    if (!(table = malloc(sizeof(unsigned) * len))) return STRING_ERROR;
+    if (!(table = __ds_malloc(sizeof(unsigned) * len))) return STRING_ERROR;
     table[minIndex] = minIndex;
 
     while (i != UINT_MAX) {
@@ -345,9 +590,88 @@ unsigned string_rfind(String const *this, unsigned end_pos,
             break;
         }
     }
-    free(table);
+    __ds_free(table);
     return res;
 }
+#endif /* STR_VEC_SSE2 */
+
+unsigned string_find(String const *this, unsigned start_pos,
+                     char const *needle, unsigned len) {
+    const unsigned len_haystack = this->size - start_pos;
+#ifdef STR_VEC_SSE2
+    char const *match;
+#else
+    unsigned res;
+#endif
+    if (start_pos >= this->size) return STRING_ERROR;
+    else if (!(*needle && len)) return start_pos;
+
+    if (len == DS_ARG_NOT_APPLICABLE) len = (unsigned) strlen(needle);
+
+    if (len > len_haystack) return STRING_NPOS;
+    else if (len == 1) return string_find_first_of(this, start_pos, needle, 1);
+
+#ifdef STR_VEC_SSE2
+    match = str_find_vec(this->s + start_pos, len_haystack, needle, len);
+    return match ? (unsigned) (match - this->s) : STRING_NPOS;
+#else
+    res = str_find_kmp(this->s + start_pos, len_haystack, needle, len);
+    return res < STRING_NPOS ? start_pos + res : res;
+#endif
+}
+
+unsigned string_rfind(String const *this, unsigned end_pos,
+                      char const *needle, unsigned len) {
+#ifdef STR_VEC_SSE2
+    char const *match;
+#endif
+    if (end_pos >= this->size) return STRING_ERROR;
+    else if (!(*needle && len)) return end_pos;
+
+    if (len == DS_ARG_NOT_APPLICABLE) len = (unsigned) strlen(needle);
+
+    if (len > end_pos + 1) return STRING_NPOS;
+    else if (len == 1) return string_find_last_of(this, end_pos, needle, 1);
+
+#ifdef STR_VEC_SSE2
+    match = str_rfind_vec(this->s, (size_t) end_pos + 1, needle, len);
+    return match ? (unsigned) (match - this->s) : STRING_NPOS;
+#else
+    return str_rfind_kmp(this->s, end_pos, needle, len);
+#endif
+}
+
+void string_searcher_init(StringSearcher *searcher, char const *needle,
+                          unsigned len) {
+    unsigned i;
+    if (!*needle) len = 0;
+    else if (len == DS_ARG_NOT_APPLICABLE) len = (unsigned) strlen(needle);
+
+    searcher->needle = needle;
+    searcher->len = len;
+    for (i = 0; i < 256; ++i) searcher->shift[i] = len;
+    for (i = 0; i + 1 < len; ++i) {
+        searcher->shift[(unsigned char) needle[i]] = len - 1 - i;
+    }
+}
+
+unsigned string_find_with(StringSearcher const *searcher,
+                          String const *this, unsigned start_pos) {
+    const unsigned len = searcher->len;
+    char const *const needle = searcher->needle;
+    unsigned i, last;
+    if (start_pos >= this->size) return STRING_ERROR;
+    else if (!len) return start_pos;
+    else if (len > this->size - start_pos) return STRING_NPOS;
+
+    last = this->size - len;
+    for (i = start_pos; i <= last;
+         i += searcher->shift[(unsigned char) this->s[i + len - 1]]) {
+        if (this->s[i + len - 1] == needle[len - 1] &&
+            !memcmp(&this->s[i], needle, len - 1)) return i;
+    }
+    return STRING_NPOS;
+}
 
 String *string_substr(String const *this, unsigned start,
                       unsigned n, int step_size) {
@@ -389,9 +713,9 @@ String **string_split(String const *this, char const *delim) {
     String *substring = NULL;
 
     if (!(*delim && iEnd) || !(len = (unsigned) strlen(delim)) ||
-            !(positions = calloc(arrLen, sizeof(unsigned)))) return NULL;
+            !(positions = __ds_calloc(arrLen, sizeof(unsigned)))) return NULL;
     else if (!(table = str_gen_prefix_table(delim, len))) {
-        free(positions);
+        __ds_free(positions);
         return NULL;
     }
 
@@ -408,7 +732,7 @@ String **string_split(String const *this, char const *delim) {
         if (j == len) {
             if (arrIdx == arrLen) {
                 arrLen <<= 1;
-                if (!(temp = realloc(positions,
+                if (!(temp = __ds_realloc(positions,
                                      arrLen * sizeof(unsigned)))) goto cleanup;
                 positions = temp;
                 memset(&positions[arrIdx + 1], 0,
@@ -420,14 +744,14 @@ String **string_split(String const *this, char const *delim) {
     }
 
     if (arrIdx == arrLen) {
-        if (!(temp = realloc(positions,
+        if (!(temp = __ds_realloc(positions,
                              (arrLen + 1) * sizeof(unsigned)))) goto cleanup;
         positions = temp;
     }
     positions[arrIdx++] = UINT_MAX;
     arrLen = arrIdx;
 
-    if (!(arr = calloc(arrLen + 1, sizeof(String *)))) goto cleanup;
+    if (!(arr = __ds_calloc(arrLen + 1, sizeof(String *)))) goto cleanup;
 
     arrIdx = 0;
     i = 0;
@@ -437,7 +761,7 @@ String **string_split(String const *this, char const *delim) {
             for (i = 0; i < arrLen; ++i) {
                 if (arr[i]) string_free(arr[i]);
             }
-            free(arr);
+            __ds_free(arr);
             arr = NULL;
             goto cleanup;
         }
@@ -451,7 +775,7 @@ String **string_split(String const *this, char const *delim) {
         for (i = 0; i < arrLen; ++i) {
             if (arr[i]) string_free(arr[i]);
         }
-        free(arr);
+        __ds_free(arr);
         arr = NULL;
         goto cleanup;
     }
@@ -459,11 +783,53 @@ String **string_split(String const *this, char const *delim) {
     arr[arrIdx++] = substring;
     arr[arrLen] = NULL;
 cleanup:
-    free(positions);
-    free(table);
+    __ds_free(positions);
+    __ds_free(table);
     return arr;
 }
 
+void string_split_free(String **arr) {
+    String **sPtr;
+    for (sPtr = arr; *sPtr; ++sPtr) string_free(*sPtr);
+    __ds_free(arr);
+}
+
+unsigned string_split_views(String const *this, char const *delim,
+                            StringView *views, unsigned n) {
+    StringTokenizer it;
+    StringView token;
+    unsigned count = 0;
+    string_iter_tokens(this, &it, delim, token) {
+        if (count < n) views[count] = token;
+        ++count;
+    }
+    return count;
+}
+
+void string_tokenizer_init(StringTokenizer *it, String const *this,
+                           char const *delim) {
+    it->pos = this->s;
+    it->end = this->s + this->size;
+    it->delim = delim;
+    it->delimLen = (unsigned) strlen(delim);
+    it->done = !(this->size && it->delimLen);
+}
+
+unsigned char string_tokenizer_next(StringTokenizer *it, StringView *token) {
+    char const *match;
+    if (it->done) return 0;
+
+    token->s = it->pos;
+    if ((match = str_find_delim(it->pos, it->end, it->delim, it->delimLen))) {
+        token->len = (unsigned) (match - it->pos);
+        it->pos = match + it->delimLen;
+    } else {
+        token->len = (unsigned) (it->end - it->pos);
+        it->done = 1;
+    }
+    return 1;
+}
+
 #if __STDC_VERSION__ >= 199901L
 #ifndef __CDS_SCAN
 #include <stdarg.h>
@@ -474,12 +840,12 @@ static char *str_read_format(unsigned *n, const char *format, va_list args) {
     va_list localArgs;
     int _n, buf_size = 256;
     char *temp, *buf;
-    if (!(buf = malloc(256))) return NULL;
+    if (!(buf = __ds_malloc(256))) return NULL;
 
     va_copy(localArgs, args);
     _n = vsnprintf(buf, 256, format, args);
     if (_n < 0) {
-        free(buf);
+        __ds_free(buf);
         return NULL;
     } else if (_n < buf_size) {
         *n = (unsigned) _n;
@@ -487,15 +853,15 @@ static char *str_read_format(unsigned *n, const char *format, va_list args) {
     }
 
     buf_size = _n + 1;
-    if (!(temp = realloc(buf, (size_t) buf_size))) {
-        free(buf);
+    if (!(temp = __ds_realloc(buf, (size_t) buf_size))) {
+        __ds_free(buf);
         return NULL;
     }
 
     buf = temp;
     _n = vsnprintf(buf, (size_t) buf_size, format, localArgs);
     if (_n < 0 || _n >= buf_size) {
-        free(buf);
+        __ds_free(buf);
         return NULL;
     }
     *n = (unsigned) _n;
@@ -514,7 +880,7 @@ unsigned char string_replace_withFormat(String *this, unsigned pos,
     va_end(args);
     if (!result) return 0;
     res = string_replace(this, pos, nToReplace, result, n);
-    free(result);
+    __ds_free(result);
     return res;
 }
 
@@ -529,7 +895,7 @@ String *string_new_withFormat(char const *format, ...) {
     va_end(args);
     if (!result) return s;
     string_append(s, result, n);
-    free(result);
+    __ds_free(result);
     return s;
 }
 #endif /* __STDC_VERSION__ >= 199901L */
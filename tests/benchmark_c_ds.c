@@ -1,27 +1,38 @@
+#define _POSIX_C_SOURCE 200112L
 #include "array.h"
+#include "alg_parallel.h"
 #include "list.h"
 #include <stdio.h>
 #include <time.h>
 
 gen_array_headers_withAlg(unsigned, unsigned)
-gen_array_source_withAlg(unsigned, unsigned, ds_cmp_num_lt, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_array_source_withNumericAlg(unsigned, unsigned)
+gen_alg_headers_radix(unsigned, unsigned)
+gen_alg_source_radix(unsigned, unsigned, DSRadix_keyUnsigned)
+gen_alg_parallel_headers(unsigned, unsigned)
+gen_alg_parallel_source(unsigned, unsigned)
 
 gen_list_headers_withAlg(unsigned, unsigned)
 gen_list_source_withAlg(unsigned, unsigned, ds_cmp_num_lt, DSDefault_shallowCopy, DSDefault_shallowDelete)
 
 char *ProgName = NULL;
 unsigned n = 10000;
+unsigned nthreads = 4;
 
 typedef enum {
     TEST_QSORT,
     TEST_ARRAY,
-    TEST_LIST
+    TEST_LIST,
+    TEST_PARALLEL,
+    TEST_RADIX,
+    TEST_LIST_MERGE
 } DSTest;
 
 static int usage(void) {
     char *s = "Usage: %s\n"
-    "    -d DATA_STRUTURE    One of [ARRAY,LIST,QSORT]\n"
-    "    -n NELEM            Number of elements to sort\n";
+    "    -d DATA_STRUTURE    One of [ARRAY,LIST,LISTMERGE,QSORT,PARALLEL,RADIX]\n"
+    "    -n NELEM            Number of elements to sort\n"
+    "    -t THREADS          Number of threads for PARALLEL\n";
     fprintf(stderr, s, ProgName);
     return 1;
 }
@@ -42,6 +53,22 @@ void test_list(void) {
     list_free(unsigned, l);
 }
 
+void test_list_merge(void) {
+    List_unsigned *l = list_new(unsigned);
+    unsigned i = 0;
+    double elapsed;
+    clock_t before, after;
+    for (; i < n; ++i) {
+        list_push_back(unsigned, l, ((unsigned) rand()) % UINT_MAX);
+    }
+    before = clock();
+    list_merge_sort(unsigned, l);
+    after = clock();
+    elapsed = ((double) (after - before) / CLOCKS_PER_SEC) * 1000;
+    printf("%.6f\n", elapsed);
+    list_free(unsigned, l);
+}
+
 void test_arr(void) {
     Array_unsigned *a = array_new(unsigned);
     unsigned i = 0;
@@ -58,6 +85,40 @@ void test_arr(void) {
     array_free(unsigned, a);
 }
 
+void test_arr_radix(void) {
+    Array_unsigned *a = array_new(unsigned);
+    unsigned i = 0;
+    double elapsed;
+    clock_t before, after;
+    for (; i < n; ++i) {
+        array_push_back(unsigned, a, ((unsigned) rand()) % UINT_MAX);
+    }
+    before = clock();
+    array_radix_sort(unsigned, a);
+    after = clock();
+    elapsed = ((double) (after - before) / CLOCKS_PER_SEC) * 1000;
+    printf("%.6f\n", elapsed);
+    array_free(unsigned, a);
+}
+
+void test_arr_parallel(void) {
+    Array_unsigned *a = array_new(unsigned);
+    unsigned i = 0;
+    double elapsed;
+    struct timespec before, after;
+    for (; i < n; ++i) {
+        array_push_back(unsigned, a, ((unsigned) rand()) % UINT_MAX);
+    }
+    /* wall time: clock() would add up the time of every thread */
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    array_sort_parallel(unsigned, a, nthreads);
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    elapsed = (double) (after.tv_sec - before.tv_sec) * 1000 +
+              (double) (after.tv_nsec - before.tv_nsec) / 1000000;
+    printf("%.6f\n", elapsed);
+    array_free(unsigned, a);
+}
+
 int sort_compare(const void *a, const void *b) {
     return *(unsigned *)a < *(unsigned *)b ? -1 : (*(unsigned *)a > *(unsigned *)b ? 1 : 0);
 }
@@ -94,6 +155,12 @@ int main(int argc, char *argv[]) {
                     type = TEST_ARRAY;
                 } else if (streq(temp, "QSORT")) {
                     type = TEST_QSORT;
+                } else if (streq(temp, "PARALLEL")) {
+                    type = TEST_PARALLEL;
+                } else if (streq(temp, "RADIX")) {
+                    type = TEST_RADIX;
+                } else if (streq(temp, "LISTMERGE")) {
+                    type = TEST_LIST_MERGE;
                 } else {
                     return usage();
                 }
@@ -101,6 +168,9 @@ int main(int argc, char *argv[]) {
             case 'n':
                 n = (unsigned) atoi(argv[argind++]);
                 break;
+            case 't':
+                nthreads = (unsigned) atoi(argv[argind++]);
+                break;
             default:
                 return usage();
         }
@@ -114,6 +184,15 @@ int main(int argc, char *argv[]) {
         case TEST_ARRAY:
             test_arr();
             break;
+        case TEST_PARALLEL:
+            test_arr_parallel();
+            break;
+        case TEST_RADIX:
+            test_arr_radix();
+            break;
+        case TEST_LIST_MERGE:
+            test_list_merge();
+            break;
         default:
             test_list();
             break;
@@ -0,0 +1,224 @@
+#define _POSIX_C_SOURCE 200112L
+#include "queue.h"
+#include "ring_queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+
+#define MAX_THREADS 64
+#define MAX_BATCH 256
+
+gen_queue_headers(unsigned, unsigned)
+gen_queue_source(unsigned, unsigned, DSDefault_shallowCopy, DSDefault_shallowDelete)
+
+gen_spsc_queue_headers(unsigned, unsigned)
+gen_spsc_queue_source(unsigned, unsigned, DSDefault_shallowCopy, DSDefault_shallowDelete)
+
+gen_mpmc_queue_headers(unsigned, unsigned)
+gen_mpmc_queue_source(unsigned, unsigned, DSDefault_shallowCopy, DSDefault_shallowDelete)
+
+typedef struct {
+    pthread_mutex_t lock;
+    Queue_unsigned *q;
+} MutexQueue;
+
+typedef size_t (*PushFunc)(void *q, unsigned const *arr, size_t n);
+typedef size_t (*PopFunc)(void *q, unsigned *out, size_t n);
+
+typedef struct {
+    void *q;
+    PushFunc push;
+    PopFunc pop;
+    unsigned count;
+} WorkerArg;
+
+typedef enum {
+    TEST_SPSC,
+    TEST_MPMC,
+    TEST_MUTEX
+} QueueTest;
+
+char *ProgName = NULL;
+unsigned n = 1000000;
+unsigned producers = 1, consumers = 1;
+size_t batch = 1, capacity = 1024;
+
+static int usage(void) {
+    char *s = "Usage: %s\n"
+    "    -d QUEUE         One of [SPSC,MPMC,MUTEX]\n"
+    "    -n NELEM         Number of elements to pass through the queue\n"
+    "    -p PRODUCERS     Number of producer threads (1 for SPSC)\n"
+    "    -c CONSUMERS     Number of consumer threads (1 for SPSC)\n"
+    "    -b BATCH         Elements pushed/popped per call\n"
+    "    -s CAPACITY      Capacity of the ring queues\n";
+    fprintf(stderr, s, ProgName);
+    return 1;
+}
+
+static size_t spsc_push(void *q, unsigned const *arr, size_t len) {
+    return spsc_queue_push_n(unsigned, (SPSCQueue_unsigned *) q, arr, len);
+}
+
+static size_t spsc_pop(void *q, unsigned *out, size_t len) {
+    return spsc_queue_pop_n(unsigned, (SPSCQueue_unsigned *) q, out, len);
+}
+
+static size_t mpmc_push(void *q, unsigned const *arr, size_t len) {
+    return mpmc_queue_push_n(unsigned, (MPMCQueue_unsigned *) q, arr, len);
+}
+
+static size_t mpmc_pop(void *q, unsigned *out, size_t len) {
+    return mpmc_queue_pop_n(unsigned, (MPMCQueue_unsigned *) q, out, len);
+}
+
+static size_t mutex_push(void *q, unsigned const *arr, size_t len) {
+    MutexQueue *mq = q;
+    size_t i;
+    pthread_mutex_lock(&mq->lock);
+    for (i = 0; i < len && queue_push(unsigned, mq->q, arr[i]); ++i);
+    pthread_mutex_unlock(&mq->lock);
+    return i;
+}
+
+static size_t mutex_pop(void *q, unsigned *out, size_t len) {
+    MutexQueue *mq = q;
+    size_t i;
+    pthread_mutex_lock(&mq->lock);
+    for (i = 0; i < len && !queue_empty(mq->q); ++i) {
+        out[i] = *queue_front(mq->q);
+        queue_pop(unsigned, mq->q);
+    }
+    pthread_mutex_unlock(&mq->lock);
+    return i;
+}
+
+static void *producer(void *p) {
+    WorkerArg *arg = p;
+    unsigned i = 0, arr[MAX_BATCH];
+    size_t j;
+    for (j = 0; j < batch; ++j) {
+        arr[j] = (unsigned) j;
+    }
+    while (i < arg->count) {
+        size_t pushed = arg->push(arg->q, arr, min(batch, arg->count - i));
+        if (!pushed) {
+            sched_yield();
+        }
+        i += (unsigned) pushed;
+    }
+    return NULL;
+}
+
+static void *consumer(void *p) {
+    WorkerArg *arg = p;
+    unsigned i = 0, out[MAX_BATCH];
+    while (i < arg->count) {
+        size_t popped = arg->pop(arg->q, out, min(batch, arg->count - i));
+        if (!popped) {
+            sched_yield();
+        }
+        i += (unsigned) popped;
+    }
+    return NULL;
+}
+
+static double elapsed_ms(struct timespec *before, struct timespec *after) {
+    return (double) (after->tv_sec - before->tv_sec) * 1000 +
+           (double) (after->tv_nsec - before->tv_nsec) / 1000000;
+}
+
+static void run(void *q, PushFunc push, PopFunc pop) {
+    pthread_t threads[2 * MAX_THREADS];
+    WorkerArg args[2 * MAX_THREADS];
+    struct timespec before, after;
+    unsigned i;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    for (i = 0; i < producers + consumers; ++i) {
+        unsigned k = i < producers ? i : i - producers;
+        unsigned nthreads = i < producers ? producers : consumers;
+        args[i].q = q;
+        args[i].push = push;
+        args[i].pop = pop;
+        args[i].count = n / nthreads + (k < n % nthreads);
+        pthread_create(&threads[i], NULL, i < producers ? producer : consumer, &args[i]);
+    }
+    for (i = 0; i < producers + consumers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &after);
+    printf("%.6f\n", elapsed_ms(&before, &after));
+}
+
+int main(int argc, char *argv[]) {
+    int argind = 1;
+    QueueTest type = TEST_MPMC;
+    ProgName = argv[0];
+
+    while (argind < argc && strlen(argv[argind]) && argv[argind][0] == '-') {
+        char* arg = argv[argind++], *temp;
+        if (argind >= argc) {
+            return usage();
+        }
+        switch(arg[1]) {
+            case 'd':
+                temp = argv[argind++];
+                if (streq(temp, "SPSC")) {
+                    type = TEST_SPSC;
+                } else if (streq(temp, "MPMC")) {
+                    type = TEST_MPMC;
+                } else if (streq(temp, "MUTEX")) {
+                    type = TEST_MUTEX;
+                } else {
+                    return usage();
+                }
+                break;
+            case 'n':
+                n = (unsigned) atoi(argv[argind++]);
+                break;
+            case 'p':
+                producers = (unsigned) atoi(argv[argind++]);
+                break;
+            case 'c':
+                consumers = (unsigned) atoi(argv[argind++]);
+                break;
+            case 'b':
+                batch = (size_t) atoi(argv[argind++]);
+                break;
+            case 's':
+                capacity = (size_t) atoi(argv[argind++]);
+                break;
+            default:
+                return usage();
+        }
+    }
+    if (!producers || !consumers || producers > MAX_THREADS || consumers > MAX_THREADS ||
+        !batch || batch > MAX_BATCH || (type == TEST_SPSC && producers + consumers != 2)) {
+        return usage();
+    }
+
+    switch (type) {
+        case TEST_SPSC: {
+            SPSCQueue_unsigned *q = spsc_queue_new(unsigned, capacity);
+            run(q, spsc_push, spsc_pop);
+            spsc_queue_free(unsigned, q);
+            break;
+        }
+        case TEST_MPMC: {
+            MPMCQueue_unsigned *q = mpmc_queue_new(unsigned, capacity);
+            run(q, mpmc_push, mpmc_pop);
+            mpmc_queue_free(unsigned, q);
+            break;
+        }
+        default: {
+            MutexQueue mq;
+            pthread_mutex_init(&mq.lock, NULL);
+            mq.q = queue_new(unsigned);
+            run(&mq, mutex_push, mutex_pop);
+            queue_free(unsigned, mq.q);
+            pthread_mutex_destroy(&mq.lock);
+            break;
+        }
+    }
+    return 0;
+}
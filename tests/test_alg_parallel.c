@@ -0,0 +1,134 @@
+#include "array.h"
+#include "alg_parallel.h"
+#ifndef __CDS_SCAN
+#include <assert.h>
+#include <stdio.h>
+#endif
+
+#define customStrCopy(dest, src) do { if (src) { dest = malloc(strlen(src) + 1); strcpy(dest, src); } } while(0)
+#define customStrDelete(x) do { if (x) free(x); } while(0)
+
+gen_array_headers_withAlg(int, int)
+gen_array_headers_withAlg(str, char *)
+gen_array_source_withAlg(int, int, ds_cmp_num_lt, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_array_source_withAlg(str, char *, ds_cmp_str_lt, customStrCopy, customStrDelete)
+gen_array_headers_withAlg(num, int)
+gen_array_source_withNumericAlg(num, int)
+
+gen_alg_parallel_headers(int, int)
+gen_alg_parallel_headers(str, char *)
+gen_alg_parallel_source(int, int)
+gen_alg_parallel_source(str, char *)
+gen_alg_parallel_headers(num, int)
+gen_alg_parallel_source(num, int)
+
+#define NELEM 200000
+
+int *random_ints(unsigned n, int range) {
+    int *a = malloc(n * sizeof(int));
+    unsigned i;
+    assert(a);
+    for (i = 0; i < n; ++i) {
+        a[i] = rand() % range;
+    }
+    return a;
+}
+
+void check_sorted(int const *a, unsigned n, long sum) {
+    unsigned i;
+    for (i = 0; i < n; ++i) {
+        assert(i == 0 || a[i - 1] <= a[i]);
+        sum -= a[i];
+    }
+    assert(sum == 0);
+}
+
+void test_sort_small(void) {
+    int arr[] = {5, 3, 9, 1, 7};
+    int sorted[] = {1, 3, 5, 7, 9};
+    Array_int *a = array_new_fromArray(int, arr, 5);
+    unsigned i;
+    array_sort_parallel(int, a, 4);
+    for (i = 0; i < 5; ++i) {
+        assert(*array_at(a, i) == sorted[i]);
+    }
+    sort_parallel(int, arr, 0, 4);
+    array_free(int, a);
+}
+
+void test_sort_random(void) {
+    unsigned nthreads, i;
+    for (nthreads = 1; nthreads <= 8; nthreads *= 2) {
+        int *a = random_ints(NELEM, nthreads == 8 ? 4 : RAND_MAX);
+        long sum = 0;
+        for (i = 0; i < NELEM; ++i) {
+            sum += a[i];
+        }
+        sort_parallel(int, a, NELEM, nthreads);
+        check_sorted(a, NELEM, sum);
+        free(a);
+    }
+}
+
+void test_sort_patterns(void) {
+    int *a = malloc(NELEM * sizeof(int));
+    unsigned i;
+    assert(a);
+    for (i = 0; i < NELEM; ++i) {
+        a[i] = (int) i;
+    }
+    sort_parallel(int, a, NELEM, 4);
+    check_sorted(a, NELEM, (long) NELEM * (NELEM - 1) / 2);
+    for (i = 0; i < NELEM; ++i) {
+        a[i] = (int) (NELEM - i);
+    }
+    sort_parallel(int, a, NELEM, 4);
+    check_sorted(a, NELEM, (long) NELEM * (NELEM + 1) / 2);
+    free(a);
+}
+
+void test_sort_numeric(void) {
+    /* with -msse4.1 or -mavx2, the tasks partition with the vector kernel */
+    int ranges[] = {RAND_MAX, 1000, 4, 1};
+    unsigned r, i;
+    for (r = 0; r < 4; ++r) {
+        int *a = random_ints(NELEM, ranges[r]);
+        long sum = 0;
+        for (i = 0; i < NELEM; ++i) {
+            sum += a[i];
+        }
+        sort_parallel(num, a, NELEM, 4);
+        check_sorted(a, NELEM, sum);
+        for (i = 0; i < NELEM; ++i) {
+            a[i] = (int) (NELEM - i);
+        }
+        sort_parallel(num, a, NELEM, 4);
+        check_sorted(a, NELEM, (long) NELEM * (NELEM + 1) / 2);
+        free(a);
+    }
+}
+
+void test_sort_strs(void) {
+    Array_str *a = array_new(str);
+    char buf[16];
+    unsigned i;
+    for (i = 0; i < 20000; ++i) {
+        sprintf(buf, "%05d", rand() % 100000);
+        array_push_back(str, a, buf);
+    }
+    array_sort_parallel(str, a, 3);
+    for (i = 1; i < 20000; ++i) {
+        assert(strcmp(*array_at(a, i - 1), *array_at(a, i)) <= 0);
+    }
+    array_free(str, a);
+}
+
+int main(void) {
+    srand(1);
+    test_sort_small();
+    test_sort_random();
+    test_sort_patterns();
+    test_sort_numeric();
+    test_sort_strs();
+    return 0;
+}
@@ -11,6 +11,57 @@ gen_array_headers_withAlg(int, int)
 gen_array_source_withAlg(str, char *, ds_cmp_str_lt, customStrCopy, customStrDelete)
 gen_array_source_withAlg(int, int, ds_cmp_num_lt, DSDefault_shallowCopy, DSDefault_shallowDelete)
 
+typedef struct {
+    unsigned key;
+    unsigned pos;
+} Record;
+
+#define record_lt(x, y) ((x).key < (y).key)
+#define record_key(x) (x).key
+
+gen_alg_headers_radix(int, int)
+gen_alg_source_radix(int, int, DSRadix_keyInt)
+gen_alg_headers(rec, Record)
+gen_alg_source(rec, Record, record_lt)
+gen_alg_headers_radix(rec, Record)
+gen_alg_source_radix(rec, Record, record_key)
+gen_alg_headers(dbl, double)
+gen_alg_source(dbl, double, ds_cmp_num_lt)
+gen_alg_headers_radix(dbl, double)
+gen_alg_source_radix(dbl, double, DSRadix_keyDouble)
+gen_array_headers_withAlg(num, int)
+gen_array_source_withNumericAlg(num, int)
+gen_alg_headers(uns, unsigned)
+gen_alg_source_numeric(uns, unsigned)
+gen_alg_headers(flt, float)
+gen_alg_source_numeric(flt, float)
+
+typedef struct {
+    unsigned allocs;
+    unsigned frees;
+} AllocStats;
+
+AllocStats counted_stats;
+
+void *counted_malloc(AllocStats *st, size_t n) { st->allocs++; return malloc(n); }
+void *counted_calloc(AllocStats *st, size_t n, size_t size) { st->allocs++; return calloc(n, size); }
+void *counted_realloc(AllocStats *st, void *p, size_t n) { if (!p) st->allocs++; return realloc(p, n); }
+void counted_free(AllocStats *st, void *p) { if (p) st->frees++; free(p); }
+
+#undef DS_ALLOC_CONTEXT
+#undef DS_MALLOC
+#undef DS_CALLOC
+#undef DS_REALLOC
+#undef DS_FREE
+#define DS_ALLOC_CONTEXT (&counted_stats)
+#define DS_MALLOC(ctx, size) counted_malloc(ctx, size)
+#define DS_CALLOC(ctx, n, size) counted_calloc(ctx, n, size)
+#define DS_REALLOC(ctx, ptr, size) counted_realloc(ctx, ptr, size)
+#define DS_FREE(ctx, ptr) counted_free(ctx, ptr)
+
+gen_array_headers(counted, char *)
+gen_array_source(counted, char *, DSDefault_deepCopyStr, DSDefault_deepDelete)
+
 int ints[] = {0,5,10,15,20,25,30,35,40,45,50,55,60,65,70,75,80,85,90,95,100,105,110,115,120,125,
 130,135,140,145,150,155,160,165,170,175,180,185,190,195,200,205,210,215,220,225,230,235,240,245};
 char *strs[] = {"000","005","010","015","020","025","030","035","040","045","050","055","060",
@@ -461,6 +512,192 @@ void test_sort(void) {
     array_free(int, ai);
 }
 
+void check_stable(Record const *recs, unsigned n) {
+    unsigned i;
+    for (i = 1; i < n; ++i) {
+        assert(recs[i - 1].key <= recs[i].key);
+        if (recs[i - 1].key == recs[i].key) assert(recs[i - 1].pos < recs[i].pos);
+    }
+}
+
+void test_radix_sort(void) {
+    int ints_rand[] = {200,25,220,120,5,205,50,15,60,235,10,70,130,105,185,225,90,30,155,100,150,0,95,170,190,
+125,210,75,45,160,175,145,55,230,35,65,110,140,115,20,215,85,195,240,245,135,80,180,40,165};
+    Array_int *ai = array_new_fromArray(int, ints_rand, 50);
+    Record *recs = malloc(5000 * sizeof(Record));
+    double *dbls = malloc(5000 * sizeof(double));
+    int i;
+    array_radix_sort(int, ai);
+    compare_ints(ai, ints, 50);
+    array_clear(int, ai);
+    for (i = 0; i < 5000; ++i) {
+        array_push_back(int, ai, 2500 - i);
+        recs[i].key = (unsigned) (i * 7919) % 1000;
+        recs[i].pos = (unsigned) i;
+        dbls[i] = (i % 2 ? -1.5 : 2.25) * (double) (i * 31 % 977);
+    }
+    array_radix_sort(int, ai);
+    for (i = 0; i < 5000; ++i) {
+        assert(ai->arr[i] == i - 2499);
+    }
+    radix_sort(rec, recs, 5000);
+    for (i = 1; i < 5000; ++i) {
+        assert(recs[i - 1].key <= recs[i].key);
+        if (recs[i - 1].key == recs[i].key) assert(recs[i - 1].pos < recs[i].pos);
+    }
+    radix_sort(dbl, dbls, 5000);
+    for (i = 1; i < 5000; ++i) {
+        assert(dbls[i - 1] <= dbls[i]);
+    }
+    /* below DS_RADIX_SORT_CUTOFF too */
+    for (i = 0; i < 300; ++i) {
+        recs[i].key = (unsigned) (i * 7919) % 10;
+        recs[i].pos = (unsigned) i;
+    }
+    radix_sort(rec, recs, 300);
+    check_stable(recs, 300);
+    free(recs);
+    free(dbls);
+    array_free(int, ai);
+}
+
+void test_stable_sort(void) {
+    int ints_rand[] = {200,25,220,120,5,205,50,15,60,235,10,70,130,105,185,225,90,30,155,100,150,0,95,170,190,
+125,210,75,45,160,175,145,55,230,35,65,110,140,115,20,215,85,195,240,245,135,80,180,40,165};
+    Array_int *ai = array_new_fromArray(int, ints_rand, 50);
+    Record *recs = malloc(5000 * sizeof(Record));
+    Record *buf = malloc(2500 * sizeof(Record));
+    unsigned i;
+    assert(array_stable_sort(int, ai));
+    compare_ints(ai, ints, 50);
+    array_free(int, ai);
+
+    for (i = 0; i < 5000; ++i) {
+        recs[i].key = (unsigned) rand() % 100;
+        recs[i].pos = i;
+    }
+    assert(stable_sort(rec, recs, 5000));
+    check_stable(recs, 5000);
+    /* nearly sorted, with a few elements out of place */
+    for (i = 0; i < 5000; ++i) {
+        recs[i].key = (i % 500 == 7) ? (unsigned) rand() % 2000 : i / 3;
+        recs[i].pos = i;
+    }
+    assert(stable_sort_withBuffer(rec, recs, 5000, buf, 2500));
+    check_stable(recs, 5000);
+    /* descending runs of equal keys */
+    for (i = 0; i < 5000; ++i) {
+        recs[i].key = (5000 - i) / 4;
+        recs[i].pos = i;
+    }
+    assert(stable_sort_withBuffer(rec, recs, 5000, buf, 10));
+    check_stable(recs, 5000);
+    free(buf);
+    free(recs);
+}
+
+void test_select(void) {
+    int ints_rand[] = {200,25,220,120,5,205,50,15,60,235,10,70,130,105,185,225,90,30,155,100,150,0,95,170,190,
+125,210,75,45,160,175,145,55,230,35,65,110,140,115,20,215,85,195,240,245,135,80,180,40,165};
+    Array_int *ai = array_new_fromArray(int, ints_rand, 50);
+    Array_num *an = array_new(num);
+    Array_int *sorted = array_new(int);
+    unsigned i, j, n;
+    array_top_k(int, ai, 0);
+    array_top_k(int, ai, 10);
+    for (i = 0; i < 10; ++i) {
+        assert(ai->arr[i] == ints[i]);
+    }
+    array_top_k(int, ai, 100);
+    compare_ints(ai, ints, 50);
+    nth_element(int, ai->arr, &ai->arr[50], &ai->arr[50]);
+    compare_ints(ai, ints, 50);
+    array_free(int, ai);
+
+    for (n = 1; n <= 2000; n = n * 3 + 1) {
+        for (j = 0; j < 10; ++j) {
+            unsigned const nth = (n - 1) * j / 9;
+            array_clear(num, an);
+            array_clear(int, sorted);
+            for (i = 0; i < n; ++i) {
+                int const x = rand() % (j % 2 ? 10 : 10000);
+                array_push_back(num, an, x);
+                array_push_back(int, sorted, x);
+            }
+            array_sort(int, sorted);
+            nth_element(num, an->arr, &an->arr[nth], &an->arr[n]);
+            assert(an->arr[nth] == sorted->arr[nth]);
+            for (i = 0; i < n; ++i) {
+                if (i < nth) assert(an->arr[i] <= an->arr[nth]);
+                if (i > nth) assert(an->arr[i] >= an->arr[nth]);
+            }
+            partial_sort(num, an->arr, &an->arr[nth], &an->arr[n]);
+            for (i = 0; i < nth; ++i) {
+                assert(an->arr[i] == sorted->arr[i]);
+            }
+        }
+    }
+    array_free(num, an);
+    array_free(int, sorted);
+}
+
+int qsort_cmp_uns(const void *a, const void *b) {
+    return ds_cmp_num(*(const unsigned *) a, *(const unsigned *) b);
+}
+
+int qsort_cmp_flt(const void *a, const void *b) {
+    return ds_cmp_num(*(const float *) a, *(const float *) b);
+}
+
+void test_numeric_sort(void) {
+    unsigned const sizes[] = {0,1,2,3,7,8,9,15,16,17,24,31,32,33,100,1000,5000};
+    unsigned const mods[] = {1,4,1000,RAND_MAX};
+    Array_num *an = array_new(num);
+    Array_int *ai = array_new(int);
+    unsigned *us = malloc(5000 * sizeof(unsigned));
+    unsigned *ur = malloc(5000 * sizeof(unsigned));
+    float *fs = malloc(5000 * sizeof(float));
+    float *fr = malloc(5000 * sizeof(float));
+    unsigned s, m, i;
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (m = 0; m < sizeof(mods) / sizeof(mods[0]); ++m) {
+            array_clear(num, an);
+            array_clear(int, ai);
+            for (i = 0; i < sizes[s]; ++i) {
+                int x = rand() % (int) mods[m];
+                array_push_back(num, an, x - (int) mods[m] / 2);
+                array_push_back(int, ai, x - (int) mods[m] / 2);
+                us[i] = ur[i] = (unsigned) x * 2654435761u;
+                fs[i] = fr[i] = (x % 7 == 3) ? -0.0f : (float) x - (float) mods[m] / 2;
+            }
+            array_sort(num, an);
+            array_sort(int, ai);
+            sort(uns, us, sizes[s]);
+            qsort(ur, sizes[s], sizeof(unsigned), qsort_cmp_uns);
+            sort(flt, fs, sizes[s]);
+            qsort(fr, sizes[s], sizeof(float), qsort_cmp_flt);
+            for (i = 0; i < sizes[s]; ++i) {
+                assert(an->arr[i] == ai->arr[i]);
+                assert(us[i] == ur[i]);
+                assert(fs[i] == fr[i]);
+            }
+        }
+    }
+    for (i = 0; i < 5000; ++i) {
+        us[i] = 4999 - i;
+    }
+    sort(uns, us, 5000);
+    for (i = 0; i < 5000; ++i) {
+        assert(us[i] == i);
+    }
+    free(us);
+    free(ur);
+    free(fs);
+    free(fr);
+    array_free(num, an);
+    array_free(int, ai);
+}
+
 void test_union(void) {
     int c1[] = {0,5,10,15,20,25,30,35,40,45,50,55,60,65,70};
     char *c2[] = {"000","005","010","015","020","025","030","035","040","045","050","055","060","065","070"};
@@ -584,6 +821,23 @@ void test_includes(void) {
     assert(!array_includes(str, &strs[5], &strs[11], strs, &strs[6]));
 }
 
+void test_alloc_hooks(void) {
+    Array_counted *a = array_new(counted);
+    Array_int *b = array_new(int);
+    int i;
+    assert(counted_stats.allocs == 2 && !counted_stats.frees);
+    for (i = 0; i < 50; ++i) {
+        array_push_back(counted, a, strs[i]);
+        array_push_back(int, b, ints[i]);
+    }
+    assert(counted_stats.allocs == 52);
+    array_pop_back(counted, a);
+    assert(counted_stats.frees == 1);
+    array_free(counted, a);
+    array_free(int, b);
+    assert(counted_stats.allocs == counted_stats.frees);
+}
+
 int main(void) {    
     test_empty_init();
     test_init_repeatingValue();
@@ -603,10 +857,15 @@ int main(void) {
     test_find();
     test_merge();
     test_sort();
+    test_radix_sort();
+    test_numeric_sort();
+    test_stable_sort();
+    test_select();
     test_union();
     test_intersection();
     test_difference();
     test_symmetric_difference();
     test_includes();
+    test_alloc_hooks();
     return 0;
 }
@@ -19,8 +19,8 @@
 #define tree_remove_value(id, s, value) __avltree_remove_entry_##id(s, __avltree_find_key_##id(s, value, 0))
 #define tree_remove_entry(id, s, entry) __avltree_remove_entry_##id(s, entry)
 
-__setup_avltree_headers(int, int, AVLTree_int, int, AVLNode_int)
-__setup_avltree_headers(str, char *, AVLTree_str, char *, AVLNode_str)
+__setup_avltree_headers(int, int, AVLTree_int, int, AVLNode_int, __avl_counts_none)
+__setup_avltree_headers(str, char *, AVLTree_str, char *, AVLNode_str, __avl_counts_none)
 __setup_avltree_source(int, int, AVLTree_int, int, AVLNode_int, ds_cmp_num_lt, __tree_entry_get_key, __tree_data_get_key, DSDefault_shallowCopy, DSDefault_shallowDelete, __tree_copy_value, __tree_delete_value)
 __setup_avltree_source(str, char *, AVLTree_str, char *, AVLNode_str, ds_cmp_str_lt, __tree_entry_get_key, __tree_data_get_key, DSDefault_deepCopyStr, DSDefault_deepDelete, __tree_copy_value, __tree_delete_value)
 
@@ -644,11 +644,67 @@ void test_erase(void) {
     tree_free(str, t);
 }
 
+int check_balanced(AVLNode_int *node, AVLNode_int *parent) {
+    int left, right;
+    if (!node) return 0;
+    assert(node->parent == parent);
+    left = check_balanced(node->left, node);
+    right = check_balanced(node->right, node);
+    assert(node->bf == right - left);
+    assert(node->bf >= -1 && node->bf <= 1);
+    return (left > right ? left : right) + 1;
+}
+
+void test_fromSorted(void) {
+    int arr[1000], unsorted[] = {3, 1, 2, 3};
+    char *strs[] = {"a", "b", "c"};
+    AVLNode_int *node;
+    AVLNode_str *snode;
+    AVLTree_int *t = __avltree_new_fromSorted_int(NULL, 0);
+    AVLTree_str *st;
+    int i;
+    assert(t && t->size == 0 && !t->root);
+    tree_free(int, t);
+    for (i = 0; i < 1000; ++i) {
+        arr[i] = i * 2;
+    }
+    t = __avltree_new_fromSorted_int(arr, 1000);
+    assert(t->size == 1000);
+    assert(check_balanced(t->root, NULL) == 10);
+    i = 0;
+    tree_iter(int, t, node) {
+        assert(node->data == arr[i++]);
+    }
+    for (i = 0; i < 1000; ++i) {
+        tree_insert(int, t, i * 2 + 1);
+    }
+    for (i = 0; i < 2000; i += 3) {
+        tree_remove_value(int, t, i);
+    }
+    assert(t->size == 1333);
+    check_balanced(t->root, NULL);
+    tree_free(int, t);
+
+    t = __avltree_new_fromSorted_int(unsorted, 4);
+    assert(t->size == 3);
+    check_balanced(t->root, NULL);
+    tree_free(int, t);
+
+    st = __avltree_new_fromSorted_str(strs, 3);
+    assert(st->size == 3 && streq(st->root->data, "b") && st->root->data != strs[1]);
+    i = 0;
+    tree_iter(str, st, snode) {
+        assert(streq(snode->data, strs[i++]));
+    }
+    tree_free(str, st);
+}
+
 int main(void) {
     test_increasing_ints();
     test_decreasing_ints();
     test_iter();
     test_strings();
     test_erase();
+    test_fromSorted();
     return 0;
 }
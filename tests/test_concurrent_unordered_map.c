@@ -0,0 +1,168 @@
+#define _POSIX_C_SOURCE 200112L
+#include "concurrent_unordered_map.h"
+#ifndef __CDS_SCAN
+#include <assert.h>
+#endif
+
+#define NTHREADS 8
+#define PER_THREAD 5000
+#define SHARED_KEYS 64
+#define ROUNDS 200
+
+gen_umap_concurrent_headers(int_int, int, int)
+gen_umap_concurrent_headers(str_int, char *, int)
+gen_umap_concurrent_headers(hashed, unsigned long, unsigned long)
+
+gen_umap_concurrent_source(int_int, int, int, ds_cmp_num_eq, DSDefault_addrOfVal, DSDefault_sizeOfVal, DSDefault_shallowCopy, DSDefault_shallowDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_umap_concurrent_source(str_int, char *, int, ds_cmp_str_eq, DSDefault_addrOfRef, DSDefault_sizeOfStr, DSDefault_deepCopyStr, DSDefault_deepDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_umap_concurrent_source_withHash(hashed, unsigned long, unsigned long, ds_cmp_num_eq, DSDefault_hashInt, DSDefault_shallowCopy, DSDefault_shallowDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
+
+typedef struct {
+    CUMap_int_int *m;
+    int tid;
+} ThreadArg;
+
+static void increment(int *value, void *arg) {
+    *value += *(int *) arg;
+}
+
+void test_single_thread(void) {
+    int i, val = 0, one = 1;
+    char *keys[] = {"a", "bb", "ccc", "dddd"};
+    Pair_str_int p;
+    CUMap_str_int *m = cumap_new(str_int, 3);
+    assert(m->nshards == 4);
+    for (i = 0; i < 4; ++i) {
+        p.first = keys[i], p.second = i;
+        assert(cumap_insert(str_int, m, p));
+    }
+    assert(cumap_size(str_int, m) == 4);
+    assert(cumap_find(str_int, m, "ccc", &val));
+    assert(val == 2);
+    assert(!cumap_find(str_int, m, "e", &val));
+    p.first = "ccc", p.second = 100;
+    assert(cumap_upsert(str_int, m, p, increment, &one));
+    p.first = "e";
+    assert(cumap_upsert(str_int, m, p, increment, &one));
+    assert(cumap_find(str_int, m, "ccc", &val));
+    assert(val == 3);
+    assert(cumap_find(str_int, m, "e", &val));
+    assert(val == 100);
+    assert(cumap_size(str_int, m) == 5);
+    assert(cumap_remove_key(str_int, m, "a"));
+    assert(!cumap_remove_key(str_int, m, "a"));
+    assert(!cumap_contains(str_int, m, "a"));
+    assert(cumap_contains(str_int, m, "bb"));
+    cumap_clear(str_int, m);
+    assert(cumap_size(str_int, m) == 0);
+    assert(!cumap_contains(str_int, m, "bb"));
+    cumap_free(str_int, m);
+}
+
+void test_int_hash(void) {
+    unsigned long i, val = 0;
+    Pair_hashed p;
+    CUMap_hashed *m = cumap_new(hashed, 1);
+    assert(m->nshards == 1);
+    for (i = 0; i < 1000; ++i) {
+        p.first = i * 4096, p.second = i;
+        assert(cumap_insert(hashed, m, p));
+    }
+    assert(cumap_size(hashed, m) == 1000);
+    for (i = 0; i < 1000; ++i) {
+        assert(cumap_find(hashed, m, i * 4096, &val));
+        assert(val == i);
+    }
+    cumap_free(hashed, m);
+
+    /* strided keys must still spread over every shard */
+    m = cumap_new(hashed, 16);
+    for (i = 0; i < 4096; ++i) {
+        p.first = i << 16, p.second = i;
+        assert(cumap_insert(hashed, m, p));
+    }
+    for (i = 0; i < m->nshards; ++i) {
+        assert(m->shards[i].table->size > 4096 / m->nshards / 2);
+    }
+    cumap_free(hashed, m);
+}
+
+static void *insert_range(void *p) {
+    ThreadArg *arg = p;
+    int i, start = arg->tid * PER_THREAD;
+    Pair_int_int pair;
+    for (i = start; i < start + PER_THREAD; ++i) {
+        pair.first = i, pair.second = -i;
+        assert(cumap_insert(int_int, arg->m, pair));
+    }
+    return NULL;
+}
+
+static void *upsert_shared(void *p) {
+    ThreadArg *arg = p;
+    int i, j, one = 1;
+    Pair_int_int pair;
+    pair.second = 1;
+    for (i = 0; i < ROUNDS; ++i) {
+        for (j = 0; j < SHARED_KEYS; ++j) {
+            pair.first = -1 - j;
+            assert(cumap_upsert(int_int, arg->m, pair, increment, &one));
+        }
+    }
+    return NULL;
+}
+
+static void *find_and_erase(void *p) {
+    ThreadArg *arg = p;
+    int i, val, start = arg->tid * PER_THREAD;
+    for (i = start; i < start + PER_THREAD; ++i) {
+        assert(cumap_find(int_int, arg->m, i, &val));
+        assert(val == -i);
+        if (i % 2) {
+            assert(cumap_remove_key(int_int, arg->m, i));
+        }
+    }
+    return NULL;
+}
+
+static void run_threads(CUMap_int_int *m, void *(*func)(void *)) {
+    pthread_t threads[NTHREADS];
+    ThreadArg args[NTHREADS];
+    int i;
+    for (i = 0; i < NTHREADS; ++i) {
+        args[i].m = m;
+        args[i].tid = i;
+        assert(pthread_create(&threads[i], NULL, func, &args[i]) == 0);
+    }
+    for (i = 0; i < NTHREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+void test_threads(void) {
+    int i, val;
+    CUMap_int_int *m = cumap_new(int_int, 4 * NTHREADS);
+    run_threads(m, insert_range);
+    assert(cumap_size(int_int, m) == NTHREADS * PER_THREAD);
+
+    run_threads(m, upsert_shared);
+    assert(cumap_size(int_int, m) == NTHREADS * PER_THREAD + SHARED_KEYS);
+    for (i = 0; i < SHARED_KEYS; ++i) {
+        assert(cumap_find(int_int, m, -1 - i, &val));
+        assert(val == NTHREADS * ROUNDS);
+    }
+
+    run_threads(m, find_and_erase);
+    assert(cumap_size(int_int, m) == NTHREADS * PER_THREAD / 2 + SHARED_KEYS);
+    for (i = 0; i < NTHREADS * PER_THREAD; ++i) {
+        assert(cumap_contains(int_int, m, i) == !(i % 2));
+    }
+    cumap_free(int_int, m);
+}
+
+int main(void) {
+    test_single_thread();
+    test_int_hash();
+    test_threads();
+    return 0;
+}
@@ -306,6 +306,107 @@ void test_mixed(void) {
     deque_free(str, qs);
 }
 
+void test_at_iter(void) {
+    Deque_int *qi = deque_new(int);
+    int i, *iptr;
+    assert(deque_at(qi, 0) == NULL);
+    /* the elements wrap around the end of the buffer */
+    for (i = 0; i < 6; ++i) {
+        deque_push_back(int, qi, i);
+        deque_pop_front(int, qi);
+    }
+    for (i = 0; i < 6; ++i) {
+        deque_push_back(int, qi, i);
+    }
+    for (i = 0; i < 6; ++i) {
+        iptr = deque_at(qi, (unsigned) i);
+        assert(iptr && *iptr == i);
+    }
+    assert(deque_at(qi, 6) == NULL);
+    i = 0;
+    deque_iter(qi, iptr) {
+        assert(*iptr == i++);
+    }
+    assert(i == 6);
+    deque_riter(qi, iptr) {
+        assert(*iptr == --i);
+    }
+    assert(i == 0);
+    deque_free(int, qi);
+}
+
+void test_grow_wrapped(void) {
+    Deque_int *qi = deque_new(int);
+    Deque_str *qs = deque_new(str);
+    unsigned i, round;
+    int *iptr;
+    char **sptr;
+    /* grow while the elements wrap, with the split point at different offsets */
+    for (round = 0; round < 8; ++round) {
+        for (i = 0; i < round * 5; ++i) {
+            deque_push_front(int, qi, -1 - (int) i);
+            deque_push_front(str, qs, strs[LEN - 1 - i]);
+        }
+        for (i = 0; i < LEN; ++i) {
+            deque_push_back(int, qi, (int) i);
+            deque_push_back(str, qs, strs[i]);
+        }
+        assert(deque_size(qi) == round * 5 + LEN);
+        for (i = 0; i < deque_size(qi); ++i) {
+            iptr = deque_at(qi, i);
+            sptr = deque_at(qs, i);
+            assert(iptr && *iptr == (int) i - (int) (round * 5));
+            assert(sptr && streq(*sptr, i < round * 5 ? strs[LEN - round * 5 + i] :
+                                                        strs[i - round * 5]));
+        }
+        while (!deque_empty(qi)) {
+            deque_pop_back(int, qi);
+            deque_pop_front(str, qs);
+        }
+    }
+    deque_free(int, qi);
+    deque_free(str, qs);
+}
+
+void test_push_fromArray(void) {
+    Deque_int *qi = deque_new(int);
+    Deque_str *qs = deque_new(str);
+    int i, arr[LEN], *iptr;
+    char **sptr;
+    for (i = 0; i < LEN; ++i) {
+        arr[i] = i;
+    }
+    assert(deque_push_back_fromArray(int, qi, arr, 0));
+    assert(deque_empty(qi));
+    /* make the first batch wrap around the end of the buffer */
+    for (i = 0; i < 5; ++i) {
+        deque_push_back(int, qi, 0);
+        deque_pop_front(int, qi);
+    }
+    assert(deque_push_back_fromArray(int, qi, arr + 50, 6));
+    assert(deque_push_front_fromArray(int, qi, arr + 20, 30));
+    assert(deque_push_back_fromArray(int, qi, arr + 56, LEN - 56));
+    assert(deque_push_front_fromArray(int, qi, arr, 20));
+    assert(deque_size(qi) == LEN);
+    i = 0;
+    deque_iter(qi, iptr) {
+        assert(*iptr == i++);
+    }
+    assert(i == LEN);
+
+    assert(deque_reserve(str, qs, 100));
+    assert(qs->cap == 128);
+    assert(deque_push_back_fromArray(str, qs, strs + 10, 10));
+    assert(deque_push_front_fromArray(str, qs, strs, 10));
+    assert(qs->cap == 128);
+    for (i = 0; i < 20; ++i) {
+        sptr = deque_at(qs, (unsigned) i);
+        assert(sptr && *sptr != strs[i] && streq(*sptr, strs[i]));
+    }
+    deque_free(int, qi);
+    deque_free(str, qs);
+}
+
 int main(void) {
     test_empty();
     test_push_pop_front();
@@ -313,5 +414,8 @@ int main(void) {
     test_push_front_pop_back();
     test_push_back_pop_front();
     test_mixed();
+    test_at_iter();
+    test_grow_wrapped();
+    test_push_fromArray();
     return 0;
 }
@@ -611,6 +611,57 @@ void test_sort(void) {
     compare_strs(ls, strs, 50);
     list_free(str, ls);
     list_free(int, li);
+
+    li = list_new_fromArray(int, &ints[1], 2);
+    list_push_front(int, li, ints[2]);
+    list_pop_back(int, li);
+    list_sort(int, li);
+    compare_ints(li, &ints[1], 2);
+    list_free(int, li);
+}
+
+void test_merge_sort(void) {
+    int ints_rand[] = {200,25,220,120,5,205,50,15,60,235,10,70,130,105,185,225,90,30,155,100,150,0,95,170,190,
+125,210,75,45,160,175,145,55,230,35,65,110,140,115,20,215,85,195,240,245,135,80,180,40,165};
+    char *strs_rand[] = {"200","025","220","120","005","205","050","015","060","235","010","070","130","105",
+"185","225","090","030","155","100","150","000","095","170","190","125","210","075","045","160","175",
+"145","055","230","035","065","110","140","115","020","215","085","195","240","245","135","080","180",
+"040","165"};
+    int i;
+    List_int *li = list_new_fromArray(int, ints_rand, 50), *li2 = list_new_withPool(int, 8);
+    List_str *ls = list_new_fromArray(str, strs_rand, 50);
+    list_merge_sort(str, ls);
+    list_merge_sort(int, li);
+    compare_ints(li, ints, 50);
+    compare_strs(ls, strs, 50);
+    list_merge_sort(int, li);
+    compare_ints(li, ints, 50);
+
+    for (i = 49; i >= 0; --i) {
+        list_push_back(int, li2, ints[i]);
+    }
+    list_merge_sort(int, li2);
+    compare_ints(li2, ints, 50);
+
+    /* presorted, with a few neighbours swapped */
+    list_clear(int, li2);
+    for (i = 0; i < 50; ++i) {
+        list_push_back(int, li2, ints[i % 7 == 3 ? i + 1 : (i % 7 == 4 ? i - 1 : i)]);
+    }
+    list_merge_sort(int, li2);
+    compare_ints(li2, ints, 50);
+
+    list_clear(int, li);
+    list_merge_sort(int, li);
+    compare_ints(li, ints, 0);
+    for (i = 3; i > 0; --i) {
+        list_push_back(int, li, ints[i - 1]);
+        list_merge_sort(int, li);
+        compare_ints(li, &ints[i - 1], (unsigned) (4 - i));
+    }
+    list_free(str, ls);
+    list_free(int, li);
+    list_free(int, li2);
 }
 
 void test_union(void) {
@@ -768,6 +819,56 @@ void test_includes(void) {
     }
 }
 
+void test_pool(void) {
+    List_str *l = list_new_withPool(str, 8), *copy, *plain = list_new_fromArray(str, strs, 10);
+    List_int *li = list_new_withPool(int, 4);
+    ListEntry_str *e;
+    int i;
+    for (i = 0; i < 50; ++i) {
+        list_push_back(str, l, strs[i]);
+    }
+    compare_strs(l, strs, 50);
+    list_erase(str, l, l->front, NULL);
+    assert(list_empty(l) && !l->pool.slabs);
+    list_insert_fromArray(str, l, NULL, &strs[10], 40);
+    list_erase(str, l, l->front, l->front->next);
+    list_push_front(str, l, strs[10]);
+    compare_strs(l, &strs[10], 40);
+
+    copy = list_createCopy(str, l);
+    assert(copy->pool.chunk == 8);
+    compare_strs(copy, &strs[10], 40);
+
+    /* entries moving between lists with different pools are re-homed */
+    list_splice(str, l, l->front, plain);
+    assert(list_empty(plain));
+    compare_strs(l, strs, 50);
+    e = copy->back;
+    list_splice_element(str, plain, NULL, copy, e);
+    assert(list_size(plain) == 1 && streq(plain->front->data, "245"));
+    list_free(str, copy);
+    assert(streq(plain->front->data, "245"));
+    list_merge(str, l, plain);
+    assert(list_empty(plain) && list_size(l) == 51);
+    list_unique(str, l);
+    compare_strs(l, strs, 50);
+    list_free(str, l);
+    list_free(str, plain);
+
+    for (i = 49; i >= 0; --i) {
+        list_push_back(int, li, ints[i]);
+    }
+    list_sort(int, li);
+    compare_ints(li, ints, 50);
+    list_remove_if(int, li, testCond);
+    compare_ints(li, &ints[1], 49);
+    list_clear(int, li);
+    assert(list_empty(li));
+    list_push_back(int, li, 5);
+    compare_ints(li, &ints[1], 1);
+    list_free(int, li);
+}
+
 int main(void) {
     test_empty_init();
     test_init_repeatingValue();
@@ -794,10 +895,12 @@ int main(void) {
     test_find();
     test_merge();
     test_sort();
+    test_merge_sort();
     test_union();
     test_intersection();
     test_difference();
     test_symmetric_difference();
     test_includes();
+    test_pool();
     return 0;
 }
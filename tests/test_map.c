@@ -1,6 +1,7 @@
 #include "map.h"
 #ifndef __CDS_SCAN
 #include <assert.h>
+#include <stdio.h>
 #endif
 
 #define freeNestedMap(x) map_free(strv_int, x)
@@ -15,6 +16,12 @@ gen_map_source(strv_int, char *, int, ds_cmp_str_lt, DSDefault_deepCopyStr, DSDe
 gen_map_source(strp_int, char *, int, ds_cmp_str_lt, DSDefault_shallowCopy, DSDefault_shallowDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
 gen_map_source(nested, char *, Map_strv_int *, ds_cmp_str_lt, DSDefault_deepCopyStr, DSDefault_deepDelete, DSDefault_shallowCopy, freeNestedMap)
 
+gen_map_headers_withRank(rint_str, int, char *)
+gen_map_source(rint_str, int, char *, ds_cmp_num_lt, DSDefault_shallowCopy, DSDefault_shallowDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
+
+gen_map_headers_btree(bstr_int, char *, int)
+gen_map_source_btree(bstr_int, char *, int, ds_cmp_str_lt, DSDefault_deepCopyStr, DSDefault_deepDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
+
 int ints_rand[] = {200,25,220,120,5,205,50,15,60,235,10,70,130,105,185,225,90,30,155,100,150,0,95,170,190,
 125,210,75,45,160,175,145,55,230,35,65,110,140,115,20,215,85,195,240,245,135,80,180,40,165};
 int ints[] = {0,5,10,15,20,25,30,35,40,45,50,55,60,65,70,75,80,85,90,95,100,105,110,115,120,125,
@@ -612,6 +619,154 @@ void test_nested_dicts(void) {
     map_free(nested, m);
 }
 
+void test_range(void) {
+    Map_strv_int *m = map_new(strv_int);
+    MapEntry_strv_int *it, *first, *last;
+    Pair_strv_int p;
+    unsigned i;
+    for (i = 0; i < 50; ++i) {
+        p.first = strs_rand[i];
+        p.second = ints_rand[i];
+        map_insert(strv_int, m, p);
+    }
+    assert(map_lower_bound(strv_int, m, "100")->data.second == 100);
+    assert(map_lower_bound(strv_int, m, "1")->data.second == 100);
+    assert(map_upper_bound(strv_int, m, "100")->data.second == 105);
+    assert(!map_upper_bound(strv_int, m, "245"));
+    map_equal_range(strv_int, m, "050", first, last);
+    assert(first->data.second == 50 && last->data.second == 55);
+
+    i = 0;
+    map_iter_range(strv_int, m, "1", "2", it) {
+        assert(streq(it->data.first, strs[20 + i]) && it->data.second == ints[20 + i]);
+        ++i;
+    }
+    assert(i == 20);
+    map_free(strv_int, m);
+}
+
+void test_rank(void) {
+    Map_rint_str *m = map_new(rint_str);
+    MapEntry_rint_str *e;
+    Pair_rint_str p;
+    unsigned i;
+    for (i = 0; i < 50; ++i) {
+        p.first = ints_rand[i];
+        p.second = strs_rand[i];
+        map_insert(rint_str, m, p);
+    }
+    for (i = 0; i < 50; ++i) {
+        e = map_at_rank(rint_str, m, i);
+        assert(e->data.first == ints[i] && streq(e->data.second, strs[i]));
+        assert(map_rank_of(rint_str, m, ints[i]) == i);
+    }
+    assert(!map_at_rank(rint_str, m, 50));
+    assert(map_count_range(rint_str, m, 0, 250) == 50);
+    assert(map_count_range(rint_str, m, 3, 28) == 5);
+    e = map_find(rint_str, m, 100);
+    mapEntry_advance(rint_str, &e, 10);
+    assert(e->data.first == 150);
+    assert(mapEntry_distance(rint_str, map_iterator_begin(rint_str, m), e) == 30);
+    map_erase(rint_str, m, map_find(rint_str, m, 50), map_find(rint_str, m, 200));
+    assert(map_count_range(rint_str, m, 0, 250) == 20);
+    assert(map_rank_of(rint_str, m, 200) == 10 && map_at_rank(rint_str, m, 10)->data.first == 200);
+    map_free(rint_str, m);
+}
+
+void test_btree(void) {
+    Map_bstr_int *m = map_new(bstr_int), *copy;
+    MapEntry_bstr_int *e;
+    Pair_bstr_int p;
+    int i, inserted, *value;
+    char buf[16];
+    p.first = buf;
+    for (i = 0; i < 3000; ++i) {
+        sprintf(buf, "%04d", (i * 7919) % 3000);
+        p.second = (i * 7919) % 3000;
+        e = map_insert_withResult(bstr_int, m, p, &inserted);
+        assert(e && inserted && e->data.first != buf && streq(e->data.first, buf));
+    }
+    sprintf(buf, "%04d", 10);
+    p.second = -10;
+    e = map_insert_withResult(bstr_int, m, p, &inserted);
+    assert(e && !inserted && e->data.second == -10);
+    assert(map_size(m) == 3000 && m->root->level);
+    assert((value = map_at(bstr_int, m, "2999")) && *value == 2999);
+    assert(!map_at(bstr_int, m, "3000") && !map_find(bstr_int, m, "-1"));
+
+    for (i = 1; i < 3000; i += 2) {
+        sprintf(buf, "%04d", i);
+        e = map_remove_key(bstr_int, m, buf);
+        assert(e == MAP_END || atoi(e->data.first) == i + 1);
+    }
+    assert(map_size(m) == 1500);
+    i = 0;
+    map_iter(bstr_int, m, e) {
+        sprintf(buf, "%04d", i);
+        assert(streq(e->data.first, buf) && e->data.second == (i == 10 ? -10 : i));
+        i += 2;
+    }
+    i = 2998;
+    map_riter(bstr_int, m, e) {
+        assert(e->data.second == (i == 10 ? -10 : i));
+        i -= 2;
+    }
+    assert(i == -2);
+
+    copy = map_createCopy(bstr_int, m);
+    e = map_find(bstr_int, m, "0100");
+    assert(map_erase(bstr_int, m, e, map_find(bstr_int, m, "2000")) ==
+           map_find(bstr_int, m, "2000"));
+    assert(map_size(m) == 550);
+    e = map_iterator_begin(bstr_int, m);
+    mapEntry_advance(bstr_int, &e, 50);
+    assert(streq(e->data.first, "2000"));
+    assert(mapEntry_distance(bstr_int, map_iterator_begin(bstr_int, m), e) == 50);
+    map_clear(bstr_int, m);
+    assert(map_empty(m) && !map_size(m));
+    assert(map_size(copy) == 1500 && *map_at(bstr_int, copy, "1000") == 1000);
+    map_free(bstr_int, m);
+    map_free(bstr_int, copy);
+}
+
+void test_merge(void) {
+    char *keys[] = {"a", "b", "c", "d", "e"};
+    int values[] = {1, 20, 3, 40, 5};
+    Map_strv_int *m1 = map_new(strv_int), *m2 = map_new(strv_int);
+    Pair_strv_int p;
+    int i;
+    for (i = 0; i < 5; ++i) {
+        p.first = keys[i];
+        p.second = i + 1;
+        if (i % 2 == 0) map_insert(strv_int, m1, p);
+        p.second = (i + 1) * 10;
+        if (i != 4) map_insert(strv_int, m2, p);
+    }
+    assert(map_merge(strv_int, m1, m2));
+    compare_strv_int(m1, keys, values, 5);
+    assert(map_empty(m2) && map_size(m2) == 0);
+    map_free(strv_int, m1);
+    map_free(strv_int, m2);
+}
+
+void test_init_fromSortedArray(void) {
+    char *keys[] = {"a", "b", "c", "d", "e"};
+    int values[] = {1, 2, 3, 4, 5};
+    Pair_strv_int arr[5];
+    Map_strv_int *m;
+    int i;
+    for (i = 0; i < 5; ++i) {
+        arr[i].first = keys[i];
+        arr[i].second = values[i];
+    }
+    m = map_new_fromSortedArray(strv_int, arr, 5);
+    compare_strv_int(m, keys, values, 5);
+    assert(map_find(strv_int, m, "c")->data.first != keys[2]);
+    map_remove_key(strv_int, m, "c");
+    assert(map_size(m) == 4 && !map_find(strv_int, m, "c"));
+    map_free(strv_int, m);
+}
+
 int main(void) {
     test_empty_init();
     test_init_fromArray();
@@ -624,5 +779,10 @@ int main(void) {
     test_erase_entries();
     test_find();
     test_nested_dicts();
+    test_range();
+    test_rank();
+    test_btree();
+    test_merge();
+    test_init_fromSortedArray();
     return 0;
 }
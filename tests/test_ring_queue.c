@@ -0,0 +1,218 @@
+#define _POSIX_C_SOURCE 200112L
+#include "ring_queue.h"
+#ifndef __CDS_SCAN
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define NTHREADS 4
+#define PER_THREAD 20000
+#define BATCH 7
+
+gen_spsc_queue_headers(int, int)
+gen_spsc_queue_headers(str, char *)
+gen_mpmc_queue_headers(int, unsigned long)
+gen_mpmc_queue_headers(str, char *)
+
+gen_spsc_queue_source(int, int, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_spsc_queue_source(str, char *, DSDefault_deepCopyStr, DSDefault_deepDelete)
+gen_mpmc_queue_source(int, unsigned long, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_mpmc_queue_source(str, char *, DSDefault_deepCopyStr, DSDefault_deepDelete)
+
+char *strs[] = {"000","001","002","003","004","005","006","007","008","009"};
+
+typedef struct {
+    MPMCQueue_int *q;
+    unsigned long tid;
+    unsigned long sum;
+    unsigned long count;
+} ThreadArg;
+
+unsigned long consumed = 0;
+
+void test_spsc_single_thread(void) {
+    int i, val, arr[20], out[20];
+    SPSCQueue_int *q = spsc_queue_new(int, 5);
+    assert(spsc_queue_capacity(q) == 8);
+    assert(spsc_queue_size(q) == 0);
+    assert(!spsc_queue_pop(int, q, &val));
+    /* wrap around the buffer a few times */
+    for (i = 0; i < 30; ++i) {
+        assert(spsc_queue_push(int, q, i));
+        assert(spsc_queue_push(int, q, i + 100));
+        assert(spsc_queue_size(q) == 2);
+        assert(spsc_queue_pop(int, q, &val) && val == i);
+        assert(spsc_queue_pop(int, q, &val) && val == i + 100);
+    }
+    for (i = 0; i < 20; ++i) {
+        arr[i] = i;
+    }
+    assert(spsc_queue_push_n(int, q, arr, 5) == 5);
+    assert(spsc_queue_push_n(int, q, arr + 5, 15) == 3);
+    assert(!spsc_queue_push(int, q, 0));
+    assert(spsc_queue_size(q) == 8);
+    assert(spsc_queue_pop_n(int, q, out, 6) == 6);
+    assert(spsc_queue_push_n(int, q, arr + 8, 12) == 6);
+    assert(spsc_queue_pop_n(int, q, out + 6, 20) == 8);
+    for (i = 0; i < 14; ++i) {
+        assert(out[i] == i);
+    }
+    assert(spsc_queue_pop_n(int, q, out, 20) == 0);
+    spsc_queue_free(int, q);
+}
+
+void test_mpmc_single_thread(void) {
+    unsigned long i, val, arr[20], out[20];
+    MPMCQueue_int *q = mpmc_queue_new(int, 8);
+    assert(mpmc_queue_capacity(q) == 8);
+    assert(!mpmc_queue_pop(int, q, &val));
+    for (i = 0; i < 30; ++i) {
+        assert(mpmc_queue_push(int, q, i));
+        assert(mpmc_queue_pop(int, q, &val) && val == i);
+    }
+    for (i = 0; i < 20; ++i) {
+        arr[i] = i;
+    }
+    assert(mpmc_queue_push_n(int, q, arr, 5) == 5);
+    assert(mpmc_queue_push_n(int, q, arr + 5, 15) == 3);
+    assert(!mpmc_queue_push(int, q, 0));
+    assert(mpmc_queue_size(q) == 8);
+    assert(mpmc_queue_pop_n(int, q, out, 6) == 6);
+    assert(mpmc_queue_push_n(int, q, arr + 8, 12) == 6);
+    assert(mpmc_queue_pop_n(int, q, out + 6, 20) == 8);
+    for (i = 0; i < 14; ++i) {
+        assert(out[i] == i);
+    }
+    assert(mpmc_queue_pop_n(int, q, out, 20) == 0);
+    assert(mpmc_queue_size(q) == 0);
+    mpmc_queue_free(int, q);
+}
+
+void test_deep_copy(void) {
+    char *s;
+    SPSCQueue_str *sq = spsc_queue_new(str, 4);
+    MPMCQueue_str *mq = mpmc_queue_new(str, 4);
+    assert(spsc_queue_push_n(str, sq, strs, 10) == 4);
+    assert(mpmc_queue_push_n(str, mq, strs, 10) == 4);
+    assert(spsc_queue_pop(str, sq, &s));
+    assert(s != strs[0] && streq(s, strs[0]));
+    free(s);
+    assert(mpmc_queue_pop(str, mq, &s));
+    assert(s != strs[0] && streq(s, strs[0]));
+    free(s);
+    /* the remaining elements are freed with the queues */
+    spsc_queue_free(str, sq);
+    mpmc_queue_free(str, mq);
+}
+
+static void *spsc_producer(void *p) {
+    SPSCQueue_int *q = p;
+    int i = 0, arr[BATCH];
+    while (i < PER_THREAD) {
+        int j, n = min(BATCH, PER_THREAD - i);
+        for (j = 0; j < n; ++j) {
+            arr[j] = i + j;
+        }
+        j = (int) spsc_queue_push_n(int, q, arr, (size_t) n);
+        if (!j) {
+            sched_yield();
+        }
+        i += j;
+    }
+    return NULL;
+}
+
+void test_spsc_threads(void) {
+    pthread_t producer;
+    int i = 0, val;
+    SPSCQueue_int *q = spsc_queue_new(int, 64);
+    assert(pthread_create(&producer, NULL, spsc_producer, q) == 0);
+    while (i < PER_THREAD) {
+        if (spsc_queue_pop(int, q, &val)) {
+            assert(val == i);
+            ++i;
+        } else {
+            sched_yield();
+        }
+    }
+    pthread_join(producer, NULL);
+    assert(spsc_queue_size(q) == 0);
+    spsc_queue_free(int, q);
+}
+
+static void *mpmc_producer(void *p) {
+    ThreadArg *arg = p;
+    unsigned long i = 0, arr[BATCH];
+    while (i < PER_THREAD) {
+        unsigned long j, n = min(BATCH, PER_THREAD - i);
+        for (j = 0; j < n; ++j) {
+            /* low bits hold the producer so consumers can check its order */
+            arr[j] = (i + j) * NTHREADS + arg->tid;
+        }
+        j = mpmc_queue_push_n(int, arg->q, arr, n);
+        if (!j) {
+            sched_yield();
+        }
+        i += j;
+    }
+    return NULL;
+}
+
+static void *mpmc_consumer(void *p) {
+    ThreadArg *arg = p;
+    unsigned long i, n, out[BATCH], last[NTHREADS];
+    for (i = 0; i < NTHREADS; ++i) {
+        last[i] = 0;
+    }
+    while (__atomic_load_n(&consumed, __ATOMIC_RELAXED) < NTHREADS * PER_THREAD) {
+        n = mpmc_queue_pop_n(int, arg->q, out, BATCH);
+        if (!n) {
+            sched_yield();
+            continue;
+        }
+        __atomic_fetch_add(&consumed, n, __ATOMIC_RELAXED);
+        for (i = 0; i < n; ++i) {
+            unsigned long tid = out[i] % NTHREADS, seq = out[i] / NTHREADS + 1;
+            assert(seq > last[tid]);
+            last[tid] = seq;
+            arg->sum += out[i];
+            ++arg->count;
+        }
+    }
+    return NULL;
+}
+
+void test_mpmc_threads(void) {
+    pthread_t producers[NTHREADS], consumers[NTHREADS];
+    ThreadArg pargs[NTHREADS], cargs[NTHREADS];
+    unsigned long i, sum = 0, count = 0;
+    const unsigned long total = NTHREADS * PER_THREAD;
+    MPMCQueue_int *q = mpmc_queue_new(int, 128);
+    for (i = 0; i < NTHREADS; ++i) {
+        pargs[i].q = cargs[i].q = q;
+        pargs[i].tid = cargs[i].tid = i;
+        cargs[i].sum = cargs[i].count = 0;
+        assert(pthread_create(&consumers[i], NULL, mpmc_consumer, &cargs[i]) == 0);
+        assert(pthread_create(&producers[i], NULL, mpmc_producer, &pargs[i]) == 0);
+    }
+    for (i = 0; i < NTHREADS; ++i) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+        sum += cargs[i].sum;
+        count += cargs[i].count;
+    }
+    assert(count == total);
+    assert(sum == total * (total - 1) / 2);
+    assert(mpmc_queue_size(q) == 0);
+    mpmc_queue_free(int, q);
+}
+
+int main(void) {
+    test_spsc_single_thread();
+    test_mpmc_single_thread();
+    test_deep_copy();
+    test_spsc_threads();
+    test_mpmc_threads();
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include "set.h"
 #ifndef __CDS_SCAN
 #include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
 #endif
 
 gen_set_headers(int, int)
@@ -8,6 +10,17 @@ gen_set_headers(str, char *)
 gen_set_source(int, int, ds_cmp_num_lt, DSDefault_shallowCopy, DSDefault_shallowDelete)
 gen_set_source(str, char *, ds_cmp_str_lt, DSDefault_deepCopyStr, DSDefault_deepDelete)
 
+gen_set_headers(ld, long double)
+gen_set_source(ld, long double, ds_cmp_num_lt, DSDefault_shallowCopy, DSDefault_shallowDelete)
+
+gen_set_headers_withRank(rint, int)
+gen_set_source(rint, int, ds_cmp_num_lt, DSDefault_shallowCopy, DSDefault_shallowDelete)
+
+gen_set_headers_btree(bint, int)
+gen_set_headers_btree(bstr, char *)
+gen_set_source_btree(bint, int, ds_cmp_num_lt, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_set_source_btree(bstr, char *, ds_cmp_str_lt, DSDefault_deepCopyStr, DSDefault_deepDelete)
+
 int ints_rand[] = {200,25,220,120,5,205,50,15,60,235,10,70,130,105,185,225,90,30,155,100,150,0,95,170,190,
 125,210,75,45,160,175,145,55,230,35,65,110,140,115,20,215,85,195,240,245,135,80,180,40,165};
 int ints[] = {0,5,10,15,20,25,30,35,40,45,50,55,60,65,70,75,80,85,90,95,100,105,110,115,120,125,
@@ -551,6 +564,381 @@ void test_disjoint(void) {
     set_free(str, ss3);
 }
 
+void test_pool(void) {
+    Set_str *ss = set_new_withPool(str, 16), *copy;
+    Set_int *si = set_new_withPool(int, 4);
+    SetEntry_int *e;
+    int i;
+    for (i = 0; i < 50; ++i) {
+        set_insert(str, ss, strs_rand[i]);
+        set_insert(int, si, ints_rand[i]);
+    }
+    compare_strs(ss, strs, 50);
+    compare_ints(si, ints, 50);
+    for (i = 0; i < 50; i += 2) {
+        set_remove_value(int, si, ints[i]);
+    }
+    for (i = 0; i < 50; i += 2) {
+        set_insert(int, si, ints[i]);
+    }
+    compare_ints(si, ints, 50);
+
+    copy = set_createCopy(str, ss);
+    assert(copy->pool.chunk == 16);
+    set_clear(str, ss);
+    assert(set_empty(ss) && !set_size(ss) && !ss->pool.slabs);
+    compare_strs(copy, strs, 50);
+    set_insert_fromArray(str, ss, strs, 10);
+    compare_strs(ss, strs, 10);
+
+    e = set_iterator_begin(int, si);
+    setEntry_advance(int, &e, 10);
+    assert(set_erase(int, si, e, NULL) == SET_END);
+    compare_ints(si, ints, 10);
+    set_free(int, si);
+    set_free(str, ss);
+    set_free(str, copy);
+}
+
+typedef struct {
+    char c;
+    long double ld;
+} LongDoubleAlign;
+
+void check_aligned(Set_ld *s, unsigned size) {
+    SetEntry_ld *e;
+    unsigned i = 0;
+    set_iter(ld, s, e) {
+        assert((size_t) &e->data % offsetof(LongDoubleAlign, ld) == 0);
+        assert(e->data == (long double) i++);
+    }
+    assert(i == size);
+}
+
+void test_pool_alignment(void) {
+    Set_ld *s = set_new_withPool(ld, 5);
+    long double arr[5];
+    int i;
+    for (i = 49; i >= 0; --i) {
+        set_insert(ld, s, (long double) i);
+    }
+    check_aligned(s, 50);
+    set_free(ld, s);
+
+    /* entries built from a sorted array share one slab without asking for a pool */
+    for (i = 0; i < 5; ++i) {
+        arr[i] = (long double) i;
+    }
+    s = set_new_fromSortedArray(ld, arr, 5);
+    check_aligned(s, 5);
+    set_free(ld, s);
+}
+
+void test_bounds(void) {
+    Set_int *si = set_new_fromArray(int, ints_rand, 50);
+    Set_bint *sb = set_new(bint);
+    SetEntry_int *first, *last, *it;
+    SetEntry_bint *bit;
+    int i = 0;
+    assert(set_lower_bound(int, si, 15)->data == 15);
+    assert(set_lower_bound(int, si, 16)->data == 20);
+    assert(set_upper_bound(int, si, 15)->data == 20);
+    assert(set_lower_bound(int, si, -5)->data == 0);
+    assert(!set_lower_bound(int, si, 246) && !set_upper_bound(int, si, 245));
+    set_equal_range(int, si, 100, first, last);
+    assert(first->data == 100 && last->data == 105);
+    set_equal_range(int, si, 101, first, last);
+    assert(first == last && first->data == 105);
+
+    set_iter_range(int, si, 42, 100, it) {
+        assert(it->data == ints[9 + i++]);
+    }
+    assert(i == 11);
+    set_iter_range(int, si, 100, 42, it) {
+        assert(0);
+    }
+
+    for (i = 0; i < 5000; ++i) {
+        set_insert(bint, sb, 2 * i);
+    }
+    assert(set_lower_bound(bint, sb, 4001)->data == 4002);
+    assert(set_upper_bound(bint, sb, 4002)->data == 4004);
+    assert(!set_upper_bound(bint, sb, 9998));
+    i = 0;
+    set_iter_range(bint, sb, 1001, 7001, bit) {
+        assert(bit->data == 1002 + 2 * i++);
+    }
+    assert(i == 3000);
+    set_free(int, si);
+    set_free(bint, sb);
+}
+
+void test_rank(void) {
+    Set_rint *sr = set_new(rint);
+    Set_int *si = set_new(int);
+    Set_bint *sb = set_new(bint);
+    SetEntry_rint *e, *f;
+    int i;
+    for (i = 0; i < 50; ++i) {
+        set_insert(rint, sr, ints_rand[i]);
+        set_insert(int, si, ints_rand[i]);
+        set_insert(bint, sb, ints_rand[i]);
+    }
+    for (i = 0; i < 50; ++i) {
+        assert(set_at_rank(rint, sr, (unsigned) i)->data == ints[i]);
+        assert(set_at_rank(int, si, (unsigned) i)->data == ints[i]);
+        assert(set_at_rank(bint, sb, (unsigned) i)->data == ints[i]);
+        assert(set_rank_of(rint, sr, ints[i]) == (unsigned) i);
+        assert(set_rank_of(rint, sr, ints[i] + 1) == (unsigned) i + 1);
+        assert(set_rank_of(int, si, ints[i]) == (unsigned) i);
+        assert(set_rank_of(bint, sb, ints[i] + 1) == (unsigned) i + 1);
+    }
+    assert(!set_at_rank(rint, sr, 50) && !set_at_rank(bint, sb, 50));
+    assert(set_rank_of(rint, sr, -1) == 0 && set_rank_of(rint, sr, 1000) == 50);
+    assert(set_count_range(rint, sr, 10, 101) == 19);
+    assert(set_count_range(int, si, 10, 101) == 19);
+    assert(set_count_range(bint, sb, 10, 101) == 19);
+    assert(set_count_range(rint, sr, 101, 10) == 0);
+
+    e = set_at_rank(rint, sr, 5);
+    f = e;
+    setEntry_advance(rint, &f, 40);
+    assert(f->data == ints[45]);
+    assert(setEntry_distance(rint, e, f) == 40);
+    assert(setEntry_distance(rint, f, e) == -1);
+    assert(setEntry_distance(rint, e, NULL) == 45);
+    setEntry_advance(rint, &f, -45);
+    assert(f->data == ints[0]);
+    setEntry_advance(rint, &f, -1);
+    assert(!f);
+
+    for (i = 0; i < 50; i += 2) {
+        set_remove_value(rint, sr, ints[i]);
+    }
+    for (i = 0; i < 25; ++i) {
+        assert(set_at_rank(rint, sr, (unsigned) i)->data == ints[2 * i + 1]);
+    }
+    set_free(rint, sr);
+    set_free(int, si);
+    set_free(bint, sb);
+}
+
+void test_btree(void) {
+    Set_bint *si = set_new(bint), *copy;
+    Set_bstr *ss = set_new_withPool(bstr, 64);
+    SetEntry_bint *e, *end;
+    SetEntry_bstr *es;
+    int i, inserted;
+    char buf[16];
+    for (i = 0; i < 5000; ++i) {
+        e = set_insert_withResult(bint, si, (i * 7919) % 5000, &inserted);
+        assert(e && e->data == (i * 7919) % 5000 && inserted);
+    }
+    e = set_insert_withResult(bint, si, 42, &inserted);
+    assert(e && e->data == 42 && !inserted);
+    assert(set_size(si) == 5000 && si->root->level > 1);
+    i = 0;
+    set_iter(bint, si, e) {
+        assert(e->data == i++);
+    }
+    assert(i == 5000);
+    set_riter(bint, si, e) {
+        assert(e->data == --i);
+    }
+    assert(set_contains(bint, si, 4999) && !set_contains(bint, si, 5000));
+
+    e = set_iterator_begin(bint, si);
+    setEntry_advance(bint, &e, 1234);
+    assert(e->data == 1234);
+    setEntry_advance(bint, &e, -1000);
+    assert(e->data == 234);
+    end = set_find(bint, si, 4000);
+    assert(setEntry_distance(bint, e, end) == 3766);
+    assert(setEntry_distance(bint, end, e) == -1);
+    assert(setEntry_distance(bint, e, NULL) == 4766);
+
+    for (i = 0; i < 5000; i += 2) {
+        e = set_remove_value(bint, si, i);
+        assert(e && e->data == i + 1);
+    }
+    assert(set_size(si) == 2500);
+    e = set_find(bint, si, 1001);
+    e = set_erase(bint, si, e, set_find(bint, si, 3001));
+    assert(e && e->data == 3001);
+    assert(set_size(si) == 1500);
+    copy = set_createCopy(bint, si);
+    i = 1;
+    set_iter(bint, copy, e) {
+        assert(e->data == i);
+        i += i == 999 ? 2002 : 2;
+    }
+    assert(i == 5001);
+    assert(set_remove_value(bint, copy, 4999) == SET_END);
+    set_clear(bint, copy);
+    assert(set_empty(copy) && !set_size(copy) && !set_iterator_begin(bint, copy));
+
+    for (i = 0; i < 2000; ++i) {
+        sprintf(buf, "%04d", (i * 7919) % 2000);
+        set_insert(bstr, ss, buf);
+    }
+    sprintf(buf, "%04d", 1500);
+    es = set_find(bstr, ss, buf);
+    assert(es && streq(es->data, "1500") && es->data != buf);
+    assert(set_erase(bstr, ss, es, NULL) == SET_END);
+    assert(set_size(ss) == 1500);
+    i = 0;
+    set_iter(bstr, ss, es) {
+        sprintf(buf, "%04d", i++);
+        assert(streq(es->data, buf));
+    }
+    assert(i == 1500);
+    set_free(bint, si);
+    set_free(bint, copy);
+    set_free(bstr, ss);
+}
+
+void test_btree_algebra(void) {
+    Set_bint *a = set_new(bint), *b = set_new(bint), *u, *n, *d, *x;
+    SetEntry_bint *e;
+    int i;
+    for (i = 0; i < 3000; i += 2) {
+        set_insert(bint, a, i);
+    }
+    for (i = 0; i < 3000; i += 3) {
+        set_insert(bint, b, i);
+    }
+    u = set_union(bint, a, b);
+    n = set_intersection(bint, a, b);
+    d = set_difference(bint, a, b);
+    x = set_symmetric_difference(bint, a, b);
+    assert(set_size(u) == 2000 && set_size(n) == 500);
+    assert(set_size(d) == 1000 && set_size(x) == 1500);
+    set_iter(bint, n, e) {
+        assert(e->data % 6 == 0);
+    }
+    set_iter(bint, x, e) {
+        assert((e->data % 2 == 0) != (e->data % 3 == 0));
+    }
+    assert(set_issubset(bint, n, a) && set_issuperset(bint, u, b));
+    assert(!set_isdisjoint(bint, a, b) && set_isdisjoint(bint, d, b));
+    set_free(bint, a);
+    set_free(bint, b);
+    set_free(bint, u);
+    set_free(bint, n);
+    set_free(bint, d);
+    set_free(bint, x);
+}
+
+void test_merge(void) {
+    char *strs[] = {"a", "c", "e", "g"}, *others[] = {"b", "c", "d", "g", "h"};
+    char *merged[] = {"a", "b", "c", "d", "e", "g", "h"};
+    Set_rint *a = set_new(rint), *b = set_new(rint), *u;
+    Set_int *pooled = set_new_withPool(int, 8), *c = set_new(int);
+    Set_str *s1 = set_new_fromArray(str, strs, 4), *s2 = set_new_fromArray(str, others, 5);
+    SetEntry_rint *e;
+    int i, prev = -1;
+    for (i = 0; i < 3000; i += 2) {
+        set_insert(rint, a, i);
+    }
+    for (i = 0; i < 3000; i += 3) {
+        set_insert(rint, b, i);
+    }
+    u = set_union(rint, a, b);
+    assert(set_merge(rint, a, b));
+    assert(set_size(a) == 2000 && set_size(u) == 2000);
+    assert(set_empty(b) && set_size(b) == 0);
+    set_iter(rint, a, e) {
+        assert(e->data > prev && (e->data % 2 == 0 || e->data % 3 == 0));
+        prev = e->data;
+    }
+    for (i = 0; i < 2000; i += 250) {
+        e = set_at_rank(rint, a, (unsigned) i);
+        assert(e->data == set_at_rank(rint, u, (unsigned) i)->data);
+        assert(set_rank_of(rint, a, e->data) == (unsigned) i);
+    }
+    assert(set_merge(rint, a, a) && set_size(a) == 2000);
+    set_insert(rint, b, 1);
+    assert(set_size(b) == 1);
+
+    for (i = 0; i < 100; ++i) {
+        set_insert(int, pooled, i * 2);
+        set_insert(int, c, i * 5);
+    }
+    assert(set_merge(int, pooled, c));
+    assert(set_size(pooled) == 180 && set_empty(c));
+
+    assert(set_merge(str, s1, s2));
+    compare_strs(s1, merged, 7);
+    assert(set_empty(s2));
+    set_free(rint, a);
+    set_free(rint, b);
+    set_free(rint, u);
+    set_free(int, pooled);
+    set_free(int, c);
+    set_free(str, s1);
+    set_free(str, s2);
+}
+
+unsigned count_slabs(void *slabs) {
+    unsigned n = 0;
+    DSPoolSlabHeader *slab;
+    for (slab = slabs; slab; slab = slab->next) ++n;
+    return n;
+}
+
+void test_init_fromSortedArray(void) {
+    int arr[500], unsorted[] = {5, 1, 3};
+    int sorted[] = {1, 3, 5};
+    Set_int *s;
+    Set_bint *b, *b2;
+    SetEntry_bint *e;
+    int i;
+    for (i = 0; i < 500; ++i) {
+        arr[i] = i;
+    }
+    s = set_new_fromSortedArray(int, arr, 500);
+    compare_ints(s, arr, 500);
+    for (i = 0; i < 500; i += 2) {
+        set_remove_value(int, s, i);
+    }
+    set_insert(int, s, 1000);
+    assert(set_size(s) == 251 && set_contains(int, s, 499) && !set_contains(int, s, 0));
+    set_free(int, s);
+
+    s = set_new_fromSortedArray(int, unsorted, 3);
+    compare_ints(s, sorted, 3);
+    set_free(int, s);
+
+    b = set_new_fromSortedArray(bint, arr, 500);
+    assert(set_size(b) == 500 && !((DSPoolSlabHeader *) b->slabs)->next);
+    i = 0;
+    set_iter(bint, b, e) {
+        assert(e->data == i++);
+    }
+    set_free(bint, b);
+
+    /* unsorted input is inserted normally instead of into one huge slab */
+    for (i = 0; i < 500; ++i) {
+        arr[i] = 499 - i;
+    }
+    b = set_new_fromSortedArray(bint, arr, 500);
+    b2 = set_new_fromArray(bint, arr, 500);
+    assert(set_size(b) == 500 && count_slabs(b->slabs) == count_slabs(b2->slabs));
+    i = 0;
+    set_iter(bint, b, e) {
+        assert(e->data == i++);
+    }
+    set_free(bint, b);
+    set_free(bint, b2);
+    b = set_new_fromSortedArray(bint, unsorted, 3);
+    i = 0;
+    set_iter(bint, b, e) {
+        assert(e->data == sorted[i++]);
+    }
+    assert(i == 3);
+    set_free(bint, b);
+}
+
 int main(void) {
     test_empty_init();
     test_init_fromArray();
@@ -568,5 +956,13 @@ int main(void) {
     test_symmetric_difference();
     test_subset_superset();
     test_disjoint();
+    test_pool();
+    test_pool_alignment();
+    test_bounds();
+    test_rank();
+    test_btree();
+    test_btree_algebra();
+    test_merge();
+    test_init_fromSortedArray();
     return 0;
 }
@@ -493,6 +493,48 @@ void test_rfind(void) {
     string_free(s);
 }
 
+void test_find_long(void) {
+    String *s = string_new_repeatingChar(200, 'a');
+    string_replace(s, 70, 3, "abc", 3);
+    string_replace(s, 130, 3, "abc", 3);
+    string_replace(s, 170, 2, "xy", 2);
+    assert(string_find(s, 0, "abc", 3) == 70);
+    assert(string_find(s, 71, "abc", 3) == 130);
+    assert(string_find(s, 131, "abc", 3) == STRING_NPOS);
+    assert(string_find(s, 0, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", 41) == 31);
+    assert(string_rfind(s, 199, "abc", 3) == 130);
+    assert(string_rfind(s, 131, "abc", 3) == 70);
+    assert(string_rfind(s, 71, "abc", 3) == STRING_NPOS);
+    assert(string_find_first_of(s, 0, "cyx", 3) == 72);
+    assert(string_find_first_of(s, 73, "yx", 2) == 170);
+    assert(string_find_first_not_of(s, 0, "a", 1) == 71);
+    assert(string_find_first_not_of(s, 100, "ab", 2) == 132);
+    assert(string_find_last_of(s, 199, "bc", 2) == 132);
+    assert(string_find_last_not_of(s, 199, "a", 1) == 171);
+    string_free(s);
+}
+
+void test_searcher(void) {
+    StringSearcher searcher;
+    String *s = string_new_fromCStr("ABC ABCDAB ABCDABCDABDE", 23);
+    String *other = string_new_fromCStr("xxABCDABD", 9);
+    string_searcher_init(&searcher, "ABCDABD", DS_ARG_NOT_APPLICABLE);
+    assert(string_find_with(&searcher, s, 0) == 15);
+    assert(string_find_with(&searcher, s, 15) == 15);
+    assert(string_find_with(&searcher, s, 16) == STRING_NPOS);
+    assert(string_find_with(&searcher, s, 23) == STRING_ERROR);
+    assert(string_find_with(&searcher, other, 0) == 2);
+    assert(string_find_with(&searcher, other, 3) == STRING_NPOS);
+
+    string_searcher_init(&searcher, "D", 1);
+    assert(string_find_with(&searcher, s, 0) == 7);
+    assert(string_find_with(&searcher, s, 8) == 14);
+    string_searcher_init(&searcher, "", 5);
+    assert(string_find_with(&searcher, s, 4) == 4);
+    string_free(other);
+    string_free(s);
+}
+
 void test_split(void) {
     int i = 0, count = 0;
     unsigned len1[] = {22,33};
@@ -528,6 +570,46 @@ void test_split(void) {
     string_free(s);
 }
 
+void test_split_views(void) {
+    int i = 0;
+    unsigned len[] = {4,3,7,6,10,4,4,5,5};
+    const char *cmp[] = {"this","has","several","words,","definitely","more","than","eight","words"};
+    StringView views[9], token;
+    StringTokenizer it;
+    String *s = string_new();
+    assert(string_split_views(s, ":", views, 9) == 0);
+    string_append(s, "this has several words, definitely more than eight words", 56);
+    assert(string_split_views(s, "", views, 9) == 0);
+
+    assert(string_split_views(s, ":", views, 9) == 1);
+    assert(views[0].s == s->s && views[0].len == 56);
+
+    assert(string_split_views(s, " ", views, 4) == 9);
+    assert(string_split_views(s, " ", views, 9) == 9);
+    for (i = 0; i < 9; ++i) {
+        assert(views[i].len == len[i]);
+        assert(!memcmp(views[i].s, cmp[i], len[i]));
+    }
+
+    i = 0;
+    string_iter_tokens(s, &it, ", ", token) {
+        assert(token.s == (i ? &s->s[24] : s->s));
+        assert(token.len == (i ? 32 : 22));
+        ++i;
+    }
+    assert(i == 2);
+
+    string_clear(s);
+    string_append(s, "::a::::b::", 10);
+    i = 0;
+    string_iter_tokens(s, &it, "::", token) {
+        assert(token.len == (unsigned) (i == 1 || i == 3));
+        ++i;
+    }
+    assert(i == 5);
+    string_free(s);
+}
+
 void test_has_certain_chars(void) {
     String *s = string_new();
     assert(!isAlphaNum(string_c_str(s)));
@@ -609,6 +691,40 @@ void test_format(void) {
 #endif
 }
 
+void test_inline_storage(void) {
+    String *s = string_new_fromCStr(testStr, 10);
+    assert(string_c_str(s) == s->buf);
+    string_append(s, &testStr[10], LEN - 10);
+    assert(string_c_str(s) != s->buf && string_capacity(s) == 128);
+    compareStrs(s, testStr, LEN);
+    string_erase(s, 10, DS_ARG_NOT_APPLICABLE);
+    string_shrink_to_fit(s);
+    assert(string_c_str(s) == s->buf && string_capacity(s) == 64);
+    compareStrs(s, testStr, 10);
+    string_free(s);
+}
+
+void test_arena(void) {
+    StringArena *arena = string_arena_new(256);
+    String *strs[100];
+    int i;
+    for (i = 0; i < 100; ++i) {
+        strs[i] = string_new_inArena(arena, testStr, (unsigned) (i % 20) + 1);
+        assert(strs[i] && strs[i]->arena == arena);
+    }
+    string_append(strs[7], testStr, LEN);
+    assert(string_capacity(strs[7]) == 128);
+    string_free(strs[3]);
+    for (i = 0; i < 100; ++i) {
+        if (i != 7) compareStrs(strs[i], testStr, (unsigned) (i % 20) + 1);
+    }
+    assert(streq(string_c_str(strs[7]) + 8, testStr));
+    string_erase(strs[7], 8, DS_ARG_NOT_APPLICABLE);
+    string_shrink_to_fit(strs[7]);
+    compareStrs(strs[7], testStr, 8);
+    string_arena_free(arena);
+}
+
 int main(void) {
     test_empty_init();
     test_init_repeatingChar();
@@ -639,9 +755,14 @@ int main(void) {
     test_find_last_not_of();
     test_find();
     test_rfind();
+    test_find_long();
+    test_searcher();
     test_split();
+    test_split_views();
     test_has_certain_chars();
     test_case_conversion();
     test_format();
+    test_inline_storage();
+    test_arena();
     return 0;
 }
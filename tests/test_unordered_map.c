@@ -1,19 +1,33 @@
 #include "unordered_map.h"
 #ifndef __CDS_SCAN
 #include <assert.h>
+#include <stdio.h>
 #endif
 
 #define freeNestedMap(x) umap_free(strv_int, x)
+#define countingHash(x, seed) (++hashCalls, murmurhash(x, (int) strlen(x), seed))
+
+unsigned hashCalls = 0;
 
 gen_umap_headers(strv_int, char *, int)
 gen_umap_headers(int_str, int, char *)
 gen_umap_headers(strp_int, char *, int)
 gen_umap_headers(nested, char *, UMap_strv_int *)
+gen_umap_headers_flat(flat_int, int, int)
+gen_umap_headers_flat(flat_str, char *, int)
+gen_umap_headers(hashed, unsigned long, int)
+gen_umap_headers_flat(flat_hashed, unsigned long, int)
+gen_umap_headers_storeHash(stored, char *, int)
 
 gen_umap_source(strv_int, char *, int, ds_cmp_str_eq, DSDefault_addrOfRef, DSDefault_sizeOfStr, DSDefault_deepCopyStr, DSDefault_deepDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
 gen_umap_source(int_str, int, char *, ds_cmp_num_eq, DSDefault_addrOfVal, DSDefault_sizeOfVal, DSDefault_shallowCopy, DSDefault_shallowDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
 gen_umap_source(strp_int, char *, int, ds_cmp_str_eq, DSDefault_addrOfRef, DSDefault_sizeOfStr, DSDefault_shallowCopy, DSDefault_shallowDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
 gen_umap_source(nested, char *, UMap_strv_int *, ds_cmp_str_eq, DSDefault_addrOfRef, DSDefault_sizeOfStr, DSDefault_deepCopyStr, DSDefault_deepDelete, DSDefault_shallowCopy, freeNestedMap)
+gen_umap_source_flat(flat_int, int, int, ds_cmp_num_eq, DSDefault_addrOfVal, DSDefault_sizeOfVal, DSDefault_shallowCopy, DSDefault_shallowDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_umap_source_flat(flat_str, char *, int, ds_cmp_str_eq, DSDefault_addrOfRef, DSDefault_sizeOfStr, DSDefault_deepCopyStr, DSDefault_deepDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_umap_source_withHash(hashed, unsigned long, int, ds_cmp_num_eq, DSDefault_hashInt, DSDefault_shallowCopy, DSDefault_shallowDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_umap_source_withHash(stored, char *, int, ds_cmp_str_eq, countingHash, DSDefault_deepCopyStr, DSDefault_deepDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_umap_source_flat_withHash(flat_hashed, unsigned long, int, ds_cmp_num_eq, DSDefault_hashInt, DSDefault_shallowCopy, DSDefault_shallowDelete, DSDefault_shallowCopy, DSDefault_shallowDelete)
 
 char *strs[] = {"000","001","002","003","004","005","006","007","008","009","010","011","012","013","014",
 "015","016","017","018","019","020","021","022","023","024","025","026","027","028","029","030","031","032","033",
@@ -442,7 +456,9 @@ void test_find(void) {
 }
 
 void test_set_load_factor(void) {
-    UMap_int_str *m1 = umap_new(int_str);
+    UMap_int_str *m1 = umap_new(int_str), *c1;
+    UMap_flat_int *f = umap_new(flat_int), *fc;
+    Pair_flat_int fp;
     UMap_strv_int *m2 = umap_new(strv_int);
     UMap_strp_int *m3 = umap_new(strp_int);
     Pair_int_str arrInt[50];
@@ -501,6 +517,22 @@ void test_set_load_factor(void) {
     compare_int_str(m1, data, 50);
     compare_strv_int(m2, data, 50);
     compare_strp_int(m3, data, 50);
+
+    /* copies keep the load factor */
+    c1 = umap_createCopy(int_str, m1);
+    assert(umap_max_load_factor(c1) == 25 && c1->threshold == m1->threshold);
+    compare_int_str(c1, data, 50);
+    umap_set_load_factor(flat_int, f, 50);
+    for (i = 0; i < 50; ++i) {
+        fp.first = fp.second = i;
+        umap_insert(flat_int, f, fp);
+    }
+    fc = umap_createCopy(flat_int, f);
+    assert(umap_max_load_factor(fc) == 50 && fc->threshold == f->threshold);
+    assert(umap_size(fc) == 50 && umap_bucket_count(fc) == umap_bucket_count(f));
+    umap_free(int_str, c1);
+    umap_free(flat_int, f);
+    umap_free(flat_int, fc);
     umap_free(int_str, m1);
     umap_free(strv_int, m2);
     umap_free(strp_int, m3);
@@ -628,6 +660,256 @@ void test_nested_dicts(void) {
     umap_free(nested, m);
 }
 
+void test_flat_backend(void) {
+    UMap_flat_int *m = umap_new(flat_int), *copy;
+    UMap_flat_str *ms;
+    Pair_flat_int p, *it;
+    Pair_flat_str arrStr[50];
+    int i, inserted = 0, count = 0, seen[1000] = {0};
+    for (i = 0; i < 50; ++i) {
+        arrStr[i].first = strs[i];
+        arrStr[i].second = i;
+    }
+
+    assert(umap_bucket_count(m) == 32);
+    for (i = 0; i < 1000; ++i) {
+        p.first = i;
+        p.second = i * 2;
+        assert(umap_insert_withResult(flat_int, m, p, &inserted));
+        assert(inserted);
+    }
+    assert(umap_size(m) == 1000);
+    for (i = 0; i < 1000; ++i) {
+        int *at = umap_at(flat_int, m, i);
+        assert(at && *at == i * 2);
+    }
+    assert(!umap_find(flat_int, m, 1000));
+    p.first = 10;
+    p.second = -1;
+    assert(umap_insert_withResult(flat_int, m, p, &inserted)->second == -1);
+    assert(!inserted && umap_size(m) == 1000);
+
+    /* churn through removals and reinsertions to exercise tombstones */
+    for (i = 0; i < 1000; i += 2) {
+        assert(umap_remove_key(flat_int, m, i));
+        assert(!umap_remove_key(flat_int, m, i));
+    }
+    assert(umap_size(m) == 500);
+    for (i = 0; i < 1000; ++i) {
+        assert((umap_find(flat_int, m, i) != NULL) == (i & 1));
+    }
+    for (i = 0; i < 1000; i += 2) {
+        p.first = i;
+        p.second = i * 2;
+        umap_insert(flat_int, m, p);
+    }
+    assert(umap_size(m) == 1000);
+    umap_iter(flat_int, m, it) {
+        assert(it->first >= 0 && it->first < 1000 && !seen[it->first]);
+        assert(it->second == it->first * 2);
+        seen[it->first] = 1;
+        ++count;
+    }
+    assert(count == 1000);
+
+    copy = umap_createCopy(flat_int, m);
+    assert(umap_size(copy) == 1000);
+    for (i = 0; i < 1000; ++i) {
+        assert(*umap_at(flat_int, copy, i) == i * 2);
+    }
+    umap_clear(flat_int, m);
+    assert(umap_empty(m) && !umap_find(flat_int, m, 1));
+    count = 0;
+    umap_iter(flat_int, m, it) {
+        ++count;
+    }
+    assert(count == 0);
+    assert(umap_size(copy) == 1000);
+    umap_free(flat_int, m);
+    umap_free(flat_int, copy);
+
+    ms = umap_new(flat_str);
+    assert(umap_rehash(flat_str, ms, 33));
+    assert(umap_bucket_count(ms) == 64);
+    umap_insert_fromArray(flat_str, ms, arrStr, 50);
+    assert(umap_bucket_count(ms) == 128);
+    assert(umap_rehash(flat_str, ms, 1024));
+    assert(umap_bucket_count(ms) == 1024);
+    assert(!umap_rehash(flat_str, ms, UINT_MAX));
+    for (i = 0; i < 50; ++i) {
+        Pair_flat_str *ptr = umap_find(flat_str, ms, strs[i]);
+        assert(ptr && ptr->second == i && ptr->first != strs[i]);
+    }
+    assert(umap_remove_key(flat_str, ms, strs[5]));
+    assert(!umap_find(flat_str, ms, strs[5]) && umap_size(ms) == 49);
+    umap_free(flat_str, ms);
+}
+
+void test_int_hash(void) {
+    UMap_hashed *m = umap_new(hashed);
+    UMap_flat_hashed *fm = umap_new(flat_hashed);
+    Pair_hashed p;
+    Pair_flat_hashed fp;
+    unsigned long i, used;
+    /* keys that only differ in their high bits must still spread out */
+    for (i = 0; i < 5000; ++i) {
+        p.first = fp.first = i << 20;
+        p.second = fp.second = (int) i;
+        assert(umap_insert(hashed, m, p));
+        assert(umap_insert(flat_hashed, fm, fp));
+    }
+    assert(umap_size(m) == 5000 && umap_size(fm) == 5000);
+    assert(umap_bucket_count(m) == 8192);
+    for (i = 0; i < 5000; ++i) {
+        assert(*umap_at(hashed, m, i << 20) == (int) i);
+        assert(*umap_at(flat_hashed, fm, i << 20) == (int) i);
+    }
+    assert(!umap_find(hashed, m, 1) && !umap_find(flat_hashed, fm, 1));
+    for (i = 0; i < 5000; i += 2) {
+        assert(umap_remove_key(hashed, m, i << 20));
+        assert(umap_remove_key(flat_hashed, fm, i << 20));
+    }
+    for (i = 0; i < 5000; ++i) {
+        assert((umap_find(hashed, m, i << 20) != NULL) == (i & 1));
+        assert((umap_find(flat_hashed, fm, i << 20) != NULL) == (i & 1));
+    }
+    umap_free(hashed, m);
+    umap_free(flat_hashed, fm);
+
+    /* strided keys must not share buckets (at random, ~70% would be occupied) */
+    m = umap_new(hashed);
+    for (i = 0; i < 200000; ++i) {
+        p.first = i * 4096;
+        p.second = (int) i;
+        assert(umap_insert(hashed, m, p));
+    }
+    for (i = 0, used = 0; i < umap_bucket_count(m); ++i) {
+        used += m->buckets[i] != NULL;
+    }
+    assert(used > 200000 / 2);
+    umap_free(hashed, m);
+}
+
+void test_stored_hash(void) {
+    UMap_stored *m = umap_new(stored), *copy;
+    Pair_stored p;
+    int i;
+    char buf[16];
+    for (i = 0; i < 1000; ++i) {
+        sprintf(buf, "k%d", i);
+        p.first = buf;
+        p.second = i;
+        assert(umap_insert(stored, m, p));
+    }
+    /* growing from 32 to 2048 buckets never hashed a key again */
+    assert(hashCalls == 1000);
+    assert(umap_bucket_count(m) == 2048);
+    assert(umap_rehash(stored, m, 4096));
+    assert(hashCalls == 1000);
+
+    for (i = 0; i < 1000; ++i) {
+        sprintf(buf, "k%d", i);
+        assert(*umap_at(stored, m, buf) == i);
+    }
+    assert(!umap_find(stored, m, "k1000"));
+    for (i = 0; i < 1000; i += 2) {
+        sprintf(buf, "k%d", i);
+        assert(umap_remove_key(stored, m, buf));
+        assert(!umap_remove_key(stored, m, buf));
+    }
+    assert(umap_size(m) == 500);
+    copy = umap_createCopy(stored, m);
+    for (i = 0; i < 1000; ++i) {
+        sprintf(buf, "k%d", i);
+        assert((umap_find(stored, copy, buf) != NULL) == (i & 1));
+    }
+    umap_free(stored, m);
+    umap_free(stored, copy);
+}
+
+void test_incremental_rehash(void) {
+    UMap_hashed *m = umap_new(hashed), *copy;
+    Pair_hashed p, *it;
+    unsigned long i;
+    int count = 0, migrating = 0;
+    umap_set_incremental_rehash(hashed, m, 1);
+    for (i = 0; i < 3000; ++i) {
+        p.first = i;
+        p.second = (int) i;
+        assert(umap_insert(hashed, m, p));
+        if (m->oldBuckets) ++migrating;
+        if (i == 1600) {
+            /* 2048 -> 4096 buckets was just started */
+            assert(m->oldBuckets && umap_bucket_count(m) == 4096);
+            copy = umap_createCopy(hashed, m);
+            assert(umap_size(copy) == 1601 && *umap_at(hashed, copy, 1600) == 1600);
+            umap_free(hashed, copy);
+        }
+        assert(*umap_at(hashed, m, i) == (int) i);
+        assert(*umap_at(hashed, m, i / 2) == (int) (i / 2));
+    }
+    assert(migrating);
+    assert(umap_rehash(hashed, m, 8192) && m->oldBuckets);
+    for (i = 0; i < 3000; i += 2) assert(umap_remove_key(hashed, m, i));
+    umap_iter(hashed, m, it) {
+        assert(it->first & 1);
+        ++count;
+    }
+    assert(count == 1500 && umap_size(m) == 1500);
+    for (i = 0; i < 3000; ++i) {
+        assert((umap_find(hashed, m, i) != NULL) == (i & 1));
+    }
+
+    assert(umap_rehash(hashed, m, 16384) && m->oldBuckets);
+    umap_set_incremental_rehash(hashed, m, 0);
+    assert(!m->oldBuckets && umap_size(m) == 1500);
+    assert(umap_rehash(hashed, m, 32768) && !m->oldBuckets);
+    umap_set_incremental_rehash(hashed, m, 1);
+    assert(umap_rehash(hashed, m, 65536) && m->oldBuckets);
+    umap_clear(hashed, m);
+    assert(!m->oldBuckets && umap_empty(m) && !umap_find(hashed, m, 1));
+    umap_free(hashed, m);
+}
+
+void test_pool(void) {
+    UMap_strv_int *m = umap_new_withPool(strv_int, 16), *copy;
+    UMap_flat_int *f = umap_new_withPool(flat_int, 16);
+    Pair_strv_int p;
+    DictData data[50] = {0};
+    int i;
+    for (i = 0; i < 50; ++i) {
+        data[i].i = i;
+        data[i].s = strs[i];
+        p.first = strs[i];
+        p.second = i;
+        umap_insert(strv_int, m, p);
+    }
+    compare_strv_int(m, data, 50);
+    for (i = 0; i < 50; i += 5) {
+        assert(umap_remove_key(strv_int, m, strs[i]));
+    }
+    for (i = 0; i < 50; i += 5) {
+        p.first = strs[i];
+        p.second = i;
+        umap_insert(strv_int, m, p);
+    }
+    compare_strv_int(m, data, 50);
+
+    copy = umap_createCopy(strv_int, m);
+    assert(copy->pool.chunk == 16);
+    umap_clear(strv_int, m);
+    assert(umap_empty(m) && !m->pool.slabs);
+    compare_strv_int(copy, data, 50);
+    p.first = strs[3];
+    p.second = 3;
+    umap_insert(strv_int, m, p);
+    compare_strv_int(m, &data[3], 1);
+    umap_free(strv_int, m);
+    umap_free(strv_int, copy);
+    assert(umap_empty(f));
+    umap_free(flat_int, f);
+}
+
 int main(void) {
     test_empty_init();
     test_init_fromArray();
@@ -639,5 +921,10 @@ int main(void) {
     test_set_load_factor();
     test_rehash();
     test_nested_dicts();
+    test_flat_backend();
+    test_int_hash();
+    test_stored_hash();
+    test_incremental_rehash();
+    test_pool();
     return 0;
 }
@@ -5,8 +5,14 @@
 
 gen_uset_headers(int, int)
 gen_uset_headers(str, char *)
+gen_uset_headers_flat(flat_int, int)
+gen_uset_headers_flat(flat_str, char *)
+gen_uset_headers_storeHash(stored, char *)
 gen_uset_source(int, int, ds_cmp_num_eq, DSDefault_addrOfVal, DSDefault_sizeOfVal, DSDefault_shallowCopy, DSDefault_shallowDelete)
 gen_uset_source(str, char *, ds_cmp_str_eq, DSDefault_addrOfRef, DSDefault_sizeOfStr, DSDefault_deepCopyStr, DSDefault_deepDelete)
+gen_uset_source_flat(flat_int, int, ds_cmp_num_eq, DSDefault_addrOfVal, DSDefault_sizeOfVal, DSDefault_shallowCopy, DSDefault_shallowDelete)
+gen_uset_source_flat(flat_str, char *, ds_cmp_str_eq, DSDefault_addrOfRef, DSDefault_sizeOfStr, DSDefault_deepCopyStr, DSDefault_deepDelete)
+gen_uset_source(stored, char *, ds_cmp_str_eq, DSDefault_addrOfRef, DSDefault_sizeOfStr, DSDefault_shallowCopy, DSDefault_shallowDelete)
 
 char *strs[] = {"000","001","002","003","004","005","006","007","008","009","010","011","012","013","014",
 "015","016","017","018","019","020","021","022","023","024","025","026","027","028","029","030","031","032","033",
@@ -349,6 +355,72 @@ void test_rehash(void) {
     uset_free(str, ss);
 }
 
+void test_flat_backend(void) {
+    USet_flat_int *si = uset_new(flat_int), *copy;
+    USet_flat_str *ss = uset_new_fromArray(flat_str, strs, 50);
+    int i, *it, inserted = 0, count = 0, seen[2000] = {0};
+    char **sit;
+
+    for (i = 0; i < 2000; ++i) {
+        uset_insert_withResult(flat_int, si, i, &inserted);
+        assert(inserted);
+    }
+    uset_insert_withResult(flat_int, si, 7, &inserted);
+    assert(!inserted && uset_size(si) == 2000);
+    for (i = 0; i < 2000; i += 3) {
+        assert(uset_remove(flat_int, si, i));
+    }
+    for (i = 0; i < 2000; ++i) {
+        assert(uset_contains(flat_int, si, i) == (i % 3 != 0));
+    }
+    for (i = 0; i < 2000; i += 3) {
+        uset_insert(flat_int, si, i);
+    }
+    assert(uset_size(si) == 2000);
+    uset_iter(flat_int, si, it) {
+        assert(*it >= 0 && *it < 2000 && !seen[*it]);
+        seen[*it] = 1;
+        ++count;
+    }
+    assert(count == 2000);
+    copy = uset_createCopy(flat_int, si);
+    uset_clear(flat_int, si);
+    assert(uset_empty(si) && !uset_contains(flat_int, si, 1));
+    assert(uset_size(copy) == 2000 && uset_contains(flat_int, copy, 1999));
+    uset_free(flat_int, si);
+    uset_free(flat_int, copy);
+
+    assert(uset_size(ss) == 50 && uset_bucket_count(ss) == 128);
+    count = 0;
+    uset_iter(flat_str, ss, sit) {
+        assert(strlen(*sit) == 3);
+        ++count;
+    }
+    assert(count == 50);
+    for (i = 0; i < 50; ++i) {
+        assert(uset_contains(flat_str, ss, strs[i]));
+    }
+    assert(uset_remove(flat_str, ss, strs[0]) && !uset_contains(flat_str, ss, strs[0]));
+    assert(uset_rehash(flat_str, ss, 1024) && uset_bucket_count(ss) == 1024);
+    assert(!uset_rehash(flat_str, ss, UINT_MAX));
+    assert(uset_size(ss) == 49 && uset_contains(flat_str, ss, strs[49]));
+    uset_free(flat_str, ss);
+}
+
+void test_stored_hash(void) {
+    USet_stored *s = uset_new_fromArray(stored, strs, 50);
+    int i;
+    assert(uset_size(s) == 50);
+    assert(uset_rehash(stored, s, 1024));
+    for (i = 0; i < 50; ++i) {
+        assert(uset_contains(stored, s, strs[i]));
+    }
+    assert(!uset_contains(stored, s, "050"));
+    for (i = 0; i < 50; i += 2) assert(uset_remove(stored, s, strs[i]));
+    for (i = 0; i < 50; ++i) assert(uset_contains(stored, s, strs[i]) == (i & 1));
+    uset_free(stored, s);
+}
+
 int main(void) {
     test_empty_init();
     test_init_fromArray();
@@ -359,5 +431,7 @@ int main(void) {
     test_find();
     test_set_load_factor();
     test_rehash();
+    test_flat_backend();
+    test_stored_hash();
     return 0;
 }